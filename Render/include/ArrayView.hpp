@@ -0,0 +1,46 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT)
+* (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace m3d {
+
+/* Non owning, read only view of a contiguous array */
+template <class T>
+class ArrayView {
+public:
+    ArrayView()
+        : ptr(nullptr)
+        , count(0)
+    {
+    }
+    ArrayView(const T* data, size_t size)
+        : ptr(data)
+        , count(size)
+    {
+    }
+    ArrayView(const std::vector<T>& v)
+        : ptr(v.data())
+        , count(v.size())
+    {
+    }
+
+    const T* data() const { return ptr; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    const T* begin() const { return ptr; }
+    const T* end() const { return ptr + count; }
+    const T& operator[](size_t i) const { return ptr[i]; }
+
+private:
+    const T* ptr;
+    size_t count;
+};
+} // End of namespace m3d
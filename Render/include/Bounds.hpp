@@ -0,0 +1,255 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT)
+* (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+
+#include "Matrix.h"
+#include "Quaternion.h"
+
+namespace m3d {
+
+struct AABB {
+    m3d::math::Vector3 min;
+    m3d::math::Vector3 max;
+
+    static AABB Empty()
+    {
+        AABB box;
+        box.min = m3d::math::Vector3(FLT_MAX, FLT_MAX, FLT_MAX);
+        box.max = m3d::math::Vector3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+        return box;
+    }
+
+    bool IsEmpty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+
+    m3d::math::Vector3 Center() const { return (min + max) * 0.5f; }
+    m3d::math::Vector3 Extents() const { return (max - min) * 0.5f; }
+
+    void Expand(const m3d::math::Vector3& p)
+    {
+        min = m3d::math::Vector3(std::fmin(min.x, p.x), std::fmin(min.y, p.y), std::fmin(min.z, p.z));
+        max = m3d::math::Vector3(std::fmax(max.x, p.x), std::fmax(max.y, p.y), std::fmax(max.z, p.z));
+    }
+
+    void Expand(const AABB& other)
+    {
+        Expand(other.min);
+        Expand(other.max);
+    }
+};
+
+struct Sphere {
+    m3d::math::Vector3 center;
+    float radius;
+};
+
+struct Ray {
+    m3d::math::Vector3 origin;
+    m3d::math::Vector3 direction;
+    float tMax;
+};
+
+/* Points p with (normal | p) + d >= 0 are on the inner side */
+struct Plane {
+    m3d::math::Vector3 normal;
+    float d;
+
+    float Distance(const m3d::math::Vector3& p) const { return (normal | p) + d; }
+};
+
+enum class Containment {
+    Outside,
+    Intersect,
+    Inside
+};
+
+struct Frustum {
+    enum { Left = 0,
+        Right,
+        Bottom,
+        Top,
+        Near,
+        Far,
+        PlaneCount };
+
+    Plane planes[PlaneCount];
+
+    /* Gribb/Hartmann extraction, expects clip = viewProj * p (translation in m[i][3]) */
+    static Frustum FromMatrix(const m3d::math::Matrix4x4& viewProj)
+    {
+        const float(&m)[4][4] = viewProj.m;
+        Frustum f;
+        for (int i = 0; i < 3; ++i) {
+            Plane& lo = f.planes[i * 2];
+            Plane& hi = f.planes[i * 2 + 1];
+            lo.normal = m3d::math::Vector3(m[3][0] + m[i][0], m[3][1] + m[i][1], m[3][2] + m[i][2]);
+            lo.d = m[3][3] + m[i][3];
+            hi.normal = m3d::math::Vector3(m[3][0] - m[i][0], m[3][1] - m[i][1], m[3][2] - m[i][2]);
+            hi.d = m[3][3] - m[i][3];
+        }
+        for (int i = 0; i < PlaneCount; ++i) {
+            Plane& p = f.planes[i];
+            const float invLength = 1.0f / std::sqrt(p.normal | p.normal);
+            p.normal *= invLength;
+            p.d *= invLength;
+        }
+        return f;
+    }
+
+    /* Builds the planes directly from camera parameters, fovY in degrees */
+    static Frustum FromPerspective(const m3d::math::Vector3& eye, const m3d::math::Vector3& target, const m3d::math::Vector3& up,
+        float fovY, float aspect, float nearZ, float farZ)
+    {
+        using m3d::math::Vector3;
+
+        Vector3 forward = target - eye;
+        forward.Normalize();
+        Vector3 right = forward ^ up;
+        right.Normalize();
+        const Vector3 realUp = right ^ forward;
+
+        const float halfV = std::tan(fovY * 0.5f * m3d::math::PI_F / 180.0f);
+        const float halfH = halfV * aspect;
+
+        Frustum f;
+        auto setPlane = [&](int index, Vector3 normal, const Vector3& point) {
+            normal.Normalize();
+            f.planes[index].normal = normal;
+            f.planes[index].d = -(normal | point);
+        };
+        setPlane(Near, forward, eye + forward * nearZ);
+        setPlane(Far, -forward, eye + forward * farZ);
+        // side planes pass through the eye, normals point into the volume
+        setPlane(Left, (forward - right * halfH) ^ realUp, eye);
+        setPlane(Right, realUp ^ (forward + right * halfH), eye);
+        setPlane(Bottom, right ^ (forward - realUp * halfV), eye);
+        setPlane(Top, (forward + realUp * halfV) ^ right, eye);
+        return f;
+    }
+};
+
+inline bool Intersects(const AABB& a, const AABB& b)
+{
+    return a.min.x <= b.max.x && a.max.x >= b.min.x
+        && a.min.y <= b.max.y && a.max.y >= b.min.y
+        && a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+inline bool Intersects(const AABB& box, const Sphere& sphere)
+{
+    const float dx = std::fmax(std::fmax(box.min.x - sphere.center.x, 0.0f), sphere.center.x - box.max.x);
+    const float dy = std::fmax(std::fmax(box.min.y - sphere.center.y, 0.0f), sphere.center.y - box.max.y);
+    const float dz = std::fmax(std::fmax(box.min.z - sphere.center.z, 0.0f), sphere.center.z - box.max.z);
+    return dx * dx + dy * dy + dz * dz <= sphere.radius * sphere.radius;
+}
+
+/* Slab test, writes the entry distance into tHit when the ray hits within [0, tMax] */
+inline bool Intersects(const Ray& ray, const AABB& box, float* tHit = nullptr)
+{
+    float tNear = 0.0f;
+    float tFar = ray.tMax;
+    const float* origin = &ray.origin.x;
+    const float* direction = &ray.direction.x;
+    const float* lo = &box.min.x;
+    const float* hi = &box.max.x;
+    for (int i = 0; i < 3; ++i) {
+        if (std::fabs(direction[i]) < 1e-12f) {
+            if (origin[i] < lo[i] || origin[i] > hi[i])
+                return false;
+            continue;
+        }
+        const float invD = 1.0f / direction[i];
+        float t0 = (lo[i] - origin[i]) * invD;
+        float t1 = (hi[i] - origin[i]) * invD;
+        if (t0 > t1) {
+            const float tmp = t0;
+            t0 = t1;
+            t1 = tmp;
+        }
+        tNear = std::fmax(tNear, t0);
+        tFar = std::fmin(tFar, t1);
+        if (tNear > tFar)
+            return false;
+    }
+    if (tHit)
+        *tHit = tNear;
+    return true;
+}
+
+inline Containment Classify(const Frustum& frustum, const AABB& box)
+{
+    const m3d::math::Vector3 center = box.Center();
+    const m3d::math::Vector3 extents = box.Extents();
+    Containment result = Containment::Inside;
+    for (int i = 0; i < Frustum::PlaneCount; ++i) {
+        const Plane& p = frustum.planes[i];
+        const float radius = extents.x * std::fabs(p.normal.x) + extents.y * std::fabs(p.normal.y) + extents.z * std::fabs(p.normal.z);
+        const float distance = p.Distance(center);
+        if (distance < -radius)
+            return Containment::Outside;
+        if (distance < radius)
+            result = Containment::Intersect;
+    }
+    return result;
+}
+
+/*
+ * Classify starting at plane *planeHint, the plane that rejected the box
+ * last time: a box that stays outside is rejected by one test. *planeHint
+ * is set to the rejecting plane when the box is outside.
+ */
+inline Containment Classify(const Frustum& frustum, const AABB& box, uint32_t* planeHint)
+{
+    const m3d::math::Vector3 center = box.Center();
+    const m3d::math::Vector3 extents = box.Extents();
+    const uint32_t first = *planeHint < Frustum::PlaneCount ? *planeHint : 0;
+    Containment result = Containment::Inside;
+    for (uint32_t n = 0; n < Frustum::PlaneCount; ++n) {
+        const uint32_t i = (first + n) % Frustum::PlaneCount;
+        const Plane& p = frustum.planes[i];
+        const float radius = extents.x * std::fabs(p.normal.x) + extents.y * std::fabs(p.normal.y) + extents.z * std::fabs(p.normal.z);
+        const float distance = p.Distance(center);
+        if (distance < -radius) {
+            *planeHint = i;
+            return Containment::Outside;
+        }
+        if (distance < radius)
+            result = Containment::Intersect;
+    }
+    return result;
+}
+
+inline bool Intersects(const Frustum& frustum, const AABB& box)
+{
+    return Classify(frustum, box) != Containment::Outside;
+}
+
+/* Conservative world bounds of a local box under translate * rotate * scale */
+inline AABB TransformAABB(const AABB& local, const m3d::math::Vector3& position, const m3d::math::Quaternion& rotation, const m3d::math::Vector3& scale)
+{
+    using m3d::math::Vector3;
+
+    const Vector3 center = rotation * (local.Center() * scale) + position;
+    const Vector3 extents = local.Extents() * Vector3(std::fabs(scale.x), std::fabs(scale.y), std::fabs(scale.z));
+
+    const Vector3 axisX = rotation * Vector3(1.0f, 0.0f, 0.0f);
+    const Vector3 axisY = rotation * Vector3(0.0f, 1.0f, 0.0f);
+    const Vector3 axisZ = rotation * Vector3(0.0f, 0.0f, 1.0f);
+    const Vector3 worldExtents(
+        std::fabs(axisX.x) * extents.x + std::fabs(axisY.x) * extents.y + std::fabs(axisZ.x) * extents.z,
+        std::fabs(axisX.y) * extents.x + std::fabs(axisY.y) * extents.y + std::fabs(axisZ.y) * extents.z,
+        std::fabs(axisX.z) * extents.x + std::fabs(axisY.z) * extents.y + std::fabs(axisZ.z) * extents.z);
+
+    AABB world;
+    world.min = center - worldExtents;
+    world.max = center + worldExtents;
+    return world;
+}
+} // End of namespace m3d
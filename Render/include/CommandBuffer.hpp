@@ -8,12 +8,17 @@
 #include <vector>
 #include <vulkan/vulkan.hpp>
 
+#include "Matrix.h"
+
 // TODO: move into namespace ::m3d
 
 namespace m3d {
 class VulkanSwapChain;
 class Scene;
 class Pipeline;
+class RenderQueue;
+class MemoryReport;
+struct VertexFormat;
 
 class CommandBuffer {
 public:
@@ -26,16 +31,45 @@ public:
 
     /* Vertex */
     void CreateBuffer(vk::BufferUsageFlags, vk::MemoryPropertyFlags, vk::DeviceSize, void* data, vk::Buffer& buffer, vk::DeviceMemory& memory);
-    void CreateVertices(std::vector<float>& vertices, std::vector<uint32_t> &indices);
+    void CreateVertices(std::vector<uint8_t>& vertices, std::vector<uint32_t>& indices, std::vector<uint16_t>& shortIndices);
+    /*
+     * Packs every mesh of the scene into one vertex buffer of the given format
+     * and its indices into a 16 or a 32 bit index buffer, replacing the previous ones.
+     * Levels of detail finer than firstLod are left out, see LodSelection::firstLod.
+     */
+    void CreateSceneBuffers(Scene&, const VertexFormat&, uint32_t firstLod = 0);
+    void DestroySceneBuffers();
 
     uint32_t Create(vk::CommandBufferLevel level, bool begin);
     void Flush(uint32_t index);
-    void Build(Pipeline&);
+    void Build(Pipeline&, const Scene&, const RenderQueue&);
+    /* Re-records the draw command buffer of one swap chain image from the draw list */
+    void Record(uint32_t index, Pipeline&, const Scene&, const RenderQueue&);
+    /*
+     * Recomputes the cached world matrices of the transforms in
+     * scene.dirtyTransforms, of every transform after CreateSceneBuffers.
+     * The caller may clear the dirty set right after, images updated in
+     * later frames catch up through the versions.
+     */
+    void UpdateTransforms(const Scene&);
+    /*
+     * Stages the world matrix of every queued item whose transform changed, or
+     * that holds another instance than the last time this swap chain image was
+     * updated; Record copies the staged items in coalesced regions.
+     */
+    void UpdateInstances(uint32_t index, const Scene&, const RenderQueue&);
+
+    /* Device bytes of each mesh, the instance and depth buffers, and the renderer's caches */
+    void ReportMemory(const Scene&, MemoryReport&) const;
 
 	std::vector<vk::CommandBuffer>& GetDrawCommandBuffers() { return drawCmdBuffers; }
 
 private:
     void createCommandPool();
+    void reserveInstanceBuffer(uint32_t index, uint32_t instanceCount);
+    void destroyInstanceBuffer(uint32_t index);
+    /* Device local buffer filled from data through a staging copy */
+    void createDeviceBuffer(vk::BufferUsageFlags usage, vk::DeviceSize size, void* data, vk::Buffer& buffer, vk::DeviceMemory& memory);
 
 private:
     vk::Device& device;
@@ -50,8 +84,47 @@ private:
     struct {
         StagingBuffer vertices;
         StagingBuffer indices;
+        // meshes whose slices all fit 16 bit indices, relative to each slice's baseVertex
+        StagingBuffer shortIndices;
         uint32_t indexCount;
     } meshBuffer;
+    /* where each mesh starts in meshBuffer, indexed by the 16 LSBs of the mesh id */
+    struct MeshRange {
+        int32_t vertexOffset;
+        // into shortIndices for eUint16, indices otherwise
+        uint32_t firstIndex;
+        vk::IndexType indexType;
+    };
+    std::vector<MeshRange> meshRanges;
+    // vertex and index bytes uploaded for each mesh, same indexing
+    std::vector<uint64_t> meshGpuBytes;
+
+    /*
+     * Per instance world matrices in item order, one device local buffer per
+     * swap chain image so the CPU never stages into a buffer the GPU is still
+     * reading. The staging buffer mirrors it and is kept mapped; both grow on
+     * demand.
+     */
+    struct InstanceBuffer {
+        vk::DeviceMemory mem;
+        vk::Buffer buf;
+        vk::DeviceMemory stagingMem;
+        vk::Buffer stagingBuf;
+        void* mapped = nullptr;
+        uint32_t capacity = 0;
+        // transform slot written to each item, a prefab part in the 16 MSBs, ~0 when never written
+        std::vector<uint32_t> itemTransforms;
+        // transformVersion when last updated
+        uint32_t version = 0;
+        // staged items for Record to copy
+        std::vector<vk::BufferCopy> copies;
+    };
+    std::vector<InstanceBuffer> instanceBuffers;
+
+    /* World matrix of each transform slot and the transformVersion it last changed in */
+    std::vector<m3d::math::Matrix4x4> worldMatrices;
+    std::vector<uint32_t> worldVersions;
+    uint32_t transformVersion;
 
     /* frame buffers */
     std::vector<vk::Framebuffer> frameBuffers;
@@ -60,6 +133,7 @@ private:
         vk::Image image;
         vk::DeviceMemory mem;
         vk::ImageView view;
+        vk::DeviceSize bytes;
     } depthStencil;
 
     vk::CommandPool cmdPool;
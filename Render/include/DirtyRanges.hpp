@@ -0,0 +1,81 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT)
+* (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace m3d {
+struct SlotRange {
+    uint32_t first;
+    uint32_t count;
+};
+
+/*
+ * Appends index to ranges in ascending order. An index at most maxGap
+ * indices past the end of the last range grows it, copying the few clean
+ * entries in between is cheaper than another copy region.
+ */
+void AppendRange(std::vector<SlotRange>& ranges, uint32_t index, uint32_t maxGap = 0);
+
+/*
+ * One bit per packed_freelist slot (the 16 LSBs of an id) of a scene array
+ * that changed since the last Clear(). Growing on Mark() is the only
+ * allocation; iterating skips clean runs 64 slots at a time.
+ */
+class DirtyRanges {
+public:
+    DirtyRanges();
+
+    void Mark(uint32_t id);
+    bool IsDirty(uint32_t id) const;
+    bool Any() const { return any; }
+    void Clear();
+
+    /* fn(uint32_t slot) for every dirty slot, ascending */
+    template <class Fn>
+    void ForEach(Fn fn) const;
+
+    /* Appends the dirty slots as ranges, see AppendRange */
+    void GetRanges(std::vector<SlotRange>& ranges, uint32_t maxGap = 0) const;
+
+private:
+    static const uint32_t index_mask = 0xFFFF;
+
+    static uint32_t countTrailingZeros(uint64_t word)
+    {
+#ifdef _MSC_VER
+        unsigned long bit;
+        _BitScanForward64(&bit, word);
+        return bit;
+#else
+        return static_cast<uint32_t>(__builtin_ctzll(word));
+#endif
+    }
+
+    std::vector<uint64_t> words;
+    bool any;
+};
+
+template <class Fn>
+void DirtyRanges::ForEach(Fn fn) const
+{
+    if (!any)
+        return;
+    for (uint32_t w = 0; w < words.size(); ++w) {
+        uint64_t word = words[w];
+        while (word) {
+            fn(w * 64 + countTrailingZeros(word));
+            word &= word - 1;
+        }
+    }
+}
+} // End of namespace m3d
@@ -0,0 +1,293 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT)
+* (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ThreadPool.hpp"
+
+namespace m3d {
+const uint32_t MaxComponentTypes = 32;
+// bit i set when the entity has component type i
+typedef uint32_t ComponentMask;
+
+/* How the store constructs, moves and destroys a component type it only knows by id */
+struct ComponentInfo {
+    uint32_t size;
+    uint32_t alignment;
+    // move constructs dst from src and destroys src
+    void (*move)(void* dst, void* src);
+    void (*destroy)(void* component);
+};
+
+/* Runtime id of a component type, in order of first use */
+uint32_t RegisterComponentType(const ComponentInfo& info);
+const ComponentInfo& GetComponentInfo(uint32_t typeId);
+
+template <class T>
+struct ComponentOps {
+    static void Move(void* dst, void* src)
+    {
+        T* source = static_cast<T*>(src);
+        new (dst) T(std::move(*source));
+        source->~T();
+    }
+    static void Destroy(void* component) { static_cast<T*>(component)->~T(); }
+};
+
+template <class T>
+uint32_t ComponentTypeId()
+{
+    static const uint32_t id = RegisterComponentType(
+        ComponentInfo{ sizeof(T), alignof(T), &ComponentOps<T>::Move, &ComponentOps<T>::Destroy });
+    return id;
+}
+
+template <class... Ts>
+struct ComponentMaskOf;
+
+template <>
+struct ComponentMaskOf<> {
+    static ComponentMask Get() { return 0; }
+};
+
+template <class T, class... Ts>
+struct ComponentMaskOf<T, Ts...> {
+    static ComponentMask Get() { return (ComponentMask(1) << ComponentTypeId<T>()) | ComponentMaskOf<Ts...>::Get(); }
+};
+
+/*
+ * Archetype storage: entities with the same set of components live together
+ * in fixed size chunks, each component type in its own array inside the
+ * chunk, so iterating a few components of many entities reads contiguous
+ * memory only. Chunks of an archetype stay packed, removing an entity moves
+ * the archetype's last one into the hole.
+ *
+ * Entity handles are like packed_freelist ids: the 16 LSBs index the entity
+ * record, the 16 MSBs count reuses of it, so a handle stays valid while
+ * its entity moves between chunks and archetypes, and a stale one is not
+ * alive. Component pointers are only valid until the next structural
+ * change (Create, Destroy, Add of a new type, Remove).
+ */
+class EntityStore {
+public:
+    static const uint32_t ChunkSize = 16 * 1024;
+    static const uint32_t MaxEntities = 0xFFFF;
+
+    EntityStore();
+    ~EntityStore();
+
+    template <class... Ts>
+    uint32_t Create(const Ts&... components);
+    void Destroy(uint32_t entity);
+    bool IsAlive(uint32_t entity) const;
+    uint32_t GetEntityCount() const { return entityCount; }
+
+    template <class T>
+    bool Has(uint32_t entity) const;
+    /* nullptr when the entity has no T */
+    template <class T>
+    T* Get(uint32_t entity);
+    /* Sets the component, moving the entity to another archetype when it had none */
+    template <class T>
+    void Add(uint32_t entity, const T& component);
+    template <class T>
+    void Remove(uint32_t entity);
+
+    /*
+     * fn(uint32_t count, const uint32_t* entities, Ts*... components) once per
+     * chunk of every archetype with at least the components Ts
+     */
+    template <class... Ts, class Fn>
+    void ForEachChunk(Fn fn);
+    /* fn(uint32_t entity, Ts&... components) for every entity with at least the components Ts */
+    template <class... Ts, class Fn>
+    void ForEach(Fn fn);
+    /* ForEach with the chunks spread over the pool; fn runs concurrently and must only touch its entity */
+    template <class... Ts, class Fn>
+    void ParallelForEach(ThreadPool& pool, Fn fn);
+
+private:
+    EntityStore(const EntityStore&) = delete;
+    EntityStore& operator=(const EntityStore&) = delete;
+
+    static const uint32_t index_mask = 0xFFFF;
+    static const uint32_t invalid = 0xFFFFFFFF;
+
+    struct alignas(16) ChunkData {
+        uint8_t bytes[ChunkSize];
+    };
+    struct Chunk {
+        ChunkData* data;
+        uint32_t count;
+    };
+    struct Archetype {
+        ComponentMask mask;
+        std::vector<uint32_t> types;
+        // byte offset of each component type's array in a chunk, invalid when absent
+        uint32_t offsets[MaxComponentTypes];
+        uint32_t sizes[MaxComponentTypes];
+        // entities per chunk, their handles are the first array of the chunk
+        uint32_t capacity;
+        std::vector<Chunk> chunks;
+    };
+    struct EntityRecord {
+        uint32_t id;
+        uint32_t archetype;
+        uint32_t chunk;
+        uint32_t row;
+    };
+
+    uint32_t getArchetype(ComponentMask mask);
+    /* New entity at the end of the archetype, its components not constructed */
+    uint32_t allocateEntity(uint32_t archetype);
+    /* Moves the entity into the archetype of mask; components it gains are not constructed */
+    void changeArchetype(uint32_t entity, ComponentMask mask);
+    /* Appends an unconstructed row, returns its chunk and row */
+    void appendRow(Archetype& archetype, uint32_t entity, uint32_t& chunk, uint32_t& row);
+    /* Fills the row, whose components are already destroyed or moved out, with the archetype's last */
+    void removeRow(uint32_t archetype, uint32_t chunk, uint32_t row);
+    void* componentAt(uint32_t archetype, uint32_t chunk, uint32_t row, uint32_t typeId) const;
+    const EntityRecord* findRecord(uint32_t entity) const;
+
+    template <class T>
+    static T* column(const Archetype& archetype, const Chunk& chunk)
+    {
+        return reinterpret_cast<T*>(chunk.data->bytes + archetype.offsets[ComponentTypeId<T>()]);
+    }
+
+    static const uint32_t* entities(const Chunk& chunk)
+    {
+        return reinterpret_cast<const uint32_t*>(chunk.data->bytes);
+    }
+
+    void construct(const EntityRecord&) {}
+
+    template <class T, class... Ts>
+    void construct(const EntityRecord& record, const T& component, const Ts&... components)
+    {
+        new (componentAt(record.archetype, record.chunk, record.row, ComponentTypeId<T>())) T(component);
+        construct(record, components...);
+    }
+
+    std::vector<Archetype> archetypes;
+    std::unordered_map<ComponentMask, uint32_t> archetypeIndices;
+    std::vector<EntityRecord> records;
+    // free records, reused oldest first like packed_freelist to delay id reuse
+    std::vector<uint32_t> freeRecords;
+    size_t freeHead;
+    uint32_t entityCount;
+};
+
+template <class... Ts>
+uint32_t EntityStore::Create(const Ts&... components)
+{
+    const uint32_t entity = allocateEntity(getArchetype(ComponentMaskOf<Ts...>::Get()));
+    if (entity != invalid)
+        construct(records[entity & index_mask], components...);
+    return entity;
+}
+
+template <class T>
+bool EntityStore::Has(uint32_t entity) const
+{
+    const EntityRecord* record = findRecord(entity);
+    return record && (archetypes[record->archetype].mask & ComponentMaskOf<T>::Get());
+}
+
+template <class T>
+T* EntityStore::Get(uint32_t entity)
+{
+    const EntityRecord* record = findRecord(entity);
+    if (!record || !(archetypes[record->archetype].mask & ComponentMaskOf<T>::Get()))
+        return nullptr;
+    return static_cast<T*>(componentAt(record->archetype, record->chunk, record->row, ComponentTypeId<T>()));
+}
+
+template <class T>
+void EntityStore::Add(uint32_t entity, const T& component)
+{
+    if (T* existing = Get<T>(entity)) {
+        *existing = component;
+        return;
+    }
+    const EntityRecord* record = findRecord(entity);
+    if (!record)
+        return;
+    changeArchetype(entity, archetypes[record->archetype].mask | ComponentMaskOf<T>::Get());
+    construct(records[entity & index_mask], component);
+}
+
+template <class T>
+void EntityStore::Remove(uint32_t entity)
+{
+    if (!Has<T>(entity))
+        return;
+    const EntityRecord& record = records[entity & index_mask];
+    changeArchetype(entity, archetypes[record.archetype].mask & ~ComponentMaskOf<T>::Get());
+}
+
+template <class... Ts, class Fn>
+void EntityStore::ForEachChunk(Fn fn)
+{
+    const ComponentMask mask = ComponentMaskOf<Ts...>::Get();
+    for (const Archetype& archetype : archetypes) {
+        if ((archetype.mask & mask) != mask)
+            continue;
+        for (const Chunk& chunk : archetype.chunks) {
+            fn(chunk.count, entities(chunk), column<Ts>(archetype, chunk)...);
+        }
+    }
+}
+
+template <class... Ts, class Fn>
+void EntityStore::ForEach(Fn fn)
+{
+    const ComponentMask mask = ComponentMaskOf<Ts...>::Get();
+    for (const Archetype& archetype : archetypes) {
+        if ((archetype.mask & mask) != mask)
+            continue;
+        for (const Chunk& chunk : archetype.chunks) {
+            const uint32_t* ids = entities(chunk);
+            for (uint32_t i = 0; i < chunk.count; ++i) {
+                fn(ids[i], column<Ts>(archetype, chunk)[i]...);
+            }
+        }
+    }
+}
+
+template <class... Ts, class Fn>
+void EntityStore::ParallelForEach(ThreadPool& pool, Fn fn)
+{
+    const ComponentMask mask = ComponentMaskOf<Ts...>::Get();
+    std::vector<std::pair<const Archetype*, const Chunk*>> chunks;
+    for (const Archetype& archetype : archetypes) {
+        if ((archetype.mask & mask) != mask)
+            continue;
+        for (const Chunk& chunk : archetype.chunks) {
+            chunks.push_back(std::make_pair(&archetype, &chunk));
+        }
+    }
+
+    // a chunk is a few hundred entities at most, enough work for one task
+    pool.ParallelFor(0, static_cast<uint32_t>(chunks.size()), 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t c = begin; c < end; ++c) {
+            const Archetype& archetype = *chunks[c].first;
+            const Chunk& chunk = *chunks[c].second;
+            const uint32_t* ids = entities(chunk);
+            for (uint32_t i = 0; i < chunk.count; ++i) {
+                fn(ids[i], column<Ts>(archetype, chunk)[i]...);
+            }
+        }
+    });
+}
+} // End of namespace m3d
@@ -0,0 +1,39 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT)
+* (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "Scene.hpp"
+
+/*
+ * Everything that needs the FBX SDK. Only built with M3D_FBX_IMPORT, the
+ * runtime loads scenes cooked by fbxconv through SceneAsset.hpp instead.
+ */
+namespace m3d {
+/*
+ * Receives what ImportFbx extracts, in dependency order: a texture before the
+ * first material using it, materials before the meshes using them. Materials
+ * and textures are referenced by import order: Mesh::materialIds index the
+ * materials handed out so far, Material::diffuseMapId the textures, ImportNone
+ * for none. ImportIds turns them into scene ids.
+ */
+struct FbxImportCallbacks {
+    std::function<void(DiffuseMap&&)> onTexture;
+    std::function<void(Material&&)> onMaterial;
+    std::function<void(Mesh&&)> onMesh;
+    /* Fraction done in [0, 1], returning false cancels the import */
+    std::function<bool(float)> onProgress;
+};
+
+/* Imports, converts and triangulates an FBX file. False on error or when cancelled */
+bool ImportFbx(const char* path, const FbxImportCallbacks& callbacks);
+
+/* Synchronous import of scene->loadPath, see SceneLoader for the background version */
+bool LoadMeshes(Scene* scene, std::vector<uint32_t>* loadedMeshIDs);
+} // End of namespace m3d
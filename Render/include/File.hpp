@@ -6,27 +6,85 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <cstdio>
+#include <string>
 #include <type_traits>
+#include <vector>
+
+#include "ArrayView.hpp"
 
 namespace m3d {
 namespace file {
+    /* Access pattern hints, madvise on POSIX */
+    enum class Access {
+        Normal,
+        Sequential,
+        Random,
+        WillNeed,
+        DontNeed
+    };
+
+    /*
+     * Read only memory mapping of a whole file. Pages are faulted in on first
+     * touch, so opening is cheap and unused parts of the file are never read.
+     * When the file can not be mapped (pipes, some network shares) it is read
+     * into memory instead, pipes until they end; callers see the same
+     * Data()/View() either way.
+     */
+    class MappedFile {
+    public:
+        MappedFile();
+        ~MappedFile();
+        MappedFile(MappedFile&& other) noexcept;
+        MappedFile& operator=(MappedFile&& other) noexcept;
+
+        bool Open(const char* path, Access access = Access::Normal);
+        void Close();
+
+        /* Hints the kernel about a byte range, length 0 means up to the end */
+        void Advise(Access access, size_t offset = 0, size_t length = 0) const;
+
+        bool IsOpen() const { return opened; }
+        /* false when Open fell back to reading the file */
+        bool IsMapped() const { return mapping != nullptr; }
+        const uint8_t* Data() const { return data; }
+        size_t Size() const { return size; }
+
+        /* Bytes [offset, offset + length), clamped to the file */
+        ArrayView<uint8_t> View(size_t offset, size_t length) const;
+
+    private:
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        /* Reads size bytes, or up to the end when size is 0, and closes fp */
+        bool readAll(std::FILE* fp, const char* path);
+
+        const uint8_t* data;
+        size_t size;
+        bool opened;
+        // the mapping, or null when data points into fallback
+        void* mapping;
+        std::vector<uint8_t> fallback;
+#ifdef _WIN32
+        void* fileHandle;
+        void* mappingHandle;
+#endif
+    };
+
     template <class T>
     bool readBinary(const char* path, T& container)
     {
         static_assert(std::is_same<T, std::vector<uint8_t>>::value || std::is_same<T, std::string>::value, "T must be std::vector<uint8_t> or std::string");
-        std::FILE* fp = std::fopen(path, "rb");
-        if (fp) {
-            std::fseek(fp, 0, SEEK_END);
-            container.resize(std::ftell(fp));
-            std::rewind(fp);
-            std::fread(&container[0], 1, container.size(), fp);
-            std::fclose(fp);
-
-            return true;
-        } else {
+        // sizes are 64 bit in MappedFile, ftell capped files at 2 GB
+        MappedFile file;
+        if (!file.Open(path, Access::Sequential)) {
             return false;
         }
+        container.assign(file.Data(), file.Data() + file.Size());
+        return true;
     }
 }
 }
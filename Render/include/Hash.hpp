@@ -0,0 +1,27 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT)
+* (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace m3d {
+/*
+ * XXH64 of size bytes, several GB/s, for finding identical content, not
+ * for security. Chain calls through seed to hash several arrays as one.
+ */
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 0);
+
+template <class T>
+uint64_t HashArray(const std::vector<T>& values, uint64_t seed = 0)
+{
+    // the size goes in too, so [a][bc] and [ab][c] differ
+    const uint64_t count = values.size();
+    return HashBytes(values.data(), values.size() * sizeof(T), HashBytes(&count, sizeof(count), seed));
+}
+} // End of namespace m3d
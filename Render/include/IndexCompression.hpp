@@ -0,0 +1,34 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT)
+* (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * Lossless index buffer compression for scene files. Each index is stored as
+ * the difference to the one before it; after OptimizeVertexFetch neighbouring
+ * indices are close, so most differences fit a byte. Blocks of 16 indices use
+ * the narrowest of 8, 16 or 32 bit differences that holds the whole block:
+ *
+ *   modes: 2 bits per block, 4 blocks per byte
+ *   blocks: 16, 32 or 64 bytes each
+ *   tail: the indexCount % 16 last indices, uncompressed
+ *
+ * Decoding is a sign extension and a prefix sum, done 4 indices at a time
+ * with SSE2 and one at a time where it is missing. Every index takes at least
+ * a byte.
+ */
+namespace m3d {
+const uint32_t IndexBlockSize = 16;
+
+void EncodeIndexBuffer(const uint32_t* indices, size_t indexCount, std::vector<uint8_t>& encoded);
+
+/* Writes indexCount indices to destination, false when the data is too short for them */
+bool DecodeIndexBuffer(uint32_t* destination, size_t indexCount, const uint8_t* data, size_t size);
+} // End of namespace m3d
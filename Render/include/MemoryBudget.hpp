@@ -0,0 +1,106 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT)
+* (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace m3d {
+enum MemoryCategory : uint32_t {
+    MemoryMeshes = 0,
+    MemoryTextures,
+    MemoryMaterials,
+    // transforms, instances and cameras, the freelists' own storage
+    MemorySceneGraph,
+    // cooked scene files meshes point into, page cache rather than heap
+    MemoryMappedFiles,
+    // instance buffers, depth buffer and caches of the renderer
+    MemoryRenderer,
+    MemoryCategoryCount
+};
+
+const char* GetMemoryCategoryName(MemoryCategory category);
+
+struct MemoryUsage {
+    uint64_t cpuBytes;
+    uint64_t gpuBytes;
+};
+
+/* What one asset, a mesh or texture id of a category, takes */
+struct AssetMemory {
+    MemoryCategory category;
+    uint32_t id;
+    std::string name;
+    MemoryUsage usage;
+};
+
+/*
+ * Bytes per category and per asset, filled by ReportSceneMemory and
+ * CommandBuffer::ReportMemory. Sizes are what the containers hold
+ * (capacities, not sizes) and what was allocated on the device; texture
+ * sizes are estimated from their dimensions.
+ */
+class MemoryReport {
+public:
+    void Clear();
+
+    /* Bytes not owned by any single asset */
+    void Add(MemoryCategory category, uint64_t cpuBytes, uint64_t gpuBytes);
+    /* Bytes of an asset, summed with earlier reports of the same category and id */
+    void AddAsset(MemoryCategory category, uint32_t id, const std::string& name, uint64_t cpuBytes, uint64_t gpuBytes);
+
+    const MemoryUsage& GetCategory(MemoryCategory category) const { return categories[category]; }
+    MemoryUsage GetTotal() const;
+    const std::vector<AssetMemory>& GetAssets() const { return assets; }
+
+    /* A table per category, its largest maxAssets assets listed */
+    void WriteText(std::string& out, uint32_t maxAssets = 8) const;
+    /*
+     * {"total":{"cpu":..,"gpu":..},"categories":{"meshes":{"cpu":..,"gpu":..,
+     * "assets":[{"id":..,"name":"..","cpu":..,"gpu":..}, ...]}, ...}}, every asset listed
+     */
+    void WriteJson(std::string& out) const;
+
+private:
+    MemoryUsage categories[MemoryCategoryCount] = {};
+    std::vector<AssetMemory> assets;
+    // category in the 32 MSBs, id in the LSBs, to the index in assets
+    std::unordered_map<uint64_t, size_t> assetIndices;
+};
+
+/* Bytes of a 4 byte per texel 2D texture with its mip chain, the first firstMip levels evicted */
+uint64_t GetTextureBytes(uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t firstMip = 0);
+
+/* Limits on device memory, 0 is unlimited */
+struct MemoryBudget {
+    uint64_t meshGpuBytes;
+    uint64_t textureGpuBytes;
+};
+
+/*
+ * How far the renderer steps down to stay in budget: meshes drop their
+ * lodBias finest levels of detail (LodSelection::firstLod), textures their
+ * textureMipBias largest mips (DiffuseMap::firstMip).
+ */
+struct BudgetLevels {
+    uint32_t lodBias;
+    uint32_t textureMipBias;
+};
+
+const uint32_t MaxLodBias = 7;
+const uint32_t MaxTextureMipBias = 15;
+
+/*
+ * One step of budget enforcement from a report taken at the current
+ * levels: a category over its budget drops one more level, one that would
+ * still fit after taking a level back takes it back. Returns whether the
+ * levels changed.
+ */
+bool UpdateBudgetLevels(const MemoryBudget& budget, const MemoryReport& report, BudgetLevels& levels);
+} // End of namespace m3d
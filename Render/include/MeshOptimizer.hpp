@@ -0,0 +1,136 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT)
+* (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * Mesh processing on the raw arrays of Mesh: positions are xyzw, normals xyz,
+ * uvs uv and tangents xyzw per vertex, all but positions may be empty. Nothing here depends on
+ * the renderer or the FBX SDK, fbxconv and the importer run these offline.
+ */
+namespace m3d {
+const uint32_t PositionStride = 4;
+const uint32_t NormalStride = 3;
+const uint32_t UVStride = 2;
+const uint32_t TangentStride = 4;
+
+/*
+ * Merges vertices whose position, normal and uv are equal and rewrites indices
+ * to the merged vertices, which keep the order of their first use. With an
+ * epsilon > 0 each attribute is snapped to a grid of that size before the
+ * compare, so near duplicates merge too; the first vertex of a group is kept
+ * as is. Returns the new vertex count.
+ */
+uint32_t WeldVertices(std::vector<float>& positions, std::vector<float>& normals, std::vector<float>& uvs,
+    std::vector<uint32_t>& indices, float epsilon = 0.0f);
+
+/*
+ * Post transform cache efficiency of a triangle list on a FIFO cache:
+ * ACMR is transformed vertices per triangle (0.5 is ideal for big regular
+ * meshes, 3 the worst), ATVR transformed per used vertex (1 is ideal).
+ */
+struct VertexCacheStats {
+    uint32_t triangles;
+    uint32_t vertices;
+    uint32_t transformed;
+
+    float Acmr() const { return triangles ? float(transformed) / triangles : 0.0f; }
+    float Atvr() const { return vertices ? float(transformed) / vertices : 0.0f; }
+};
+
+const uint32_t DefaultVertexCacheSize = 16;
+
+VertexCacheStats AnalyzeVertexCache(const uint32_t* indices, size_t indexCount, uint32_t vertexCount,
+    uint32_t cacheSize = DefaultVertexCacheSize);
+
+/*
+ * The index passes work on a range of a mesh's indices, one material slice at
+ * a time, and keep the triangles of the range; run them in this order:
+ *
+ * OptimizeVertexCache reorders triangles for the post transform cache with
+ * Forsyth's linear speed algorithm.
+ */
+void OptimizeVertexCache(uint32_t* indices, size_t indexCount, uint32_t vertexCount);
+
+/*
+ * OptimizeOverdraw cuts the cache optimized order into clusters where the
+ * cache starts over anyway, and draws outward facing clusters on the outside
+ * of the mesh first: they are the likely occluders, so inner surfaces fail
+ * the depth test. Costs next to nothing in cache efficiency.
+ */
+void OptimizeOverdraw(uint32_t* indices, size_t indexCount, const float* positions, uint32_t vertexCount);
+
+/*
+ * Renumbers vertices in order of first use over all indices, so vertex
+ * fetches walk memory forward, and drops unused vertices. Returns the new
+ * vertex count.
+ */
+uint32_t OptimizeVertexFetch(std::vector<float>& positions, std::vector<float>& normals, std::vector<float>& uvs,
+    std::vector<uint32_t>& indices);
+
+/* A run of triangles whose vertices all lie in [baseVertex, baseVertex + 65535] */
+struct IndexWindow {
+    uint32_t indexOffset;
+    uint32_t triangleCount;
+    uint32_t baseVertex;
+};
+
+/*
+ * Cuts indices[0, indexCount) in triangle order into runs that 16 bit
+ * indices relative to the run's baseVertex can address, appending them to
+ * windows with indexOffset relative to indices. A range after
+ * OptimizeVertexFetch mostly uses ascending vertices, so it rarely needs more
+ * than vertexCount / 65536 + 1 runs. Returns the number of runs added.
+ */
+uint32_t SplitFor16BitIndices(const uint32_t* indices, size_t indexCount, std::vector<IndexWindow>& windows);
+
+/*
+ * Per vertex tangents from the uv mapping, xyz orthogonal to the normal and
+ * w the sign of the bitangent, cross(normal, tangent) * w. Vertices whose
+ * triangles have no uv gradient get any tangent orthogonal to the normal.
+ * Needs normals and uvs; tangents is resized to the vertex count.
+ */
+void ComputeTangents(const std::vector<float>& positions, const std::vector<float>& normals, const std::vector<float>& uvs,
+    const std::vector<uint32_t>& indices, std::vector<float>& tangents);
+
+/*
+ * Static batching: appends the triangles indices[0, indexCount) of a mesh,
+ * placed by world (rows of an affine transform, translation in column 3,
+ * like Matrix4x4::m), to the arrays of a combined mesh. The vertices the
+ * triangles use are transformed and appended once each in order of first
+ * use, normals by the inverse transpose and renormalized, and the indices
+ * rewritten to them. Mirroring transforms get their winding flipped so front
+ * faces stay front faces. normals or uvs may be null when the source has
+ * none, nothing is appended to that array then. Returns the vertices added.
+ */
+uint32_t AppendTransformed(const float world[3][4], const float* positions, const float* normals, const float* uvs,
+    uint32_t vertexCount, const uint32_t* indices, size_t indexCount, std::vector<float>& outPositions,
+    std::vector<float>& outNormals, std::vector<float>& outUVs, std::vector<uint32_t>& outIndices);
+
+/*
+ * Quadric error edge collapse. Writes the simplified triangles of indices to
+ * destination (at most indexCount indices, must not alias indices) and
+ * returns the index count. The vertex buffer is not touched: each collapse
+ * moves a vertex onto a neighbour, so every LOD indexes the same vertices.
+ *
+ * Border vertices and vertices on uv or normal seams (positions shared by
+ * several vertices) never move, which keeps the outline, material boundaries
+ * when run per slice, and the seams themselves in place. normals and uvs
+ * (either may be null) add Hoppe's attribute quadrics: a collapse also costs
+ * how far the normals and uvs left behind stray from those the original
+ * triangles interpolate, so collapses that bend shading or stretch the texture
+ * come last. They only order the collapses. Stops at targetIndexCount, or
+ * before a collapse would move the surface more than targetError, in object
+ * space units. resultError receives the largest surface error accepted.
+ */
+size_t SimplifyMesh(uint32_t* destination, const uint32_t* indices, size_t indexCount, const float* positions,
+    const float* normals, const float* uvs, uint32_t vertexCount, size_t targetIndexCount, float targetError,
+    float* resultError = nullptr);
+} // End of namespace m3d
@@ -0,0 +1,62 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT)
+* (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Bounds.hpp"
+#include "Matrix.h"
+
+namespace m3d {
+
+/*
+ * A run of consecutive triangles of a mesh's index buffer, small enough to be
+ * culled on its own. Meshlets never cross a material slice, so a visible run
+ * of meshlets is directly an index range to draw.
+ */
+struct Meshlet {
+    // object space bounding sphere
+    m3d::math::Vector3 center;
+    float radius;
+    // every triangle normal is within the cone around axis; cutoff is the
+    // sine of the cone's spread, 1 when the cone is too wide to ever cull
+    m3d::math::Vector3 coneAxis;
+    float coneCutoff;
+    // in Mesh::indices, like Mesh::Slice::indexOffset
+    uint32_t indexOffset;
+    uint32_t triangleCount;
+};
+
+const uint32_t MeshletMaxVertices = 64;
+const uint32_t MeshletMaxTriangles = 124;
+
+/*
+ * Cuts indices[indexOffset, indexOffset + triangleCount * 3) into meshlets in
+ * triangle order, appending them to meshlets. Run it after the index order
+ * optimizations, which keep neighbouring triangles together. Positions are
+ * xyzw. Returns the number of meshlets added.
+ */
+uint32_t BuildMeshlets(const float* positions, uint32_t vertexCount, const uint32_t* indices, uint32_t indexOffset,
+    uint32_t triangleCount, std::vector<Meshlet>& meshlets,
+    uint32_t maxVertices = MeshletMaxVertices, uint32_t maxTriangles = MeshletMaxTriangles);
+
+struct IndexRange {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+};
+
+/*
+ * Tests meshlets of an instance against the frustum and, with cullBackfaces,
+ * for facing away from eye. Appends the index ranges of the visible ones,
+ * neighbours merged. world is the instance's world matrix. Returns the
+ * visible meshlet count.
+ */
+uint32_t CullMeshlets(const Meshlet* meshlets, uint32_t meshletCount, const m3d::math::Matrix4x4& world,
+    const Frustum& frustum, const m3d::math::Vector3& eye, bool cullBackfaces, std::vector<IndexRange>& ranges);
+} // End of namespace m3d
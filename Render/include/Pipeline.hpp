@@ -1,19 +1,22 @@
 #pragma once
 #include <vulkan/vulkan.hpp>
 #include "Matrix.h"
+#include "VertexFormat.hpp"
 
 namespace m3d {
 	class Pipeline
 	{
 	public:
-		Pipeline(vk::Device&, vk::PhysicalDevice&);
+		Pipeline(vk::Device&, vk::PhysicalDevice&, const VertexFormat&);
 		~Pipeline();
-		// create uniform buffer
+		// create uniform buffer, kept mapped until the pipeline is destroyed
 		void CreateUniformBuffers();
+		// copy uboVS to the mapped uniform buffer, no frame in flight may be reading it
+		void UpdateUniformBuffer();
 		// create render pass
 		void CreateRenderPass();
-		// set vertex data format
-		void SetupVertexInputs();
+		// set vertex data format, one attribute per attribute of the format
+		void SetupVertexInputs(const VertexFormat&);
 		//
 		void CreateDescriptorPool();
 		void CreateDescriptorSetLayout();
@@ -36,6 +39,7 @@ namespace m3d {
 			vk::Buffer buffer;
 			vk::DeviceMemory memory;
 			vk::DescriptorBufferInfo descriptor;
+			void* mapped;
 		} uniformDataVS;
 
 		struct {
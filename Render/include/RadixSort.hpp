@@ -0,0 +1,60 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT)
+* (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+namespace m3d {
+
+/*
+ * LSD radix sort on a 64-bit key, 8 bits per pass. The histograms for all
+ * passes are built in one sweep, and passes whose digit is the same for every
+ * item (common for the high bits of sort keys) are skipped. Stable.
+ *
+ * KeyOf(const T&) returns the uint64_t key. scratch must hold count items.
+ * Returns the buffer the sorted items ended up in, items or scratch.
+ */
+template <class T, class KeyOf>
+T* RadixSort64(T* items, T* scratch, size_t count, KeyOf keyOf)
+{
+    const int passCount = 8;
+    size_t histograms[passCount][256];
+    std::memset(histograms, 0, sizeof(histograms));
+
+    for (size_t i = 0; i < count; ++i) {
+        const uint64_t key = keyOf(items[i]);
+        for (int pass = 0; pass < passCount; ++pass) {
+            ++histograms[pass][(key >> (pass * 8)) & 0xFF];
+        }
+    }
+
+    T* src = items;
+    T* dst = scratch;
+    for (int pass = 0; pass < passCount; ++pass) {
+        size_t* histogram = histograms[pass];
+        const uint64_t firstDigit = count ? (keyOf(src[0]) >> (pass * 8)) & 0xFF : 0;
+        if (histogram[firstDigit] == count)
+            continue;
+
+        size_t offset = 0;
+        for (int digit = 0; digit < 256; ++digit) {
+            const size_t n = histogram[digit];
+            histogram[digit] = offset;
+            offset += n;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            const uint64_t digit = (keyOf(src[i]) >> (pass * 8)) & 0xFF;
+            dst[histogram[digit]++] = src[i];
+        }
+        std::swap(src, dst);
+    }
+    return src;
+}
+} // End of namespace m3d
@@ -0,0 +1,198 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT)
+* (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Bounds.hpp"
+#include "Matrix.h"
+#include "Meshlet.hpp"
+
+namespace m3d {
+class Scene;
+struct Mesh;
+struct Transform;
+
+/*
+ * 64-bit draw sort key, from the most significant bits:
+ *   pass(4) | material(16) | mesh(16) | lod(4) | slice(8) | depth(16)
+ * Sorting by key groups draws by state, most expensive state change first,
+ * and orders each group front to back. There is one pipeline, it is not part
+ * of the key. Items that differ only in depth end up
+ * next to each other and become one instanced draw.
+ */
+namespace sortkey {
+    const uint32_t PassBits = 4;
+    const uint32_t MaterialBits = 16;
+    const uint32_t MeshBits = 16;
+    const uint32_t LodBits = 4;
+    const uint32_t SliceBits = 8;
+    const uint32_t DepthBits = 16;
+
+    // meshes with more levels or slices would alias in the key, the loader and fbxconv keep them within
+    const uint32_t MaxLodCount = 1u << LodBits;
+    const uint32_t MaxSliceCount = 1u << SliceBits;
+
+    const uint32_t DepthShift = 0;
+    const uint32_t SliceShift = DepthShift + DepthBits;
+    const uint32_t LodShift = SliceShift + SliceBits;
+    const uint32_t MeshShift = LodShift + LodBits;
+    const uint32_t MaterialShift = MeshShift + MeshBits;
+    const uint32_t PassShift = MaterialShift + MaterialBits;
+
+    inline uint64_t Field(uint64_t key, uint32_t shift, uint32_t bits)
+    {
+        return (key >> shift) & ((uint64_t(1) << bits) - 1);
+    }
+
+    inline uint64_t Make(uint32_t pass, uint32_t material, uint32_t mesh, uint32_t lod, uint32_t slice, uint32_t depth)
+    {
+        return (uint64_t(pass & ((1u << PassBits) - 1)) << PassShift)
+            | (uint64_t(material & ((1u << MaterialBits) - 1)) << MaterialShift)
+            | (uint64_t(mesh & ((1u << MeshBits) - 1)) << MeshShift)
+            | (uint64_t(lod & ((1u << LodBits) - 1)) << LodShift)
+            | (uint64_t(slice & ((1u << SliceBits) - 1)) << SliceShift)
+            | (uint64_t(depth & ((1u << DepthBits) - 1)) << DepthShift);
+    }
+
+    /* Maps a view distance in [0, farZ] onto the depth field */
+    inline uint32_t QuantizeDepth(float distance, float farZ)
+    {
+        float t = distance / farZ;
+        t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+        return static_cast<uint32_t>(t * float((1u << DepthBits) - 1));
+    }
+}
+
+/*
+ * Screen space error limit for picking levels of detail (Mesh::lods). A level
+ * is good enough while its error, projected at the distance of the object,
+ * covers at most maxPixelError pixels.
+ */
+struct LodSelection {
+    // pixels covered by one world unit at distance 1, viewportHeight / (2 tan(fovY / 2)); 0 draws full meshes only
+    float projectionScale;
+    float maxPixelError;
+    // finer levels are never picked, they may not be uploaded, see BudgetLevels
+    uint32_t firstLod;
+
+    bool Accepts(float worldError, float distance) const
+    {
+        return projectionScale > 0.0f && worldError * projectionScale <= maxPixelError * distance;
+    }
+};
+
+enum RenderPass : uint32_t {
+    RenderPassOpaque = 0,
+    RenderPassTransparent = 1
+};
+
+struct RenderItem {
+    uint64_t key;
+    // a PrefabInstance id when prefabPart is set
+    uint32_t instanceId;
+    // 1 + the index into the prefab's parts, 0 for an Instance
+    uint32_t prefabPart;
+    uint32_t meshId;
+    uint32_t materialId;
+    uint32_t lod;
+    uint32_t slice;
+};
+
+/* Where an item is drawn, its instance's transform or its prefab part's combined with the root */
+Transform GetItemTransform(const Scene& scene, const RenderItem& item);
+
+struct DrawCommand {
+    enum ChangeBits : uint32_t {
+        ChangeMaterial = 1 << 0,
+        ChangeMesh = 1 << 1
+    };
+
+    uint32_t changes;
+    uint32_t material;
+    uint32_t meshId;
+    uint32_t lod;
+    /* into Mesh::GetSlices(lod) */
+    uint32_t slice;
+    /* range of GetItems() drawn by this command, one GPU instance per item, 0 when culled entirely */
+    uint32_t firstInstance;
+    uint32_t instanceCount;
+    /* range of GetClusterRanges() to draw instead of the whole slice, see CullClusters */
+    uint32_t firstRange;
+    uint32_t rangeCount;
+};
+
+/*
+ * Per frame draw list. Visible instances and prefab parts are turned into one RenderItem per
+ * mesh slice, radix sorted by key, then walked once to emit DrawCommands that
+ * carry which pieces of state differ from the previous command. Consecutive
+ * items sharing material, mesh and slice are merged into a single
+ * instanced command (items of different levels of detail never merge, they
+ * draw different indices); the sorted items are the instance order, so the renderer
+ * writes one transform per item and firstInstance indexes straight into it.
+ * CullClusters then cuts single instance draws of meshes with meshlets down to
+ * the index ranges of their visible meshlets.
+ */
+class RenderQueue {
+public:
+    struct Stats {
+        uint32_t draws;
+        uint32_t instances;
+        uint32_t materialChanges;
+        uint32_t meshChanges;
+        uint32_t clustersCulled;
+    };
+
+    void Reserve(size_t itemCount);
+    void Clear();
+
+    void Push(const RenderItem& item);
+    /* Level of detail choice for the following PushInstance calls, full meshes until set */
+    void SetLodSelection(const LodSelection& selection) { lodSelection = selection; }
+    /* Pushes every slice of the instance's level of detail, depth is measured from eye */
+    void PushInstance(const Scene& scene, uint32_t instanceId, const m3d::math::Vector3& eye, float farZ,
+        uint32_t pass = RenderPassOpaque);
+    /* PushInstance for many instances, their meshes and transforms looked up in batches; stale ids are skipped */
+    void PushInstances(const Scene& scene, const uint32_t* instanceIds, size_t count, const m3d::math::Vector3& eye,
+        float farZ, uint32_t pass = RenderPassOpaque);
+    /*
+     * Expands prefab placements into their parts, each pushed like an
+     * instance at its root's transform combined with its own. Parts outside
+     * frustum are skipped, every part is pushed when it is null, for
+     * placements entirely inside it. Stale ids are skipped.
+     */
+    void PushPrefabInstances(const Scene& scene, const uint32_t* prefabInstanceIds, size_t count,
+        const m3d::math::Vector3& eye, float farZ, const Frustum* frustum, uint32_t pass = RenderPassOpaque);
+
+    void Sort();
+    void BuildDrawList();
+    /*
+     * Meshlet culling for draws of a single instance. Instanced draws keep
+     * their whole slice, the instances share one index range. Backfacing
+     * meshlets are only culled with cullBackfaces.
+     */
+    void CullClusters(const Scene& scene, const Frustum& frustum, const m3d::math::Vector3& eye, bool cullBackfaces);
+
+    const std::vector<RenderItem>& GetItems() const { return items; }
+    const std::vector<DrawCommand>& GetDrawList() const { return drawList; }
+    const std::vector<IndexRange>& GetClusterRanges() const { return clusterRanges; }
+    const Stats& GetStats() const { return stats; }
+
+private:
+    void pushInstance(uint32_t instanceId, uint32_t prefabPart, uint32_t meshId, const Transform& transform,
+        const Mesh& mesh, const m3d::math::Vector3& eye, float farZ, uint32_t pass);
+
+    std::vector<RenderItem> items;
+    std::vector<RenderItem> scratch;
+    std::vector<DrawCommand> drawList;
+    // relative to the mesh's first index, like Mesh::Slice::indexOffset
+    std::vector<IndexRange> clusterRanges;
+    LodSelection lodSelection = {};
+    Stats stats = {};
+};
+} // End of namespace m3d
@@ -6,9 +6,14 @@
 #pragma once
 
 #include <Matrix.h>
+#include <functional>
 #include <vulkan/vulkan.hpp>
 
+#include "MemoryBudget.hpp"
+#include "RenderQueue.hpp"
 #include "Renderer.hpp"
+#include "SpatialGrid.hpp"
+#include "VertexFormat.hpp"
 #include "VulkanSwapchain.hpp"
 
 #define DEFAULT_FENCE_TIMEOUT 100000000000
@@ -16,7 +21,6 @@
 namespace m3d {
 class Scene;
 class Pipeline;
-class RenderPass;
 class CommandBuffer;
 
 class RendererVulkan : Renderer {
@@ -28,6 +32,25 @@ public:
 
 	void OnWindowSizeChanged() override;
 	void Draw() override;
+    /*
+     * Re-uploads meshes and rebuilds the spatial grid after meshes were added
+     * or the scene arrays were written without marking them dirty. Moved
+     * transforms and instances added with AddInstance need no call.
+     */
+    void OnSceneChanged();
+
+    /* No instance or prefab placement, see transformInstances */
+    static const uint32_t InvalidOwner = 0xFFFFFFFF;
+
+    /*
+     * Device memory limits, checked every few frames: over budget, meshes
+     * drop their finest levels of detail and textures their largest mips,
+     * one level per check, and take them back once they fit again
+     */
+    void SetMemoryBudget(const MemoryBudget& budget) { memoryBudget = budget; }
+    const BudgetLevels& GetBudgetLevels() const { return budgetLevels; }
+    /* CPU and GPU bytes of the scene and the renderer; MemoryReport::WriteJson is the dump for dashboards */
+    void ReportMemory(MemoryReport& report) const;
 private:
     void CreateConsole(const char* title);
 
@@ -45,11 +68,16 @@ private:
 
 private:
     void PrepareFrame();
+    void RebuildTransformOwners();
+    void UpdateSceneChanges();
+    void EnforceMemoryBudget();
+    void UpdateRenderQueue();
     void SubmitFrame();
 
 public:
 
-    void DrawLoop();
+    /* beforeFrame runs at the start of every frame, e.g. to publish streamed in scene data */
+    void DrawLoop(const std::function<void()>& beforeFrame = std::function<void()>());
     uint32_t frameCounter;
     float frameTimer;
 
@@ -140,5 +168,32 @@ private:
     /* Render Pass */
     Pipeline* pipeLine;
     CommandBuffer* commandBuffer;
+    /* Layout of the scene vertex buffer, the pipeline's vertex input matches it */
+    VertexFormat vertexFormat = CompactVertexFormat();
+
+    /* Per frame draw list */
+    Scene* scene;
+    SpatialGrid spatialGrid;
+    // prefab placements, culled whole before their parts are expanded
+    SpatialGrid prefabGrid;
+    /*
+     * Per transform slot the instance and the prefab placement placing it,
+     * InvalidOwner for none; AddInstance and AddPrefabInstance give each
+     * its own transform. Stale entries are ignored, see UpdateSceneChanges.
+     */
+    std::vector<uint32_t> transformInstances;
+    std::vector<uint32_t> transformPrefabInstances;
+    // the main camera's culling results of last frame, see QueryFrustumCached
+    FrustumCache frustumCache;
+    FrustumCache prefabFrustumCache;
+    RenderQueue renderQueue;
+    std::vector<uint32_t> visibleInstances;
+    // placements entirely inside the frustum, and those crossing it whose parts are culled one by one
+    std::vector<uint32_t> insidePrefabInstances;
+    std::vector<uint32_t> crossingPrefabInstances;
+
+    MemoryBudget memoryBudget = {};
+    BudgetLevels budgetLevels = {};
+    uint32_t framesSinceBudgetCheck = 0;
 };
 }
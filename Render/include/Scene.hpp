@@ -6,12 +6,21 @@
 
 #pragma once
 
+#include <functional>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "Matrix.h"
 #include "Quaternion.h"
 
+#include "ArrayView.hpp"
+#include "Bounds.hpp"
+#include "DirtyRanges.hpp"
+#include "File.hpp"
+#include "MemoryBudget.hpp"
+#include "Meshlet.hpp"
+#include "SpatialGrid.hpp"
 #include "packed_freelist.h"
 #include "vulkanTextureLoader.hpp"
 
@@ -23,8 +32,14 @@ class FbxMesh;
 }
 
 namespace m3d {
+class ThreadPool;
+class ViewSet;
+
 struct DiffuseMap {
+    std::string path;
     vkext::VulkanTexture texture;
+    // mips finer than this are evicted to stay in the texture budget, see BudgetLevels
+    uint32_t firstMip = 0;
 };
 
 struct Light {
@@ -46,16 +61,31 @@ struct Material {
 };
 
 struct Mesh {
-    bool init(fbxsdk::FbxMesh* fbxMesh);
+    /*
+     * Extracts a triangulated FBX mesh, splitting big meshes into polygon
+     * ranges on the pool when one is given. Only built with M3D_FBX_IMPORT.
+     */
+    bool init(fbxsdk::FbxMesh* fbxMesh, ThreadPool* pool = nullptr);
 
     struct Slice {
-        Slice(int offset, int count)
+        Slice(int offset, int count, uint32_t materialIndex = 0)
             : indexOffset(offset)
             , triangleCount(count)
+            , firstMeshlet(0)
+            , meshletCount(0)
+            , baseVertex(0)
+            , material(materialIndex)
         {
         }
         int indexOffset;
         int triangleCount;
+        // range of Mesh::meshlets covering this slice, empty when not built
+        uint32_t firstMeshlet;
+        uint32_t meshletCount;
+        // indices stay absolute; the GPU gets them minus baseVertex, in 16 bits when they fit
+        uint32_t baseVertex;
+        // into materialIds, fbxconv may split one material into several slices
+        uint32_t material;
     };
 
     std::string name;
@@ -65,8 +95,45 @@ struct Mesh {
     std::vector<float> vertices;
     std::vector<float> uvs;
     std::vector<float> normals;
+    // xyz and the bitangent sign, built by fbxconv, see ComputeTangents
+    std::vector<float> tangents;
     std::vector<uint32_t> indices;
 
+    // set instead of the vectors above when the mesh lives in a mapped scene file
+    ArrayView<float> mappedVertices;
+    ArrayView<float> mappedUVs;
+    ArrayView<float> mappedNormals;
+    ArrayView<float> mappedTangents;
+    ArrayView<uint32_t> mappedIndices;
+
+    ArrayView<float> GetVertices() const { return mappedVertices.data() ? mappedVertices : ArrayView<float>(vertices); }
+    ArrayView<float> GetUVs() const { return mappedUVs.data() ? mappedUVs : ArrayView<float>(uvs); }
+    ArrayView<float> GetNormals() const { return mappedNormals.data() ? mappedNormals : ArrayView<float>(normals); }
+    ArrayView<float> GetTangents() const { return mappedTangents.data() ? mappedTangents : ArrayView<float>(tangents); }
+    ArrayView<uint32_t> GetIndices() const { return mappedIndices.data() ? mappedIndices : ArrayView<uint32_t>(indices); }
+
+    // object space bounds of all vertices
+    AABB bounds;
+
+    // built by fbxconv, empty for meshes imported at runtime
+    std::vector<Meshlet> meshlets;
+
+    /*
+     * Coarser levels of detail, built by fbxconv. Each level has its own
+     * slices over the same materials, indexing the same vertices; its
+     * indices and meshlets are appended to the mesh's. error is how far, in
+     * object space, the level's surface strays from the full mesh.
+     */
+    struct Lod {
+        float error;
+        std::vector<Slice> slices;
+    };
+    std::vector<Lod> lods;
+
+    uint32_t GetLodCount() const { return static_cast<uint32_t>(lods.size()) + 1; }
+    // level 0 is the full mesh
+    const std::vector<Slice>& GetSlices(uint32_t lod) const { return lod == 0 ? slices : lods[lod - 1].slices; }
+
     std::vector<vk::CommandBuffer> drawCommands;
     std::vector<uint32_t> materialIds;
 };
@@ -82,6 +149,31 @@ struct Instance {
     uint32_t transformId;
 };
 
+/*
+ * An assembly stored once and placed many times, a chair or a lamp: meshes
+ * at transforms relative to the prefab's root. A placement costs one
+ * transform and one PrefabInstance however many parts the prefab has; the
+ * parts are only expanded for placements that pass culling, see
+ * RenderQueue::PushPrefabInstances.
+ */
+struct Prefab {
+    struct Part {
+        uint32_t meshId;
+        Transform local;
+    };
+
+    std::string name;
+    std::vector<Part> parts;
+    // prefab space bounds of all parts, set by AddPrefab
+    AABB bounds;
+};
+
+struct PrefabInstance {
+    uint32_t prefabId;
+    // the root, its parts follow it
+    uint32_t transformId;
+};
+
 struct Camera {
     // view
     m3d::math::Vector3 eye;
@@ -91,6 +183,7 @@ struct Camera {
     float fovY;
     float aspect;
     float nearZ;
+    float farZ;
 };
 
 class Scene {
@@ -103,14 +196,115 @@ public:
     packed_freelist<Transform> transforms;
     packed_freelist<Instance> instances;
     packed_freelist<Camera> cameras;
+    packed_freelist<Prefab> prefabs;
+    packed_freelist<PrefabInstance> prefabInstances;
 
     uint32_t mainCameraID;
 
+    /*
+     * Transforms and instances changed since the renderer last uploaded them,
+     * marked by SetTransform and AddInstance; code writing the arrays
+     * directly marks them itself or calls RendererVulkan::OnSceneChanged
+     */
+    DirtyRanges dirtyTransforms;
+    DirtyRanges dirtyInstances;
+    DirtyRanges dirtyPrefabInstances;
+
+    // cooked scene files, kept mapped while meshes point into them
+    std::vector<m3d::file::MappedFile> mappedFiles;
+
     Scene();
     void Init();
 };
 
-void LoadMeshes(Scene* scene, std::vector<uint32_t>* loadedMeshIDs);
+/* Marks a missing material or texture in import results */
+const uint32_t ImportNone = 0xFFFFFFFF;
+
+/*
+ * Inserts import results (see FbxImport.hpp) into a scene, remapping import
+ * order references to scene ids. Content already added through the same
+ * ImportIds is not inserted again: textures with the same file bytes,
+ * materials with the same parameters and meshes with the same geometry,
+ * slices and materials, whatever their names, map to the first one's id, so
+ * instances of duplicates share one mesh. Found by a content hash; materials
+ * and meshes are confirmed by a compare, textures by their hash alone, their
+ * files are never read twice.
+ *
+ * The content hashes read whole files and meshes. Importers that insert on
+ * another thread than they import on (SceneLoader) compute them where they
+ * import and pass them in, the inserts then only look them up.
+ */
+struct ImportIds {
+    std::vector<uint32_t> textureIds;
+    std::vector<uint32_t> materialIds;
+
+    void AddTexture(Scene& scene, DiffuseMap&& diffuseMap);
+    void AddTexture(Scene& scene, DiffuseMap&& diffuseMap, uint64_t contentHash);
+    void AddMaterial(Scene& scene, Material&& material);
+    uint32_t AddMesh(Scene& scene, Mesh&& mesh);
+    uint32_t AddMesh(Scene& scene, Mesh&& mesh, uint64_t geometryHash);
+
+    // content hash to scene id of everything inserted
+    std::unordered_multimap<uint64_t, uint32_t> textureHashes;
+    std::unordered_multimap<uint64_t, uint32_t> materialHashes;
+    std::unordered_multimap<uint64_t, uint32_t> meshHashes;
+
+    // duplicates merged into an earlier id
+    uint32_t duplicateTextures = 0;
+    uint32_t duplicateMaterials = 0;
+    uint32_t duplicateMeshes = 0;
+};
+
+/* The texture's file bytes, its path when the file can not be read */
+uint64_t HashTextureContent(const DiffuseMap& diffuseMap);
+/* Everything ImportIds compares of a mesh but its material ids, which are import order until AddMesh */
+uint64_t HashMeshGeometry(const Mesh& mesh);
 
 void AddInstance(Scene& scene, uint32_t meshID, uint32_t* newInstanceID);
+
+/* Inserts a prefab, its bounds computed from its parts' meshes, which must be in the scene */
+uint32_t AddPrefab(Scene& scene, Prefab&& prefab);
+
+/* Places a prefab: one root transform and one PrefabInstance, its parts are not copied */
+void AddPrefabInstance(Scene& scene, uint32_t prefabID, const Transform& transform, uint32_t* newPrefabInstanceID);
+
+/* Moves a transform and marks it for upload */
+void SetTransform(Scene& scene, uint32_t transformID, const Transform& transform);
+
+/* World space bounds of an instance, its mesh bounds moved by its transform */
+AABB GetInstanceBounds(const Scene& scene, uint32_t instanceID);
+
+/* World space bounds of a prefab placement, the prefab's bounds moved by its root */
+AABB GetPrefabInstanceBounds(const Scene& scene, uint32_t prefabInstanceID);
+
+/* (Re)fills the grid with every instance of the scene */
+void BuildSpatialGrid(const Scene& scene, SpatialGrid& grid);
+/* (Re)fills the grid with every prefab placement, their ids are not instance ids so they get a grid of their own */
+void BuildPrefabSpatialGrid(const Scene& scene, SpatialGrid& grid);
+
+/*
+ * Culls every instance against all views in one parallel pass: ids[i] is an
+ * instance, masks[i] its ViewSet bits; CollectVisible picks one view's
+ * instances out of them. Both are resized to the instance count.
+ */
+void CullInstances(const Scene& scene, const ViewSet& views, std::vector<uint32_t>& ids, std::vector<uint32_t>& masks);
+/* CullInstances for prefab placements, whole placements by their bounds */
+void CullPrefabInstances(const Scene& scene, const ViewSet& views, std::vector<uint32_t>& ids, std::vector<uint32_t>& masks);
+
+/*
+ * CPU bytes of the scene's meshes, materials, textures, freelists and mapped
+ * files, and the estimated device bytes of its loaded textures
+ */
+void ReportSceneMemory(const Scene& scene, MemoryReport& report);
+
+/*
+ * local placed under parent, what a prefab part's transform is in the world;
+ * exact while the parent's scale is uniform, a skewing parent is not a Transform
+ */
+Transform CombineTransforms(const Transform& parent, const Transform& local);
+
+/* translate * rotate * scale, translation in m[i][3] like Matrix4x4::Translation */
+m3d::math::Matrix4x4 GetWorldMatrix(const Transform& transform);
+
+Frustum GetCameraFrustum(const Camera& camera);
 } // End of namspace m3d
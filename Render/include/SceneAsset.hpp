@@ -0,0 +1,35 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT)
+* (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+
+namespace m3d {
+class Scene;
+
+/*
+ * Cooked scene files (.m3ds) are the SScene flatbuffer of data/schema/scene.fbs.
+ * Bump the version whenever the meaning of the data changes, old files are
+ * rejected and have to be cooked again.
+ */
+const uint32_t SceneAssetVersion = 5;
+
+/*
+ * Writes the meshes, materials, textures and instances of the scene. With
+ * compressIndices the index buffers are stored delta encoded (see
+ * IndexCompression.hpp), usually well under half their size after fbxconv's
+ * optimizations, at the cost of decoding them at load.
+ */
+bool SaveSceneAsset(const Scene& scene, const char* path, bool compressIndices = true);
+
+/*
+ * Maps a cooked scene file and adds its content to the scene. Vertex and
+ * uncompressed index data are not copied, meshes point into the mapping which
+ * the scene keeps open.
+ */
+bool LoadSceneAsset(Scene& scene, const char* path);
+} // End of namespace m3d
@@ -0,0 +1,87 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT)
+* (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "FbxImport.hpp"
+
+namespace m3d {
+
+/*
+ * Imports an FBX file on a background thread. Finished textures, materials
+ * and meshes queue up until Publish moves them into the Scene, which the
+ * render thread calls between frames, so rendering starts with whatever is
+ * ready and the Scene is never touched by two threads. The content hashes
+ * ImportIds merges duplicates by are computed on the loader thread too, they
+ * read whole texture files and meshes.
+ */
+class SceneLoader {
+public:
+    enum class State {
+        Idle,
+        Loading,
+        Done,
+        Failed,
+        Cancelled
+    };
+
+    SceneLoader();
+    /* Cancels a running import and waits for the thread */
+    ~SceneLoader();
+
+    /* False if an import is already running */
+    bool Start(const std::string& path);
+    /* Asks the import to stop, it does at the next progress report */
+    void Cancel();
+
+    State GetState() const { return state.load(); }
+    /* In [0, 1] */
+    float GetProgress() const { return progress.load(); }
+
+    /*
+     * The sync point: inserts everything finished since the last call into
+     * the scene. Ids of the new meshes are appended to newMeshIds.
+     * Returns the number of new meshes.
+     */
+    size_t Publish(Scene& scene, std::vector<uint32_t>* newMeshIds = nullptr);
+
+private:
+    SceneLoader(const SceneLoader&) = delete;
+    SceneLoader& operator=(const SceneLoader&) = delete;
+
+    void run(std::string path);
+
+    std::thread thread;
+    std::atomic<State> state;
+    std::atomic<float> progress;
+    std::atomic<bool> cancelled;
+
+    // an import result with its content hash, see ImportIds
+    struct PendingTexture {
+        DiffuseMap diffuseMap;
+        uint64_t contentHash;
+    };
+    struct PendingMesh {
+        Mesh mesh;
+        uint64_t geometryHash;
+    };
+
+    // filled by the loader thread, drained by Publish
+    std::mutex pendingMutex;
+    std::vector<PendingTexture> pendingTextures;
+    std::vector<Material> pendingMaterials;
+    std::vector<PendingMesh> pendingMeshes;
+
+    // import order to scene ids, only touched by Publish
+    ImportIds ids;
+};
+} // End of namespace m3d
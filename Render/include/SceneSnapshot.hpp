@@ -0,0 +1,49 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT)
+* (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Matrix.h"
+
+#include "Scene.hpp"
+#include "Snapshot.hpp"
+
+namespace m3d {
+class SpatialGrid;
+
+/*
+ * What rendering a frame needs from the simulation, frozen: the render
+ * thread reads frame N from a SnapshotExchange while the simulation
+ * changes the Scene and captures frame N + 1. Meshes, materials and
+ * textures are not part of it, they only change between frames with both
+ * threads synchronized (RendererVulkan::OnSceneChanged).
+ */
+struct SceneSnapshot {
+    uint64_t frame = 0;
+    Camera camera = {};
+    // by transform slot (the 16 LSBs of the id)
+    CowArray<m3d::math::Matrix4x4> worldMatrices;
+    // by instance slot, meaningful for the ids in instanceIds only
+    CowArray<Instance> instances;
+    // live instances, shared by consecutive snapshots until one is added or erased
+    std::shared_ptr<const std::vector<uint32_t>> instanceIds;
+    // the instances in the camera frustum, empty when captured without a grid
+    std::shared_ptr<const std::vector<uint32_t>> visibleInstances;
+};
+
+/*
+ * Brings a snapshot begun from the previous one (SnapshotExchange::BeginWrite)
+ * up to date: world matrices of scene.dirtyTransforms, instances of
+ * scene.dirtyInstances, the main camera and, with a grid holding the scene's
+ * instances, the visible set. Everything is rewritten when the scene's
+ * capacities changed. The caller clears the dirty sets after capturing.
+ */
+void CaptureScene(const Scene& scene, const SpatialGrid* grid, SceneSnapshot& snapshot);
+} // End of namespace m3d
@@ -0,0 +1,151 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT)
+* (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace m3d {
+/*
+ * Array split into fixed size chunks shared between copies. Copying one
+ * copies a pointer per chunk; Write clones a chunk the first time it is
+ * written while another copy still holds it. Copies made on one thread may
+ * be read on another while the first is written, each copy itself has one
+ * writer at a time.
+ */
+template <class T>
+class CowArray {
+public:
+    static const uint32_t ChunkShift = 8;
+    static const uint32_t ChunkSize = 1u << ChunkShift;
+
+    CowArray()
+        : count(0)
+    {
+    }
+
+    size_t Size() const { return count; }
+    /* Growing adds value initialized chunks, shrinking drops whole chunks past the end */
+    void Resize(size_t size);
+
+    const T& operator[](size_t i) const
+    {
+        assert(i < count);
+        return chunks[i >> ChunkShift]->items[i & (ChunkSize - 1)];
+    }
+    T& Write(size_t i);
+
+    uint32_t GetChunkCount() const { return static_cast<uint32_t>(chunks.size()); }
+    const T* GetChunk(uint32_t c) const { return chunks[c]->items; }
+    /* Whether chunk c is the same memory in both, so unchanged since they were copied */
+    bool SharesChunk(const CowArray& other, uint32_t c) const
+    {
+        return c < chunks.size() && c < other.chunks.size() && chunks[c] == other.chunks[c];
+    }
+
+private:
+    struct Chunk {
+        T items[ChunkSize];
+    };
+
+    std::vector<std::shared_ptr<Chunk>> chunks;
+    size_t count;
+};
+
+template <class T>
+void CowArray<T>::Resize(size_t size)
+{
+    const size_t chunkCount = (size + ChunkSize - 1) >> ChunkShift;
+    while (chunks.size() < chunkCount) {
+        chunks.push_back(std::make_shared<Chunk>());
+    }
+    chunks.resize(chunkCount);
+    count = size;
+}
+
+template <class T>
+T& CowArray<T>::Write(size_t i)
+{
+    assert(i < count);
+    std::shared_ptr<Chunk>& chunk = chunks[i >> ChunkShift];
+    // held by this copy only, no other thread can be reading it
+    if (chunk.use_count() > 1)
+        chunk = std::make_shared<Chunk>(*chunk);
+    return chunk->items[i & (ChunkSize - 1)];
+}
+
+/*
+ * Lock free triple buffer handing snapshots from one writer thread to one
+ * reader thread. The writer fills the back slot and publishes it, the
+ * reader takes the latest published slot; neither ever waits for the
+ * other, and the reader's slot stays untouched until its next Acquire.
+ * Each BeginWrite starts from a copy of the last published snapshot, with
+ * CowArray members only the chunks written since are new memory.
+ */
+template <class T>
+class SnapshotExchange {
+public:
+    SnapshotExchange()
+        : latest(1)
+        , writeIndex(0)
+        , published(nullptr)
+        , readIndex(2)
+        , acquired(false)
+    {
+    }
+
+    /* Writer: the slot to fill, a copy of the last published snapshot */
+    T& BeginWrite()
+    {
+        if (published)
+            slots[writeIndex] = *published;
+        return slots[writeIndex];
+    }
+
+    /* Writer: makes the slot from BeginWrite the latest */
+    void Publish()
+    {
+        published = &slots[writeIndex];
+        writeIndex = latest.exchange(writeIndex | freshBit, std::memory_order_acq_rel) & indexMask;
+    }
+
+    /*
+     * Reader: the latest published snapshot, valid until the next Acquire;
+     * the same one again when nothing was published since, nullptr before
+     * the first Publish
+     */
+    const T* Acquire()
+    {
+        if (latest.load(std::memory_order_relaxed) & freshBit) {
+            readIndex = latest.exchange(readIndex, std::memory_order_acq_rel) & indexMask;
+            acquired = true;
+        }
+        return acquired ? &slots[readIndex] : nullptr;
+    }
+
+private:
+    SnapshotExchange(const SnapshotExchange&) = delete;
+    SnapshotExchange& operator=(const SnapshotExchange&) = delete;
+
+    static const uint32_t indexMask = 3;
+    // set while the latest slot has not been acquired yet
+    static const uint32_t freshBit = 4;
+
+    T slots[3];
+    std::atomic<uint32_t> latest;
+    // owned by the writer
+    uint32_t writeIndex;
+    const T* published;
+    // owned by the reader
+    uint32_t readIndex;
+    bool acquired;
+};
+} // End of namespace m3d
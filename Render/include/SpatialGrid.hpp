@@ -0,0 +1,315 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT)
+* (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "Bounds.hpp"
+
+namespace m3d {
+/*
+ * What SpatialGrid::QueryFrustumCached keeps between frames for one view of one grid:
+ * the last frustum, and per cell and per object the containment found and
+ * the plane that rejected it. It only ever makes a query cheaper, results
+ * are the same as QueryFrustum's whatever the cache holds.
+ */
+class FrustumCache {
+public:
+    struct Stats {
+        // cells and objects classified against the frustum
+        uint32_t cellTests;
+        uint32_t objectTests;
+        // cells and objects whose last containment was reused
+        uint32_t cellsReused;
+        uint32_t objectsReused;
+    };
+
+    FrustumCache();
+
+    /* Forgets everything, the next query tests every cell and object once */
+    void Clear() { valid = false; }
+    const Stats& GetStats() const { return stats; }
+
+private:
+    friend class SpatialGrid;
+
+    struct State {
+        uint8_t containment;
+        uint8_t plane;
+    };
+
+    std::vector<State> cells;
+    std::vector<State> entries;
+    Frustum frustum;
+    // the grid's change stamp when last queried
+    uint32_t stamp;
+    bool valid;
+    Stats stats;
+};
+
+/*
+ * Loose hashed uniform grid for highly dynamic instances.
+ *
+ * Every object lives in the cell that contains the center of its bounds, a cell
+ * is "loose" by half a cell size on each side so objects up to one cell wide fit
+ * in a single cell. Bigger objects go into an oversized list that every query
+ * visits. Moving an object is an unlink/link between two intrusive lists.
+ *
+ * All storage is sized in Init(), Insert/Move/Remove and the queries never
+ * allocate. Object ids are packed_freelist ids, their 16 LSBs index the entries.
+ */
+class SpatialGrid {
+public:
+    SpatialGrid();
+
+    /* bucketCount is rounded up to a power of two */
+    void Init(float cellSize, uint32_t maxObjects, uint32_t bucketCount = 4096);
+    void Clear();
+
+    void Insert(uint32_t id, const AABB& bounds);
+    void Move(uint32_t id, const AABB& bounds);
+    void Remove(uint32_t id);
+    bool Contains(uint32_t id) const;
+    /* Whether an object sits in an id's slot (16 LSBs) whatever its generation, *id gets its id */
+    bool ContainsSlot(uint32_t slot, uint32_t* id) const;
+
+    size_t size() const { return objectCount; }
+    size_t cellCount() const { return liveCells.size(); }
+
+    /* fn(uint32_t id, const AABB& bounds) is called once per overlapping object */
+    template <class Fn>
+    void QueryAABB(const AABB& box, Fn&& fn) const;
+    template <class Fn>
+    void QuerySphere(const Sphere& sphere, Fn&& fn) const;
+    /* fn(uint32_t id, const AABB& bounds, Containment c) */
+    template <class Fn>
+    void QueryFrustum(const Frustum& frustum, Fn&& fn) const;
+    /*
+     * QueryFrustum using what cache found last time: each cell and object is
+     * classified starting at the plane that rejected it, so most of those
+     * staying outside cost one plane test. While the frustum is exactly the
+     * last one, cells and objects that did not move reuse their containment
+     * and only moved or inserted objects are tested again.
+     */
+    template <class Fn>
+    void QueryFrustumCached(const Frustum& frustum, FrustumCache& cache, Fn&& fn) const;
+    /* fn(uint32_t id, const AABB& bounds, float tHit), hits are not sorted */
+    template <class Fn>
+    void QueryRay(const Ray& ray, Fn&& fn) const;
+
+private:
+    static const uint32_t invalid = 0xFFFFFFFF;
+    static const uint32_t oversized = 0xFFFFFFFE;
+    static const uint32_t index_mask = 0xFFFF;
+
+    struct Entry {
+        AABB bounds;
+        uint32_t id;
+        uint32_t cell;
+        uint32_t prev;
+        uint32_t next;
+        // changeStamp when inserted or last moved
+        uint32_t stamp;
+    };
+
+    struct Cell {
+        int32_t x, y, z;
+        uint32_t head;
+        uint32_t count;
+        uint32_t nextInBucket;
+        // changeStamp when acquired
+        uint32_t stamp;
+    };
+
+    void cellCoord(const AABB& bounds, int32_t* x, int32_t* y, int32_t* z) const;
+    bool isOversized(const AABB& bounds) const;
+    uint32_t bucketOf(int32_t x, int32_t y, int32_t z) const;
+    uint32_t findCell(int32_t x, int32_t y, int32_t z) const;
+    uint32_t acquireCell(int32_t x, int32_t y, int32_t z);
+    void releaseCell(uint32_t cellIndex);
+    void link(uint32_t slot, uint32_t cellIndex);
+    void unlink(uint32_t slot);
+    AABB looseBounds(const Cell& cell) const;
+    // whether a stamp is newer than what a cache saw, across wrap around
+    static bool changedSince(uint32_t stamp, uint32_t seen) { return static_cast<int32_t>(stamp - seen) > 0; }
+
+    template <class Test, class Fn>
+    void visitList(uint32_t head, Test&& test, Fn&& fn) const;
+    template <class CellTest, class Test, class Fn>
+    void visitCells(CellTest&& cellTest, Test&& test, Fn&& fn) const;
+
+    float cellSize;
+    float invCellSize;
+    uint32_t bucketMask;
+    size_t objectCount;
+
+    std::vector<Entry> entries;
+    std::vector<Cell> cells;
+    std::vector<uint32_t> buckets;
+    // cells are pooled, freed cells are chained through nextInBucket
+    uint32_t cellFreeHead;
+    // dense list of live cells, queries walk it instead of the pool
+    std::vector<uint32_t> liveCells;
+    std::vector<uint32_t> liveIndex;
+    uint32_t oversizedHead;
+    // bumped by every insert, move and new cell, FrustumCache compares against it
+    uint32_t changeStamp;
+};
+
+template <class Test, class Fn>
+void SpatialGrid::visitList(uint32_t head, Test&& test, Fn&& fn) const
+{
+    for (uint32_t slot = head; slot != invalid; slot = entries[slot].next) {
+        const Entry& e = entries[slot];
+        test(e, fn);
+    }
+}
+
+template <class CellTest, class Test, class Fn>
+void SpatialGrid::visitCells(CellTest&& cellTest, Test&& test, Fn&& fn) const
+{
+    for (uint32_t cellIndex : liveCells) {
+        const Cell& cell = cells[cellIndex];
+        if (cellTest(looseBounds(cell)))
+            visitList(cell.head, test, fn);
+    }
+    visitList(oversizedHead, test, fn);
+}
+
+template <class Fn>
+void SpatialGrid::QueryAABB(const AABB& box, Fn&& fn) const
+{
+    auto test = [&box](const Entry& e, Fn& f) {
+        if (Intersects(box, e.bounds))
+            f(e.id, e.bounds);
+    };
+
+    // a loose cell reaches half a cell beyond its core, so widen the search by that much
+    const float half = cellSize * 0.5f;
+    const int32_t x0 = static_cast<int32_t>(std::floor((box.min.x - half) * invCellSize));
+    const int32_t y0 = static_cast<int32_t>(std::floor((box.min.y - half) * invCellSize));
+    const int32_t z0 = static_cast<int32_t>(std::floor((box.min.z - half) * invCellSize));
+    const int32_t x1 = static_cast<int32_t>(std::floor((box.max.x + half) * invCellSize));
+    const int32_t y1 = static_cast<int32_t>(std::floor((box.max.y + half) * invCellSize));
+    const int32_t z1 = static_cast<int32_t>(std::floor((box.max.z + half) * invCellSize));
+    const uint64_t range = uint64_t(x1 - x0 + 1) * uint64_t(y1 - y0 + 1) * uint64_t(z1 - z0 + 1);
+
+    if (range > liveCells.size()) {
+        visitCells([&box](const AABB& loose) { return Intersects(box, loose); }, test, fn);
+        return;
+    }
+
+    for (int32_t z = z0; z <= z1; ++z)
+        for (int32_t y = y0; y <= y1; ++y)
+            for (int32_t x = x0; x <= x1; ++x) {
+                const uint32_t cellIndex = findCell(x, y, z);
+                if (cellIndex != invalid)
+                    visitList(cells[cellIndex].head, test, fn);
+            }
+    visitList(oversizedHead, test, fn);
+}
+
+template <class Fn>
+void SpatialGrid::QuerySphere(const Sphere& sphere, Fn&& fn) const
+{
+    AABB box;
+    box.min = sphere.center - sphere.radius;
+    box.max = sphere.center + sphere.radius;
+    QueryAABB(box, [&sphere, &fn](uint32_t id, const AABB& bounds) {
+        if (Intersects(bounds, sphere))
+            fn(id, bounds);
+    });
+}
+
+template <class Fn>
+void SpatialGrid::QueryFrustum(const Frustum& frustum, Fn&& fn) const
+{
+    for (uint32_t cellIndex : liveCells) {
+        const Cell& cell = cells[cellIndex];
+        const Containment c = Classify(frustum, looseBounds(cell));
+        if (c == Containment::Outside)
+            continue;
+        for (uint32_t slot = cell.head; slot != invalid; slot = entries[slot].next) {
+            const Entry& e = entries[slot];
+            // everything in a fully contained cell is contained too
+            const Containment ec = c == Containment::Inside ? c : Classify(frustum, e.bounds);
+            if (ec != Containment::Outside)
+                fn(e.id, e.bounds, ec);
+        }
+    }
+    for (uint32_t slot = oversizedHead; slot != invalid; slot = entries[slot].next) {
+        const Entry& e = entries[slot];
+        const Containment ec = Classify(frustum, e.bounds);
+        if (ec != Containment::Outside)
+            fn(e.id, e.bounds, ec);
+    }
+}
+
+template <class Fn>
+void SpatialGrid::QueryFrustumCached(const Frustum& frustum, FrustumCache& cache, Fn&& fn) const
+{
+    if (cache.cells.size() != cells.size() || cache.entries.size() != entries.size()) {
+        cache.cells.assign(cells.size(), FrustumCache::State());
+        cache.entries.assign(entries.size(), FrustumCache::State());
+        cache.valid = false;
+    }
+    const bool sameFrustum = cache.valid && memcmp(&cache.frustum, &frustum, sizeof(Frustum)) == 0;
+    const uint32_t seen = cache.stamp;
+    cache.stats = {};
+
+    auto classify = [&](FrustumCache::State& state, const AABB& bounds, uint32_t stamp, uint32_t& tests, uint32_t& reused) {
+        if (sameFrustum && !changedSince(stamp, seen)) {
+            ++reused;
+            return static_cast<Containment>(state.containment);
+        }
+        ++tests;
+        uint32_t plane = state.plane;
+        const Containment c = Classify(frustum, bounds, &plane);
+        state.containment = static_cast<uint8_t>(c);
+        state.plane = static_cast<uint8_t>(plane);
+        return c;
+    };
+    auto visit = [&](uint32_t slot, bool inside) {
+        const Entry& e = entries[slot];
+        const Containment ec = inside ? Containment::Inside
+                                      : classify(cache.entries[slot], e.bounds, e.stamp, cache.stats.objectTests, cache.stats.objectsReused);
+        if (ec != Containment::Outside)
+            fn(e.id, e.bounds, ec);
+    };
+
+    for (uint32_t cellIndex : liveCells) {
+        const Cell& cell = cells[cellIndex];
+        const Containment c = classify(cache.cells[cellIndex], looseBounds(cell), cell.stamp, cache.stats.cellTests, cache.stats.cellsReused);
+        if (c == Containment::Outside)
+            continue;
+        // everything in a fully contained cell is contained too, its objects keep their old state
+        for (uint32_t slot = cell.head; slot != invalid; slot = entries[slot].next) {
+            visit(slot, c == Containment::Inside);
+        }
+    }
+    for (uint32_t slot = oversizedHead; slot != invalid; slot = entries[slot].next) {
+        visit(slot, false);
+    }
+
+    cache.frustum = frustum;
+    cache.stamp = changeStamp;
+    cache.valid = true;
+}
+
+template <class Fn>
+void SpatialGrid::QueryRay(const Ray& ray, Fn&& fn) const
+{
+    auto test = [&ray](const Entry& e, Fn& f) {
+        float t;
+        if (Intersects(ray, e.bounds, &t))
+            f(e.id, e.bounds, t);
+    };
+    visitCells([&ray](const AABB& loose) { return Intersects(ray, loose); }, test, fn);
+}
+} // End of namespace m3d
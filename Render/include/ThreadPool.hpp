@@ -0,0 +1,56 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT)
+* (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace m3d {
+
+/*
+ * Fixed set of worker threads pulling tasks from one queue. ParallelFor is
+ * the main entry point: the calling thread works on the range too and only
+ * waits for chunks already running, so it may be called from inside a task.
+ */
+class ThreadPool {
+public:
+    /* 0 workers runs everything on the calling thread */
+    explicit ThreadPool(uint32_t workerCount);
+    ~ThreadPool();
+
+    /* Process wide pool with one worker per hardware thread but the caller's */
+    static ThreadPool& Shared();
+
+    uint32_t GetWorkerCount() const { return static_cast<uint32_t>(workers.size()); }
+
+    void Submit(std::function<void()> task);
+
+    /*
+     * Calls fn(chunkBegin, chunkEnd) over [begin, end) in chunks of at most
+     * grain items and returns when all chunks are done. Chunks run in any
+     * order on any thread.
+     */
+    void ParallelFor(uint32_t begin, uint32_t end, uint32_t grain, const std::function<void(uint32_t, uint32_t)>& fn);
+
+private:
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    bool stopping;
+};
+} // End of namespace m3d
@@ -0,0 +1,72 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT)
+* (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace m3d {
+enum VertexAttribute : uint32_t {
+    VertexPosition = 0,
+    VertexNormal,
+    VertexUV,
+    VertexTangent,
+    VertexAttributeCount
+};
+
+/* Storage of one attribute in the vertex buffer, None leaves it out */
+enum VertexEncoding : uint32_t {
+    VertexEncodingNone = 0,
+    VertexEncodingFloat32,
+    VertexEncodingFloat16,
+    VertexEncodingSnorm16,
+    VertexEncodingSnorm8
+};
+
+/* Vertex shader input location of each attribute, 1 to 4 are the instance matrix */
+const uint32_t VertexLocations[VertexAttributeCount] = { 0, 5, 6, 7 };
+
+/*
+ * One interleaved vertex buffer binding. Positions are xyz (w reads as 1),
+ * normals xyz, uvs uv and tangents xyz plus the bitangent sign in w; 16 and
+ * 8 bit encodings are padded to four components so every format is one the
+ * Vulkan spec requires for vertex buffers. Snorm is only allowed for unit
+ * vectors, positions and uvs are not in [-1, 1].
+ */
+struct VertexFormat {
+    VertexEncoding encodings[VertexAttributeCount];
+    // byte offset of each attribute inside a vertex
+    uint32_t offsets[VertexAttributeCount];
+    uint32_t stride;
+
+    bool Has(VertexAttribute attribute) const { return encodings[attribute] != VertexEncodingNone; }
+};
+
+/* Components stored for the attribute, including padding */
+uint32_t GetVertexComponentCount(VertexAttribute attribute, VertexEncoding encoding);
+
+/* Lays out the attributes in order; false, with a message, for an encoding the attribute can not use */
+bool MakeVertexFormat(VertexFormat& format, VertexEncoding position, VertexEncoding normal, VertexEncoding uv,
+    VertexEncoding tangent);
+
+/* float positions only, 12 bytes per vertex */
+VertexFormat PositionVertexFormat();
+/* float position, snorm8 normal and tangent, half uv: 24 bytes per vertex */
+VertexFormat CompactVertexFormat();
+
+/*
+ * Writes vertexCount vertices to destination, format.stride bytes each.
+ * Arrays use the Mesh strides (positions xyzw, normals xyz, uvs uv,
+ * tangents xyzw); a null array writes the default of its attribute: normal
+ * +z, uv 0, tangent +x.
+ */
+void PackVertices(const VertexFormat& format, const float* positions, const float* normals, const float* uvs,
+    const float* tangents, uint32_t vertexCount, void* destination);
+
+/* IEEE half, round to nearest even; overflows to infinity */
+uint16_t FloatToHalf(float value);
+} // End of namespace m3d
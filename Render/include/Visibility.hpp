@@ -0,0 +1,55 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT)
+* (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Bounds.hpp"
+
+namespace m3d {
+class ThreadPool;
+
+/*
+ * Frustums of every view rendered in a frame, the main camera, shadow
+ * cascades, probes, tested together: one pass over the bounds gives each
+ * object a mask with bit v set when it is at least partly inside view v,
+ * instead of one scan per view. A box's center and extents are computed
+ * once for all views.
+ */
+class ViewSet {
+public:
+    static const uint32_t MaxViews = 32;
+
+    ViewSet();
+
+    void Clear() { viewCount = 0; }
+    /* Returns the view's bit index */
+    uint32_t AddView(const Frustum& frustum);
+    uint32_t GetViewCount() const { return viewCount; }
+    /* Bits of all views added so far */
+    uint32_t GetAllViewsMask() const { return viewCount == MaxViews ? 0xFFFFFFFF : (1u << viewCount) - 1; }
+
+    uint32_t Test(const AABB& box) const;
+    /* masks[i] = Test(boxes[i]), chunks of grain boxes run on the pool */
+    void TestAll(const AABB* boxes, size_t count, uint32_t* masks, ThreadPool& pool, uint32_t grain = 1024) const;
+
+private:
+    // planes with their normals' absolute values, for the box radius
+    struct ViewPlanes {
+        float normal[Frustum::PlaneCount][3];
+        float absNormal[Frustum::PlaneCount][3];
+        float d[Frustum::PlaneCount];
+    };
+
+    ViewPlanes views[MaxViews];
+    uint32_t viewCount;
+};
+
+/* Appends ids[i] for every masks[i] with the view's bit set, in order */
+void CollectVisible(const uint32_t* ids, const uint32_t* masks, size_t count, uint32_t view, std::vector<uint32_t>& out);
+} // End of namespace m3d
@@ -5,8 +5,18 @@
 
 #include <cstdint>
 #include <cassert>
+#include <cstddef>
 #include <utility>
 
+#include "ThreadPool.hpp"
+
+#if defined(_MSC_VER)
+#include <xmmintrin.h>
+#define PACKED_FREELIST_PREFETCH(address) _mm_prefetch(reinterpret_cast<const char*>(address), _MM_HINT_T0)
+#else
+#define PACKED_FREELIST_PREFETCH(address) __builtin_prefetch(address)
+#endif
+
 template<class T>
 class packed_freelist
 {
@@ -244,6 +254,19 @@ public:
         return alloc->allocation_id == id && alloc->object_index != tombstone;
     }
 
+    // whether the allocation an id's 16 LSBs index owns an object, whatever its current id
+    bool contains_slot(uint32_t slot) const
+    {
+        return _allocations[slot & alloc_index_mask].object_index != tombstone;
+    }
+
+    // the current id of a slot contains_slot reports live
+    uint32_t id_of_slot(uint32_t slot) const
+    {
+        assert(contains_slot(slot));
+        return _allocations[slot & alloc_index_mask].allocation_id;
+    }
+
     T& operator[](uint32_t id) const
     {
         // grab the allocation corresponding to this ID
@@ -324,6 +347,107 @@ public:
         return iterator{ _object_alloc_ids + _num_objects };
     }
 
+    // walks the packed objects with their IDs, in storage order:
+    //     for (auto c = list.get_cursor(); c; ++c) { c.id(); *c; }
+    // unlike iterator, reaching the object needs no trip through the allocations
+    struct cursor
+    {
+        cursor(T* objects, const uint32_t* ids, size_t count)
+        {
+            _curr_object = objects;
+            _curr_id = ids;
+            _end_id = ids + count;
+        }
+
+        explicit operator bool() const
+        {
+            return _curr_id != _end_id;
+        }
+
+        cursor& operator++()
+        {
+            _curr_object++;
+            _curr_id++;
+            return *this;
+        }
+
+        uint32_t id() const
+        {
+            return *_curr_id;
+        }
+
+        T& operator*() const
+        {
+            return *_curr_object;
+        }
+
+        T* operator->() const
+        {
+            return _curr_object;
+        }
+
+    private:
+        T* _curr_object;
+        const uint32_t* _curr_id;
+        const uint32_t* _end_id;
+    };
+
+    cursor get_cursor() const
+    {
+        return cursor(_objects, _object_alloc_ids, _num_objects);
+    }
+
+    // resolves n IDs at once, out[i] is the object of ids[i] or nullptr when the ID is stale.
+    // each lookup is two dependent loads (allocation, then object): the allocation is
+    // prefetched lookahead IDs ahead and the object half as far, so both are in cache
+    // when reached instead of each ID waiting on its own two misses. returns the number found.
+    size_t lookup_batch(const uint32_t* ids, size_t n, T** out) const
+    {
+        const size_t lookahead = 8;
+        size_t found = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            if (i + lookahead < n)
+                PACKED_FREELIST_PREFETCH(&_allocations[ids[i + lookahead] & alloc_index_mask]);
+            if (i + lookahead / 2 < n)
+            {
+                // the allocation was prefetched lookahead / 2 IDs ago
+                const allocation_t* ahead = &_allocations[ids[i + lookahead / 2] & alloc_index_mask];
+                if (ahead->object_index != tombstone)
+                    PACKED_FREELIST_PREFETCH(_objects + ahead->object_index);
+            }
+
+            const allocation_t* alloc = &_allocations[ids[i] & alloc_index_mask];
+            const bool valid = alloc->allocation_id == ids[i] && alloc->object_index != tombstone;
+            out[i] = valid ? _objects + alloc->object_index : nullptr;
+            found += valid ? 1 : 0;
+        }
+        return found;
+    }
+
+    // calls fn(T* objects, const uint32_t* ids, size_t first, size_t count) on consecutive
+    // slices of at most grain packed objects; objects and ids point at the slice, which
+    // starts at index first of the storage. returns when all slices are done.
+    // slices run concurrently on the pool's threads: fn may modify its own objects but must
+    // not insert or erase. the calling thread takes part, so this may run inside a task.
+    template<class Fn>
+    void parallel_for_each(m3d::ThreadPool& pool, Fn fn, size_t grain) const
+    {
+        assert(grain > 0);
+        T* objects = _objects;
+        const uint32_t* ids = _object_alloc_ids;
+        pool.ParallelFor(0, (uint32_t)_num_objects, (uint32_t)grain, [&](uint32_t begin, uint32_t end) {
+            fn(objects + begin, ids + begin, (size_t)begin, (size_t)(end - begin));
+        });
+    }
+
+    // parallel_for_each on the process wide pool
+    template<class Fn>
+    void parallel_for_each(Fn fn, size_t grain = 1024) const
+    {
+        parallel_for_each(m3d::ThreadPool::Shared(), fn, grain);
+    }
+
     bool empty() const
     {
         return _num_objects == 0;
@@ -339,6 +463,12 @@ public:
         return _max_objects;
     }
 
+    // bytes of the object, ID and allocation storage, whether used or not
+    size_t memory_bytes() const
+    {
+        return _cap_objects * (sizeof(T) + sizeof(uint32_t) + sizeof(allocation_t));
+    }
+
 private:
     allocation_t* insert_alloc()
     {
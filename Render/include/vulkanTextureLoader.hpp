@@ -17,6 +17,7 @@
 #include <android/asset_manager.h>
 #endif
 
+#include "File.hpp"
 #include "VulkanHelper.hpp"
 
 #define DEFAULT_FENCE_TIMEOUT 100000000000
@@ -122,7 +123,10 @@ namespace vkext
 
 			free(textureData);
 #else
-			gli::texture2d tex2D(gli::load(filename.c_str()));
+			// parse straight from the mapped file instead of gli reading a copy
+			m3d::file::MappedFile textureFile;
+			textureFile.Open(filename.c_str(), m3d::file::Access::Sequential);
+			gli::texture2d tex2D(gli::load(reinterpret_cast<const char*>(textureFile.Data()), textureFile.Size()));
 #endif		
 			assert(!tex2D.empty());
 
@@ -434,7 +438,10 @@ namespace vkext
 
 			free(textureData);
 #else
-			gli::texture_cube texCube(gli::load(filename));
+			// parse straight from the mapped file instead of gli reading a copy
+			m3d::file::MappedFile textureFile;
+			textureFile.Open(filename.c_str(), m3d::file::Access::Sequential);
+			gli::texture_cube texCube(gli::load(reinterpret_cast<const char*>(textureFile.Data()), textureFile.Size()));
 #endif	
 			assert(!texCube.empty());
 
@@ -640,7 +647,10 @@ namespace vkext
 
 			free(textureData);
 #else
-			gli::texture2d_array tex2DArray(gli::load(filename));
+			// parse straight from the mapped file instead of gli reading a copy
+			m3d::file::MappedFile textureFile;
+			textureFile.Open(filename.c_str(), m3d::file::Access::Sequential);
+			gli::texture2d_array tex2DArray(gli::load(reinterpret_cast<const char*>(textureFile.Data()), textureFile.Size()));
 #endif	
 
 			assert(!tex2DArray.empty());
@@ -1,9 +1,14 @@
 #include "../include/CommandBuffer.hpp"
 #include "../include/Pipeline.hpp"
+#include "../include/RenderQueue.hpp"
+#include "../include/MeshOptimizer.hpp"
 #include "../include/Scene.hpp"
+#include "../include/VertexFormat.hpp"
 #include "../include/VulkanHelper.hpp"
 #include "../include/VulkanSwapchain.hpp"
 
+#include <algorithm>
+
 static const uint32_t width = 1280;
 static const uint32_t height = 720;
 
@@ -13,7 +18,9 @@ CommandBuffer::CommandBuffer(vk::Device& Device, vk::PhysicalDevice& PhysicalDev
     , physicalDevice(PhysicalDevice)
     , queue(Queue)
     , swapChain(swapChain)
+    , transformVersion(0)
 {
+    depthStencil.bytes = 0;
     createCommandPool();
 
     drawCmdBuffers.resize(swapChain.images.size());
@@ -24,6 +31,8 @@ CommandBuffer::CommandBuffer(vk::Device& Device, vk::PhysicalDevice& PhysicalDev
     cmdBufAllocateInfo.commandBufferCount = drawCmdBuffers.size();
 
     drawCmdBuffers = device.allocateCommandBuffers(cmdBufAllocateInfo);
+
+    instanceBuffers.resize(drawCmdBuffers.size());
 }
 
 /* Create Frame Buffer */
@@ -69,6 +78,7 @@ void CommandBuffer::CreateDepthStencil()
     memAlloc.allocationSize = memReqs.size;
     memAlloc.memoryTypeIndex = vkhelper::getMemoryType(physicalDevice, memReqs.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal);
     depthStencil.mem = device.allocateMemory(memAlloc, nullptr);
+    depthStencil.bytes = memReqs.size;
     device.bindImageMemory(depthStencil.image, depthStencil.mem, 0);
 
     depthStencilView.image = depthStencil.image;
@@ -131,82 +141,327 @@ void CommandBuffer::CreateBuffer(vk::BufferUsageFlags usageFlags, vk::MemoryProp
     device.bindBufferMemory(buffer, memory, 0);
 }
 
-void CommandBuffer::CreateVertices(std::vector<float>& vertices, std::vector<uint32_t> &indices)
+void CommandBuffer::createDeviceBuffer(vk::BufferUsageFlags usage, vk::DeviceSize size, void* data, vk::Buffer& buffer, vk::DeviceMemory& memory)
 {
-    size_t vertexBufferSize = vertices.size() * sizeof(float);
-    size_t indexBufferSize = indices.size() * sizeof(uint32_t);
-    // TODO
-    meshBuffer.indexCount = indices.size();
-
-    struct {
-        vk::Buffer buffer;
-        vk::DeviceMemory memory;
-    } vertexStaging, indexStaging;
-
-    // Create staging buffers
-    // Vertex data
-    CreateBuffer(
-        vk::BufferUsageFlagBits::eTransferSrc,
-        vk::MemoryPropertyFlagBits::eHostVisible,
-        vertexBufferSize,
-        vertices.data(),
-        vertexStaging.buffer,
-        vertexStaging.memory);
-    // Index data
+    StagingBuffer staging;
     CreateBuffer(
         vk::BufferUsageFlagBits::eTransferSrc,
         vk::MemoryPropertyFlagBits::eHostVisible,
-        indexBufferSize,
-        indices.data(),
-        indexStaging.buffer,
-        indexStaging.memory);
-
-    // Create device local buffers
-    // Vertex buffer
-    CreateBuffer(
-        vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst,
-        vk::MemoryPropertyFlagBits::eDeviceLocal,
-        vertexBufferSize,
-        nullptr,
-        meshBuffer.vertices.buf,
-        meshBuffer.vertices.mem);
-    // Index buffer
+        size,
+        data,
+        staging.buf,
+        staging.mem);
     CreateBuffer(
-        vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst,
+        usage | vk::BufferUsageFlagBits::eTransferDst,
         vk::MemoryPropertyFlagBits::eDeviceLocal,
-        indexBufferSize,
+        size,
         nullptr,
-        meshBuffer.indices.buf,
-        meshBuffer.indices.mem);
+        buffer,
+        memory);
 
-    // Copy from staging buffers
     uint32_t copyCmdIndex = Create(vk::CommandBufferLevel::ePrimary, true);
-
     vk::BufferCopy copyRegion = {};
+    copyRegion.size = size;
+    tempCmdBuffers[copyCmdIndex].copyBuffer(staging.buf, buffer, copyRegion);
+    Flush(copyCmdIndex);
 
-    copyRegion.size = vertexBufferSize;
-
-    tempCmdBuffers[copyCmdIndex].copyBuffer(vertexStaging.buffer, meshBuffer.vertices.buf, copyRegion);
+    device.destroyBuffer(staging.buf);
+    device.freeMemory(staging.mem);
+}
 
-    copyRegion.size = indexBufferSize;
+void CommandBuffer::CreateVertices(std::vector<uint8_t>& vertices, std::vector<uint32_t>& indices, std::vector<uint16_t>& shortIndices)
+{
+    meshBuffer.indexCount = static_cast<uint32_t>(indices.size() + shortIndices.size());
+
+    createDeviceBuffer(vk::BufferUsageFlagBits::eVertexBuffer, vertices.size(), vertices.data(), meshBuffer.vertices.buf, meshBuffer.vertices.mem);
+    // zero sized buffers are not allowed, an index buffer no mesh uses is left out
+    if (!indices.empty())
+        createDeviceBuffer(vk::BufferUsageFlagBits::eIndexBuffer, indices.size() * sizeof(uint32_t), indices.data(), meshBuffer.indices.buf, meshBuffer.indices.mem);
+    if (!shortIndices.empty())
+        createDeviceBuffer(vk::BufferUsageFlagBits::eIndexBuffer, shortIndices.size() * sizeof(uint16_t), shortIndices.data(), meshBuffer.shortIndices.buf, meshBuffer.shortIndices.mem);
+}
 
-    tempCmdBuffers[copyCmdIndex].copyBuffer(indexStaging.buffer, meshBuffer.indices.buf, copyRegion);
+void CommandBuffer::DestroySceneBuffers()
+{
+    StagingBuffer* buffers[] = { &meshBuffer.vertices, &meshBuffer.indices, &meshBuffer.shortIndices };
+    for (StagingBuffer* buffer : buffers) {
+        if (buffer->buf) {
+            device.destroyBuffer(buffer->buf);
+            device.freeMemory(buffer->mem);
+        }
+        *buffer = StagingBuffer();
+    }
+    meshBuffer.indexCount = 0;
+}
 
-    Flush(copyCmdIndex);
+void CommandBuffer::CreateSceneBuffers(Scene& scene, const VertexFormat& vertexFormat, uint32_t firstLod)
+{
+    DestroySceneBuffers();
+
+    std::vector<uint8_t> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<uint16_t> shortIndices;
+    std::vector<float> tangents;
+
+    // the scene may have been replaced, UpdateTransforms starts over
+    worldMatrices.clear();
+
+    meshRanges.assign(scene.meshes.capacity(), MeshRange{ 0, 0, vk::IndexType::eUint32 });
+    meshGpuBytes.assign(scene.meshes.capacity(), 0);
+    for (uint32_t meshId : scene.meshes) {
+        const Mesh& mesh = scene.meshes[meshId];
+        const ArrayView<float> meshVertices = mesh.GetVertices();
+        const ArrayView<uint32_t> meshIndices = mesh.GetIndices();
+        const uint32_t vertexCount = static_cast<uint32_t>(meshVertices.size() / PositionStride);
+
+        MeshRange& range = meshRanges[meshId & 0xFFFF];
+        range.vertexOffset = static_cast<int32_t>(vertices.size() / vertexFormat.stride);
+
+        // missing or partial attributes are packed as defaults
+        const ArrayView<float> normals = mesh.GetNormals();
+        const ArrayView<float> uvs = mesh.GetUVs();
+        ArrayView<float> meshTangents = mesh.GetTangents();
+        const bool hasNormals = normals.size() == vertexCount * NormalStride;
+        const bool hasUVs = uvs.size() == vertexCount * UVStride;
+        // meshes imported at runtime have no tangents yet
+        if (vertexFormat.Has(VertexTangent) && meshTangents.empty() && hasNormals && hasUVs
+            && !mesh.normals.empty() && !mesh.uvs.empty() && !mesh.indices.empty()) {
+            ComputeTangents(mesh.vertices, mesh.normals, mesh.uvs, mesh.indices, tangents);
+            meshTangents = ArrayView<float>(tangents);
+        }
+        const bool hasTangents = meshTangents.size() == vertexCount * TangentStride;
+
+        const size_t offset = vertices.size();
+        vertices.resize(offset + vertexCount * vertexFormat.stride);
+        PackVertices(vertexFormat, meshVertices.data(), hasNormals ? normals.data() : nullptr, hasUVs ? uvs.data() : nullptr,
+            hasTangents ? meshTangents.data() : nullptr, vertexCount, vertices.data() + offset);
+
+        // only the indices of the levels that can be drawn, [firstUsed, endUsed) of mesh.indices;
+        // firstIndex is moved back by firstUsed, so slice offsets still add up (modulo 2^32)
+        const uint32_t keptLod = std::min(firstLod, mesh.GetLodCount() - 1);
+        uint32_t firstUsed = static_cast<uint32_t>(meshIndices.size());
+        uint32_t endUsed = 0;
+        for (uint32_t lod = keptLod; lod < mesh.GetLodCount(); ++lod) {
+            for (const Mesh::Slice& slice : mesh.GetSlices(lod)) {
+                firstUsed = std::min(firstUsed, static_cast<uint32_t>(slice.indexOffset));
+                endUsed = std::max(endUsed, static_cast<uint32_t>(slice.indexOffset + slice.triangleCount * 3));
+            }
+        }
+        if (firstUsed >= endUsed) {
+            firstUsed = 0;
+            endUsed = 0;
+        }
+
+        // same layout as mesh.indices, each slice's indices made relative to its baseVertex;
+        // a mesh with one slice that does not fit keeps 32 bit indices for all
+        const size_t shortOffset = shortIndices.size();
+        shortIndices.resize(shortOffset + (endUsed - firstUsed), 0);
+        bool fits = true;
+        for (uint32_t lod = keptLod; lod < mesh.GetLodCount() && fits; ++lod) {
+            for (const Mesh::Slice& slice : mesh.GetSlices(lod)) {
+                const uint32_t end = slice.indexOffset + slice.triangleCount * 3;
+                for (uint32_t i = slice.indexOffset; i < end && fits; ++i) {
+                    const uint32_t index = meshIndices[i] - slice.baseVertex;
+                    fits = meshIndices[i] >= slice.baseVertex && index <= 0xFFFF;
+                    shortIndices[shortOffset + i - firstUsed] = static_cast<uint16_t>(index);
+                }
+            }
+        }
+        if (fits) {
+            range.firstIndex = static_cast<uint32_t>(shortOffset) - firstUsed;
+            range.indexType = vk::IndexType::eUint16;
+        } else {
+            shortIndices.resize(shortOffset);
+            range.firstIndex = static_cast<uint32_t>(indices.size()) - firstUsed;
+            indices.insert(indices.end(), meshIndices.begin() + firstUsed, meshIndices.begin() + endUsed);
+        }
+        meshGpuBytes[meshId & 0xFFFF] = vertexCount * vertexFormat.stride
+            + uint64_t(endUsed - firstUsed) * (fits ? sizeof(uint16_t) : sizeof(uint32_t));
+    }
 
-    device.destroyBuffer(vertexStaging.buffer);
-    device.freeMemory(vertexStaging.memory);
-    device.destroyBuffer(indexStaging.buffer);
-    device.freeMemory(indexStaging.memory);
+    // nothing loaded yet, zero sized buffers are not allowed
+    if (vertices.empty() || (indices.empty() && shortIndices.empty()))
+        return;
+    CreateVertices(vertices, indices, shortIndices);
 }
 
-void CommandBuffer::Build(Pipeline& pipeline)
+void CommandBuffer::Build(Pipeline& pipeline, const Scene& scene, const RenderQueue& renderQueue)
 {
     {
         CreateDepthStencil();
         CreateFramebuffers(pipeline);
     }
 
+    UpdateTransforms(scene);
+    for (uint32_t i = 0; i < drawCmdBuffers.size(); ++i) {
+        UpdateInstances(i, scene, renderQueue);
+        Record(i, pipeline, scene, renderQueue);
+    }
+}
+
+void CommandBuffer::destroyInstanceBuffer(uint32_t i)
+{
+    InstanceBuffer& instances = instanceBuffers[i];
+    if (instances.buf) {
+        device.unmapMemory(instances.stagingMem);
+        device.destroyBuffer(instances.stagingBuf);
+        device.freeMemory(instances.stagingMem);
+        device.destroyBuffer(instances.buf);
+        device.freeMemory(instances.mem);
+    }
+    instances = InstanceBuffer();
+}
+
+void CommandBuffer::reserveInstanceBuffer(uint32_t i, uint32_t instanceCount)
+{
+    if (instanceCount <= instanceBuffers[i].capacity)
+        return;
+
+    // grow geometrically so a slowly growing scene does not reallocate every frame
+    uint32_t capacity = instanceBuffers[i].capacity ? instanceBuffers[i].capacity : 256;
+    while (capacity < instanceCount)
+        capacity *= 2;
+    destroyInstanceBuffer(i);
+
+    InstanceBuffer& instances = instanceBuffers[i];
+    const vk::DeviceSize size = capacity * sizeof(m3d::math::Matrix4x4);
+    CreateBuffer(
+        vk::BufferUsageFlagBits::eTransferSrc,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+        size,
+        nullptr,
+        instances.stagingBuf,
+        instances.stagingMem);
+    CreateBuffer(
+        vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst,
+        vk::MemoryPropertyFlagBits::eDeviceLocal,
+        size,
+        nullptr,
+        instances.buf,
+        instances.mem);
+    instances.mapped = device.mapMemory(instances.stagingMem, 0, size);
+    instances.capacity = capacity;
+    // the new buffer holds nothing, every item is staged
+    instances.itemTransforms.assign(capacity, 0xFFFFFFFF);
+}
+
+void CommandBuffer::UpdateTransforms(const Scene& scene)
+{
+    const size_t slotCount = scene.transforms.capacity();
+    if (worldMatrices.size() != slotCount) {
+        worldMatrices.resize(slotCount);
+        worldVersions.assign(slotCount, 0);
+        ++transformVersion;
+        const uint32_t version = transformVersion;
+        // every transform writes its own slot, the slices need no locking
+        scene.transforms.parallel_for_each([&](const Transform* transforms, const uint32_t* ids, size_t, size_t count) {
+            for (size_t i = 0; i < count; ++i) {
+                worldMatrices[ids[i] & 0xFFFF] = GetWorldMatrix(transforms[i]);
+                worldVersions[ids[i] & 0xFFFF] = version;
+            }
+        });
+        return;
+    }
+    if (!scene.dirtyTransforms.Any())
+        return;
+
+    ++transformVersion;
+    scene.dirtyTransforms.ForEach([&](uint32_t slot) {
+        // the transform may have been erased since it was marked
+        if (slot >= slotCount || !scene.transforms.contains_slot(slot))
+            return;
+        worldMatrices[slot] = GetWorldMatrix(scene.transforms[slot]);
+        worldVersions[slot] = transformVersion;
+    });
+}
+
+void CommandBuffer::ReportMemory(const Scene& scene, MemoryReport& report) const
+{
+    for (uint32_t meshId : scene.meshes) {
+        if ((meshId & 0xFFFF) < meshGpuBytes.size())
+            report.AddAsset(MemoryMeshes, meshId, scene.meshes[meshId].name, 0, meshGpuBytes[meshId & 0xFFFF]);
+    }
+
+    uint64_t cpuBytes = meshRanges.capacity() * sizeof(MeshRange) + meshGpuBytes.capacity() * sizeof(uint64_t)
+        + worldMatrices.capacity() * sizeof(m3d::math::Matrix4x4) + worldVersions.capacity() * sizeof(uint32_t);
+    uint64_t gpuBytes = depthStencil.bytes;
+    for (const InstanceBuffer& instances : instanceBuffers) {
+        const uint64_t bytes = uint64_t(instances.capacity) * sizeof(m3d::math::Matrix4x4);
+        // the device local buffer and its host visible staging mirror
+        gpuBytes += 2 * bytes;
+        cpuBytes += instances.itemTransforms.capacity() * sizeof(uint32_t) + instances.copies.capacity() * sizeof(vk::BufferCopy);
+    }
+    report.Add(MemoryRenderer, cpuBytes, gpuBytes);
+}
+
+void CommandBuffer::UpdateInstances(uint32_t i, const Scene& scene, const RenderQueue& renderQueue)
+{
+    const std::vector<RenderItem>& items = renderQueue.GetItems();
+    reserveInstanceBuffer(i, static_cast<uint32_t>(items.size()));
+
+    // a run of up to this many unchanged items between two changed ones is copied along
+    const uint32_t maxGap = 4;
+
+    // item order is instance order, see DrawCommand::firstInstance
+    InstanceBuffer& instances = instanceBuffers[i];
+    m3d::math::Matrix4x4* matrices = static_cast<m3d::math::Matrix4x4*>(instances.mapped);
+    std::vector<SlotRange> ranges;
+    const uint32_t batchSize = 64;
+    uint32_t instanceIds[batchSize];
+    uint32_t placementIds[batchSize];
+    uint32_t instanceItems[batchSize];
+    uint32_t placementItems[batchSize];
+    Instance* batch[batchSize];
+    PrefabInstance* placements[batchSize];
+    // transform slot of each item, prefab parts add their part in the 16 MSBs
+    uint32_t keys[batchSize];
+    for (uint32_t begin = 0; begin < items.size(); begin += batchSize) {
+        const uint32_t count = std::min(batchSize, static_cast<uint32_t>(items.size()) - begin);
+        uint32_t instanceCount = 0;
+        uint32_t placementCount = 0;
+        for (uint32_t n = 0; n < count; ++n) {
+            const RenderItem& item = items[begin + n];
+            if (item.prefabPart) {
+                placementIds[placementCount] = item.instanceId;
+                placementItems[placementCount++] = n;
+            } else {
+                instanceIds[instanceCount] = item.instanceId;
+                instanceItems[instanceCount++] = n;
+            }
+        }
+        // the queue only holds live instances
+        scene.instances.lookup_batch(instanceIds, instanceCount, batch);
+        scene.prefabInstances.lookup_batch(placementIds, placementCount, placements);
+        for (uint32_t n = 0; n < instanceCount; ++n) {
+            keys[instanceItems[n]] = batch[n]->transformId & 0xFFFF;
+        }
+        for (uint32_t n = 0; n < placementCount; ++n) {
+            keys[placementItems[n]] = (placements[n]->transformId & 0xFFFF) | (items[begin + placementItems[n]].prefabPart << 16);
+        }
+
+        for (uint32_t n = 0; n < count; ++n) {
+            const uint32_t item = begin + n;
+            const uint32_t slot = keys[n] & 0xFFFF;
+            if (instances.itemTransforms[item] == keys[n] && worldVersions[slot] <= instances.version)
+                continue;
+            // a part's matrix is not cached, it changes with its root's
+            matrices[item] = keys[n] == slot ? worldMatrices[slot] : GetWorldMatrix(GetItemTransform(scene, items[item]));
+            instances.itemTransforms[item] = keys[n];
+            AppendRange(ranges, item, maxGap);
+        }
+    }
+    instances.version = transformVersion;
+
+    instances.copies.clear();
+    for (const SlotRange& range : ranges) {
+        // the gaps copy matrices staged earlier, still what the items hold
+        const vk::DeviceSize offset = range.first * sizeof(m3d::math::Matrix4x4);
+        instances.copies.push_back(vk::BufferCopy(offset, offset, range.count * sizeof(m3d::math::Matrix4x4)));
+    }
+}
+
+void CommandBuffer::Record(uint32_t i, Pipeline& pipeline, const Scene& scene, const RenderQueue& renderQueue)
+{
     vk::CommandBufferBeginInfo cmdBufInfo = {};
 
     vk::ClearValue clearValues[2];
@@ -223,12 +478,28 @@ void CommandBuffer::Build(Pipeline& pipeline)
     renderPassBeginInfo.clearValueCount = 2;
     renderPassBeginInfo.pClearValues = clearValues;
 
-    for (int32_t i = 0; i < drawCmdBuffers.size(); ++i) {
+    {
         renderPassBeginInfo.framebuffer = frameBuffers[i];
 
         //VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffers[i], &cmdBufInfo));
         drawCmdBuffers[i].begin(cmdBufInfo);
 
+        // transfers are not allowed inside a render pass
+        const InstanceBuffer& instances = instanceBuffers[i];
+        if (!instances.copies.empty()) {
+            drawCmdBuffers[i].copyBuffer(instances.stagingBuf, instances.buf, instances.copies);
+            vk::BufferMemoryBarrier barrier;
+            barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+            barrier.dstAccessMask = vk::AccessFlagBits::eVertexAttributeRead;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.buffer = instances.buf;
+            barrier.offset = 0;
+            barrier.size = VK_WHOLE_SIZE;
+            drawCmdBuffers[i].pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eVertexInput,
+                vk::DependencyFlags(), nullptr, barrier, nullptr);
+        }
+
         //vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
         drawCmdBuffers[i].beginRenderPass(renderPassBeginInfo, vk::SubpassContents::eInline);
 		vk::Viewport viewport = {0, 0, (float)width, (float)height, 0.0f, 1.0f};
@@ -236,14 +507,47 @@ void CommandBuffer::Build(Pipeline& pipeline)
 		vk::Rect2D rect2d = { (0, 0), (width, height) };
         drawCmdBuffers[i].setScissor(0, 1, &rect2d);
 
-        vk::DeviceSize offsets[1] = { 0 };
-
-        drawCmdBuffers[i].bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline.GetPipelineLayout(), 0, 1, &pipeline.GetDescriptorSet(), 0, nullptr);
-        drawCmdBuffers[i].bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline.GetPipeline());
-
-        drawCmdBuffers[i].bindVertexBuffers(0, 1, &meshBuffer.vertices.buf, offsets);
-        drawCmdBuffers[i].bindIndexBuffer(meshBuffer.indices.buf, 0, vk::IndexType::eUint32);
-        drawCmdBuffers[i].drawIndexed(meshBuffer.indexCount, 1, 0, 0, 1);
+        vk::DeviceSize offsets[2] = { 0, 0 };
+        vk::Buffer vertexBuffers[2] = { meshBuffer.vertices.buf, instanceBuffers[i].buf };
+
+        // all meshes share one vertex buffer and two index buffers, 16 and 32 bit; a mesh
+        // change is an offset change and, when the index size differs, an index buffer bind
+        // one pipeline draws everything, see sortkey
+        if (!renderQueue.GetDrawList().empty()) {
+            drawCmdBuffers[i].bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline.GetPipeline());
+            drawCmdBuffers[i].bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline.GetPipelineLayout(), 0, 1, &pipeline.GetDescriptorSet(), 0, nullptr);
+            drawCmdBuffers[i].bindVertexBuffers(0, 2, vertexBuffers, offsets);
+        }
+        bool indicesBound = false;
+        vk::IndexType boundIndexType = vk::IndexType::eUint32;
+
+        for (const DrawCommand& draw : renderQueue.GetDrawList()) {
+            // materials have no descriptor sets yet, ChangeMaterial has nothing to bind
+
+            // state above is still bound for later commands when cluster culling emptied this one
+            if (draw.instanceCount == 0)
+                continue;
+
+            const Mesh::Slice& slice = scene.meshes[draw.meshId].GetSlices(draw.lod)[draw.slice];
+            const MeshRange& range = meshRanges[draw.meshId & 0xFFFF];
+            if (!indicesBound || range.indexType != boundIndexType) {
+                const bool shortIndices = range.indexType == vk::IndexType::eUint16;
+                drawCmdBuffers[i].bindIndexBuffer(shortIndices ? meshBuffer.shortIndices.buf : meshBuffer.indices.buf, 0, range.indexType);
+                indicesBound = true;
+                boundIndexType = range.indexType;
+            }
+            // 16 bit indices are relative to the slice's baseVertex, 32 bit ones absolute
+            const int32_t vertexOffset = range.vertexOffset + static_cast<int32_t>(range.indexType == vk::IndexType::eUint16 ? slice.baseVertex : 0);
+            if (draw.rangeCount) {
+                // meshlets never cross a slice, so they share its baseVertex
+                for (uint32_t r = draw.firstRange; r < draw.firstRange + draw.rangeCount; ++r) {
+                    const IndexRange& cluster = renderQueue.GetClusterRanges()[r];
+                    drawCmdBuffers[i].drawIndexed(cluster.indexCount, 1, range.firstIndex + cluster.firstIndex, vertexOffset, draw.firstInstance);
+                }
+                continue;
+            }
+            drawCmdBuffers[i].drawIndexed(slice.triangleCount * 3, draw.instanceCount, range.firstIndex + slice.indexOffset, vertexOffset, draw.firstInstance);
+        }
         drawCmdBuffers[i].endRenderPass();
         drawCmdBuffers[i].end();
     }
@@ -314,6 +618,12 @@ CommandBuffer::~CommandBuffer()
     }
     drawCmdBuffers.clear();
 
+    DestroySceneBuffers();
+    for (uint32_t i = 0; i < instanceBuffers.size(); ++i) {
+        destroyInstanceBuffer(i);
+    }
+    instanceBuffers.clear();
+
     // destroy command pool
     device.destroyCommandPool(cmdPool);
 }
@@ -0,0 +1,66 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT)
+* (http://opensource.org/licenses/MIT)
+*/
+
+#include "DirtyRanges.hpp"
+
+#include <algorithm>
+
+namespace m3d {
+void AppendRange(std::vector<SlotRange>& ranges, uint32_t index, uint32_t maxGap)
+{
+    if (!ranges.empty()) {
+        SlotRange& last = ranges.back();
+        const uint32_t end = last.first + last.count;
+        if (index >= end && index - end <= maxGap) {
+            last.count = index + 1 - last.first;
+            return;
+        }
+    }
+    SlotRange range = { index, 1 };
+    ranges.push_back(range);
+}
+
+DirtyRanges::DirtyRanges()
+    : any(false)
+{
+}
+
+void DirtyRanges::Mark(uint32_t id)
+{
+    const uint32_t slot = id & index_mask;
+    if (slot / 64 >= words.size())
+        words.resize(slot / 64 + 1, 0);
+    words[slot / 64] |= uint64_t(1) << (slot % 64);
+    any = true;
+}
+
+bool DirtyRanges::IsDirty(uint32_t id) const
+{
+    const uint32_t slot = id & index_mask;
+    return slot / 64 < words.size() && (words[slot / 64] >> (slot % 64)) & 1;
+}
+
+void DirtyRanges::Clear()
+{
+    if (any)
+        std::fill(words.begin(), words.end(), 0);
+    any = false;
+}
+
+void DirtyRanges::GetRanges(std::vector<SlotRange>& ranges, uint32_t maxGap) const
+{
+    const size_t firstRange = ranges.size();
+    ForEach([&](uint32_t slot) {
+        // only merge with ranges appended here
+        if (ranges.size() == firstRange) {
+            SlotRange range = { slot, 1 };
+            ranges.push_back(range);
+        } else {
+            AppendRange(ranges, slot, maxGap);
+        }
+    });
+}
+} // End of namespace m3d
@@ -0,0 +1,221 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT)
+* (http://opensource.org/licenses/MIT)
+*/
+
+#include "EntityStore.hpp"
+
+#include <cassert>
+#include <cstdio>
+#include <mutex>
+
+namespace m3d {
+// entries are written once, before their id is handed out, and read without the lock
+static ComponentInfo componentRegistry[MaxComponentTypes];
+static uint32_t componentTypeCount = 0;
+static std::mutex componentRegistryMutex;
+
+uint32_t RegisterComponentType(const ComponentInfo& info)
+{
+    std::lock_guard<std::mutex> lock(componentRegistryMutex);
+    assert(componentTypeCount < MaxComponentTypes);
+    componentRegistry[componentTypeCount] = info;
+    return componentTypeCount++;
+}
+
+const ComponentInfo& GetComponentInfo(uint32_t typeId)
+{
+    return componentRegistry[typeId];
+}
+
+static uint32_t AlignUp(uint32_t offset, uint32_t alignment)
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+EntityStore::EntityStore()
+    : freeHead(0)
+    , entityCount(0)
+{
+}
+
+EntityStore::~EntityStore()
+{
+    for (Archetype& archetype : archetypes) {
+        for (Chunk& chunk : archetype.chunks) {
+            for (uint32_t typeId : archetype.types) {
+                const ComponentInfo& info = GetComponentInfo(typeId);
+                for (uint32_t row = 0; row < chunk.count; ++row) {
+                    info.destroy(chunk.data->bytes + archetype.offsets[typeId] + row * info.size);
+                }
+            }
+            delete chunk.data;
+        }
+    }
+}
+
+uint32_t EntityStore::getArchetype(ComponentMask mask)
+{
+    auto found = archetypeIndices.find(mask);
+    if (found != archetypeIndices.end())
+        return found->second;
+
+    Archetype archetype;
+    archetype.mask = mask;
+    uint32_t rowSize = sizeof(uint32_t);
+    uint32_t padding = 0;
+    for (uint32_t typeId = 0; typeId < MaxComponentTypes; ++typeId) {
+        archetype.offsets[typeId] = invalid;
+        archetype.sizes[typeId] = 0;
+        if (mask & (ComponentMask(1) << typeId)) {
+            archetype.sizes[typeId] = GetComponentInfo(typeId).size;
+            archetype.types.push_back(typeId);
+            rowSize += GetComponentInfo(typeId).size;
+            padding += GetComponentInfo(typeId).alignment;
+        }
+    }
+    // worst case alignment padding between the arrays comes off the capacity
+    archetype.capacity = (ChunkSize - padding) / rowSize;
+    assert(archetype.capacity > 0);
+
+    uint32_t offset = archetype.capacity * sizeof(uint32_t);
+    for (uint32_t typeId : archetype.types) {
+        const ComponentInfo& info = GetComponentInfo(typeId);
+        offset = AlignUp(offset, info.alignment);
+        archetype.offsets[typeId] = offset;
+        offset += archetype.capacity * info.size;
+    }
+    assert(offset <= ChunkSize);
+
+    archetypes.push_back(std::move(archetype));
+    const uint32_t index = static_cast<uint32_t>(archetypes.size() - 1);
+    archetypeIndices[mask] = index;
+    return index;
+}
+
+void EntityStore::appendRow(Archetype& archetype, uint32_t entity, uint32_t& chunk, uint32_t& row)
+{
+    if (archetype.chunks.empty() || archetype.chunks.back().count == archetype.capacity) {
+        Chunk newChunk = { new ChunkData, 0 };
+        archetype.chunks.push_back(newChunk);
+    }
+    chunk = static_cast<uint32_t>(archetype.chunks.size() - 1);
+    Chunk& last = archetype.chunks.back();
+    row = last.count++;
+    reinterpret_cast<uint32_t*>(last.data->bytes)[row] = entity;
+}
+
+uint32_t EntityStore::allocateEntity(uint32_t archetype)
+{
+    uint32_t index;
+    if (freeHead < freeRecords.size()) {
+        index = freeRecords[freeHead++];
+        // the generation in the 16 MSBs counts reuses
+        records[index].id += index_mask + 1;
+        if (freeHead == freeRecords.size()) {
+            freeRecords.clear();
+            freeHead = 0;
+        }
+    } else if (records.size() < MaxEntities) {
+        index = static_cast<uint32_t>(records.size());
+        EntityRecord record = { index, 0, 0, 0 };
+        records.push_back(record);
+    } else {
+        printf("EntityStore: more than %u entities\n", MaxEntities);
+        return invalid;
+    }
+
+    EntityRecord& record = records[index];
+    record.archetype = archetype;
+    appendRow(archetypes[archetype], record.id, record.chunk, record.row);
+    ++entityCount;
+    return record.id;
+}
+
+void EntityStore::removeRow(uint32_t archetypeIndex, uint32_t chunkIndex, uint32_t row)
+{
+    Archetype& archetype = archetypes[archetypeIndex];
+    Chunk& last = archetype.chunks.back();
+    const uint32_t lastChunk = static_cast<uint32_t>(archetype.chunks.size() - 1);
+    const uint32_t lastRow = last.count - 1;
+
+    if (chunkIndex != lastChunk || row != lastRow) {
+        Chunk& chunk = archetype.chunks[chunkIndex];
+        for (uint32_t typeId : archetype.types) {
+            const ComponentInfo& info = GetComponentInfo(typeId);
+            const uint32_t offset = archetype.offsets[typeId];
+            info.move(chunk.data->bytes + offset + row * info.size, last.data->bytes + offset + lastRow * info.size);
+        }
+        const uint32_t moved = entities(last)[lastRow];
+        reinterpret_cast<uint32_t*>(chunk.data->bytes)[row] = moved;
+        EntityRecord& record = records[moved & index_mask];
+        record.chunk = chunkIndex;
+        record.row = row;
+    }
+
+    if (--last.count == 0) {
+        delete last.data;
+        archetype.chunks.pop_back();
+    }
+}
+
+void EntityStore::changeArchetype(uint32_t entity, ComponentMask mask)
+{
+    EntityRecord& record = records[entity & index_mask];
+    const uint32_t target = getArchetype(mask);
+    // getArchetype may have grown archetypes, take references after it
+    const uint32_t source = record.archetype;
+    const uint32_t sourceChunk = record.chunk;
+    const uint32_t sourceRow = record.row;
+
+    uint32_t chunk, row;
+    appendRow(archetypes[target], entity, chunk, row);
+    for (uint32_t typeId : archetypes[source].types) {
+        void* from = componentAt(source, sourceChunk, sourceRow, typeId);
+        if (mask & (ComponentMask(1) << typeId)) {
+            GetComponentInfo(typeId).move(componentAt(target, chunk, row, typeId), from);
+        } else {
+            GetComponentInfo(typeId).destroy(from);
+        }
+    }
+    record.archetype = target;
+    record.chunk = chunk;
+    record.row = row;
+    removeRow(source, sourceChunk, sourceRow);
+}
+
+void EntityStore::Destroy(uint32_t entity)
+{
+    if (!IsAlive(entity))
+        return;
+    EntityRecord& record = records[entity & index_mask];
+    for (uint32_t typeId : archetypes[record.archetype].types) {
+        GetComponentInfo(typeId).destroy(componentAt(record.archetype, record.chunk, record.row, typeId));
+    }
+    removeRow(record.archetype, record.chunk, record.row);
+    record.archetype = invalid;
+    freeRecords.push_back(entity & index_mask);
+    --entityCount;
+}
+
+bool EntityStore::IsAlive(uint32_t entity) const
+{
+    return findRecord(entity) != nullptr;
+}
+
+const EntityStore::EntityRecord* EntityStore::findRecord(uint32_t entity) const
+{
+    const uint32_t index = entity & index_mask;
+    if (index >= records.size())
+        return nullptr;
+    const EntityRecord& record = records[index];
+    return record.id == entity && record.archetype != invalid ? &record : nullptr;
+}
+
+void* EntityStore::componentAt(uint32_t archetype, uint32_t chunk, uint32_t row, uint32_t typeId) const
+{
+    const Archetype& a = archetypes[archetype];
+    return a.chunks[chunk].data->bytes + a.offsets[typeId] + row * a.sizes[typeId];
+}
+} // End of namespace m3d
@@ -0,0 +1,463 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT)
+* (http://opensource.org/licenses/MIT)
+*/
+
+#include "FbxImport.hpp"
+#include "MeshOptimizer.hpp"
+#include "ThreadPool.hpp"
+
+#include <fbxsdk.h>
+
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+#define TRIANGLE_VERTEX_COUNT 3
+#define VERTEX_STRIDE 4
+#define NORMAL_STRIDE 3
+#define UV_STRIDE 2
+
+namespace m3d {
+// polygons per ParallelFor chunk, big enough to amortize the scheduling
+static const uint32_t POLYGON_GRAIN = 16 * 1024;
+
+static void RunParallel(ThreadPool* pool, uint32_t count, uint32_t grain, const std::function<void(uint32_t, uint32_t)>& fn)
+{
+    if (pool) {
+        pool->ParallelFor(0, count, grain, fn);
+    } else {
+        fn(0, count);
+    }
+}
+
+bool Mesh::init(FbxMesh* pFbxMesh, ThreadPool* pool)
+{
+    uint32_t normalCount = pFbxMesh->GetElementNormalCount();
+    uint32_t uvCount = pFbxMesh->GetElementUVCount();
+    FbxGeometryElement::EMappingMode normalMappingMode = normalCount ? pFbxMesh->GetElementNormal(0)->GetMappingMode()
+                                                                     : FbxGeometryElement::eNone;
+    FbxGeometryElement::EMappingMode uvMappingModel = uvCount ? pFbxMesh->GetElementUV(0)->GetMappingMode()
+                                                              : FbxGeometryElement::eNone;
+
+    bool hasNormal = normalMappingMode != FbxGeometryElement::eNone;
+    bool hasUV = uvMappingModel != FbxGeometryElement::eNone;
+
+    bool byControlPoint = hasNormal && normalMappingMode == FbxGeometryElement::eByControlPoint && hasUV && uvMappingModel == FbxGeometryElement::eByControlPoint;
+
+    uint32_t polygonCount = pFbxMesh->GetPolygonCount();
+    uint32_t controlPointCount = byControlPoint
+        ? pFbxMesh->GetControlPointsCount()
+        : polygonCount * TRIANGLE_VERTEX_COUNT;
+
+    this->vertices.resize(controlPointCount * VERTEX_STRIDE);
+    this->indices.resize(polygonCount * TRIANGLE_VERTEX_COUNT);
+    if (hasNormal)
+        this->normals.resize(controlPointCount * NORMAL_STRIDE);
+
+    FbxStringList uvNames;
+    pFbxMesh->GetUVSetNames(uvNames);
+    const char* pUVName = nullptr;
+    if (hasUV) {
+        this->uvs.resize(controlPointCount * UV_STRIDE);
+        pUVName = uvNames[0];
+    }
+
+    /*
+     * Everything below writes disjoint ranges of the output arrays, so
+     * control points and polygons are filled in parallel chunks. The FBX
+     * mesh is only read.
+     */
+
+    /* Vertex Attributes */
+    const FbxVector4* pControlPoints = pFbxMesh->GetControlPoints();
+    if (byControlPoint) {
+        const FbxGeometryElementNormal* pNormalElement = nullptr;
+        const FbxGeometryElementUV* pUVElement = nullptr;
+        if (hasNormal)
+            pNormalElement = pFbxMesh->GetElementNormal(0);
+        if (hasUV)
+            pUVElement = pFbxMesh->GetElementUV(0);
+
+        RunParallel(pool, controlPointCount, POLYGON_GRAIN, [&](uint32_t begin, uint32_t end) {
+            FbxVector4 currentVertex;
+            FbxVector4 currentNormal;
+            FbxVector2 currentUV;
+            for (uint32_t i = begin; i < end; ++i) {
+                currentVertex = pControlPoints[i];
+                this->vertices[i * VERTEX_STRIDE] = static_cast<float>(currentVertex[0]);
+                this->vertices[i * VERTEX_STRIDE + 1] = static_cast<float>(currentVertex[1]);
+                this->vertices[i * VERTEX_STRIDE + 2] = static_cast<float>(currentVertex[2]);
+                this->vertices[i * VERTEX_STRIDE + 3] = 1.0f;
+
+                if (hasNormal) {
+                    int normalIndex = i;
+                    if (pNormalElement->GetReferenceMode() == FbxLayerElement::eIndexToDirect) {
+                        normalIndex = pNormalElement->GetIndexArray().GetAt(i);
+                    }
+                    currentNormal = pNormalElement->GetDirectArray().GetAt(normalIndex);
+                    this->normals[i * NORMAL_STRIDE] = static_cast<float>(currentNormal[0]);
+                    this->normals[i * NORMAL_STRIDE + 1] = static_cast<float>(currentNormal[1]);
+                    this->normals[i * NORMAL_STRIDE + 2] = static_cast<float>(currentNormal[2]);
+                }
+
+                if (hasUV) {
+                    int uvIndex = i;
+                    if (pUVElement->GetReferenceMode() == FbxLayerElement::eIndexToDirect) {
+                        uvIndex = pUVElement->GetIndexArray().GetAt(i);
+                    }
+                    currentUV = pUVElement->GetDirectArray().GetAt(uvIndex);
+                    this->uvs[i * UV_STRIDE] = static_cast<float>(currentUV[0]);
+                    this->uvs[i * UV_STRIDE + 1] = static_cast<float>(currentUV[1]);
+                }
+            }
+        });
+    } // end of byControlPoint
+
+    /* Slice the mesh according to materials */
+    // where the three indices of every polygon go, fixed up front so polygon
+    // ranges can be filled independently and the output does not depend on scheduling
+    std::vector<uint32_t> polygonIndexOffsets(polygonCount);
+    FbxLayerElementArrayTemplate<int>* pMaterialIndices = nullptr;
+    FbxGeometryElement::EMappingMode materialMappingMode = FbxGeometryElement::eNone;
+    if (pFbxMesh->GetElementMaterial()) {
+        pMaterialIndices = &pFbxMesh->GetElementMaterial()->GetIndexArray();
+        materialMappingMode = pFbxMesh->GetElementMaterial()->GetMappingMode();
+    }
+    slices.clear();
+    if (pMaterialIndices && materialMappingMode == FbxGeometryElement::eByPolygon) {
+        FBX_ASSERT(pMaterialIndices->GetCount() == polygonCount);
+        // material indices do not have to show up in order, size by the largest
+        int maxMaterialIndex = 0;
+        for (uint32_t i = 0; i < polygonCount; ++i) {
+            maxMaterialIndex = std::max(maxMaterialIndex, pMaterialIndices->GetAt(i));
+        }
+        slices.assign(maxMaterialIndex + 1, Slice(0, 0));
+        for (uint32_t i = 0; i < polygonCount; ++i) {
+            slices[pMaterialIndices->GetAt(i)].triangleCount += 1;
+        }
+
+        int offset = 0;
+        for (uint32_t i = 0; i < slices.size(); ++i) {
+            slices[i].material = i;
+            slices[i].indexOffset = offset;
+            offset += slices[i].triangleCount * 3;
+            // counted again while handing out the polygon offsets
+            slices[i].triangleCount = 0;
+        }
+        FBX_ASSERT(offset == polygonCount * 3);
+
+        for (uint32_t i = 0; i < polygonCount; ++i) {
+            Slice& slice = slices[pMaterialIndices->GetAt(i)];
+            polygonIndexOffsets[i] = slice.indexOffset + slice.triangleCount * 3;
+            slice.triangleCount += 1;
+        }
+    } else {
+        // There is only one material.
+        slices.emplace_back(0, polygonCount);
+        for (uint32_t i = 0; i < polygonCount; ++i) {
+            polygonIndexOffsets[i] = i * 3;
+        }
+    }
+
+    /* Indices */
+    RunParallel(pool, polygonCount, POLYGON_GRAIN, [&](uint32_t begin, uint32_t end) {
+        FbxVector4 currentVertex;
+        FbxVector4 currentNormal;
+        FbxVector2 currentUV;
+        for (uint32_t i = begin; i < end; ++i) {
+            const uint32_t indexOffset = polygonIndexOffsets[i];
+            for (int v = 0; v < TRIANGLE_VERTEX_COUNT; ++v) {
+                const int controlPointIndex = pFbxMesh->GetPolygonVertex(i, v);
+
+                if (byControlPoint) {
+                    this->indices[indexOffset + v] = static_cast<unsigned int>(controlPointIndex);
+                    continue;
+                }
+
+                // three new vertices per polygon, in polygon order
+                const uint32_t vertexCount = i * TRIANGLE_VERTEX_COUNT + v;
+                this->indices[indexOffset + v] = vertexCount;
+
+                currentVertex = pControlPoints[controlPointIndex];
+                this->vertices[vertexCount * VERTEX_STRIDE] = static_cast<float>(currentVertex[0]);
+                this->vertices[vertexCount * VERTEX_STRIDE + 1] = static_cast<float>(currentVertex[1]);
+                this->vertices[vertexCount * VERTEX_STRIDE + 2] = static_cast<float>(currentVertex[2]);
+                this->vertices[vertexCount * VERTEX_STRIDE + 3] = 1.0f;
+
+                if (hasNormal) {
+                    pFbxMesh->GetPolygonVertexNormal(i, v, currentNormal);
+                    this->normals[vertexCount * NORMAL_STRIDE] = static_cast<float>(currentNormal[0]);
+                    this->normals[vertexCount * NORMAL_STRIDE + 1] = static_cast<float>(currentNormal[1]);
+                    this->normals[vertexCount * NORMAL_STRIDE + 2] = static_cast<float>(currentNormal[2]);
+                }
+
+                if (hasUV) {
+                    bool bUnmappedUV;
+                    pFbxMesh->GetPolygonVertexUV(i, v, pUVName, currentUV, bUnmappedUV);
+                    this->uvs[vertexCount * UV_STRIDE] = static_cast<float>(currentUV[0]);
+                    this->uvs[vertexCount * UV_STRIDE + 1] = static_cast<float>(currentUV[1]);
+                }
+            }
+        }
+    });
+
+    // the per polygon vertex path writes three vertices per triangle, store shared ones once
+    if (!byControlPoint) {
+        controlPointCount = WeldVertices(this->vertices, this->normals, this->uvs, this->indices);
+    }
+
+    bounds = AABB::Empty();
+    for (uint32_t i = 0; i < controlPointCount; ++i) {
+        const float* v = &this->vertices[i * VERTEX_STRIDE];
+        bounds.Expand(m3d::math::Vector3(v[0], v[1], v[2]));
+    }
+
+    return true;
+}
+
+struct FbxMeshJob {
+    FbxNode* node;
+    FbxMesh* mesh;
+    // import order index of the node material of every slice
+    std::vector<uint32_t> materials;
+};
+
+struct FbxImportContext {
+    const FbxImportCallbacks& callbacks;
+    std::unordered_map<FbxSurfaceMaterial*, uint32_t> materialIndices;
+    std::unordered_map<FbxFileTexture*, uint32_t> textureIndices;
+    // meshes shared by several nodes are extracted once
+    std::unordered_set<FbxMesh*> collectedMeshes;
+    // in scene graph order, which is the order meshes are handed out
+    std::vector<FbxMeshJob> meshJobs;
+};
+
+/* Import and conversion take the first half of the progress, mesh extraction the second */
+static bool ReportProgress(const FbxImportCallbacks& callbacks, float progress)
+{
+    return !callbacks.onProgress || callbacks.onProgress(progress);
+}
+
+static bool FbxImportProgress(void* pArgs, float pPercentage, const char* /*pStatus*/)
+{
+    return ReportProgress(*static_cast<const FbxImportCallbacks*>(pArgs), 0.5f * pPercentage / 100.0f);
+}
+
+static uint32_t ImportTexture(FbxFileTexture* pFbxTexture, FbxImportContext& context)
+{
+    auto found = context.textureIndices.find(pFbxTexture);
+    if (found != context.textureIndices.end()) {
+        return found->second;
+    }
+    DiffuseMap diffuseMap;
+    diffuseMap.path = pFbxTexture->GetFileName();
+    const uint32_t index = static_cast<uint32_t>(context.textureIndices.size());
+    context.textureIndices[pFbxTexture] = index;
+    if (context.callbacks.onTexture)
+        context.callbacks.onTexture(std::move(diffuseMap));
+    return index;
+}
+
+static uint32_t ImportMaterial(FbxSurfaceMaterial* pFbxMaterial, FbxImportContext& context)
+{
+    auto found = context.materialIndices.find(pFbxMaterial);
+    if (found != context.materialIndices.end()) {
+        return found->second;
+    }
+    Material material = {};
+    material.init(pFbxMaterial);
+    material.name = pFbxMaterial->GetName();
+    material.diffuseMapId = ImportNone;
+    FbxProperty diffuse = pFbxMaterial->FindProperty(FbxSurfaceMaterial::sDiffuse);
+    if (diffuse.IsValid()) {
+        if (FbxFileTexture* pFbxTexture = diffuse.GetSrcObject<FbxFileTexture>(0)) {
+            material.diffuseMapId = ImportTexture(pFbxTexture, context);
+        }
+    }
+    const uint32_t index = static_cast<uint32_t>(context.materialIndices.size());
+    context.materialIndices[pFbxMaterial] = index;
+    if (context.callbacks.onMaterial)
+        context.callbacks.onMaterial(std::move(material));
+    return index;
+}
+
+/* Walks the scene graph, materials and textures are handed out right away, meshes only collected */
+static void CollectNode(FbxNode* pFbxNode, FbxImportContext& context)
+{
+    // Material, slice i of the node's mesh uses node material i
+    std::vector<uint32_t> nodeMaterials;
+    const int materialCount = pFbxNode->GetMaterialCount();
+    for (int i = 0; i < materialCount; ++i) {
+        FbxSurfaceMaterial* pFbxMaterial = pFbxNode->GetMaterial(i);
+        nodeMaterials.push_back(pFbxMaterial ? ImportMaterial(pFbxMaterial, context) : ImportNone);
+    }
+
+    FbxNodeAttribute* nodeAttribute = pFbxNode->GetNodeAttribute();
+    if (nodeAttribute) {
+        // Mesh
+        if (nodeAttribute->GetAttributeType() == FbxNodeAttribute::eMesh) {
+            FbxMesh* pFbxMesh = pFbxNode->GetMesh();
+            if (pFbxMesh && context.collectedMeshes.insert(pFbxMesh).second) {
+                FbxMeshJob job = { pFbxNode, pFbxMesh, std::move(nodeMaterials) };
+                context.meshJobs.push_back(std::move(job));
+            }
+        }
+        // Light
+        else if (nodeAttribute->GetAttributeType() == FbxNodeAttribute::eLight) {
+            FbxLight* pFbxLight = pFbxNode->GetLight();
+            if (pFbxLight && !pFbxLight->GetUserDataPtr()) {
+                FbxAutoPtr<Light> pLight(new Light);
+                if (pLight->init(pFbxLight)) {
+                    pFbxLight->SetUserDataPtr(pLight.Release());
+                }
+            }
+        }
+    }
+
+    const int childCount = pFbxNode->GetChildCount();
+    for (int i = 0; i < childCount; ++i) {
+        CollectNode(pFbxNode->GetChild(i), context);
+    }
+}
+
+/*
+ * Extracts the collected meshes a batch at a time: meshes of a batch run in
+ * parallel, and big meshes split further into polygon ranges inside
+ * Mesh::init. Callbacks stay on the calling thread and in scene graph order.
+ */
+static bool ExtractMeshes(FbxImportContext& context, ThreadPool& pool)
+{
+    const uint32_t meshCount = static_cast<uint32_t>(context.meshJobs.size());
+    const uint32_t batchSize = (pool.GetWorkerCount() + 1) * 2;
+
+    std::vector<Mesh> batch;
+    std::vector<uint8_t> extracted;
+    for (uint32_t batchBegin = 0; batchBegin < meshCount; batchBegin += batchSize) {
+        const uint32_t batchEnd = std::min(meshCount, batchBegin + batchSize);
+        batch.clear();
+        batch.resize(batchEnd - batchBegin);
+        extracted.assign(batchEnd - batchBegin, 0);
+
+        pool.ParallelFor(batchBegin, batchEnd, 1, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; ++i) {
+                extracted[i - batchBegin] = batch[i - batchBegin].init(context.meshJobs[i].mesh, &pool) ? 1 : 0;
+            }
+        });
+
+        for (uint32_t i = batchBegin; i < batchEnd; ++i) {
+            if (!extracted[i - batchBegin]) {
+                continue;
+            }
+            const FbxMeshJob& job = context.meshJobs[i];
+            Mesh& mesh = batch[i - batchBegin];
+            mesh.name = job.node->GetName();
+            mesh.materialIds.resize(mesh.slices.size(), ImportNone);
+            for (size_t slice = 0; slice < mesh.slices.size() && slice < job.materials.size(); ++slice) {
+                mesh.materialIds[slice] = job.materials[slice];
+            }
+            if (context.callbacks.onMesh)
+                context.callbacks.onMesh(std::move(mesh));
+        }
+
+        if (!ReportProgress(context.callbacks, 0.5f + 0.5f * batchEnd / meshCount)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ImportFbx(const char* path, const FbxImportCallbacks& callbacks)
+{
+    FbxManager* fbxManager = FbxManager::Create();
+
+    FbxIOSettings* pFbxIOSettings = FbxIOSettings::Create(fbxManager, IOSROOT);
+    fbxManager->SetIOSettings(pFbxIOSettings);
+
+    (*(fbxManager->GetIOSettings())).SetBoolProp(IMP_FBX_MATERIAL, true);
+    (*(fbxManager->GetIOSettings())).SetBoolProp(IMP_FBX_TEXTURE, true);
+    (*(fbxManager->GetIOSettings())).SetBoolProp(IMP_FBX_LINK, false);
+    (*(fbxManager->GetIOSettings())).SetBoolProp(IMP_FBX_SHAPE, false);
+    (*(fbxManager->GetIOSettings())).SetBoolProp(IMP_FBX_GOBO, false);
+    (*(fbxManager->GetIOSettings())).SetBoolProp(IMP_FBX_ANIMATION, true);
+    (*(fbxManager->GetIOSettings())).SetBoolProp(IMP_FBX_GLOBAL_SETTINGS, true);
+
+    bool bEmbedMedia = true;
+    (*(fbxManager->GetIOSettings())).SetBoolProp(EXP_FBX_MATERIAL, true);
+    (*(fbxManager->GetIOSettings())).SetBoolProp(EXP_FBX_TEXTURE, true);
+    (*(fbxManager->GetIOSettings())).SetBoolProp(EXP_FBX_EMBEDDED, bEmbedMedia);
+    (*(fbxManager->GetIOSettings())).SetBoolProp(EXP_FBX_SHAPE, true);
+    (*(fbxManager->GetIOSettings())).SetBoolProp(EXP_FBX_GOBO, true);
+    (*(fbxManager->GetIOSettings())).SetBoolProp(EXP_FBX_ANIMATION, true);
+    (*(fbxManager->GetIOSettings())).SetBoolProp(EXP_FBX_GLOBAL_SETTINGS, true);
+
+    FbxImporter* pFbxImporter = FbxImporter::Create(fbxManager, "");
+    pFbxImporter->SetProgressCallback(FbxImportProgress, const_cast<FbxImportCallbacks*>(&callbacks));
+
+    // Initialize the importer.
+    bool result = pFbxImporter->Initialize(path, -1, fbxManager->GetIOSettings());
+    if (!result) {
+        printf("Get error when init FBX Importer: %s\n\n",
+            pFbxImporter->GetStatus().GetErrorString());
+        pFbxImporter->Destroy();
+        fbxManager->Destroy();
+        return false;
+    }
+
+    // fbx version number
+    int major, minor, revision;
+    pFbxImporter->GetFileVersion(major, minor, revision);
+
+    // import pFbxScene, the progress callback returning false cancels it
+    FbxScene* pFbxScene = FbxScene::Create(fbxManager, "myScene");
+    result = pFbxImporter->Import(pFbxScene);
+    pFbxImporter->Destroy();
+    pFbxImporter = nullptr;
+    if (!result || !ReportProgress(callbacks, 0.5f)) {
+        fbxManager->Destroy();
+        return false;
+    }
+
+    // check axis system
+    FbxAxisSystem axisSystem = pFbxScene->GetGlobalSettings().GetAxisSystem();
+    FbxAxisSystem vulkanAxisSystem(FbxAxisSystem::eYAxis,
+        FbxAxisSystem::eParityOdd,
+        FbxAxisSystem::eRightHanded);
+    if (axisSystem != vulkanAxisSystem) {
+        axisSystem.ConvertScene(pFbxScene);
+    }
+
+    // check unit system
+    FbxSystemUnit systemUnit = pFbxScene->GetGlobalSettings().GetSystemUnit();
+    if (systemUnit.GetScaleFactor() != 1.0) {
+        FbxSystemUnit::cm.ConvertScene(pFbxScene);
+    }
+
+    // Triangulate Mesh
+    FbxGeometryConverter fbxGeometryConverter(fbxManager);
+    fbxGeometryConverter.Triangulate(pFbxScene, true);
+
+    FbxImportContext context = { callbacks };
+    CollectNode(pFbxScene->GetRootNode(), context);
+    result = ExtractMeshes(context, ThreadPool::Shared()) && ReportProgress(callbacks, 1.0f);
+
+    fbxManager->Destroy();
+    return result;
+}
+
+bool LoadMeshes(Scene* pScene, std::vector<uint32_t>* loadedMeshIDs)
+{
+    ImportIds ids;
+    FbxImportCallbacks callbacks;
+    callbacks.onTexture = [&](DiffuseMap&& diffuseMap) { ids.AddTexture(*pScene, std::move(diffuseMap)); };
+    callbacks.onMaterial = [&](Material&& material) { ids.AddMaterial(*pScene, std::move(material)); };
+    callbacks.onMesh = [&](Mesh&& mesh) {
+        const uint32_t meshId = ids.AddMesh(*pScene, std::move(mesh));
+        if (loadedMeshIDs) {
+            loadedMeshIDs->push_back(meshId);
+        }
+    };
+    return ImportFbx(pScene->loadPath.c_str(), callbacks);
+}
+} // End of namespace m3d
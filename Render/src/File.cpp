@@ -0,0 +1,301 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT)
+* (http://opensource.org/licenses/MIT)
+*/
+
+#include "File.hpp"
+
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <fcntl.h>
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace m3d {
+namespace file {
+    MappedFile::MappedFile()
+        : data(nullptr)
+        , size(0)
+        , opened(false)
+        , mapping(nullptr)
+#ifdef _WIN32
+        , fileHandle(nullptr)
+        , mappingHandle(nullptr)
+#endif
+    {
+    }
+
+    MappedFile::~MappedFile()
+    {
+        Close();
+    }
+
+    MappedFile::MappedFile(MappedFile&& other) noexcept
+        : MappedFile()
+    {
+        *this = std::move(other);
+    }
+
+    MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+    {
+        if (this != &other) {
+            Close();
+            // swapping the vector keeps its heap buffer, so data stays valid
+            std::swap(data, other.data);
+            std::swap(size, other.size);
+            std::swap(opened, other.opened);
+            std::swap(mapping, other.mapping);
+            fallback.swap(other.fallback);
+#ifdef _WIN32
+            std::swap(fileHandle, other.fileHandle);
+            std::swap(mappingHandle, other.mappingHandle);
+#endif
+        }
+        return *this;
+    }
+
+    ArrayView<uint8_t> MappedFile::View(size_t offset, size_t length) const
+    {
+        if (offset >= size) {
+            return ArrayView<uint8_t>();
+        }
+        if (length > size - offset) {
+            length = size - offset;
+        }
+        return ArrayView<uint8_t>(data + offset, length);
+    }
+
+    bool MappedFile::readAll(std::FILE* fp, const char* path)
+    {
+        if (!fp) {
+            return false;
+        }
+        // a size of 0 is unknown, pipes are read until they end; a known size is read in chunks anyway so a short read is caught
+        const bool knownSize = size != 0;
+        const size_t chunkSize = 64u << 20;
+        fallback.resize(knownSize ? size : 64u << 10);
+        size_t done = 0;
+        for (;;) {
+            if (done == fallback.size()) {
+                if (knownSize) {
+                    break;
+                }
+                fallback.resize(fallback.size() * 2);
+            }
+            const size_t n = std::fread(fallback.data() + done, 1, fallback.size() - done < chunkSize ? fallback.size() - done : chunkSize, fp);
+            if (n == 0) {
+                break;
+            }
+            done += n;
+        }
+        const bool failed = std::ferror(fp) != 0;
+        std::fclose(fp);
+        if (failed || (knownSize && done != size)) {
+            printf("MappedFile: short read of %s\n", path);
+            fallback.clear();
+            return false;
+        }
+        fallback.resize(done);
+        size = done;
+        data = fallback.data();
+        return true;
+    }
+
+#ifdef _WIN32
+    bool MappedFile::Open(const char* path, Access access)
+    {
+        Close();
+
+        const DWORD flags = access == Access::Sequential ? FILE_FLAG_SEQUENTIAL_SCAN
+            : access == Access::Random ? FILE_FLAG_RANDOM_ACCESS : FILE_ATTRIBUTE_NORMAL;
+        HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            printf("MappedFile: can not open %s\n", path);
+            return false;
+        }
+
+        // pipes have no size and can not be mapped, they are read until they end
+        if (GetFileType(file) != FILE_TYPE_DISK) {
+            const int fd = _open_osfhandle(reinterpret_cast<intptr_t>(file), _O_RDONLY);
+            std::FILE* fp = fd >= 0 ? _fdopen(fd, "rb") : nullptr;
+            if (!fp) {
+                if (fd >= 0)
+                    _close(fd);
+                else
+                    CloseHandle(file);
+                return false;
+            }
+            size = 0;
+            opened = readAll(fp, path);
+            return opened;
+        }
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize)) {
+            CloseHandle(file);
+            return false;
+        }
+        size = static_cast<size_t>(fileSize.QuadPart);
+        opened = true;
+        // empty files can not be mapped, and do not need to be
+        if (size == 0) {
+            CloseHandle(file);
+            return true;
+        }
+
+        HANDLE mappingObject = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        void* view = mappingObject ? MapViewOfFile(mappingObject, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (!view) {
+            if (mappingObject)
+                CloseHandle(mappingObject);
+            CloseHandle(file);
+            opened = readAll(std::fopen(path, "rb"), path);
+            if (!opened)
+                size = 0;
+            return opened;
+        }
+
+        fileHandle = file;
+        mappingHandle = mappingObject;
+        mapping = view;
+        data = static_cast<const uint8_t*>(view);
+        Advise(access);
+        return true;
+    }
+
+    void MappedFile::Close()
+    {
+        if (mapping)
+            UnmapViewOfFile(mapping);
+        if (mappingHandle)
+            CloseHandle(mappingHandle);
+        if (fileHandle)
+            CloseHandle(fileHandle);
+        data = nullptr;
+        size = 0;
+        opened = false;
+        mapping = nullptr;
+        fallback = std::vector<uint8_t>();
+        fileHandle = nullptr;
+        mappingHandle = nullptr;
+    }
+
+    void MappedFile::Advise(Access access, size_t offset, size_t length) const
+    {
+#if defined(_WIN32_WINNT) && _WIN32_WINNT >= 0x0602
+        // the only hint the memory manager takes for a mapped view
+        if (mapping && access == Access::WillNeed && offset < size) {
+            WIN32_MEMORY_RANGE_ENTRY range;
+            range.VirtualAddress = const_cast<uint8_t*>(data) + offset;
+            range.NumberOfBytes = length == 0 || length > size - offset ? size - offset : length;
+            PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+        }
+#else
+        (void)access;
+        (void)offset;
+        (void)length;
+#endif
+    }
+#else
+    bool MappedFile::Open(const char* path, Access access)
+    {
+        Close();
+
+        int file = ::open(path, O_RDONLY);
+        if (file < 0) {
+            printf("MappedFile: can not open %s\n", path);
+            return false;
+        }
+
+        struct stat st;
+        if (fstat(file, &st) != 0) {
+            ::close(file);
+            return false;
+        }
+        // pipes and character devices report no size and can not be mapped, they are read until they end
+        if (!S_ISREG(st.st_mode)) {
+            std::FILE* fp = fdopen(file, "rb");
+            if (!fp) {
+                ::close(file);
+                return false;
+            }
+            opened = readAll(fp, path);
+            return opened;
+        }
+        size = static_cast<size_t>(st.st_size);
+        opened = true;
+        // empty files can not be mapped, and do not need to be
+        if (size == 0) {
+            ::close(file);
+            return true;
+        }
+
+        void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+        // the mapping holds its own reference to the file
+        ::close(file);
+        if (view == MAP_FAILED) {
+            opened = readAll(std::fopen(path, "rb"), path);
+            if (!opened)
+                size = 0;
+            return opened;
+        }
+
+        mapping = view;
+        data = static_cast<const uint8_t*>(view);
+        Advise(access);
+        return true;
+    }
+
+    void MappedFile::Close()
+    {
+        if (mapping)
+            munmap(mapping, size);
+        data = nullptr;
+        size = 0;
+        opened = false;
+        mapping = nullptr;
+        fallback = std::vector<uint8_t>();
+    }
+
+    void MappedFile::Advise(Access access, size_t offset, size_t length) const
+    {
+        if (!mapping || access == Access::Normal || offset >= size) {
+            return;
+        }
+
+        // madvise wants a page aligned start
+        const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        const size_t begin = offset & ~(pageSize - 1);
+        const size_t end = length == 0 || length > size - offset ? size : offset + length;
+
+        int advice = MADV_NORMAL;
+        switch (access) {
+        case Access::Sequential:
+            advice = MADV_SEQUENTIAL;
+            break;
+        case Access::Random:
+            advice = MADV_RANDOM;
+            break;
+        case Access::WillNeed:
+            advice = MADV_WILLNEED;
+            break;
+        case Access::DontNeed:
+            advice = MADV_DONTNEED;
+            break;
+        default:
+            break;
+        }
+        madvise(static_cast<uint8_t*>(mapping) + begin, end - begin, advice);
+    }
+#endif
+}
+}
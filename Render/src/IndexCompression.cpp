@@ -0,0 +1,159 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT)
+* (http://opensource.org/licenses/MIT)
+*/
+
+#include "IndexCompression.hpp"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h> // SSE2
+#endif
+
+namespace m3d {
+enum BlockMode : uint8_t {
+    BlockMode8 = 0,
+    BlockMode16 = 1,
+    BlockMode32 = 2
+};
+
+static const size_t BlockBytes[3] = { IndexBlockSize, IndexBlockSize * 2, IndexBlockSize * 4 };
+
+static size_t ModeBytes(size_t blockCount)
+{
+    return (blockCount + 3) / 4;
+}
+
+void EncodeIndexBuffer(const uint32_t* indices, size_t indexCount, std::vector<uint8_t>& encoded)
+{
+    const size_t blockCount = indexCount / IndexBlockSize;
+    encoded.assign(ModeBytes(blockCount), 0);
+
+    uint32_t previous = 0;
+    int32_t deltas[IndexBlockSize];
+    for (size_t block = 0; block < blockCount; ++block) {
+        BlockMode mode = BlockMode8;
+        for (uint32_t i = 0; i < IndexBlockSize; ++i) {
+            const uint32_t index = indices[block * IndexBlockSize + i];
+            // wraps for big steps, the decoder's add wraps back
+            deltas[i] = static_cast<int32_t>(index - previous);
+            previous = index;
+            if (deltas[i] < -32768 || deltas[i] > 32767)
+                mode = BlockMode32;
+            else if ((deltas[i] < -128 || deltas[i] > 127) && mode == BlockMode8)
+                mode = BlockMode16;
+        }
+        encoded[block / 4] |= static_cast<uint8_t>(mode << ((block % 4) * 2));
+
+        const size_t offset = encoded.size();
+        encoded.resize(offset + BlockBytes[mode]);
+        uint8_t* out = &encoded[offset];
+        for (uint32_t i = 0; i < IndexBlockSize; ++i) {
+            if (mode == BlockMode8) {
+                const int8_t delta = static_cast<int8_t>(deltas[i]);
+                std::memcpy(out + i, &delta, 1);
+            } else if (mode == BlockMode16) {
+                const int16_t delta = static_cast<int16_t>(deltas[i]);
+                std::memcpy(out + i * 2, &delta, 2);
+            } else {
+                std::memcpy(out + i * 4, &deltas[i], 4);
+            }
+        }
+    }
+
+    const size_t tail = indexCount - blockCount * IndexBlockSize;
+    const size_t offset = encoded.size();
+    encoded.resize(offset + tail * sizeof(uint32_t));
+    if (tail)
+        std::memcpy(&encoded[offset], indices + blockCount * IndexBlockSize, tail * sizeof(uint32_t));
+}
+
+#if defined(__SSE2__) || defined(_M_X64)
+/* Prefix sum of 4 deltas on top of the last decoded index, broadcast in previous */
+static inline void DecodeGroup(__m128i deltas, __m128i& previous, uint32_t* out)
+{
+    deltas = _mm_add_epi32(deltas, _mm_slli_si128(deltas, 4));
+    deltas = _mm_add_epi32(deltas, _mm_slli_si128(deltas, 8));
+    const __m128i indices = _mm_add_epi32(deltas, previous);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), indices);
+    previous = _mm_shuffle_epi32(indices, _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+/* Sign extends 8 int16 lanes into two groups of 4 int32 */
+static inline void DecodeHalves(__m128i words, __m128i& previous, uint32_t* out)
+{
+    const __m128i sign = _mm_srai_epi16(words, 15);
+    DecodeGroup(_mm_unpacklo_epi16(words, sign), previous, out);
+    DecodeGroup(_mm_unpackhi_epi16(words, sign), previous, out + 4);
+}
+
+/* One block of deltas, previous is the last decoded index broadcast */
+static inline void DecodeBlock(uint8_t mode, const uint8_t* in, __m128i& previous, uint32_t* out)
+{
+    if (mode == BlockMode8) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+        const __m128i sign = _mm_cmplt_epi8(bytes, _mm_setzero_si128());
+        DecodeHalves(_mm_unpacklo_epi8(bytes, sign), previous, out);
+        DecodeHalves(_mm_unpackhi_epi8(bytes, sign), previous, out + 8);
+    } else if (mode == BlockMode16) {
+        DecodeHalves(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in)), previous, out);
+        DecodeHalves(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 16)), previous, out + 8);
+    } else {
+        for (uint32_t group = 0; group < 4; ++group) {
+            DecodeGroup(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + group * 16)), previous, out + group * 4);
+        }
+    }
+}
+#else
+/* One block of deltas without SIMD (ARM, Android), previous is the last decoded index */
+static inline void DecodeBlock(uint8_t mode, const uint8_t* in, uint32_t& previous, uint32_t* out)
+{
+    for (uint32_t i = 0; i < IndexBlockSize; ++i) {
+        int32_t delta;
+        if (mode == BlockMode8) {
+            int8_t d;
+            std::memcpy(&d, in + i, 1);
+            delta = d;
+        } else if (mode == BlockMode16) {
+            int16_t d;
+            std::memcpy(&d, in + i * 2, 2);
+            delta = d;
+        } else {
+            std::memcpy(&delta, in + i * 4, 4);
+        }
+        // wraps like the encoder's subtraction
+        previous += static_cast<uint32_t>(delta);
+        out[i] = previous;
+    }
+}
+#endif
+
+bool DecodeIndexBuffer(uint32_t* destination, size_t indexCount, const uint8_t* data, size_t size)
+{
+    const size_t blockCount = indexCount / IndexBlockSize;
+    const size_t tail = indexCount - blockCount * IndexBlockSize;
+    if (size < ModeBytes(blockCount) + tail * sizeof(uint32_t))
+        return false;
+
+    const uint8_t* modes = data;
+    const uint8_t* in = data + ModeBytes(blockCount);
+    const uint8_t* end = data + size - tail * sizeof(uint32_t);
+#if defined(__SSE2__) || defined(_M_X64)
+    __m128i previous = _mm_setzero_si128();
+#else
+    uint32_t previous = 0;
+#endif
+    for (size_t block = 0; block < blockCount; ++block) {
+        const uint8_t mode = (modes[block / 4] >> ((block % 4) * 2)) & 3;
+        if (mode > BlockMode32 || static_cast<size_t>(end - in) < BlockBytes[mode])
+            return false;
+
+        DecodeBlock(mode, in, previous, destination + block * IndexBlockSize);
+        in += BlockBytes[mode];
+    }
+    std::memcpy(destination + blockCount * IndexBlockSize, in, tail * sizeof(uint32_t));
+    return true;
+}
+} // End of namespace m3d
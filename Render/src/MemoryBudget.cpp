@@ -0,0 +1,202 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT)
+* (http://opensource.org/licenses/MIT)
+*/
+
+#include "MemoryBudget.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdarg>
+#include <cstdio>
+
+namespace m3d {
+static const char* const categoryNames[MemoryCategoryCount] = {
+    "meshes",
+    "textures",
+    "materials",
+    "scene_graph",
+    "mapped_files",
+    "renderer"
+};
+
+const char* GetMemoryCategoryName(MemoryCategory category)
+{
+    return category < MemoryCategoryCount ? categoryNames[category] : "unknown";
+}
+
+void MemoryReport::Clear()
+{
+    for (MemoryUsage& usage : categories) {
+        usage = MemoryUsage();
+    }
+    assets.clear();
+    assetIndices.clear();
+}
+
+void MemoryReport::Add(MemoryCategory category, uint64_t cpuBytes, uint64_t gpuBytes)
+{
+    categories[category].cpuBytes += cpuBytes;
+    categories[category].gpuBytes += gpuBytes;
+}
+
+void MemoryReport::AddAsset(MemoryCategory category, uint32_t id, const std::string& name, uint64_t cpuBytes, uint64_t gpuBytes)
+{
+    Add(category, cpuBytes, gpuBytes);
+
+    const uint64_t key = (uint64_t(category) << 32) | id;
+    auto found = assetIndices.find(key);
+    if (found == assetIndices.end()) {
+        AssetMemory asset = { category, id, name, { cpuBytes, gpuBytes } };
+        assetIndices[key] = assets.size();
+        assets.push_back(asset);
+        return;
+    }
+    AssetMemory& asset = assets[found->second];
+    if (asset.name.empty())
+        asset.name = name;
+    asset.usage.cpuBytes += cpuBytes;
+    asset.usage.gpuBytes += gpuBytes;
+}
+
+MemoryUsage MemoryReport::GetTotal() const
+{
+    MemoryUsage total = {};
+    for (const MemoryUsage& usage : categories) {
+        total.cpuBytes += usage.cpuBytes;
+        total.gpuBytes += usage.gpuBytes;
+    }
+    return total;
+}
+
+/* Indices of the category's assets, largest first */
+static std::vector<size_t> SortedAssets(const std::vector<AssetMemory>& assets, MemoryCategory category)
+{
+    std::vector<size_t> sorted;
+    for (size_t i = 0; i < assets.size(); ++i) {
+        if (assets[i].category == category)
+            sorted.push_back(i);
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), [&](size_t a, size_t b) {
+        const MemoryUsage& ua = assets[a].usage;
+        const MemoryUsage& ub = assets[b].usage;
+        return ua.cpuBytes + ua.gpuBytes > ub.cpuBytes + ub.gpuBytes;
+    });
+    return sorted;
+}
+
+static void Append(std::string& out, const char* format, ...)
+{
+    char buffer[512];
+    va_list args;
+    va_start(args, format);
+    const int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (length > 0)
+        out.append(buffer, std::min(static_cast<size_t>(length), sizeof(buffer) - 1));
+}
+
+static double ToMiB(uint64_t bytes)
+{
+    return double(bytes) / (1024.0 * 1024.0);
+}
+
+void MemoryReport::WriteText(std::string& out, uint32_t maxAssets) const
+{
+    const MemoryUsage total = GetTotal();
+    Append(out, "%-16s %12s %12s\n", "memory (MiB)", "cpu", "gpu");
+    for (uint32_t c = 0; c < MemoryCategoryCount; ++c) {
+        const MemoryCategory category = static_cast<MemoryCategory>(c);
+        Append(out, "%-16s %12.2f %12.2f\n", GetMemoryCategoryName(category), ToMiB(categories[c].cpuBytes), ToMiB(categories[c].gpuBytes));
+
+        const std::vector<size_t> sorted = SortedAssets(assets, category);
+        for (size_t i = 0; i < sorted.size() && i < maxAssets; ++i) {
+            const AssetMemory& asset = assets[sorted[i]];
+            Append(out, "  %-14.14s %12.2f %12.2f  #%u\n", asset.name.c_str(), ToMiB(asset.usage.cpuBytes), ToMiB(asset.usage.gpuBytes), asset.id);
+        }
+        if (sorted.size() > maxAssets)
+            Append(out, "  (%zu more)\n", sorted.size() - maxAssets);
+    }
+    Append(out, "%-16s %12.2f %12.2f\n", "total", ToMiB(total.cpuBytes), ToMiB(total.gpuBytes));
+}
+
+static void AppendJsonString(std::string& out, const std::string& value)
+{
+    out += '"';
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            Append(out, "\\u%04x", static_cast<unsigned>(c));
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+void MemoryReport::WriteJson(std::string& out) const
+{
+    const MemoryUsage total = GetTotal();
+    Append(out, "{\"total\":{\"cpu\":%" PRIu64 ",\"gpu\":%" PRIu64 "},\"categories\":{", total.cpuBytes, total.gpuBytes);
+    for (uint32_t c = 0; c < MemoryCategoryCount; ++c) {
+        const MemoryCategory category = static_cast<MemoryCategory>(c);
+        Append(out, "%s\"%s\":{\"cpu\":%" PRIu64 ",\"gpu\":%" PRIu64 ",\"assets\":[", c ? "," : "",
+            GetMemoryCategoryName(category), categories[c].cpuBytes, categories[c].gpuBytes);
+
+        const std::vector<size_t> sorted = SortedAssets(assets, category);
+        for (size_t i = 0; i < sorted.size(); ++i) {
+            const AssetMemory& asset = assets[sorted[i]];
+            Append(out, "%s{\"id\":%u,\"name\":", i ? "," : "", asset.id);
+            AppendJsonString(out, asset.name);
+            Append(out, ",\"cpu\":%" PRIu64 ",\"gpu\":%" PRIu64 "}", asset.usage.cpuBytes, asset.usage.gpuBytes);
+        }
+        out += "]}";
+    }
+    out += "}}";
+}
+
+uint64_t GetTextureBytes(uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t firstMip)
+{
+    uint64_t bytes = 0;
+    for (uint32_t mip = firstMip; mip < mipLevels; ++mip) {
+        const uint64_t w = std::max(width >> mip, 1u);
+        const uint64_t h = std::max(height >> mip, 1u);
+        bytes += w * h * 4;
+    }
+    return bytes;
+}
+
+/*
+ * One level more or less: over budget drops one, and one is taken back when
+ * usage times growth, about what the finer level costs, still fits
+ */
+static bool StepLevel(uint64_t usage, uint64_t budget, uint64_t growth, uint32_t maxLevel, uint32_t& level)
+{
+    if (budget == 0) {
+        const bool changed = level != 0;
+        level = 0;
+        return changed;
+    }
+    if (usage > budget && level < maxLevel) {
+        ++level;
+        return true;
+    }
+    if (usage * growth <= budget && level > 0) {
+        --level;
+        return true;
+    }
+    return false;
+}
+
+bool UpdateBudgetLevels(const MemoryBudget& budget, const MemoryReport& report, BudgetLevels& levels)
+{
+    // a mip level holds 4 times the texels of the next, a level of detail about
+    // twice the indices of the next, the vertices are shared and stay
+    const bool meshes = StepLevel(report.GetCategory(MemoryMeshes).gpuBytes, budget.meshGpuBytes, 2, MaxLodBias, levels.lodBias);
+    const bool textures = StepLevel(report.GetCategory(MemoryTextures).gpuBytes, budget.textureGpuBytes, 4, MaxTextureMipBias, levels.textureMipBias);
+    return meshes || textures;
+}
+} // End of namespace m3d
@@ -0,0 +1,919 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT)
+* (http://opensource.org/licenses/MIT)
+*/
+
+#include "MeshOptimizer.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace m3d {
+static const uint32_t EmptySlot = 0xFFFFFFFF;
+static const uint32_t MaxWeldKey = PositionStride + NormalStride + UVStride;
+
+static uint32_t TableSize(size_t count)
+{
+    uint32_t size = 16;
+    while (size < count * 2) {
+        size <<= 1;
+    }
+    return size;
+}
+
+struct WeldKey {
+    float values[MaxWeldKey];
+    uint32_t count;
+
+    bool operator==(const WeldKey& other) const
+    {
+        for (uint32_t i = 0; i < count; ++i) {
+            if (values[i] != other.values[i])
+                return false;
+        }
+        return true;
+    }
+
+    uint32_t Hash() const
+    {
+        // FNV-1a over the bit patterns
+        uint32_t hash = 2166136261u;
+        for (uint32_t i = 0; i < count; ++i) {
+            uint32_t bits;
+            std::memcpy(&bits, &values[i], sizeof(bits));
+            hash = (hash ^ bits) * 16777619u;
+        }
+        return hash ^ (hash >> 15);
+    }
+};
+
+struct WeldAttributes {
+    std::vector<float>& positions;
+    std::vector<float>& normals;
+    std::vector<float>& uvs;
+    bool hasNormals;
+    bool hasUVs;
+    // 1 / epsilon, 0 for exact compares
+    float snap;
+
+    float Quantize(float value) const
+    {
+        // + 0.0f folds -0 into 0, which compare equal but hash differently
+        return snap > 0.0f ? std::floor(value * snap + 0.5f) + 0.0f : value + 0.0f;
+    }
+
+    WeldKey Key(uint32_t vertex) const
+    {
+        WeldKey key;
+        key.count = 0;
+        // w is always 1, not part of the key
+        for (uint32_t i = 0; i < 3; ++i)
+            key.values[key.count++] = Quantize(positions[vertex * PositionStride + i]);
+        if (hasNormals) {
+            for (uint32_t i = 0; i < NormalStride; ++i)
+                key.values[key.count++] = Quantize(normals[vertex * NormalStride + i]);
+        }
+        if (hasUVs) {
+            for (uint32_t i = 0; i < UVStride; ++i)
+                key.values[key.count++] = Quantize(uvs[vertex * UVStride + i]);
+        }
+        return key;
+    }
+
+    void Move(uint32_t from, uint32_t to)
+    {
+        std::memmove(&positions[to * PositionStride], &positions[from * PositionStride], PositionStride * sizeof(float));
+        if (hasNormals)
+            std::memmove(&normals[to * NormalStride], &normals[from * NormalStride], NormalStride * sizeof(float));
+        if (hasUVs)
+            std::memmove(&uvs[to * UVStride], &uvs[from * UVStride], UVStride * sizeof(float));
+    }
+};
+
+uint32_t WeldVertices(std::vector<float>& positions, std::vector<float>& normals, std::vector<float>& uvs,
+    std::vector<uint32_t>& indices, float epsilon)
+{
+    const uint32_t vertexCount = static_cast<uint32_t>(positions.size() / PositionStride);
+    WeldAttributes attributes = {
+        positions, normals, uvs,
+        normals.size() == vertexCount * NormalStride && vertexCount != 0,
+        uvs.size() == vertexCount * UVStride && vertexCount != 0,
+        epsilon > 0.0f ? 1.0f / epsilon : 0.0f
+    };
+
+    // open addressing, slots hold welded vertex indices. Welded vertices are
+    // compacted in place: a vertex only ever moves down, over vertices that
+    // were already visited, so the slots can compare against the moved data.
+    const uint32_t tableMask = TableSize(vertexCount) - 1;
+    std::vector<uint32_t> table(tableMask + 1, EmptySlot);
+    std::vector<uint32_t> remap(vertexCount);
+
+    uint32_t weldedCount = 0;
+    for (uint32_t vertex = 0; vertex < vertexCount; ++vertex) {
+        const WeldKey key = attributes.Key(vertex);
+        uint32_t slot = key.Hash() & tableMask;
+        while (table[slot] != EmptySlot && !(attributes.Key(table[slot]) == key)) {
+            slot = (slot + 1) & tableMask;
+        }
+
+        if (table[slot] == EmptySlot) {
+            attributes.Move(vertex, weldedCount);
+            table[slot] = weldedCount++;
+        }
+        remap[vertex] = table[slot];
+    }
+
+    for (uint32_t& index : indices) {
+        index = remap[index];
+    }
+    positions.resize(weldedCount * PositionStride);
+    if (attributes.hasNormals)
+        normals.resize(weldedCount * NormalStride);
+    if (attributes.hasUVs)
+        uvs.resize(weldedCount * UVStride);
+    return weldedCount;
+}
+
+VertexCacheStats AnalyzeVertexCache(const uint32_t* indices, size_t indexCount, uint32_t vertexCount, uint32_t cacheSize)
+{
+    VertexCacheStats stats = {};
+    stats.triangles = static_cast<uint32_t>(indexCount / 3);
+
+    // FIFO: a vertex is still cached while fewer than cacheSize misses happened since its own
+    std::vector<uint32_t> missTime(vertexCount, 0);
+    uint32_t time = cacheSize + 1;
+    for (size_t i = 0; i < indexCount; ++i) {
+        const uint32_t vertex = indices[i];
+        if (missTime[vertex] == 0)
+            ++stats.vertices;
+        if (time - missTime[vertex] > cacheSize) {
+            missTime[vertex] = time++;
+            ++stats.transformed;
+        }
+    }
+    return stats;
+}
+
+/* Forsyth's scoring, tuned for a cache of this many entries */
+static const uint32_t ForsythCacheSize = 32;
+
+static float ForsythVertexScore(int cachePosition, uint32_t liveTriangles)
+{
+    if (liveTriangles == 0)
+        return -1.0f;
+
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        // the last triangle's vertices are deliberately not the best, it
+        // would only ever pick triangles sharing an edge with the last one
+        if (cachePosition < 3) {
+            score = 0.75f;
+        } else {
+            const float scale = 1.0f / (ForsythCacheSize - 3);
+            score = std::pow(1.0f - (cachePosition - 3) * scale, 1.5f);
+        }
+    }
+    // vertices with few triangles left go first so they do not linger
+    return score + 2.0f / std::sqrt(float(liveTriangles));
+}
+
+void OptimizeVertexCache(uint32_t* indices, size_t indexCount, uint32_t vertexCount)
+{
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+        return;
+
+    // triangles of every vertex, the first liveTriangles[v] are not emitted yet
+    std::vector<uint32_t> liveTriangles(vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; ++i) {
+        ++liveTriangles[indices[i]];
+    }
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (uint32_t v = 0; v < vertexCount; ++v) {
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+    }
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (size_t i = 0; i < triangleCount * 3; ++i) {
+        adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    std::vector<int> cachePositions(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    for (uint32_t v = 0; v < vertexCount; ++v) {
+        vertexScores[v] = ForsythVertexScore(-1, liveTriangles[v]);
+    }
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    std::vector<uint32_t> output;
+    output.reserve(triangleCount * 3);
+
+    uint32_t cache[ForsythCacheSize + 3];
+    uint32_t cacheCount = 0;
+    size_t cursor = 0;
+    size_t best = triangleCount;
+    while (output.size() < triangleCount * 3) {
+        // nothing left around the cache, continue in input order
+        if (best == triangleCount) {
+            while (emitted[cursor])
+                ++cursor;
+            best = cursor;
+        }
+
+        const uint32_t* triangle = &indices[best * 3];
+        emitted[best] = 1;
+        output.insert(output.end(), triangle, triangle + 3);
+        for (int k = 0; k < 3; ++k) {
+            const uint32_t v = triangle[k];
+            uint32_t* live = &adjacency[adjacencyOffsets[v]];
+            uint32_t* last = live + liveTriangles[v] - 1;
+            *std::find(live, last, static_cast<uint32_t>(best)) = *last;
+            --liveTriangles[v];
+        }
+
+        // the triangle's vertices move to the front, the rest shifts back
+        uint32_t newCache[ForsythCacheSize + 3];
+        uint32_t newCount = 0;
+        for (int k = 0; k < 3; ++k) {
+            if (std::find(newCache, newCache + newCount, triangle[k]) == newCache + newCount)
+                newCache[newCount++] = triangle[k];
+        }
+        for (uint32_t i = 0; i < cacheCount; ++i) {
+            if (std::find(newCache, newCache + newCount, cache[i]) == newCache + newCount)
+                newCache[newCount++] = cache[i];
+        }
+
+        // rescore vertices that moved, including the ones that fell out, and
+        // pick the best triangle around what is still cached
+        best = triangleCount;
+        float bestScore = -1.0f;
+        for (uint32_t i = 0; i < newCount; ++i) {
+            const uint32_t v = newCache[i];
+            cachePositions[v] = i < ForsythCacheSize ? static_cast<int>(i) : -1;
+            vertexScores[v] = ForsythVertexScore(cachePositions[v], liveTriangles[v]);
+        }
+        for (uint32_t i = 0; i < newCount && i < ForsythCacheSize; ++i) {
+            const uint32_t v = newCache[i];
+            for (uint32_t j = 0; j < liveTriangles[v]; ++j) {
+                const uint32_t t = adjacency[adjacencyOffsets[v] + j];
+                const float score = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+                if (score > bestScore) {
+                    bestScore = score;
+                    best = t;
+                }
+            }
+        }
+
+        cacheCount = std::min(newCount, ForsythCacheSize);
+        std::copy(newCache, newCache + cacheCount, cache);
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+static void TriangleCentroidNormal(const uint32_t* triangle, const float* positions, float centroid[3], float normal[3])
+{
+    const float* a = &positions[triangle[0] * PositionStride];
+    const float* b = &positions[triangle[1] * PositionStride];
+    const float* c = &positions[triangle[2] * PositionStride];
+    const float ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+    const float ac[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+    // not normalized, the length is twice the area
+    normal[0] = ab[1] * ac[2] - ab[2] * ac[1];
+    normal[1] = ab[2] * ac[0] - ab[0] * ac[2];
+    normal[2] = ab[0] * ac[1] - ab[1] * ac[0];
+    for (int i = 0; i < 3; ++i)
+        centroid[i] = (a[i] + b[i] + c[i]) / 3.0f;
+}
+
+void OptimizeOverdraw(uint32_t* indices, size_t indexCount, const float* positions, uint32_t vertexCount)
+{
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount < 2)
+        return;
+
+    // a triangle missing the cache with all three vertices starts a cluster,
+    // cutting there costs no extra misses
+    std::vector<uint32_t> clusterStarts;
+    std::vector<uint32_t> missTime(vertexCount, 0);
+    uint32_t time = DefaultVertexCacheSize + 1;
+    for (size_t t = 0; t < triangleCount; ++t) {
+        uint32_t misses = 0;
+        for (int k = 0; k < 3; ++k) {
+            const uint32_t v = indices[t * 3 + k];
+            if (time - missTime[v] > DefaultVertexCacheSize) {
+                missTime[v] = time++;
+                ++misses;
+            }
+        }
+        if (t == 0 || misses == 3)
+            clusterStarts.push_back(static_cast<uint32_t>(t));
+    }
+    const uint32_t clusterCount = static_cast<uint32_t>(clusterStarts.size());
+    clusterStarts.push_back(static_cast<uint32_t>(triangleCount));
+
+    // area weighted centroid and normal of every cluster and of the whole range
+    std::vector<float> clusterCentroids(clusterCount * 3, 0.0f);
+    std::vector<float> clusterNormals(clusterCount * 3, 0.0f);
+    float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+    float meshArea = 0.0f;
+    for (uint32_t cluster = 0; cluster < clusterCount; ++cluster) {
+        float* centroid = &clusterCentroids[cluster * 3];
+        float* normal = &clusterNormals[cluster * 3];
+        float clusterArea = 0.0f;
+        for (uint32_t t = clusterStarts[cluster]; t < clusterStarts[cluster + 1]; ++t) {
+            float triangleCentroid[3], triangleNormal[3];
+            TriangleCentroidNormal(&indices[t * 3], positions, triangleCentroid, triangleNormal);
+            const float area = std::sqrt(triangleNormal[0] * triangleNormal[0] + triangleNormal[1] * triangleNormal[1] + triangleNormal[2] * triangleNormal[2]);
+            for (int i = 0; i < 3; ++i) {
+                centroid[i] += triangleCentroid[i] * area;
+                normal[i] += triangleNormal[i];
+                meshCentroid[i] += triangleCentroid[i] * area;
+            }
+            clusterArea += area;
+        }
+        meshArea += clusterArea;
+        if (clusterArea > 0.0f) {
+            for (int i = 0; i < 3; ++i)
+                centroid[i] /= clusterArea;
+        }
+    }
+    if (meshArea > 0.0f) {
+        for (int i = 0; i < 3; ++i)
+            meshCentroid[i] /= meshArea;
+    }
+
+    // how far out the cluster sits along its own facing
+    std::vector<float> clusterSortKeys(clusterCount);
+    for (uint32_t cluster = 0; cluster < clusterCount; ++cluster) {
+        const float* centroid = &clusterCentroids[cluster * 3];
+        const float* normal = &clusterNormals[cluster * 3];
+        const float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        float key = 0.0f;
+        if (length > 0.0f) {
+            for (int i = 0; i < 3; ++i)
+                key += (centroid[i] - meshCentroid[i]) * normal[i] / length;
+        }
+        clusterSortKeys[cluster] = key;
+    }
+
+    std::vector<uint32_t> order(clusterCount);
+    for (uint32_t cluster = 0; cluster < clusterCount; ++cluster)
+        order[cluster] = cluster;
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return clusterSortKeys[a] > clusterSortKeys[b]; });
+
+    std::vector<uint32_t> sorted;
+    sorted.reserve(triangleCount * 3);
+    for (uint32_t cluster : order) {
+        sorted.insert(sorted.end(), indices + clusterStarts[cluster] * 3, indices + clusterStarts[cluster + 1] * 3);
+    }
+    std::copy(sorted.begin(), sorted.end(), indices);
+}
+
+uint32_t OptimizeVertexFetch(std::vector<float>& positions, std::vector<float>& normals, std::vector<float>& uvs,
+    std::vector<uint32_t>& indices)
+{
+    const uint32_t vertexCount = static_cast<uint32_t>(positions.size() / PositionStride);
+    const bool hasNormals = normals.size() == vertexCount * NormalStride && vertexCount != 0;
+    const bool hasUVs = uvs.size() == vertexCount * UVStride && vertexCount != 0;
+
+    std::vector<uint32_t> remap(vertexCount, EmptySlot);
+    uint32_t newCount = 0;
+    for (uint32_t& index : indices) {
+        if (remap[index] == EmptySlot)
+            remap[index] = newCount++;
+        index = remap[index];
+    }
+
+    std::vector<float> newPositions(newCount * PositionStride);
+    std::vector<float> newNormals(hasNormals ? newCount * NormalStride : 0);
+    std::vector<float> newUVs(hasUVs ? newCount * UVStride : 0);
+    for (uint32_t v = 0; v < vertexCount; ++v) {
+        const uint32_t to = remap[v];
+        if (to == EmptySlot)
+            continue;
+        std::copy(&positions[v * PositionStride], &positions[v * PositionStride] + PositionStride, &newPositions[to * PositionStride]);
+        if (hasNormals)
+            std::copy(&normals[v * NormalStride], &normals[v * NormalStride] + NormalStride, &newNormals[to * NormalStride]);
+        if (hasUVs)
+            std::copy(&uvs[v * UVStride], &uvs[v * UVStride] + UVStride, &newUVs[to * UVStride]);
+    }
+    positions.swap(newPositions);
+    if (hasNormals)
+        normals.swap(newNormals);
+    if (hasUVs)
+        uvs.swap(newUVs);
+    return newCount;
+}
+
+uint32_t SplitFor16BitIndices(const uint32_t* indices, size_t indexCount, std::vector<IndexWindow>& windows)
+{
+    const size_t firstWindow = windows.size();
+    IndexWindow window = {};
+    uint32_t minVertex = 0xFFFFFFFF;
+    uint32_t maxVertex = 0;
+    for (size_t t = 0; t + 2 < indexCount; t += 3) {
+        const uint32_t* triangle = indices + t;
+        const uint32_t triangleMin = std::min(triangle[0], std::min(triangle[1], triangle[2]));
+        const uint32_t triangleMax = std::max(triangle[0], std::max(triangle[1], triangle[2]));
+        const uint32_t newMin = std::min(minVertex, triangleMin);
+        const uint32_t newMax = std::max(maxVertex, triangleMax);
+        if (window.triangleCount && newMax - newMin > 0xFFFF) {
+            window.baseVertex = minVertex;
+            windows.push_back(window);
+            window.indexOffset = static_cast<uint32_t>(t);
+            window.triangleCount = 0;
+            minVertex = triangleMin;
+            maxVertex = triangleMax;
+        } else {
+            minVertex = newMin;
+            maxVertex = newMax;
+        }
+        ++window.triangleCount;
+    }
+    if (window.triangleCount) {
+        window.baseVertex = minVertex;
+        windows.push_back(window);
+    }
+    return static_cast<uint32_t>(windows.size() - firstWindow);
+}
+
+void ComputeTangents(const std::vector<float>& positions, const std::vector<float>& normals, const std::vector<float>& uvs,
+    const std::vector<uint32_t>& indices, std::vector<float>& tangents)
+{
+    const uint32_t vertexCount = static_cast<uint32_t>(positions.size() / PositionStride);
+    // uv gradient directions summed over the triangles of each vertex
+    std::vector<float> sDirections(vertexCount * 3, 0.0f);
+    std::vector<float> tDirections(vertexCount * 3, 0.0f);
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        const uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+        const float* pa = &positions[a * PositionStride];
+        const float* pb = &positions[b * PositionStride];
+        const float* pc = &positions[c * PositionStride];
+        const float e1[3] = { pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2] };
+        const float e2[3] = { pc[0] - pa[0], pc[1] - pa[1], pc[2] - pa[2] };
+        const float du1 = uvs[b * UVStride] - uvs[a * UVStride];
+        const float dv1 = uvs[b * UVStride + 1] - uvs[a * UVStride + 1];
+        const float du2 = uvs[c * UVStride] - uvs[a * UVStride];
+        const float dv2 = uvs[c * UVStride + 1] - uvs[a * UVStride + 1];
+        const float determinant = du1 * dv2 - du2 * dv1;
+        if (determinant == 0.0f)
+            continue;
+        // unnormalized, bigger triangles weigh more
+        const float r = 1.0f / determinant;
+        for (int k = 0; k < 3; ++k) {
+            const float s = (dv2 * e1[k] - dv1 * e2[k]) * r;
+            const float t = (du1 * e2[k] - du2 * e1[k]) * r;
+            sDirections[a * 3 + k] += s, sDirections[b * 3 + k] += s, sDirections[c * 3 + k] += s;
+            tDirections[a * 3 + k] += t, tDirections[b * 3 + k] += t, tDirections[c * 3 + k] += t;
+        }
+    }
+
+    tangents.resize(vertexCount * TangentStride);
+    for (uint32_t v = 0; v < vertexCount; ++v) {
+        const float* n = &normals[v * NormalStride];
+        const float* sd = &sDirections[v * 3];
+        const float* td = &tDirections[v * 3];
+        float* tangent = &tangents[v * TangentStride];
+
+        // Gram-Schmidt against the normal
+        const float nDotS = n[0] * sd[0] + n[1] * sd[1] + n[2] * sd[2];
+        float t[3] = { sd[0] - n[0] * nDotS, sd[1] - n[1] * nDotS, sd[2] - n[2] * nDotS };
+        float length = std::sqrt(t[0] * t[0] + t[1] * t[1] + t[2] * t[2]);
+        if (length < 1e-12f) {
+            // no usable mapping, pick the axis least aligned with the normal
+            const float axis[3] = { std::fabs(n[0]) < 0.9f ? 1.0f : 0.0f, std::fabs(n[0]) < 0.9f ? 0.0f : 1.0f, 0.0f };
+            const float nDotAxis = n[0] * axis[0] + n[1] * axis[1];
+            for (int k = 0; k < 3; ++k)
+                t[k] = axis[k] - n[k] * nDotAxis;
+            length = std::sqrt(t[0] * t[0] + t[1] * t[1] + t[2] * t[2]);
+        }
+        for (int k = 0; k < 3; ++k)
+            tangent[k] = t[k] / length;
+
+        // handedness: does the uv v direction agree with cross(normal, tangent)
+        const float bitangent[3] = {
+            n[1] * tangent[2] - n[2] * tangent[1],
+            n[2] * tangent[0] - n[0] * tangent[2],
+            n[0] * tangent[1] - n[1] * tangent[0]
+        };
+        tangent[3] = bitangent[0] * td[0] + bitangent[1] * td[1] + bitangent[2] * td[2] < 0.0f ? -1.0f : 1.0f;
+    }
+}
+
+uint32_t AppendTransformed(const float world[3][4], const float* positions, const float* normals, const float* uvs,
+    uint32_t vertexCount, const uint32_t* indices, size_t indexCount, std::vector<float>& outPositions,
+    std::vector<float>& outNormals, std::vector<float>& outUVs, std::vector<uint32_t>& outIndices)
+{
+    // cofactors of the 3x3 part, the inverse transpose up to 1 / determinant
+    float cofactor[3][3];
+    for (int r = 0; r < 3; ++r) {
+        for (int c = 0; c < 3; ++c) {
+            const int r1 = (r + 1) % 3, r2 = (r + 2) % 3, c1 = (c + 1) % 3, c2 = (c + 2) % 3;
+            cofactor[r][c] = world[r1][c1] * world[r2][c2] - world[r1][c2] * world[r2][c1];
+        }
+    }
+    const float determinant = world[0][0] * cofactor[0][0] + world[0][1] * cofactor[0][1] + world[0][2] * cofactor[0][2];
+    const bool mirrored = determinant < 0.0f;
+
+    const uint32_t base = static_cast<uint32_t>(outPositions.size() / PositionStride);
+    std::vector<uint32_t> remap(vertexCount, EmptySlot);
+    uint32_t added = 0;
+    for (size_t i = 0; i < indexCount; ++i) {
+        // b and c of each mirrored triangle trade places
+        const size_t corner = i % 3;
+        const size_t source = mirrored && corner != 0 ? i - corner + (3 - corner) : i;
+        const uint32_t vertex = indices[source];
+        if (remap[vertex] == EmptySlot) {
+            remap[vertex] = base + added++;
+            const float* p = positions + vertex * PositionStride;
+            for (int r = 0; r < 3; ++r) {
+                outPositions.push_back(world[r][0] * p[0] + world[r][1] * p[1] + world[r][2] * p[2] + world[r][3]);
+            }
+            outPositions.push_back(p[3]);
+            if (normals) {
+                const float* n = normals + vertex * NormalStride;
+                float t[3];
+                for (int r = 0; r < 3; ++r) {
+                    t[r] = cofactor[r][0] * n[0] + cofactor[r][1] * n[1] + cofactor[r][2] * n[2];
+                }
+                const float length = std::sqrt(t[0] * t[0] + t[1] * t[1] + t[2] * t[2]);
+                // the cofactors carry the determinant's sign, normalizing by it keeps normals outward
+                const float scale = length > 0.0f ? (mirrored ? -1.0f : 1.0f) / length : 0.0f;
+                outNormals.insert(outNormals.end(), { t[0] * scale, t[1] * scale, t[2] * scale });
+            }
+            if (uvs) {
+                outUVs.insert(outUVs.end(), { uvs[vertex * UVStride], uvs[vertex * UVStride + 1] });
+            }
+        }
+        outIndices.push_back(remap[vertex]);
+    }
+    return added;
+}
+
+/* Sum of squared distances to a set of planes, symmetric 4x4 matrix in 10 values */
+struct Quadric {
+    double a00, a11, a22, a01, a02, a12;
+    double b0, b1, b2;
+    double c;
+
+    void AddPlane(double nx, double ny, double nz, double d)
+    {
+        a00 += nx * nx, a11 += ny * ny, a22 += nz * nz;
+        a01 += nx * ny, a02 += nx * nz, a12 += ny * nz;
+        b0 += nx * d, b1 += ny * d, b2 += nz * d;
+        c += d * d;
+    }
+
+    void Add(const Quadric& q)
+    {
+        a00 += q.a00, a11 += q.a11, a22 += q.a22;
+        a01 += q.a01, a02 += q.a02, a12 += q.a12;
+        b0 += q.b0, b1 += q.b1, b2 += q.b2;
+        c += q.c;
+    }
+
+    double Evaluate(const float* p) const
+    {
+        const double x = p[0], y = p[1], z = p[2];
+        const double error = a00 * x * x + a11 * y * y + a22 * z * z
+            + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+            + 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+        return error > 0.0 ? error : 0.0;
+    }
+};
+
+/*
+ * Hoppe's attribute quadric: for each attribute, the squared difference between
+ * a vertex's value and the value the triangles interpolate at its position,
+ * their linear interpolation carried on over their planes.
+ */
+struct AttributeQuadric {
+    static const int MaxAttributes = NormalStride + UVStride;
+
+    double a00, a11, a22, a01, a02, a12;
+    double b0, b1, b2;
+    double c;
+    double g[MaxAttributes][3];
+    double d[MaxAttributes];
+    double weight;
+
+    // the attribute of one triangle is gradient . p + offset
+    void AddAttribute(int i, const double gradient[3], double offset)
+    {
+        const double x = gradient[0], y = gradient[1], z = gradient[2];
+        a00 += x * x, a11 += y * y, a22 += z * z;
+        a01 += x * y, a02 += x * z, a12 += y * z;
+        b0 += x * offset, b1 += y * offset, b2 += z * offset;
+        c += offset * offset;
+        g[i][0] += x, g[i][1] += y, g[i][2] += z;
+        d[i] += offset;
+    }
+
+    void Add(const AttributeQuadric& q)
+    {
+        a00 += q.a00, a11 += q.a11, a22 += q.a22;
+        a01 += q.a01, a02 += q.a02, a12 += q.a12;
+        b0 += q.b0, b1 += q.b1, b2 += q.b2;
+        c += q.c;
+        for (int i = 0; i < MaxAttributes; ++i) {
+            g[i][0] += q.g[i][0], g[i][1] += q.g[i][1], g[i][2] += q.g[i][2];
+            d[i] += q.d[i];
+        }
+        weight += q.weight;
+    }
+
+    double Evaluate(const float* p, const float* s, int count) const
+    {
+        const double x = p[0], y = p[1], z = p[2];
+        double error = a00 * x * x + a11 * y * y + a22 * z * z
+            + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+            + 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+        for (int i = 0; i < count; ++i) {
+            error += weight * s[i] * s[i] - 2.0 * s[i] * (g[i][0] * x + g[i][1] * y + g[i][2] * z + d[i]);
+        }
+        return error > 0.0 ? error : 0.0;
+    }
+};
+
+/*
+ * Attribute differences of 1, a normal turned by 60 degrees or a whole
+ * texture repeat, weigh as much as moving the surface by these fractions of
+ * the mesh's diagonal.
+ */
+static const double NormalWeight = 0.5;
+static const double UVWeight = 1.0;
+
+struct Collapse {
+    uint32_t from;
+    uint32_t to;
+    // surface error, and the order: surface plus attribute error
+    double error;
+    double cost;
+};
+
+static void Cross(const float* a, const float* b, const float* c, double normal[3])
+{
+    const double ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+    const double ac[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+    normal[0] = ab[1] * ac[2] - ab[2] * ac[1];
+    normal[1] = ab[2] * ac[0] - ab[0] * ac[2];
+    normal[2] = ab[0] * ac[1] - ab[1] * ac[0];
+}
+
+size_t SimplifyMesh(uint32_t* destination, const uint32_t* indices, size_t indexCount, const float* positions,
+    const float* normals, const float* uvs, uint32_t vertexCount, size_t targetIndexCount, float targetError,
+    float* resultError)
+{
+    std::vector<uint32_t> result(indices, indices + indexCount - indexCount % 3);
+    auto position = [&](uint32_t v) { return &positions[v * PositionStride]; };
+
+    // vertices with the same position share a canonical vertex, the lowest one
+    std::vector<uint32_t> byPosition(vertexCount);
+    for (uint32_t v = 0; v < vertexCount; ++v)
+        byPosition[v] = v;
+    auto positionLess = [&](uint32_t a, uint32_t b) {
+        const float* pa = position(a);
+        const float* pb = position(b);
+        return pa[0] != pb[0] ? pa[0] < pb[0] : (pa[1] != pb[1] ? pa[1] < pb[1] : (pa[2] != pb[2] ? pa[2] < pb[2] : a < b));
+    };
+    std::sort(byPosition.begin(), byPosition.end(), positionLess);
+    std::vector<uint32_t> canonical(vertexCount);
+    std::vector<uint8_t> locked(vertexCount, 0);
+    for (uint32_t i = 0; i < vertexCount;) {
+        uint32_t end = i + 1;
+        while (end < vertexCount && std::memcmp(position(byPosition[end]), position(byPosition[i]), 3 * sizeof(float)) == 0)
+            ++end;
+        for (uint32_t j = i; j < end; ++j) {
+            canonical[byPosition[j]] = byPosition[i];
+            // seam
+            locked[byPosition[j]] = end - i > 1 ? 1 : 0;
+        }
+        i = end;
+    }
+
+    // edges with one triangle are borders, with more than two non manifold; both stay put
+    std::vector<uint64_t> edges;
+    edges.reserve(result.size());
+    for (size_t t = 0; t < result.size(); t += 3) {
+        for (int k = 0; k < 3; ++k) {
+            uint32_t a = canonical[result[t + k]];
+            uint32_t b = canonical[result[t + (k + 1) % 3]];
+            if (a > b)
+                std::swap(a, b);
+            edges.push_back((uint64_t(a) << 32) | b);
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    for (size_t i = 0; i < edges.size();) {
+        size_t end = i + 1;
+        while (end < edges.size() && edges[end] == edges[i])
+            ++end;
+        if (end - i != 2) {
+            locked[uint32_t(edges[i] >> 32)] = 1;
+            locked[uint32_t(edges[i])] = 1;
+        }
+        i = end;
+    }
+    // locks reached through the canonical vertex apply to all its vertices
+    for (uint32_t v = 0; v < vertexCount; ++v)
+        locked[v] |= locked[canonical[v]];
+
+    std::vector<Quadric> quadrics(vertexCount, Quadric());
+    for (size_t t = 0; t < result.size(); t += 3) {
+        const float* a = position(result[t]);
+        double normal[3];
+        Cross(a, position(result[t + 1]), position(result[t + 2]), normal);
+        const double length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        if (length == 0.0)
+            continue;
+        for (int i = 0; i < 3; ++i)
+            normal[i] /= length;
+        const double d = -(normal[0] * a[0] + normal[1] * a[1] + normal[2] * a[2]);
+        for (int k = 0; k < 3; ++k)
+            quadrics[result[t + k]].AddPlane(normal[0], normal[1], normal[2], d);
+    }
+
+    // the attributes, scaled to object space units, of every vertex
+    const int attributeCount = (normals ? NormalStride : 0) + (uvs ? UVStride : 0);
+    std::vector<float> attributes;
+    std::vector<AttributeQuadric> attributeQuadrics;
+    if (attributeCount > 0) {
+        float low[3] = { 0.0f, 0.0f, 0.0f };
+        float high[3] = { 0.0f, 0.0f, 0.0f };
+        for (uint32_t v = 0; v < vertexCount; ++v) {
+            for (int i = 0; i < 3; ++i) {
+                low[i] = v == 0 ? position(v)[i] : std::min(low[i], position(v)[i]);
+                high[i] = v == 0 ? position(v)[i] : std::max(high[i], position(v)[i]);
+            }
+        }
+        const double diagonal = std::sqrt(double(high[0] - low[0]) * (high[0] - low[0])
+            + double(high[1] - low[1]) * (high[1] - low[1]) + double(high[2] - low[2]) * (high[2] - low[2]));
+        attributes.resize(size_t(vertexCount) * attributeCount);
+        for (uint32_t v = 0; v < vertexCount; ++v) {
+            float* s = &attributes[size_t(v) * attributeCount];
+            if (normals) {
+                for (int i = 0; i < NormalStride; ++i)
+                    *s++ = static_cast<float>(normals[v * NormalStride + i] * NormalWeight * diagonal);
+            }
+            if (uvs) {
+                for (int i = 0; i < UVStride; ++i)
+                    *s++ = static_cast<float>(uvs[v * UVStride + i] * UVWeight * diagonal);
+            }
+        }
+
+        attributeQuadrics.resize(vertexCount, AttributeQuadric());
+        for (size_t t = 0; t < result.size(); t += 3) {
+            const float* p0 = position(result[t]);
+            const float* p1 = position(result[t + 1]);
+            const float* p2 = position(result[t + 2]);
+            double normal[3];
+            Cross(p0, p1, p2, normal);
+            const double length2 = normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2];
+            if (length2 == 0.0)
+                continue;
+            // the gradient g of an attribute lies in the plane, g . e1 and g . e2 are its differences along the edges
+            const double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            const double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            const double e2n[3] = { e2[1] * normal[2] - e2[2] * normal[1], e2[2] * normal[0] - e2[0] * normal[2],
+                e2[0] * normal[1] - e2[1] * normal[0] };
+            const double ne1[3] = { normal[1] * e1[2] - normal[2] * e1[1], normal[2] * e1[0] - normal[0] * e1[2],
+                normal[0] * e1[1] - normal[1] * e1[0] };
+            const float* s0 = &attributes[size_t(result[t]) * attributeCount];
+            const float* s1 = &attributes[size_t(result[t + 1]) * attributeCount];
+            const float* s2 = &attributes[size_t(result[t + 2]) * attributeCount];
+            for (int i = 0; i < attributeCount; ++i) {
+                const double d1 = double(s1[i]) - s0[i];
+                const double d2 = double(s2[i]) - s0[i];
+                double gradient[3];
+                for (int k = 0; k < 3; ++k)
+                    gradient[k] = (d1 * e2n[k] + d2 * ne1[k]) / length2;
+                const double offset = s0[i] - (gradient[0] * p0[0] + gradient[1] * p0[1] + gradient[2] * p0[2]);
+                for (int k = 0; k < 3; ++k)
+                    attributeQuadrics[result[t + k]].AddAttribute(i, gradient, offset);
+            }
+            for (int k = 0; k < 3; ++k)
+                attributeQuadrics[result[t + k]].weight += 1.0;
+        }
+    }
+    // the error of moving from onto to, with the attributes of to
+    auto attributeError = [&](uint32_t from, uint32_t to) {
+        if (attributeCount == 0)
+            return 0.0;
+        AttributeQuadric q = attributeQuadrics[from];
+        q.Add(attributeQuadrics[to]);
+        return q.Evaluate(position(to), &attributes[size_t(to) * attributeCount], attributeCount);
+    };
+
+    const double errorLimit = double(targetError) * targetError;
+    double maxError = 0.0;
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> collapseTo(vertexCount);
+    std::vector<uint8_t> touched(vertexCount);
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+    std::vector<uint32_t> adjacency;
+    while (result.size() > targetIndexCount) {
+        collapses.clear();
+        for (size_t t = 0; t < result.size(); t += 3) {
+            for (int k = 0; k < 3; ++k) {
+                const uint32_t a = result[t + k];
+                const uint32_t b = result[t + (k + 1) % 3];
+                Quadric q = quadrics[a];
+                q.Add(quadrics[b]);
+                if (!locked[a]) {
+                    const double error = q.Evaluate(position(b));
+                    Collapse collapse = { a, b, error, error + attributeError(a, b) };
+                    collapses.push_back(collapse);
+                }
+                if (!locked[b]) {
+                    const double error = q.Evaluate(position(a));
+                    Collapse collapse = { b, a, error, error + attributeError(b, a) };
+                    collapses.push_back(collapse);
+                }
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+        // triangles around every vertex, for the flip test
+        std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+        for (uint32_t v : result)
+            ++adjacencyOffsets[v + 1];
+        for (uint32_t v = 0; v < vertexCount; ++v)
+            adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+        adjacency.resize(result.size());
+        std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < result.size(); ++i)
+            adjacency[fill[result[i]]++] = static_cast<uint32_t>(i / 3);
+
+        // each collapse removes about two triangles, stop a pass where the target is reached
+        const size_t collapseLimit = (result.size() - targetIndexCount) / 6 + 1;
+        // and leaves collapses well above the cost that limit reaches to later passes, which may find cheaper ones
+        const double costGoal = collapseLimit < collapses.size() ? 1.5 * collapses[collapseLimit].cost : DBL_MAX;
+        size_t applied = 0;
+        for (uint32_t v = 0; v < vertexCount; ++v)
+            collapseTo[v] = v;
+        std::fill(touched.begin(), touched.end(), 0);
+        for (const Collapse& collapse : collapses) {
+            if (applied == collapseLimit || (collapse.cost > costGoal && applied > collapseLimit / 10))
+                break;
+            // ordered by cost, a later collapse may still move the surface less
+            if (collapse.error > errorLimit || touched[collapse.from] || touched[collapse.to])
+                continue;
+
+            // moving from onto to must not turn any remaining triangle around
+            bool flips = false;
+            for (uint32_t i = adjacencyOffsets[collapse.from]; i < adjacencyOffsets[collapse.from + 1] && !flips; ++i) {
+                const uint32_t* triangle = &result[adjacency[i] * 3];
+                if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+                    continue;
+                const float* moved[3];
+                const float* original[3];
+                for (int k = 0; k < 3; ++k) {
+                    original[k] = position(triangle[k]);
+                    moved[k] = triangle[k] == collapse.from ? position(collapse.to) : original[k];
+                }
+                double before[3], after[3];
+                Cross(original[0], original[1], original[2], before);
+                Cross(moved[0], moved[1], moved[2], after);
+                flips = before[0] * after[0] + before[1] * after[1] + before[2] * after[2] <= 0.0;
+            }
+            if (flips)
+                continue;
+
+            collapseTo[collapse.from] = collapse.to;
+            quadrics[collapse.to].Add(quadrics[collapse.from]);
+            if (attributeCount > 0)
+                attributeQuadrics[collapse.to].Add(attributeQuadrics[collapse.from]);
+            maxError = std::max(maxError, collapse.error);
+            ++applied;
+            // the neighbourhood changed, its vertices wait for the next pass
+            for (uint32_t i = adjacencyOffsets[collapse.from]; i < adjacencyOffsets[collapse.from + 1]; ++i) {
+                const uint32_t* triangle = &result[adjacency[i] * 3];
+                touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = 1;
+            }
+        }
+        if (applied == 0)
+            break;
+
+        size_t write = 0;
+        for (size_t t = 0; t < result.size(); t += 3) {
+            const uint32_t a = collapseTo[result[t]];
+            const uint32_t b = collapseTo[result[t + 1]];
+            const uint32_t c = collapseTo[result[t + 2]];
+            if (canonical[a] == canonical[b] || canonical[b] == canonical[c] || canonical[a] == canonical[c])
+                continue;
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+    }
+
+    std::copy(result.begin(), result.end(), destination);
+    if (resultError)
+        *resultError = static_cast<float>(std::sqrt(maxError));
+    return result.size();
+}
+} // End of namespace m3d
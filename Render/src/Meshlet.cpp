@@ -0,0 +1,165 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT)
+* (http://opensource.org/licenses/MIT)
+*/
+
+#include "Meshlet.hpp"
+
+#include <algorithm>
+
+namespace m3d {
+using m3d::math::Vector3;
+
+static Vector3 Position(const float* positions, uint32_t vertex)
+{
+    return Vector3(positions[vertex * 4], positions[vertex * 4 + 1], positions[vertex * 4 + 2]);
+}
+
+static float Length(const Vector3& v)
+{
+    return std::sqrt(v | v);
+}
+
+static void ComputeBounds(const float* positions, const uint32_t* indices, Meshlet& meshlet)
+{
+    const uint32_t* triangles = indices + meshlet.indexOffset;
+    const uint32_t indexCount = meshlet.triangleCount * 3;
+
+    AABB box = AABB::Empty();
+    for (uint32_t i = 0; i < indexCount; ++i) {
+        box.Expand(Position(positions, triangles[i]));
+    }
+    meshlet.center = box.Center();
+    meshlet.radius = 0.0f;
+    for (uint32_t i = 0; i < indexCount; ++i) {
+        meshlet.radius = std::max(meshlet.radius, Length(Position(positions, triangles[i]) - meshlet.center));
+    }
+
+    // normals weighted equally, a big triangle must not hide a small one facing elsewhere
+    std::vector<Vector3> normals;
+    normals.reserve(meshlet.triangleCount);
+    Vector3 axis(0.0f, 0.0f, 0.0f);
+    for (uint32_t t = 0; t < meshlet.triangleCount; ++t) {
+        const Vector3 a = Position(positions, triangles[t * 3]);
+        Vector3 normal = (Position(positions, triangles[t * 3 + 1]) - a) ^ (Position(positions, triangles[t * 3 + 2]) - a);
+        const float length = Length(normal);
+        if (length == 0.0f)
+            continue;
+        normal *= 1.0f / length;
+        normals.push_back(normal);
+        axis += normal;
+    }
+
+    meshlet.coneAxis = Vector3(0.0f, 0.0f, 1.0f);
+    meshlet.coneCutoff = 1.0f;
+    const float axisLength = Length(axis);
+    if (normals.empty() || axisLength == 0.0f)
+        return;
+    axis *= 1.0f / axisLength;
+
+    float minDot = 1.0f;
+    for (const Vector3& normal : normals) {
+        minDot = std::min(minDot, normal | axis);
+    }
+    meshlet.coneAxis = axis;
+    // a cone of 90 degrees or more always has a triangle facing the eye
+    if (minDot > 0.0f)
+        meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+}
+
+uint32_t BuildMeshlets(const float* positions, uint32_t vertexCount, const uint32_t* indices, uint32_t indexOffset,
+    uint32_t triangleCount, std::vector<Meshlet>& meshlets, uint32_t maxVertices, uint32_t maxTriangles)
+{
+    const size_t firstMeshlet = meshlets.size();
+
+    // meshlet the vertex was last counted in, plus one
+    std::vector<uint32_t> vertexStamps(vertexCount, 0);
+    uint32_t stamp = 1;
+
+    // vertices the triangle would add to the current meshlet
+    auto countNewVertices = [&](const uint32_t* triangle) {
+        uint32_t count = 0;
+        for (int k = 0; k < 3; ++k) {
+            const bool repeated = (k > 0 && triangle[k] == triangle[0]) || (k > 1 && triangle[k] == triangle[1]);
+            count += vertexStamps[triangle[k]] != stamp && !repeated ? 1 : 0;
+        }
+        return count;
+    };
+
+    Meshlet current = {};
+    current.indexOffset = indexOffset;
+    uint32_t currentVertices = 0;
+    for (uint32_t t = 0; t < triangleCount; ++t) {
+        const uint32_t* triangle = indices + indexOffset + t * 3;
+        uint32_t newVertices = countNewVertices(triangle);
+
+        if (current.triangleCount == maxTriangles || currentVertices + newVertices > maxVertices) {
+            ComputeBounds(positions, indices, current);
+            meshlets.push_back(current);
+
+            current = Meshlet();
+            current.indexOffset = indexOffset + t * 3;
+            currentVertices = 0;
+            ++stamp;
+            newVertices = countNewVertices(triangle);
+        }
+
+        for (int k = 0; k < 3; ++k) {
+            vertexStamps[triangle[k]] = stamp;
+        }
+        currentVertices += newVertices;
+        ++current.triangleCount;
+    }
+    if (current.triangleCount) {
+        ComputeBounds(positions, indices, current);
+        meshlets.push_back(current);
+    }
+    return static_cast<uint32_t>(meshlets.size() - firstMeshlet);
+}
+
+uint32_t CullMeshlets(const Meshlet* meshlets, uint32_t meshletCount, const m3d::math::Matrix4x4& world,
+    const Frustum& frustum, const Vector3& eye, bool cullBackfaces, std::vector<IndexRange>& ranges)
+{
+    const float(&m)[4][4] = world.m;
+    const Vector3 columns[3] = {
+        Vector3(m[0][0], m[1][0], m[2][0]),
+        Vector3(m[0][1], m[1][1], m[2][1]),
+        Vector3(m[0][2], m[1][2], m[2][2])
+    };
+    const float scale = std::max(Length(columns[0]), std::max(Length(columns[1]), Length(columns[2])));
+
+    const size_t firstRange = ranges.size();
+    uint32_t visible = 0;
+    for (uint32_t i = 0; i < meshletCount; ++i) {
+        const Meshlet& meshlet = meshlets[i];
+        const Vector3& c = meshlet.center;
+        const Vector3 center = columns[0] * c.x + columns[1] * c.y + columns[2] * c.z + Vector3(m[0][3], m[1][3], m[2][3]);
+        const float radius = meshlet.radius * scale;
+
+        bool culled = false;
+        for (int p = 0; p < Frustum::PlaneCount && !culled; ++p) {
+            culled = frustum.planes[p].Distance(center) < -radius;
+        }
+        if (!culled && cullBackfaces && meshlet.coneCutoff < 1.0f) {
+            // the axis goes through the matrix like a direction, fine for uniform scale
+            Vector3 axis = columns[0] * meshlet.coneAxis.x + columns[1] * meshlet.coneAxis.y + columns[2] * meshlet.coneAxis.z;
+            axis *= 1.0f / Length(axis);
+            const Vector3 toCenter = center - eye;
+            culled = (toCenter | axis) >= meshlet.coneCutoff * Length(toCenter) + radius;
+        }
+        if (culled)
+            continue;
+
+        ++visible;
+        const uint32_t indexCount = meshlet.triangleCount * 3;
+        if (ranges.size() > firstRange && ranges.back().firstIndex + ranges.back().indexCount == meshlet.indexOffset) {
+            ranges.back().indexCount += indexCount;
+        } else {
+            IndexRange range = { meshlet.indexOffset, indexCount };
+            ranges.push_back(range);
+        }
+    }
+    return visible;
+}
+} // End of namespace m3d
@@ -3,34 +3,73 @@
 #include "../include/VulkanHelper.hpp"
 #include "Matrix.h"
 #define VERTEX_BUFFER_BIND_ID 0
+#define INSTANCE_BUFFER_BIND_ID 1
 namespace m3d {
-	void Pipeline::SetupVertexInputs()
+	static vk::Format GetVertexAttributeFormat(VertexEncoding encoding, uint32_t components)
+	{
+		static const vk::Format float32Formats[4] = { vk::Format::eR32Sfloat, vk::Format::eR32G32Sfloat, vk::Format::eR32G32B32Sfloat, vk::Format::eR32G32B32A32Sfloat };
+		static const vk::Format float16Formats[4] = { vk::Format::eR16Sfloat, vk::Format::eR16G16Sfloat, vk::Format::eR16G16B16Sfloat, vk::Format::eR16G16B16A16Sfloat };
+		static const vk::Format snorm16Formats[4] = { vk::Format::eR16Snorm, vk::Format::eR16G16Snorm, vk::Format::eR16G16B16Snorm, vk::Format::eR16G16B16A16Snorm };
+		static const vk::Format snorm8Formats[4] = { vk::Format::eR8Snorm, vk::Format::eR8G8Snorm, vk::Format::eR8G8B8Snorm, vk::Format::eR8G8B8A8Snorm };
+		switch (encoding) {
+		case VertexEncodingFloat32:
+			return float32Formats[components - 1];
+		case VertexEncodingFloat16:
+			return float16Formats[components - 1];
+		case VertexEncodingSnorm16:
+			return snorm16Formats[components - 1];
+		case VertexEncodingSnorm8:
+			return snorm8Formats[components - 1];
+		default:
+			return vk::Format::eUndefined;
+		}
+	}
+
+	void Pipeline::SetupVertexInputs(const VertexFormat& vertexFormat)
 	{
 		// Binding description
-	    vertexInputs.bindingDescriptions.resize(1);
+	    vertexInputs.bindingDescriptions.resize(2);
 	    vertexInputs.bindingDescriptions[0].binding = VERTEX_BUFFER_BIND_ID;
-	    vertexInputs.bindingDescriptions[0].stride = sizeof(float) * 4;
+	    vertexInputs.bindingDescriptions[0].stride = vertexFormat.stride;
 	    vertexInputs.bindingDescriptions[0].inputRate = vk::VertexInputRate::eVertex;
+	    // Per instance world matrix, advanced once per instance of an instanced draw
+	    vertexInputs.bindingDescriptions[1].binding = INSTANCE_BUFFER_BIND_ID;
+	    vertexInputs.bindingDescriptions[1].stride = sizeof(m3d::math::Matrix4x4);
+	    vertexInputs.bindingDescriptions[1].inputRate = vk::VertexInputRate::eInstance;
 
 	    // Attribute descriptions
 	    // Describes memory layout and shader positions
-	    vertexInputs.attributeDescriptions.resize(1);
+	    vertexInputs.attributeDescriptions.clear();
 	    // Location 0 : Position
-	    vertexInputs.attributeDescriptions[0].binding = VERTEX_BUFFER_BIND_ID;
-	    vertexInputs.attributeDescriptions[0].location = 0;
-	    vertexInputs.attributeDescriptions[0].format = vk::Format::eR32G32B32A32Sfloat;
-	    vertexInputs.attributeDescriptions[0].offset = 0;
-	    //vkTools::initializers::vertexInputAttributeDescription(
-	    //	VERTEX_BUFFER_BIND_ID,
-	    //	0,
-	    //	VK_FORMAT_R32G32B32_SFLOAT,
-	    //	0);
-
-	    // Location 1 : Normal
-	    // Location 2 : Texture coordinates
-	    // Location 3 : Color
-	    // Location 4 : Bone weights
-	    // Location 5 : Bone IDs
+	    // Location 5 : Normal
+	    // Location 6 : Texture coordinates
+	    // Location 7 : Tangent
+	    // see VertexLocations, attributes missing from the format read as (0, 0, 0, 1)
+	    for (uint32_t a = 0; a < VertexAttributeCount; ++a) {
+	        const VertexAttribute vertexAttribute = static_cast<VertexAttribute>(a);
+	        if (!vertexFormat.Has(vertexAttribute))
+	            continue;
+	        vk::VertexInputAttributeDescription attribute;
+	        attribute.binding = VERTEX_BUFFER_BIND_ID;
+	        attribute.location = VertexLocations[a];
+	        attribute.format = GetVertexAttributeFormat(vertexFormat.encodings[a], GetVertexComponentCount(vertexAttribute, vertexFormat.encodings[a]));
+	        attribute.offset = vertexFormat.offsets[a];
+	        vertexInputs.attributeDescriptions.push_back(attribute);
+	    }
+
+	    // Location 1..4 : Instance matrix, a mat4 attribute takes one location per row
+	    for (uint32_t row = 0; row < 4; ++row) {
+	        vk::VertexInputAttributeDescription attribute;
+	        attribute.binding = INSTANCE_BUFFER_BIND_ID;
+	        attribute.location = 1 + row;
+	        attribute.format = vk::Format::eR32G32B32A32Sfloat;
+	        attribute.offset = sizeof(float) * 4 * row;
+	        vertexInputs.attributeDescriptions.push_back(attribute);
+	    }
+
+	    // Location 8 : Color
+	    // Location 9 : Bone weights
+	    // Location 10 : Bone IDs
 
 		//vertexInputs.inputState.flags = vk::PipelineVertexInputStateCreateFlagBits::;
 	    vertexInputs.inputState.vertexBindingDescriptionCount = vertexInputs.bindingDescriptions.size();
@@ -61,7 +100,8 @@ namespace m3d {
 		// Get the memory type index that supports host visibile memory access
 		// Most implementations offer multiple memory tpyes and selecting the
 		// correct one to allocate memory from is important
-		allocInfo.memoryTypeIndex = vkhelper::getMemoryType(physicalDevice, memReqs.memoryTypeBits, vk::MemoryPropertyFlagBits::eHostVisible);
+		// Coherent memory so the buffer can stay mapped without flushes
+		allocInfo.memoryTypeIndex = vkhelper::getMemoryType(physicalDevice, memReqs.memoryTypeBits, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
 		// Allocate memory for the uniform buffer
 		(uniformDataVS.memory) = device.allocateMemory(allocInfo);
 		// Bind memory to buffer
@@ -94,15 +134,14 @@ namespace m3d {
 		printf("vmat = %s\n", buf);
 		uboVS.modelMatrix = m3d::math::Matrix4x4();
 
-		// Map uniform buffer and update it
-		// If you want to keep a handle to the memory and not unmap it afer updating,
-		// create the memory with the vk::MemoryPropertyFlagBits::eHostCoherent
-		void* pData = device.mapMemory(uniformDataVS.memory, 0, sizeof(uboVS), vk::MemoryMapFlags());
-		// TODO:
-		size_t uboSize = sizeof(uboVS);
-		printf("sizeof ubo = %d", uboSize);
-		memcpy(pData, &uboVS, sizeof(uboVS));
-		device.unmapMemory(uniformDataVS.memory);
+		// Map uniform buffer once, updates are a plain copy
+		uniformDataVS.mapped = device.mapMemory(uniformDataVS.memory, 0, sizeof(uboVS), vk::MemoryMapFlags());
+		UpdateUniformBuffer();
+	}
+
+	void Pipeline::UpdateUniformBuffer()
+	{
+		memcpy(uniformDataVS.mapped, &uboVS, sizeof(uboVS));
 	}
 
 	void Pipeline::CreateRenderPass()
@@ -263,11 +302,12 @@ namespace m3d {
 
 	vk::ShaderModule _loadShader(const std::string& filename, vk::Device device, vk::ShaderStageFlagBits stage)
 	{
-		std::vector<uint8_t> binaryData; // = readBinaryFile(filename);
-		m3d::file::readBinary(filename.c_str(), binaryData);
+		// SPIR-V is consumed in place, mappings are page aligned
+		m3d::file::MappedFile binaryData;
+		binaryData.Open(filename.c_str(), m3d::file::Access::Sequential);
 		vk::ShaderModuleCreateInfo moduleCreateInfo;
-		moduleCreateInfo.codeSize = binaryData.size();
-		moduleCreateInfo.pCode = (uint32_t*)binaryData.data();
+		moduleCreateInfo.codeSize = binaryData.Size();
+		moduleCreateInfo.pCode = reinterpret_cast<const uint32_t*>(binaryData.Data());
 		return device.createShaderModule(moduleCreateInfo);
 	}
 
@@ -285,7 +325,7 @@ namespace m3d {
 		return shaderStage;
 	}
 
-	Pipeline::Pipeline(vk::Device &Device, vk::PhysicalDevice &PhysicalDevice) : device(Device), physicalDevice(PhysicalDevice)
+	Pipeline::Pipeline(vk::Device &Device, vk::PhysicalDevice &PhysicalDevice, const VertexFormat& vertexFormat) : device(Device), physicalDevice(PhysicalDevice)
 	{
 		CreateDescriptorPool();
 		CreateDescriptorSetLayout();
@@ -386,7 +426,7 @@ namespace m3d {
 
 	    // Assign states
 	    // Assign pipeline state create information
-		SetupVertexInputs();
+		SetupVertexInputs(vertexFormat);
 
 		vk::GraphicsPipelineCreateInfo pipelineCreateInfo = {};
 		pipelineCreateInfo.layout = pipelineLayout;
@@ -410,6 +450,17 @@ namespace m3d {
 
 	Pipeline::~Pipeline()
 	{
-		// TODO
+		// null handles are ignored, a pipeline that failed half way is destroyed the same
+		device.destroyPipeline(pipeline);
+		device.destroyPipelineLayout(pipelineLayout);
+		// frees descriptorSet with it
+		device.destroyDescriptorPool(descriptorPool);
+		device.destroyDescriptorSetLayout(descriptorSetLayout);
+		device.destroyRenderPass(renderPass);
+		if (uniformDataVS.buffer) {
+			device.unmapMemory(uniformDataVS.memory);
+			device.destroyBuffer(uniformDataVS.buffer);
+			device.freeMemory(uniformDataVS.memory);
+		}
 	}
 }
\ No newline at end of file
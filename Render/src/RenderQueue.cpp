@@ -0,0 +1,238 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT)
+* (http://opensource.org/licenses/MIT)
+*/
+
+#include "RenderQueue.hpp"
+#include "RadixSort.hpp"
+#include "Scene.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace m3d {
+Transform GetItemTransform(const Scene& scene, const RenderItem& item)
+{
+    if (!item.prefabPart)
+        return scene.transforms[scene.instances[item.instanceId].transformId];
+    const PrefabInstance& placement = scene.prefabInstances[item.instanceId];
+    const Prefab::Part& part = scene.prefabs[placement.prefabId].parts[item.prefabPart - 1];
+    return CombineTransforms(scene.transforms[placement.transformId], part.local);
+}
+
+void RenderQueue::Reserve(size_t itemCount)
+{
+    items.reserve(itemCount);
+    scratch.reserve(itemCount);
+    drawList.reserve(itemCount);
+}
+
+void RenderQueue::Clear()
+{
+    items.clear();
+    drawList.clear();
+    clusterRanges.clear();
+    stats = {};
+}
+
+void RenderQueue::Push(const RenderItem& item)
+{
+    items.push_back(item);
+}
+
+void RenderQueue::PushInstance(const Scene& scene, uint32_t instanceId, const m3d::math::Vector3& eye, float farZ,
+    uint32_t pass)
+{
+    const Instance& instance = scene.instances[instanceId];
+    pushInstance(instanceId, 0, instance.meshId, scene.transforms[instance.transformId], scene.meshes[instance.meshId],
+        eye, farZ, pass);
+}
+
+void RenderQueue::PushInstances(const Scene& scene, const uint32_t* instanceIds, size_t count,
+    const m3d::math::Vector3& eye, float farZ, uint32_t pass)
+{
+    // enough lookups per batch to keep the prefetches ahead, small enough for the stack
+    const size_t batchSize = 64;
+    Instance* instances[batchSize];
+    Transform* transforms[batchSize];
+    Mesh* meshes[batchSize];
+    uint32_t ids[batchSize];
+    uint32_t transformIds[batchSize];
+    uint32_t meshIds[batchSize];
+
+    for (size_t begin = 0; begin < count; begin += batchSize) {
+        const size_t n = std::min(batchSize, count - begin);
+        scene.instances.lookup_batch(instanceIds + begin, n, instances);
+
+        size_t live = 0;
+        for (size_t i = 0; i < n; ++i) {
+            if (!instances[i])
+                continue;
+            ids[live] = instanceIds[begin + i];
+            instances[live] = instances[i];
+            transformIds[live] = instances[i]->transformId;
+            meshIds[live] = instances[i]->meshId;
+            ++live;
+        }
+        scene.transforms.lookup_batch(transformIds, live, transforms);
+        scene.meshes.lookup_batch(meshIds, live, meshes);
+
+        for (size_t i = 0; i < live; ++i) {
+            if (transforms[i] && meshes[i])
+                pushInstance(ids[i], 0, meshIds[i], *transforms[i], *meshes[i], eye, farZ, pass);
+        }
+    }
+}
+
+void RenderQueue::PushPrefabInstances(const Scene& scene, const uint32_t* prefabInstanceIds, size_t count,
+    const m3d::math::Vector3& eye, float farZ, const Frustum* frustum, uint32_t pass)
+{
+    for (size_t i = 0; i < count; ++i) {
+        const uint32_t id = prefabInstanceIds[i];
+        if (!scene.prefabInstances.contains(id))
+            continue;
+        const PrefabInstance& placement = scene.prefabInstances[id];
+        if (!scene.prefabs.contains(placement.prefabId) || !scene.transforms.contains(placement.transformId))
+            continue;
+        const Prefab& prefab = scene.prefabs[placement.prefabId];
+        const Transform& root = scene.transforms[placement.transformId];
+
+        for (size_t p = 0; p < prefab.parts.size(); ++p) {
+            const Prefab::Part& part = prefab.parts[p];
+            const Mesh& mesh = scene.meshes[part.meshId];
+            const Transform transform = CombineTransforms(root, part.local);
+            if (frustum
+                && !Intersects(*frustum, TransformAABB(mesh.bounds, transform.position, transform.rotation, transform.scale)))
+                continue;
+            pushInstance(id, static_cast<uint32_t>(p) + 1, part.meshId, transform, mesh, eye, farZ, pass);
+        }
+    }
+}
+
+void RenderQueue::pushInstance(uint32_t instanceId, uint32_t prefabPart, uint32_t meshId, const Transform& transform,
+    const Mesh& mesh, const m3d::math::Vector3& eye, float farZ, uint32_t pass)
+{
+    const AABB bounds = TransformAABB(mesh.bounds, transform.position, transform.rotation, transform.scale);
+    const m3d::math::Vector3 toCenter = bounds.Center() - eye;
+    const float distance = std::sqrt(toCenter | toCenter);
+
+    // the coarsest level that passes where the object gets closest to the eye
+    uint32_t lod = 0;
+    if (!mesh.lods.empty()) {
+        const m3d::math::Vector3 halfExtent = (bounds.max - bounds.min) * 0.5f;
+        const float nearest = std::max(distance - std::sqrt(halfExtent | halfExtent), 0.0f);
+        const m3d::math::Vector3& scale = transform.scale;
+        const float maxScale = std::max(std::fabs(scale.x), std::max(std::fabs(scale.y), std::fabs(scale.z)));
+        lod = mesh.GetLodCount() - 1;
+        const uint32_t firstLod = std::min(lodSelection.firstLod, lod);
+        while (lod > firstLod && !lodSelection.Accepts(mesh.lods[lod - 1].error * maxScale, nearest))
+            --lod;
+    }
+    const std::vector<Mesh::Slice>& slices = mesh.GetSlices(lod);
+
+    uint32_t depth = sortkey::QuantizeDepth(distance, farZ);
+    // transparent surfaces blend back to front
+    if (pass == RenderPassTransparent)
+        depth = ((1u << sortkey::DepthBits) - 1) - depth;
+
+    RenderItem item;
+    item.instanceId = instanceId;
+    item.prefabPart = prefabPart;
+    item.meshId = meshId;
+    item.lod = lod;
+    for (uint32_t slice = 0; slice < slices.size(); ++slice) {
+        item.slice = slice;
+        const uint32_t material = slices[slice].material;
+        item.materialId = material < mesh.materialIds.size() ? mesh.materialIds[material] : 0;
+        item.key = sortkey::Make(pass, item.materialId, item.meshId, lod, slice, depth);
+        items.push_back(item);
+    }
+}
+
+void RenderQueue::Sort()
+{
+    scratch.resize(items.size());
+    RenderItem* sorted = RadixSort64(items.data(), scratch.data(), items.size(),
+        [](const RenderItem& item) { return item.key; });
+    if (sorted != items.data())
+        items.swap(scratch);
+}
+
+static bool SamePass(uint64_t a, uint64_t b)
+{
+    return sortkey::Field(a, sortkey::PassShift, sortkey::PassBits) == sortkey::Field(b, sortkey::PassShift, sortkey::PassBits);
+}
+
+void RenderQueue::BuildDrawList()
+{
+    drawList.clear();
+    stats = {};
+
+    DrawCommand previous = {};
+    for (size_t i = 0; i < items.size(); ++i) {
+        const RenderItem& item = items[i];
+        ++stats.instances;
+
+        // same pass, state and geometry, draw one more instance of the previous command
+        if (i != 0 && SamePass(item.key, items[i - 1].key) && item.materialId == previous.material
+            && item.meshId == previous.meshId && item.lod == previous.lod && item.slice == previous.slice) {
+            ++drawList.back().instanceCount;
+            continue;
+        }
+
+        DrawCommand cmd;
+        cmd.material = item.materialId;
+        cmd.meshId = item.meshId;
+        cmd.lod = item.lod;
+        cmd.slice = item.slice;
+        cmd.firstInstance = static_cast<uint32_t>(i);
+        cmd.instanceCount = 1;
+        cmd.firstRange = 0;
+        cmd.rangeCount = 0;
+
+        // the first command has to set up everything
+        cmd.changes = 0;
+        if (i == 0 || cmd.material != previous.material)
+            cmd.changes |= DrawCommand::ChangeMaterial;
+        if (i == 0 || cmd.meshId != previous.meshId)
+            cmd.changes |= DrawCommand::ChangeMesh;
+
+        stats.materialChanges += (cmd.changes & DrawCommand::ChangeMaterial) ? 1 : 0;
+        stats.meshChanges += (cmd.changes & DrawCommand::ChangeMesh) ? 1 : 0;
+        ++stats.draws;
+
+        drawList.push_back(cmd);
+        previous = cmd;
+    }
+}
+
+void RenderQueue::CullClusters(const Scene& scene, const Frustum& frustum, const m3d::math::Vector3& eye, bool cullBackfaces)
+{
+    clusterRanges.clear();
+    for (DrawCommand& draw : drawList) {
+        if (draw.instanceCount != 1)
+            continue;
+        const Mesh& mesh = scene.meshes[draw.meshId];
+        const Mesh::Slice& slice = mesh.GetSlices(draw.lod)[draw.slice];
+        if (slice.meshletCount == 0)
+            continue;
+
+        const m3d::math::Matrix4x4 world = GetWorldMatrix(GetItemTransform(scene, items[draw.firstInstance]));
+        const size_t firstRange = clusterRanges.size();
+        const uint32_t visible = CullMeshlets(&mesh.meshlets[slice.firstMeshlet], slice.meshletCount, world, frustum, eye,
+            cullBackfaces, clusterRanges);
+        stats.clustersCulled += slice.meshletCount - visible;
+
+        if (visible == slice.meshletCount) {
+            // one draw of the whole slice is cheaper
+            clusterRanges.resize(firstRange);
+        } else if (visible == 0) {
+            draw.instanceCount = 0;
+        } else {
+            draw.firstRange = static_cast<uint32_t>(firstRange);
+            draw.rangeCount = static_cast<uint32_t>(clusterRanges.size() - firstRange);
+        }
+    }
+}
+} // End of namespace m3d
@@ -9,6 +9,7 @@
 #include "File.hpp"
 #include "Matrix.h"
 #include "Pipeline.hpp"
+#include "RenderQueue.hpp"
 #include "Scene.hpp"
 #include "VulkanHelper.hpp"
 #include "VulkanSwapchain.hpp"
@@ -16,10 +17,14 @@
 #include "vulkanTextureLoader.hpp"
 
 #include <chrono>
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 #define VERTEX_BUFFER_BIND_ID 0
 namespace m3d {
+// frames between two memory budget checks
+static const uint32_t MemoryBudgetInterval = 60;
 
 // Win32 : Sets up a console window and redirects standard output to it
 void RendererVulkan::CreateConsole(const char* title)
@@ -290,19 +295,33 @@ void RendererVulkan::CreateFences()
     }
 }
 
-void RendererVulkan::Init(Scene* scene)
+void RendererVulkan::Init(Scene* pScene)
 {
+    scene = pScene;
+
 	CreateInstance();
 	CreateDevice();
 
     CreateSwapChain();
 
     commandBuffer = new CommandBuffer(device, physicalDevice, queue, swapChain);
-    commandBuffer->CreateVertices(scene->meshes[0].vertices, scene->meshes[0].indices);
+    commandBuffer->CreateSceneBuffers(*scene, vertexFormat, budgetLevels.lodBias);
+
+    pipeLine = new Pipeline(device, physicalDevice, vertexFormat);
 
-    pipeLine = new Pipeline(device, physicalDevice);
+    spatialGrid.Init(16.0f, static_cast<uint32_t>(scene->instances.capacity()));
+    BuildSpatialGrid(*scene, spatialGrid);
+    prefabGrid.Init(16.0f, static_cast<uint32_t>(scene->prefabInstances.capacity()));
+    BuildPrefabSpatialGrid(*scene, prefabGrid);
+    RebuildTransformOwners();
+    visibleInstances.reserve(scene->instances.capacity());
+    renderQueue.Reserve(scene->instances.capacity());
+    UpdateRenderQueue();
 
-    commandBuffer->Build(*pipeLine);
+    commandBuffer->Build(*pipeLine, *scene, renderQueue);
+    scene->dirtyTransforms.Clear();
+    scene->dirtyInstances.Clear();
+    scene->dirtyPrefabInstances.Clear();
 
     CreateFences();
     //OnWindowSizeChanged();
@@ -320,7 +339,8 @@ void RendererVulkan::OnWindowSizeChanged()
     // Recreate Command Buffer
     delete commandBuffer;
     commandBuffer = new CommandBuffer(device, physicalDevice, queue, swapChain);
-    commandBuffer->Build(*pipeLine);
+    commandBuffer->CreateSceneBuffers(*scene, vertexFormat, budgetLevels.lodBias);
+    commandBuffer->Build(*pipeLine, *scene, renderQueue);
 
     queue.waitIdle();
     device.waitIdle();
@@ -328,11 +348,194 @@ void RendererVulkan::OnWindowSizeChanged()
     inited = true;
 }
 
+/* Texture mips the budget evicts; the renderer does not upload diffuse maps yet, only the accounting follows */
+static void SetFirstMips(Scene& scene, uint32_t mipBias)
+{
+    for (auto c = scene.diffuseMaps.get_cursor(); c; ++c) {
+        const uint32_t mipLevels = c->texture.image ? c->texture.mipLevels : 1;
+        c->firstMip = std::min(mipBias, mipLevels - 1);
+    }
+}
+
+void RendererVulkan::OnSceneChanged()
+{
+    // the old buffers may still be read by frames in flight
+    device.waitIdle();
+    SetFirstMips(*scene, budgetLevels.textureMipBias);
+    commandBuffer->CreateSceneBuffers(*scene, vertexFormat, budgetLevels.lodBias);
+    BuildSpatialGrid(*scene, spatialGrid);
+    BuildPrefabSpatialGrid(*scene, prefabGrid);
+    RebuildTransformOwners();
+    // everything was rebuilt, CreateSceneBuffers also drops the cached world matrices
+    scene->dirtyTransforms.Clear();
+    scene->dirtyInstances.Clear();
+    scene->dirtyPrefabInstances.Clear();
+}
+
 void RendererVulkan::PrepareFrame()
 {
     swapChain.acquireNextImage(presentComplete, &currentImage);
 }
 
+/* Points every transform slot at the instance and the prefab placement it places */
+void RendererVulkan::RebuildTransformOwners()
+{
+    transformInstances.assign(scene->transforms.capacity(), InvalidOwner);
+    transformPrefabInstances.assign(scene->transforms.capacity(), InvalidOwner);
+    for (uint32_t instanceId : scene->instances) {
+        transformInstances[scene->instances[instanceId].transformId & 0xFFFF] = instanceId;
+    }
+    for (uint32_t prefabInstanceId : scene->prefabInstances) {
+        transformPrefabInstances[scene->prefabInstances[prefabInstanceId].transformId & 0xFFFF] = prefabInstanceId;
+    }
+}
+
+/*
+ * Brings a grid in line with what a freelist slot holds now: an erased
+ * object, or the old generation of a reused slot, leaves the grid before
+ * the live object is moved or inserted. Returns the live id, InvalidOwner
+ * when the slot is empty.
+ */
+template <class T, class BoundsFn>
+static uint32_t SyncGridSlot(SpatialGrid& grid, const packed_freelist<T>& objects, uint32_t slot, BoundsFn bounds)
+{
+    uint32_t gridId;
+    if (grid.ContainsSlot(slot, &gridId) && !objects.contains(gridId))
+        grid.Remove(gridId);
+    if (slot >= objects.capacity() || !objects.contains_slot(slot))
+        return RendererVulkan::InvalidOwner;
+
+    const uint32_t id = objects.id_of_slot(slot);
+    if (grid.Contains(id)) {
+        grid.Move(id, bounds(id));
+    } else {
+        grid.Insert(id, bounds(id));
+    }
+    return id;
+}
+
+/*
+ * Moves changed instances and prefab placements in their grids and
+ * refreshes their world matrices. Only dirty slots are visited, moved
+ * transforms find what they place through the transform owners.
+ */
+void RendererVulkan::UpdateSceneChanges()
+{
+    const Scene& s = *scene;
+    if (transformInstances.size() != s.transforms.capacity())
+        RebuildTransformOwners();
+
+    s.dirtyInstances.ForEach([&](uint32_t slot) {
+        const uint32_t id = SyncGridSlot(spatialGrid, s.instances, slot, [&s](uint32_t instanceId) { return GetInstanceBounds(s, instanceId); });
+        if (id != InvalidOwner)
+            transformInstances[s.instances[id].transformId & 0xFFFF] = id;
+    });
+    s.dirtyPrefabInstances.ForEach([&](uint32_t slot) {
+        const uint32_t id = SyncGridSlot(prefabGrid, s.prefabInstances, slot, [&s](uint32_t prefabInstanceId) { return GetPrefabInstanceBounds(s, prefabInstanceId); });
+        if (id != InvalidOwner)
+            transformPrefabInstances[s.prefabInstances[id].transformId & 0xFFFF] = id;
+    });
+    s.dirtyTransforms.ForEach([&](uint32_t slot) {
+        if (slot >= transformInstances.size())
+            return;
+        // owners are only trusted while they still place this slot, dirty ones were handled above
+        const uint32_t instanceId = transformInstances[slot];
+        if (instanceId != InvalidOwner && s.instances.contains(instanceId) && !s.dirtyInstances.IsDirty(instanceId)
+            && (s.instances[instanceId].transformId & 0xFFFF) == slot && spatialGrid.Contains(instanceId))
+            spatialGrid.Move(instanceId, GetInstanceBounds(s, instanceId));
+        const uint32_t prefabInstanceId = transformPrefabInstances[slot];
+        if (prefabInstanceId != InvalidOwner && s.prefabInstances.contains(prefabInstanceId) && !s.dirtyPrefabInstances.IsDirty(prefabInstanceId)
+            && (s.prefabInstances[prefabInstanceId].transformId & 0xFFFF) == slot && prefabGrid.Contains(prefabInstanceId))
+            prefabGrid.Move(prefabInstanceId, GetPrefabInstanceBounds(s, prefabInstanceId));
+    });
+
+    commandBuffer->UpdateTransforms(*scene);
+    scene->dirtyTransforms.Clear();
+    scene->dirtyInstances.Clear();
+    scene->dirtyPrefabInstances.Clear();
+}
+
+void RendererVulkan::ReportMemory(MemoryReport& report) const
+{
+    ReportSceneMemory(*scene, report);
+    commandBuffer->ReportMemory(*scene, report);
+}
+
+/* One step of the memory budget, see UpdateBudgetLevels */
+void RendererVulkan::EnforceMemoryBudget()
+{
+    const BudgetLevels previous = budgetLevels;
+    if (!memoryBudget.meshGpuBytes && !memoryBudget.textureGpuBytes && !previous.lodBias && !previous.textureMipBias)
+        return;
+
+    MemoryReport report;
+    ReportMemory(report);
+    if (!UpdateBudgetLevels(memoryBudget, report, budgetLevels))
+        return;
+
+    printf("memory budget: mesh %.1f MiB, texture %.1f MiB, lod bias %u, texture mip bias %u\n",
+        report.GetCategory(MemoryMeshes).gpuBytes / (1024.0 * 1024.0), report.GetCategory(MemoryTextures).gpuBytes / (1024.0 * 1024.0),
+        budgetLevels.lodBias, budgetLevels.textureMipBias);
+    if (budgetLevels.lodBias != previous.lodBias) {
+        // the old buffers may still be read by frames in flight
+        device.waitIdle();
+        commandBuffer->CreateSceneBuffers(*scene, vertexFormat, budgetLevels.lodBias);
+    }
+    if (budgetLevels.textureMipBias != previous.textureMipBias) {
+        SetFirstMips(*scene, budgetLevels.textureMipBias);
+    }
+}
+
+/* Culls the instances and prefab placements against the main camera and rebuilds the sorted draw list */
+void RendererVulkan::UpdateRenderQueue()
+{
+    Camera camera;
+    if (scene->cameras.contains(scene->mainCameraID)) {
+        camera = scene->cameras[scene->mainCameraID];
+    } else {
+        // matches the fixed view and projection set up by Pipeline
+        camera.eye = m3d::math::Vector3(0.0f, 0.0f, 100.0f);
+        camera.target = m3d::math::Vector3(0.0f, 0.0f, 0.0f);
+        camera.up = m3d::math::Vector3(0.0f, 1.0f, 0.0f);
+        camera.fovY = 60.0f;
+        camera.aspect = 1.0f;
+        camera.nearZ = 0.1f;
+        camera.farZ = 256.0f;
+    }
+
+    const Frustum frustum = GetCameraFrustum(camera);
+    visibleInstances.clear();
+    spatialGrid.QueryFrustumCached(frustum, frustumCache, [this](uint32_t instanceId, const AABB&, Containment) {
+        visibleInstances.push_back(instanceId);
+    });
+    insidePrefabInstances.clear();
+    crossingPrefabInstances.clear();
+    prefabGrid.QueryFrustumCached(frustum, prefabFrustumCache, [this](uint32_t prefabInstanceId, const AABB&, Containment containment) {
+        if (containment == Containment::Inside) {
+            insidePrefabInstances.push_back(prefabInstanceId);
+        } else {
+            crossingPrefabInstances.push_back(prefabInstanceId);
+        }
+    });
+
+    // levels of detail may stray from the full mesh by one pixel
+    LodSelection lodSelection;
+    lodSelection.projectionScale = height / (2.0f * std::tan(camera.fovY * 0.5f * m3d::math::PI_F / 180.0f));
+    lodSelection.maxPixelError = 1.0f;
+    // the finer levels are not uploaded while the mesh budget is exceeded
+    lodSelection.firstLod = budgetLevels.lodBias;
+    renderQueue.SetLodSelection(lodSelection);
+
+    renderQueue.Clear();
+    renderQueue.PushInstances(*scene, visibleInstances.data(), visibleInstances.size(), camera.eye, camera.farZ);
+    renderQueue.PushPrefabInstances(*scene, insidePrefabInstances.data(), insidePrefabInstances.size(), camera.eye, camera.farZ, nullptr);
+    renderQueue.PushPrefabInstances(*scene, crossingPrefabInstances.data(), crossingPrefabInstances.size(), camera.eye, camera.farZ, &frustum);
+    renderQueue.Sort();
+    renderQueue.BuildDrawList();
+    // the pipeline draws both sides, backfacing meshlets of open or thin meshes are visible
+    renderQueue.CullClusters(*scene, frustum, camera.eye, false);
+}
+
 void RendererVulkan::SubmitFrame()
 {
 	submitInfo.commandBufferCount = 1;
@@ -351,13 +554,26 @@ void RendererVulkan::Draw()
     device.waitForFences(1, &waitFences[currentImage], true, UINT64_MAX);
     device.resetFences(1, &waitFences[currentImage]);
 
+    if (++framesSinceBudgetCheck >= MemoryBudgetInterval) {
+        framesSinceBudgetCheck = 0;
+        EnforceMemoryBudget();
+    }
+    // the fence guarantees this image's command buffer is no longer executing
+    UpdateSceneChanges();
+    UpdateRenderQueue();
+    commandBuffer->UpdateInstances(currentImage, *scene, renderQueue);
+    commandBuffer->Record(currentImage, *pipeLine, *scene, renderQueue);
+
     SubmitFrame();
 }
 
-void RendererVulkan::DrawLoop()
+void RendererVulkan::DrawLoop(const std::function<void()>& beforeFrame)
 {
     while (1) {
         auto tStart = std::chrono::high_resolution_clock::now();
+        if (beforeFrame) {
+            beforeFrame();
+        }
         Draw();
         frameCounter++;
 
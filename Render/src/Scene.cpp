@@ -6,181 +6,32 @@
 
 #include "Scene.hpp"
 #include "File.hpp"
+#include "Hash.hpp"
+#include "Visibility.hpp"
+
+#include <cassert>
+#include <cstring>
 
 #include "../../data/schema/scene_generated.h"
 #include "flatbuffers/idl.h"
 #include "flatbuffers/util.h"
 
-#include <fbxsdk.h>
-
 using namespace m3d::schema;
 
-#define TRIANGLE_VERTEX_COUNT 3
-#define VERTEX_STRIDE 4
-#define NORMAL_STRIDE 3
-#define UV_STRIDE 2
-
 namespace m3d {
-bool Mesh::init(FbxMesh* pFbxMesh)
+Scene::Scene()
+    : mainCameraID(0)
 {
-    uint32_t normalCount = pFbxMesh->GetElementNormalCount();
-    uint32_t uvCount = pFbxMesh->GetElementUVCount();
-    FbxGeometryElement::EMappingMode normalMappingMode = normalCount ? pFbxMesh->GetElementNormal(0)->GetMappingMode()
-                                                                     : FbxGeometryElement::eNone;
-    FbxGeometryElement::EMappingMode uvMappingModel = uvCount ? pFbxMesh->GetElementUV(0)->GetMappingMode()
-                                                              : FbxGeometryElement::eNone;
-
-    bool hasNormal = normalMappingMode != FbxGeometryElement::eNone;
-    bool hasUV = uvMappingModel != FbxGeometryElement::eNone;
-
-    bool byControlPoint = hasNormal && normalMappingMode == FbxGeometryElement::eByControlPoint && hasUV && uvMappingModel == FbxGeometryElement::eByControlPoint;
-
-    uint32_t polygonCount = pFbxMesh->GetPolygonCount();
-    uint32_t controlPointCount = byControlPoint
-        ? pFbxMesh->GetControlPointsCount()
-        : polygonCount * TRIANGLE_VERTEX_COUNT;
-
-    this->vertices.resize(controlPointCount * VERTEX_STRIDE);
-    this->indices.resize(polygonCount * TRIANGLE_VERTEX_COUNT);
-    if (hasNormal)
-        this->normals.resize(controlPointCount * NORMAL_STRIDE);
-
-    FbxStringList uvNames;
-    pFbxMesh->GetUVSetNames(uvNames);
-    const char* pUVName = nullptr;
-    if (hasUV) {
-        this->uvs.resize(controlPointCount * UV_STRIDE);
-        pUVName = uvNames[0];
-    }
-
-    /* Vertex Attributes */
-    const FbxVector4* pControlPoints = pFbxMesh->GetControlPoints();
-    FbxVector4 currentVertex;
-    FbxVector4 currentNormal;
-    FbxVector2 currentUV;
-    if (byControlPoint) {
-        const FbxGeometryElementNormal* pNormalElement = nullptr;
-        const FbxGeometryElementUV* pUVElement = nullptr;
-        if (hasNormal)
-            pNormalElement = pFbxMesh->GetElementNormal(0);
-        if (hasUV)
-            pUVElement = pFbxMesh->GetElementUV(0);
-
-        for (uint32_t i = 0; i < controlPointCount; ++i) {
-            currentVertex = pControlPoints[i];
-            this->vertices[i * VERTEX_STRIDE] = static_cast<float>(currentVertex[0]);
-            this->vertices[i * VERTEX_STRIDE + 1] = static_cast<float>(currentVertex[1]);
-            this->vertices[i * VERTEX_STRIDE + 2] = static_cast<float>(currentVertex[2]);
-            this->vertices[i * VERTEX_STRIDE + 3] = 1.0f;
-
-            if (hasNormal) {
-                int normalIndex = i;
-                if (pNormalElement->GetReferenceMode() == FbxLayerElement::eIndexToDirect) {
-                    normalIndex = pNormalElement->GetIndexArray().GetAt(i);
-                }
-                currentNormal = pNormalElement->GetDirectArray().GetAt(normalIndex);
-                this->normals[i * NORMAL_STRIDE] = static_cast<float>(currentNormal[0]);
-                this->normals[i * NORMAL_STRIDE + 1] = static_cast<float>(currentNormal[1]);
-                this->normals[i * NORMAL_STRIDE + 2] = static_cast<float>(currentNormal[2]);
-            }
-
-            if (hasUV) {
-                int uvIndex = i;
-                if (pUVElement->GetReferenceMode() == FbxLayerElement::eIndexToDirect) {
-                    uvIndex = pUVElement->GetIndexArray().GetAt(i);
-                }
-                currentUV = pUVElement->GetDirectArray().GetAt(uvIndex);
-                this->uvs[i * UV_STRIDE] = static_cast<float>(currentUV[0]);
-                this->uvs[i * UV_STRIDE + 1] = static_cast<float>(currentUV[1]);
-            }
-        }
-    } // end of byControlPoint
-
-    /* Slice the mesh according to materials */
-    FbxLayerElementArrayTemplate<int>* pMaterialIndices = nullptr;
-    FbxGeometryElement::EMappingMode materialMappingMode = FbxGeometryElement::eNone;
-    if (pFbxMesh->GetElementMaterial()) {
-        pMaterialIndices = &pFbxMesh->GetElementMaterial()->GetIndexArray();
-        materialMappingMode = pFbxMesh->GetElementMaterial()->GetMappingMode();
-        if (pMaterialIndices && materialMappingMode == FbxGeometryElement::eByPolygon) {
-            FBX_ASSERT(pMaterialIndices->GetCount() == polygonCount);
-            for (uint32_t i = 0; i < polygonCount; ++i) {
-                const uint32_t materialIndex = pMaterialIndices->GetAt(i);
-                if (materialIndex >= slices.size()) // we meet a new material
-                {
-                    slices.emplace_back(0, 0);
-                }
-                slices[materialIndex].triangleCount += 1;
-            }
-
-            int offset = 0;
-            for (uint32_t i = 0; i < slices.size(); ++i) {
-                slices[i].indexOffset = offset;
-                offset += slices[i].triangleCount * 3;
-                // this will be reused during per-Polygon processing
-                slices[i].triangleCount = 0;
-            }
-            FBX_ASSERT(offset == polygonCount * 3);
-        }
-    }
-
-    // There is only one material.
-    if (slices.size() == 0) {
-        slices.emplace_back(0, 0);
-    }
-
-    /* Indices */
-    for (uint32_t vertexCount = 0, i = 0; i < polygonCount; ++i) {
-        int materialIndex = 0;
-        if (pMaterialIndices && materialMappingMode == FbxGeometryElement::eByPolygon) {
-            materialIndex = pMaterialIndices->GetAt(i);
-        }
-        const int indexOffset = slices[materialIndex].indexOffset + slices[materialIndex].triangleCount * 3;
-        for (int v = 0; v < TRIANGLE_VERTEX_COUNT; ++v) {
-            const int controlPointIndex = pFbxMesh->GetPolygonVertex(i, v);
-
-            if (byControlPoint) {
-                this->indices[indexOffset + v] = static_cast<unsigned int>(controlPointIndex);
-            } else {
-                this->indices[indexOffset + v] = static_cast<unsigned int>(vertexCount);
-
-                currentVertex = pControlPoints[controlPointIndex];
-                this->vertices[vertexCount * VERTEX_STRIDE] = static_cast<float>(currentVertex[0]);
-                this->vertices[vertexCount * VERTEX_STRIDE + 1] = static_cast<float>(currentVertex[1]);
-                this->vertices[vertexCount * VERTEX_STRIDE + 2] = static_cast<float>(currentVertex[2]);
-                this->vertices[vertexCount * VERTEX_STRIDE + 3] = 1.0f;
-
-                if (hasNormal) {
-                    pFbxMesh->GetPolygonVertexNormal(i, v, currentNormal);
-                    this->normals[vertexCount * NORMAL_STRIDE] = static_cast<float>(currentNormal[0]);
-                    this->normals[vertexCount * NORMAL_STRIDE + 1] = static_cast<float>(currentNormal[1]);
-                    this->normals[vertexCount * NORMAL_STRIDE + 2] = static_cast<float>(currentNormal[2]);
-                }
-
-                if (hasUV) {
-                    bool bUnmappedUV;
-                    pFbxMesh->GetPolygonVertexUV(i, v, pUVName, currentUV, bUnmappedUV);
-                    this->uvs[vertexCount * UV_STRIDE] = static_cast<float>(currentUV[0]);
-                    this->uvs[vertexCount * UV_STRIDE] = static_cast<float>(currentUV[1]);
-                }
-            }
-            ++vertexCount;
-        }
-        slices[materialIndex].triangleCount += 1;
-    }
-
-    return true;
 }
 
-Scene::Scene() {}
-
 void Scene::Init()
 {
-    std::vector<uint8_t> sceneData;
-    m3d::file::readBinary("D:\\workspace\\m3d\\data\\schema\\scene_data.bin", sceneData);
-    auto mainScene = GetSScene(sceneData.data());
-    loadPath = mainScene->models()->Get(0)->name()->str();
-    printf("fbx path: %s", loadPath.c_str());
+    m3d::file::MappedFile sceneData;
+    if (sceneData.Open("D:\\workspace\\m3d\\data\\schema\\scene_data.bin")) {
+        auto mainScene = GetSScene(sceneData.Data());
+        loadPath = mainScene->models()->Get(0)->name()->str();
+        printf("fbx path: %s", loadPath.c_str());
+    }
 
     diffuseMaps = packed_freelist<DiffuseMap>(512);
     materials = packed_freelist<Material>(512);
@@ -188,135 +39,166 @@ void Scene::Init()
     transforms = packed_freelist<Transform>(4096);
     instances = packed_freelist<Instance>(4096);
     cameras = packed_freelist<Camera>(32);
+    prefabs = packed_freelist<Prefab>(512);
+    prefabInstances = packed_freelist<PrefabInstance>(4096);
 }
 
-void LoadMeshes(FbxNode* pFbxNode, packed_freelist<Mesh>& sceneMeshes)
+uint64_t HashTextureContent(const DiffuseMap& diffuseMap)
 {
-    // Material
-    const uint32_t materialCount = pFbxNode->GetMaterialCount();
-    for (uint32_t i = 0; i < materialCount; ++i) {
-        FbxSurfaceMaterial* pFbxMaterial = pFbxNode->GetMaterial(i);
-        if (pFbxMaterial && !pFbxMaterial->GetUserDataPtr()) {
-            FbxAutoPtr<Material> pMaterial(new Material);
-            if (pMaterial->init(pFbxMaterial)) {
-                pFbxMaterial->SetUserDataPtr(pMaterial.Release());
-            }
-        }
+    m3d::file::MappedFile file;
+    if (file.Open(diffuseMap.path.c_str(), m3d::file::Access::Sequential)) {
+        // the size goes in too, files differ in length more often than in content
+        const uint64_t size = file.Size();
+        return HashBytes(file.Data(), file.Size(), HashBytes(&size, sizeof(size)));
     }
+    return HashBytes(diffuseMap.path.data(), diffuseMap.path.size());
+}
 
-    FbxNodeAttribute* nodeAttribute = pFbxNode->GetNodeAttribute();
-    if (nodeAttribute) {
-        // Mesh
-        if (nodeAttribute->GetAttributeType() == FbxNodeAttribute::eMesh) {
-            FbxMesh* pFbxMesh = pFbxNode->GetMesh();
-            if (pFbxMesh && !pFbxMesh->GetUserDataPtr()) {
-                Mesh mesh;
-                if (mesh.init(pFbxMesh)) {
-                    sceneMeshes.insert(mesh);
-                }
-                // TODO:
-                FbxAutoPtr<Mesh> pMesh(new Mesh);
-                if (pMesh->init(pFbxMesh)) {
-                    pFbxMesh->SetUserDataPtr(pMesh.Release());
-                }
-            }
-        }
-        // Light
-        else if (nodeAttribute->GetAttributeType() == FbxNodeAttribute::eLight) {
-            FbxLight* pFbxLight = pFbxNode->GetLight();
-            if (pFbxLight && !pFbxLight->GetUserDataPtr()) {
-                FbxAutoPtr<Light> pLight(new Light);
-                if (pLight->init(pFbxLight)) {
-                    pFbxLight->SetUserDataPtr(pLight.Release());
-                }
-            }
-        }
+/* Everything but the name, diffuseMapId already a scene id */
+static uint64_t HashMaterial(const Material& material)
+{
+    uint64_t hash = HashBytes(material.ambient, sizeof(material.ambient));
+    hash = HashBytes(material.diffuse, sizeof(material.diffuse), hash);
+    hash = HashBytes(material.specular, sizeof(material.specular), hash);
+    hash = HashBytes(&material.shininess, sizeof(material.shininess), hash);
+    return HashBytes(&material.diffuseMapId, sizeof(material.diffuseMapId), hash);
+}
+
+static bool SameMaterial(const Material& a, const Material& b)
+{
+    return memcmp(a.ambient, b.ambient, sizeof(a.ambient)) == 0 && memcmp(a.diffuse, b.diffuse, sizeof(a.diffuse)) == 0
+        && memcmp(a.specular, b.specular, sizeof(a.specular)) == 0 && a.shininess == b.shininess
+        && a.diffuseMapId == b.diffuseMapId;
+}
+
+static uint64_t HashSlices(const std::vector<Mesh::Slice>& slices, uint64_t hash)
+{
+    for (const Mesh::Slice& slice : slices) {
+        const uint32_t fields[] = { static_cast<uint32_t>(slice.indexOffset), static_cast<uint32_t>(slice.triangleCount),
+            slice.baseVertex, slice.material };
+        hash = HashBytes(fields, sizeof(fields), hash);
     }
+    return hash;
+}
 
-    const int childCount = pFbxNode->GetChildCount();
-    for (int i = 0; i < childCount; ++i) {
-        LoadMeshes(pFbxNode->GetChild(i), sceneMeshes);
+static bool SameSlices(const std::vector<Mesh::Slice>& a, const std::vector<Mesh::Slice>& b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].indexOffset != b[i].indexOffset || a[i].triangleCount != b[i].triangleCount
+            || a[i].baseVertex != b[i].baseVertex || a[i].material != b[i].material)
+            return false;
     }
+    return true;
 }
 
-void LoadMeshes(Scene* pScene, std::vector<uint32_t>* loadedMeshIDs)
+/*
+ * Geometry and slices; meshlets and levels of detail are built from these, so
+ * they match when these do. AddMesh adds the scene material ids.
+ */
+uint64_t HashMeshGeometry(const Mesh& mesh)
 {
-    FbxManager* fbxManager = FbxManager::Create();
-
-    FbxIOSettings* pFbxIOSettings = FbxIOSettings::Create(fbxManager, IOSROOT);
-    fbxManager->SetIOSettings(pFbxIOSettings);
-
-    (*(fbxManager->GetIOSettings())).SetBoolProp(IMP_FBX_MATERIAL, true);
-    (*(fbxManager->GetIOSettings())).SetBoolProp(IMP_FBX_TEXTURE, true);
-    (*(fbxManager->GetIOSettings())).SetBoolProp(IMP_FBX_LINK, false);
-    (*(fbxManager->GetIOSettings())).SetBoolProp(IMP_FBX_SHAPE, false);
-    (*(fbxManager->GetIOSettings())).SetBoolProp(IMP_FBX_GOBO, false);
-    (*(fbxManager->GetIOSettings())).SetBoolProp(IMP_FBX_ANIMATION, true);
-    (*(fbxManager->GetIOSettings())).SetBoolProp(IMP_FBX_GLOBAL_SETTINGS, true);
-
-    bool bEmbedMedia = true;
-    (*(fbxManager->GetIOSettings())).SetBoolProp(EXP_FBX_MATERIAL, true);
-    (*(fbxManager->GetIOSettings())).SetBoolProp(EXP_FBX_TEXTURE, true);
-    (*(fbxManager->GetIOSettings())).SetBoolProp(EXP_FBX_EMBEDDED, bEmbedMedia);
-    (*(fbxManager->GetIOSettings())).SetBoolProp(EXP_FBX_SHAPE, true);
-    (*(fbxManager->GetIOSettings())).SetBoolProp(EXP_FBX_GOBO, true);
-    (*(fbxManager->GetIOSettings())).SetBoolProp(EXP_FBX_ANIMATION, true);
-    (*(fbxManager->GetIOSettings())).SetBoolProp(EXP_FBX_GLOBAL_SETTINGS, true);
-
-    FbxImporter* pFbxImporter = FbxImporter::Create(fbxManager, "");
-
-    // Initialize the importer.
-    bool result = pFbxImporter->Initialize(pScene->loadPath.c_str(), -1, fbxManager->GetIOSettings());
-    if (!result) {
-        printf("Get error when init FBX Importer: %s\n\n",
-            pFbxImporter->GetStatus().GetErrorString());
-        exit(-1);
+    uint64_t hash = HashArray(mesh.vertices);
+    hash = HashArray(mesh.normals, hash);
+    hash = HashArray(mesh.uvs, hash);
+    hash = HashArray(mesh.tangents, hash);
+    hash = HashArray(mesh.indices, hash);
+    hash = HashSlices(mesh.slices, hash);
+    for (const Mesh::Lod& lod : mesh.lods) {
+        hash = HashSlices(lod.slices, hash);
     }
+    return hash;
+}
 
-    // fbx version number
-    int major, minor, revision;
-    pFbxImporter->GetFileVersion(major, minor, revision);
-
-    // import pFbxScene
-    FbxScene* pFbxScene = FbxScene::Create(fbxManager, "myScene");
-    pFbxImporter->Import(pFbxScene);
-    pFbxImporter->Destroy();
-    pFbxImporter = nullptr;
-
-    // check axis system
-    FbxAxisSystem axisSystem = pFbxScene->GetGlobalSettings().GetAxisSystem();
-    FbxAxisSystem vulkanAxisSystem(FbxAxisSystem::eYAxis,
-        FbxAxisSystem::eParityOdd,
-        FbxAxisSystem::eRightHanded);
-    if (axisSystem != vulkanAxisSystem) {
-        axisSystem.ConvertScene(pFbxScene);
+static bool SameMesh(const Mesh& a, const Mesh& b)
+{
+    if (a.vertices != b.vertices || a.normals != b.normals || a.uvs != b.uvs || a.tangents != b.tangents
+        || a.indices != b.indices || a.materialIds != b.materialIds || !SameSlices(a.slices, b.slices)
+        || a.lods.size() != b.lods.size())
+        return false;
+    for (size_t i = 0; i < a.lods.size(); ++i) {
+        if (!SameSlices(a.lods[i].slices, b.lods[i].slices))
+            return false;
     }
+    return true;
+}
 
-    // check unit system
-    FbxSystemUnit systemUnit = pFbxScene->GetGlobalSettings().GetSystemUnit();
-    if (systemUnit.GetScaleFactor() != 1.0) {
-        FbxSystemUnit::cm.ConvertScene(pFbxScene);
+/* Scene id of an earlier insert with the same hash and content, ImportNone for none */
+template <class T, class Same>
+static uint32_t FindDuplicate(const std::unordered_multimap<uint64_t, uint32_t>& hashes, uint64_t hash,
+    const packed_freelist<T>& objects, const T& object, Same same)
+{
+    auto range = hashes.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (objects.contains(it->second) && same(objects[it->second], object))
+            return it->second;
     }
+    return ImportNone;
+}
 
-    // Triangulate Mesh
-    FbxGeometryConverter fbxGeometryConverter(fbxManager);
-    fbxGeometryConverter.Triangulate(pFbxScene, true);
+void ImportIds::AddTexture(Scene& scene, DiffuseMap&& diffuseMap)
+{
+    const uint64_t contentHash = HashTextureContent(diffuseMap);
+    AddTexture(scene, std::move(diffuseMap), contentHash);
+}
 
-    // Load Texture
-    int textureCount = pFbxScene->GetTextureCount();
-    for (int i = 0; i < textureCount; ++i) {
-        FbxTexture* pFbxTexture = pFbxScene->GetTexture(i);
-        FbxFileTexture* pFbxFileTexture = FbxCast<FbxFileTexture>(pFbxTexture);
-        if (pFbxTexture && pFbxFileTexture->GetUserDataPtr()) {
-        }
+void ImportIds::AddTexture(Scene& scene, DiffuseMap&& diffuseMap, uint64_t contentHash)
+{
+    // the hash covers the whole file, comparing would read both files again
+    const auto sameHash = [](const DiffuseMap&, const DiffuseMap&) { return true; };
+    uint32_t id = FindDuplicate(textureHashes, contentHash, scene.diffuseMaps, diffuseMap, sameHash);
+    if (id != ImportNone) {
+        ++duplicateTextures;
+    } else {
+        id = scene.diffuseMaps.insert(std::move(diffuseMap));
+        textureHashes.insert(std::make_pair(contentHash, id));
     }
-    LoadMeshes(pFbxScene->GetRootNode(), pScene->meshes);
+    textureIds.push_back(id);
+}
+
+void ImportIds::AddMaterial(Scene& scene, Material&& material)
+{
+    material.diffuseMapId = material.diffuseMapId < textureIds.size() ? textureIds[material.diffuseMapId] : 0;
+    const uint64_t hash = HashMaterial(material);
+    uint32_t id = FindDuplicate(materialHashes, hash, scene.materials, material, SameMaterial);
+    if (id != ImportNone) {
+        ++duplicateMaterials;
+    } else {
+        id = scene.materials.insert(std::move(material));
+        materialHashes.insert(std::make_pair(hash, id));
+    }
+    materialIds.push_back(id);
+}
+
+uint32_t ImportIds::AddMesh(Scene& scene, Mesh&& mesh)
+{
+    const uint64_t geometryHash = HashMeshGeometry(mesh);
+    return AddMesh(scene, std::move(mesh), geometryHash);
+}
+
+uint32_t ImportIds::AddMesh(Scene& scene, Mesh&& mesh, uint64_t geometryHash)
+{
+    for (uint32_t& materialId : mesh.materialIds) {
+        materialId = materialId < materialIds.size() ? materialIds[materialId] : 0;
+    }
+    const uint64_t hash = HashArray(mesh.materialIds, geometryHash);
+    uint32_t id = FindDuplicate(meshHashes, hash, scene.meshes, mesh, SameMesh);
+    if (id != ImportNone) {
+        ++duplicateMeshes;
+        return id;
+    }
+    id = scene.meshes.insert(std::move(mesh));
+    meshHashes.insert(std::make_pair(hash, id));
+    return id;
 }
 
 void AddInstance(Scene& pFbxScene, uint32_t meshID, uint32_t* newInstanceID)
 {
     Transform newTransform;
+    newTransform.position = m3d::math::Vector3(0.0f, 0.0f, 0.0f);
     newTransform.scale = m3d::math::Vector3(1.0f, 1.0f, 1.0f);
+    newTransform.rotation = m3d::math::Quaternion(0.0f, 0.0f, 0.0f, 1.0f);
 
     uint32_t newTransformID = pFbxScene.transforms.insert(newTransform);
 
@@ -325,8 +207,193 @@ void AddInstance(Scene& pFbxScene, uint32_t meshID, uint32_t* newInstanceID)
     newInstance.transformId = newTransformID;
 
     uint32_t tmpNewInstanceID = pFbxScene.instances.insert(newInstance);
+    pFbxScene.dirtyTransforms.Mark(newTransformID);
+    pFbxScene.dirtyInstances.Mark(tmpNewInstanceID);
     if (newInstanceID) {
         *newInstanceID = tmpNewInstanceID;
     }
 }
+
+uint32_t AddPrefab(Scene& scene, Prefab&& prefab)
+{
+    // the part index is kept in 16 bits next to the transform slot, see RenderItem::prefabPart
+    assert(prefab.parts.size() < 0xFFFF);
+    prefab.bounds = AABB::Empty();
+    for (const Prefab::Part& part : prefab.parts) {
+        const Mesh& mesh = scene.meshes[part.meshId];
+        prefab.bounds.Expand(TransformAABB(mesh.bounds, part.local.position, part.local.rotation, part.local.scale));
+    }
+    return scene.prefabs.insert(std::move(prefab));
+}
+
+void AddPrefabInstance(Scene& scene, uint32_t prefabID, const Transform& transform, uint32_t* newPrefabInstanceID)
+{
+    PrefabInstance placement;
+    placement.prefabId = prefabID;
+    placement.transformId = scene.transforms.insert(transform);
+
+    const uint32_t id = scene.prefabInstances.insert(placement);
+    scene.dirtyTransforms.Mark(placement.transformId);
+    scene.dirtyPrefabInstances.Mark(id);
+    if (newPrefabInstanceID) {
+        *newPrefabInstanceID = id;
+    }
+}
+
+void SetTransform(Scene& scene, uint32_t transformID, const Transform& transform)
+{
+    scene.transforms[transformID] = transform;
+    scene.dirtyTransforms.Mark(transformID);
+}
+
+AABB GetInstanceBounds(const Scene& scene, uint32_t instanceID)
+{
+    const Instance& instance = scene.instances[instanceID];
+    const Transform& transform = scene.transforms[instance.transformId];
+    const Mesh& mesh = scene.meshes[instance.meshId];
+    return TransformAABB(mesh.bounds, transform.position, transform.rotation, transform.scale);
+}
+
+AABB GetPrefabInstanceBounds(const Scene& scene, uint32_t prefabInstanceID)
+{
+    const PrefabInstance& placement = scene.prefabInstances[prefabInstanceID];
+    const Transform& transform = scene.transforms[placement.transformId];
+    const Prefab& prefab = scene.prefabs[placement.prefabId];
+    return TransformAABB(prefab.bounds, transform.position, transform.rotation, transform.scale);
+}
+
+void BuildSpatialGrid(const Scene& scene, SpatialGrid& grid)
+{
+    grid.Clear();
+    // the bounds are computed in parallel, the grid itself is filled on this thread
+    std::vector<AABB> bounds(scene.instances.size());
+    scene.instances.parallel_for_each([&](const Instance* instances, const uint32_t*, size_t first, size_t count) {
+        AABB* out = bounds.data() + first;
+        for (size_t i = 0; i < count; ++i) {
+            const Transform& transform = scene.transforms[instances[i].transformId];
+            const Mesh& mesh = scene.meshes[instances[i].meshId];
+            out[i] = TransformAABB(mesh.bounds, transform.position, transform.rotation, transform.scale);
+        }
+    });
+    size_t item = 0;
+    for (uint32_t instanceId : scene.instances) {
+        grid.Insert(instanceId, bounds[item++]);
+    }
+}
+
+void BuildPrefabSpatialGrid(const Scene& scene, SpatialGrid& grid)
+{
+    grid.Clear();
+    for (uint32_t prefabInstanceId : scene.prefabInstances) {
+        grid.Insert(prefabInstanceId, GetPrefabInstanceBounds(scene, prefabInstanceId));
+    }
+}
+
+void CullInstances(const Scene& scene, const ViewSet& views, std::vector<uint32_t>& ids, std::vector<uint32_t>& masks)
+{
+    ids.resize(scene.instances.size());
+    masks.resize(scene.instances.size());
+    scene.instances.parallel_for_each([&](const Instance* instances, const uint32_t* instanceIds, size_t first, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            const Transform& transform = scene.transforms[instances[i].transformId];
+            const Mesh& mesh = scene.meshes[instances[i].meshId];
+            ids[first + i] = instanceIds[i];
+            masks[first + i] = views.Test(TransformAABB(mesh.bounds, transform.position, transform.rotation, transform.scale));
+        }
+    });
+}
+
+void CullPrefabInstances(const Scene& scene, const ViewSet& views, std::vector<uint32_t>& ids, std::vector<uint32_t>& masks)
+{
+    ids.resize(scene.prefabInstances.size());
+    masks.resize(scene.prefabInstances.size());
+    scene.prefabInstances.parallel_for_each([&](const PrefabInstance* placements, const uint32_t* placementIds, size_t first, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            const Transform& transform = scene.transforms[placements[i].transformId];
+            const Prefab& prefab = scene.prefabs[placements[i].prefabId];
+            ids[first + i] = placementIds[i];
+            masks[first + i] = views.Test(TransformAABB(prefab.bounds, transform.position, transform.rotation, transform.scale));
+        }
+    });
+}
+
+template <class T>
+static uint64_t HeapBytes(const std::vector<T>& v)
+{
+    return v.capacity() * sizeof(T);
+}
+
+static uint64_t HeapBytes(const Mesh& mesh)
+{
+    uint64_t bytes = mesh.name.capacity() + HeapBytes(mesh.slices) + HeapBytes(mesh.vertices) + HeapBytes(mesh.uvs)
+        + HeapBytes(mesh.normals) + HeapBytes(mesh.tangents) + HeapBytes(mesh.indices) + HeapBytes(mesh.meshlets)
+        + HeapBytes(mesh.lods) + HeapBytes(mesh.drawCommands) + HeapBytes(mesh.materialIds);
+    for (const Mesh::Lod& lod : mesh.lods) {
+        bytes += HeapBytes(lod.slices);
+    }
+    return bytes;
+}
+
+void ReportSceneMemory(const Scene& scene, MemoryReport& report)
+{
+    // the freelists' own storage, each object's heap data goes to its asset
+    report.Add(MemoryMeshes, scene.meshes.memory_bytes(), 0);
+    report.Add(MemoryTextures, scene.diffuseMaps.memory_bytes(), 0);
+    report.Add(MemoryMaterials, scene.materials.memory_bytes(), 0);
+    report.Add(MemorySceneGraph, scene.transforms.memory_bytes() + scene.instances.memory_bytes() + scene.cameras.memory_bytes()
+        + scene.prefabs.memory_bytes() + scene.prefabInstances.memory_bytes(), 0);
+    for (auto c = scene.prefabs.get_cursor(); c; ++c) {
+        report.Add(MemorySceneGraph, c->name.capacity() + HeapBytes(c->parts), 0);
+    }
+
+    for (auto c = scene.meshes.get_cursor(); c; ++c) {
+        report.AddAsset(MemoryMeshes, c.id(), c->name, HeapBytes(*c), 0);
+    }
+    for (auto c = scene.materials.get_cursor(); c; ++c) {
+        report.AddAsset(MemoryMaterials, c.id(), c->name, c->name.capacity(), 0);
+    }
+    for (auto c = scene.diffuseMaps.get_cursor(); c; ++c) {
+        const vkext::VulkanTexture& texture = c->texture;
+        const uint64_t gpuBytes = texture.image ? GetTextureBytes(texture.width, texture.height, texture.mipLevels, c->firstMip) : 0;
+        report.AddAsset(MemoryTextures, c.id(), c->path, c->path.capacity(), gpuBytes);
+    }
+    for (const m3d::file::MappedFile& file : scene.mappedFiles) {
+        report.Add(MemoryMappedFiles, file.Size(), 0);
+    }
+}
+
+Transform CombineTransforms(const Transform& parent, const Transform& local)
+{
+    Transform world;
+    world.position = parent.position + parent.rotation * (parent.scale * local.position);
+    world.rotation = parent.rotation * local.rotation;
+    world.scale = parent.scale * local.scale;
+    return world;
+}
+
+m3d::math::Matrix4x4 GetWorldMatrix(const Transform& transform)
+{
+    using m3d::math::Vector3;
+
+    const Vector3 axes[3] = {
+        transform.rotation * Vector3(transform.scale.x, 0.0f, 0.0f),
+        transform.rotation * Vector3(0.0f, transform.scale.y, 0.0f),
+        transform.rotation * Vector3(0.0f, 0.0f, transform.scale.z)
+    };
+    const float* position = &transform.position.x;
+
+    m3d::math::Matrix4x4 world;
+    for (int row = 0; row < 3; ++row) {
+        for (int col = 0; col < 3; ++col) {
+            world.m[row][col] = (&axes[col].x)[row];
+        }
+        world.m[row][3] = position[row];
+    }
+    return world;
+}
+
+Frustum GetCameraFrustum(const Camera& camera)
+{
+    return Frustum::FromPerspective(camera.eye, camera.target, camera.up, camera.fovY, camera.aspect, camera.nearZ, camera.farZ);
+}
 } // End of namespace m3d
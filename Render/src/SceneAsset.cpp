@@ -0,0 +1,439 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT)
+* (http://opensource.org/licenses/MIT)
+*/
+
+#include "SceneAsset.hpp"
+#include "File.hpp"
+#include "IndexCompression.hpp"
+#include "RenderQueue.hpp"
+#include "Scene.hpp"
+
+#include <algorithm>
+
+#include "../../data/schema/scene_generated.h"
+
+using namespace m3d::schema;
+
+namespace m3d {
+// force_align of the vertex attribute and index blobs in scene.fbs
+static const size_t BlobAlignment = 16;
+static const uint32_t InvalidIndex = 0xFFFFFFFF;
+
+/* CreateVector with the start of the data aligned to BlobAlignment in the finished buffer */
+template <class T>
+static flatbuffers::Offset<flatbuffers::Vector<T>> CreateAlignedVector(flatbuffers::FlatBufferBuilder& fbb, const T* data, size_t count)
+{
+    // raises the buffer alignment, the buffer is built back to front so the
+    // data end has to be aligned relative to the end of the buffer
+    fbb.Align(BlobAlignment);
+    fbb.StartVector(count, sizeof(T));
+    fbb.PreAlign(count * sizeof(T), BlobAlignment);
+    // little endian only, like the scalar fast path of CreateVector
+    fbb.PushBytes(reinterpret_cast<const uint8_t*>(data), count * sizeof(T));
+    return flatbuffers::Offset<flatbuffers::Vector<T>>(fbb.EndVector(count));
+}
+
+static SVector3 ToSVector3(const m3d::math::Vector3& v)
+{
+    return SVector3(v.x, v.y, v.z);
+}
+
+static m3d::math::Vector3 FromSVector3(const SVector3& v)
+{
+    return m3d::math::Vector3(v.x(), v.y(), v.z());
+}
+
+static SVector3 ToSVector3(const float* v)
+{
+    return SVector3(v[0], v[1], v[2]);
+}
+
+static SSlice ToSSlice(const Mesh::Slice& slice)
+{
+    return SSlice(slice.indexOffset, slice.triangleCount, slice.firstMeshlet, slice.meshletCount, slice.baseVertex, slice.material);
+}
+
+static Mesh::Slice FromSSlice(const SSlice* fileSlice)
+{
+    Mesh::Slice slice(fileSlice->index_offset(), fileSlice->triangle_count(), fileSlice->material());
+    slice.firstMeshlet = fileSlice->first_meshlet();
+    slice.meshletCount = fileSlice->meshlet_count();
+    slice.baseVertex = fileSlice->base_vertex();
+    return slice;
+}
+
+bool SaveSceneAsset(const Scene& scene, const char* path, bool compressIndices)
+{
+    flatbuffers::FlatBufferBuilder fbb(1 << 20);
+
+    // packed_freelist ids to dense file indices
+    std::vector<uint32_t> textureIndices(scene.diffuseMaps.capacity(), InvalidIndex);
+    std::vector<uint32_t> materialIndices(scene.materials.capacity(), InvalidIndex);
+    std::vector<uint32_t> meshIndices(scene.meshes.capacity(), InvalidIndex);
+
+    std::vector<flatbuffers::Offset<STexture>> textures;
+    for (uint32_t id : scene.diffuseMaps) {
+        textureIndices[id & 0xFFFF] = static_cast<uint32_t>(textures.size());
+        textures.push_back(CreateSTextureDirect(fbb, scene.diffuseMaps[id].path.c_str()));
+    }
+
+    std::vector<flatbuffers::Offset<SMaterial>> materials;
+    for (uint32_t id : scene.materials) {
+        const Material& material = scene.materials[id];
+        const SVector3 ambient = ToSVector3(material.ambient);
+        const SVector3 diffuse = ToSVector3(material.diffuse);
+        const SVector3 specular = ToSVector3(material.specular);
+        const int32_t diffuseTexture = scene.diffuseMaps.contains(material.diffuseMapId)
+            ? static_cast<int32_t>(textureIndices[material.diffuseMapId & 0xFFFF])
+            : -1;
+
+        materialIndices[id & 0xFFFF] = static_cast<uint32_t>(materials.size());
+        materials.push_back(CreateSMaterialDirect(fbb, material.name.c_str(), &ambient, &diffuse, &specular, material.shininess, diffuseTexture));
+    }
+
+    std::vector<flatbuffers::Offset<SMesh>> meshes;
+    std::vector<SSlice> slices;
+    std::vector<SMeshlet> meshlets;
+    std::vector<float> lodErrors;
+    std::vector<SSlice> lodSlices;
+    std::vector<uint32_t> lodSliceCounts;
+    std::vector<uint8_t> encodedIndices;
+    std::vector<uint32_t> meshMaterials;
+    for (uint32_t id : scene.meshes) {
+        const Mesh& mesh = scene.meshes[id];
+
+        slices.clear();
+        for (const Mesh::Slice& slice : mesh.slices) {
+            slices.push_back(ToSSlice(slice));
+        }
+        lodErrors.clear();
+        lodSlices.clear();
+        lodSliceCounts.clear();
+        for (const Mesh::Lod& lod : mesh.lods) {
+            lodErrors.push_back(lod.error);
+            lodSliceCounts.push_back(static_cast<uint32_t>(lod.slices.size()));
+            for (const Mesh::Slice& slice : lod.slices) {
+                lodSlices.push_back(ToSSlice(slice));
+            }
+        }
+        meshlets.clear();
+        for (const Meshlet& meshlet : mesh.meshlets) {
+            meshlets.push_back(SMeshlet(ToSVector3(meshlet.center), meshlet.radius, ToSVector3(meshlet.coneAxis), meshlet.coneCutoff,
+                meshlet.indexOffset, meshlet.triangleCount));
+        }
+        meshMaterials.clear();
+        for (uint32_t materialId : mesh.materialIds) {
+            meshMaterials.push_back(scene.materials.contains(materialId) ? materialIndices[materialId & 0xFFFF] : InvalidIndex);
+        }
+
+        const ArrayView<float> vertices = mesh.GetVertices();
+        const ArrayView<uint32_t> indices = mesh.GetIndices();
+        auto vertexBlob = CreateAlignedVector(fbb, vertices.data(), vertices.size());
+        // compressed indices are decoded at load, uncompressed ones are used in place
+        flatbuffers::Offset<flatbuffers::Vector<uint32_t>> indexBlob;
+        flatbuffers::Offset<flatbuffers::Vector<uint8_t>> encodedIndexVector;
+        if (compressIndices) {
+            EncodeIndexBuffer(indices.data(), indices.size(), encodedIndices);
+            encodedIndexVector = fbb.CreateVector(encodedIndices);
+        } else {
+            indexBlob = CreateAlignedVector(fbb, indices.data(), indices.size());
+        }
+        // optional attributes are left out rather than stored empty
+        const ArrayView<float> normals = mesh.GetNormals();
+        const ArrayView<float> uvs = mesh.GetUVs();
+        const ArrayView<float> tangents = mesh.GetTangents();
+        flatbuffers::Offset<flatbuffers::Vector<float>> normalBlob, uvBlob, tangentBlob;
+        if (!normals.empty())
+            normalBlob = CreateAlignedVector(fbb, normals.data(), normals.size());
+        if (!uvs.empty())
+            uvBlob = CreateAlignedVector(fbb, uvs.data(), uvs.size());
+        if (!tangents.empty())
+            tangentBlob = CreateAlignedVector(fbb, tangents.data(), tangents.size());
+        auto sliceVector = fbb.CreateVectorOfStructs(slices.data(), slices.size());
+        auto meshletVector = fbb.CreateVectorOfStructs(meshlets.data(), meshlets.size());
+        auto lodErrorVector = fbb.CreateVector(lodErrors);
+        auto lodSliceVector = fbb.CreateVectorOfStructs(lodSlices.data(), lodSlices.size());
+        auto lodSliceCountVector = fbb.CreateVector(lodSliceCounts);
+        auto materialVector = fbb.CreateVector(meshMaterials);
+        auto name = fbb.CreateString(mesh.name);
+
+        const SVector3 boundsMin = ToSVector3(mesh.bounds.min);
+        const SVector3 boundsMax = ToSVector3(mesh.bounds.max);
+
+        meshIndices[id & 0xFFFF] = static_cast<uint32_t>(meshes.size());
+        meshes.push_back(CreateSMesh(fbb, name, &boundsMin, &boundsMax, sliceVector, materialVector, vertexBlob, indexBlob, meshletVector,
+            lodErrorVector, lodSliceVector, normalBlob, uvBlob, tangentBlob, static_cast<uint32_t>(indices.size()), encodedIndexVector,
+            lodSliceCountVector));
+    }
+
+    std::vector<flatbuffers::Offset<SInstance>> instances;
+    for (uint32_t id : scene.instances) {
+        const Instance& instance = scene.instances[id];
+        const Transform& transform = scene.transforms[instance.transformId];
+        const SVector3 position = ToSVector3(transform.position);
+        const SQuaternion rotation(transform.rotation.x, transform.rotation.y, transform.rotation.z, transform.rotation.w);
+        const SVector3 scale = ToSVector3(transform.scale);
+        instances.push_back(CreateSInstance(fbb, meshIndices[instance.meshId & 0xFFFF], &position, &rotation, &scale));
+    }
+
+    auto root = CreateSSceneDirect(fbb, nullptr, SceneAssetVersion, &meshes, &materials, &textures, &instances);
+    FinishSSceneBuffer(fbb, root);
+
+    std::FILE* fp = std::fopen(path, "wb");
+    if (!fp) {
+        printf("SaveSceneAsset: can not write %s\n", path);
+        return false;
+    }
+    const bool written = std::fwrite(fbb.GetBufferPointer(), 1, fbb.GetSize(), fp) == fbb.GetSize();
+    std::fclose(fp);
+    return written;
+}
+
+/* Whether indices[offset, offset + triangleCount * 3) lies in the index buffer */
+static bool IndexRangeValid(uint64_t offset, uint64_t triangleCount, size_t indexCount)
+{
+    return offset + triangleCount * 3 <= indexCount;
+}
+
+/*
+ * Ranges and indices read from the file are checked before anything reads
+ * through them: slices and meshlets inside the index buffer, every index a
+ * vertex and no slice index below its baseVertex. No level has more slices
+ * than the draw sort key holds.
+ */
+static bool MeshRangesValid(const Mesh& mesh)
+{
+    const ArrayView<uint32_t> indices = mesh.GetIndices();
+    const size_t vertexCount = mesh.GetVertices().size() / 4;
+    for (size_t i = 0; i < indices.size(); ++i) {
+        if (indices[i] >= vertexCount)
+            return false;
+    }
+    for (const Meshlet& meshlet : mesh.meshlets) {
+        if (!IndexRangeValid(meshlet.indexOffset, meshlet.triangleCount, indices.size()))
+            return false;
+    }
+    for (uint32_t lod = 0; lod < mesh.GetLodCount(); ++lod) {
+        if (mesh.GetSlices(lod).size() > sortkey::MaxSliceCount)
+            return false;
+        for (const Mesh::Slice& slice : mesh.GetSlices(lod)) {
+            if (slice.indexOffset < 0 || slice.triangleCount < 0
+                || !IndexRangeValid(uint64_t(slice.indexOffset), uint64_t(slice.triangleCount), indices.size()))
+                return false;
+            const uint32_t end = slice.indexOffset + slice.triangleCount * 3;
+            for (uint32_t i = slice.indexOffset; i < end; ++i) {
+                if (indices[i] < slice.baseVertex)
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+template <class T>
+static bool HasRoom(const packed_freelist<T>& objects, size_t count)
+{
+    return count <= objects.capacity() - objects.size();
+}
+
+bool LoadSceneAsset(Scene& scene, const char* path)
+{
+    m3d::file::MappedFile mappedFile;
+    // start readahead now, every blob is read by the upload anyway
+    if (!mappedFile.Open(path, m3d::file::Access::WillNeed)) {
+        return false;
+    }
+
+    // only walks the tables, the vertex and index blobs are bounds checked but not read
+    flatbuffers::Verifier verifier(mappedFile.Data(), mappedFile.Size());
+    if (!VerifySSceneBuffer(verifier)) {
+        printf("LoadSceneAsset: %s is not a scene asset\n", path);
+        return false;
+    }
+    const SScene* asset = GetSScene(mappedFile.Data());
+    if (asset->version() != SceneAssetVersion) {
+        printf("LoadSceneAsset: %s has version %u, expected %u\n", path, asset->version(), SceneAssetVersion);
+        return false;
+    }
+    // inserting past a packed_freelist's capacity is only asserted, everything has to fit before the first insert
+    const size_t textureCount = asset->textures() ? asset->textures()->size() : 0;
+    const size_t materialCount = asset->materials() ? asset->materials()->size() : 0;
+    const size_t meshCount = asset->meshes() ? asset->meshes()->size() : 0;
+    const size_t instanceCount = asset->instances() ? asset->instances()->size() : 0;
+    if (!HasRoom(scene.diffuseMaps, textureCount) || !HasRoom(scene.materials, materialCount)
+        || !HasRoom(scene.meshes, meshCount) || !HasRoom(scene.instances, instanceCount)
+        || !HasRoom(scene.transforms, instanceCount)) {
+        printf("LoadSceneAsset: %s does not fit in the scene, %zu textures, %zu materials, %zu meshes, %zu instances\n",
+            path, textureCount, materialCount, meshCount, instanceCount);
+        return false;
+    }
+
+    std::vector<uint32_t> textureIds;
+    if (asset->textures()) {
+        for (flatbuffers::uoffset_t i = 0; i < asset->textures()->size(); ++i) {
+            const STexture* texture = asset->textures()->Get(i);
+            DiffuseMap diffuseMap;
+            if (texture->path())
+                diffuseMap.path = texture->path()->str();
+            textureIds.push_back(scene.diffuseMaps.insert(std::move(diffuseMap)));
+        }
+    }
+
+    std::vector<uint32_t> materialIds;
+    if (asset->materials()) {
+        for (flatbuffers::uoffset_t i = 0; i < asset->materials()->size(); ++i) {
+            const SMaterial* fileMaterial = asset->materials()->Get(i);
+            Material material = {};
+            if (fileMaterial->name())
+                material.name = fileMaterial->name()->str();
+            if (const SVector3* v = fileMaterial->ambient()) {
+                material.ambient[0] = v->x(), material.ambient[1] = v->y(), material.ambient[2] = v->z();
+            }
+            if (const SVector3* v = fileMaterial->diffuse()) {
+                material.diffuse[0] = v->x(), material.diffuse[1] = v->y(), material.diffuse[2] = v->z();
+            }
+            if (const SVector3* v = fileMaterial->specular()) {
+                material.specular[0] = v->x(), material.specular[1] = v->y(), material.specular[2] = v->z();
+            }
+            material.shininess = fileMaterial->shininess();
+            const int32_t texture = fileMaterial->diffuse_texture();
+            material.diffuseMapId = texture >= 0 && static_cast<size_t>(texture) < textureIds.size() ? textureIds[texture] : 0;
+            materialIds.push_back(scene.materials.insert(std::move(material)));
+        }
+    }
+
+    std::vector<uint32_t> meshIds;
+    if (asset->meshes()) {
+        for (flatbuffers::uoffset_t i = 0; i < asset->meshes()->size(); ++i) {
+            const SMesh* fileMesh = asset->meshes()->Get(i);
+            Mesh mesh;
+            if (fileMesh->name())
+                mesh.name = fileMesh->name()->str();
+            if (fileMesh->slices()) {
+                for (flatbuffers::uoffset_t s = 0; s < fileMesh->slices()->size(); ++s) {
+                    mesh.slices.push_back(FromSSlice(fileMesh->slices()->Get(s)));
+                }
+            }
+            if (fileMesh->meshlets()) {
+                for (flatbuffers::uoffset_t m = 0; m < fileMesh->meshlets()->size(); ++m) {
+                    const SMeshlet* fileMeshlet = fileMesh->meshlets()->Get(m);
+                    Meshlet meshlet;
+                    meshlet.center = FromSVector3(fileMeshlet->center());
+                    meshlet.radius = fileMeshlet->radius();
+                    meshlet.coneAxis = FromSVector3(fileMeshlet->cone_axis());
+                    meshlet.coneCutoff = fileMeshlet->cone_cutoff();
+                    meshlet.indexOffset = fileMeshlet->index_offset();
+                    meshlet.triangleCount = fileMeshlet->triangle_count();
+                    mesh.meshlets.push_back(meshlet);
+                }
+            }
+            // levels whose slices run past the end of the list are dropped, so are the coarsest past the sort key's lod field
+            if (fileMesh->lod_errors() && fileMesh->lod_slices() && fileMesh->lod_slice_counts()) {
+                const flatbuffers::uoffset_t lodCount = std::min(std::min(fileMesh->lod_errors()->size(), fileMesh->lod_slice_counts()->size()),
+                    sortkey::MaxLodCount - 1);
+                flatbuffers::uoffset_t firstSlice = 0;
+                for (flatbuffers::uoffset_t l = 0; l < lodCount; ++l) {
+                    const flatbuffers::uoffset_t sliceCount = fileMesh->lod_slice_counts()->Get(l);
+                    if (sliceCount > fileMesh->lod_slices()->size() - firstSlice)
+                        break;
+                    Mesh::Lod lod;
+                    lod.error = fileMesh->lod_errors()->Get(l);
+                    for (flatbuffers::uoffset_t s = 0; s < sliceCount; ++s) {
+                        lod.slices.push_back(FromSSlice(fileMesh->lod_slices()->Get(firstSlice + s)));
+                    }
+                    mesh.lods.push_back(std::move(lod));
+                    firstSlice += sliceCount;
+                }
+            }
+            for (uint32_t lod = 0; lod < mesh.GetLodCount(); ++lod) {
+                for (Mesh::Slice& slice : lod == 0 ? mesh.slices : mesh.lods[lod - 1].slices) {
+                    if (slice.firstMeshlet + slice.meshletCount > mesh.meshlets.size()) {
+                        slice.firstMeshlet = 0;
+                        slice.meshletCount = 0;
+                    }
+                }
+            }
+            if (fileMesh->material_ids()) {
+                for (flatbuffers::uoffset_t s = 0; s < fileMesh->material_ids()->size(); ++s) {
+                    const uint32_t index = fileMesh->material_ids()->Get(s);
+                    mesh.materialIds.push_back(index < materialIds.size() ? materialIds[index] : 0);
+                }
+            }
+            // the zero copy part, the blobs are used in place
+            if (fileMesh->vertices())
+                mesh.mappedVertices = ArrayView<float>(reinterpret_cast<const float*>(fileMesh->vertices()->Data()), fileMesh->vertices()->size());
+            if (fileMesh->indices()) {
+                mesh.mappedIndices = ArrayView<uint32_t>(reinterpret_cast<const uint32_t*>(fileMesh->indices()->Data()), fileMesh->indices()->size());
+            } else if (fileMesh->encoded_indices()) {
+                // every index takes at least a byte, a bigger count is corrupt and must not size the allocation
+                const bool countValid = fileMesh->index_count() <= fileMesh->encoded_indices()->size();
+                if (countValid)
+                    mesh.indices.resize(fileMesh->index_count());
+                if (!countValid || !DecodeIndexBuffer(mesh.indices.data(), mesh.indices.size(), fileMesh->encoded_indices()->Data(), fileMesh->encoded_indices()->size())) {
+                    printf("LoadSceneAsset: broken index data in mesh %u of %s\n", i, path);
+                    // nothing of the mesh is drawn
+                    mesh.indices.clear();
+                    mesh.slices.clear();
+                    mesh.lods.clear();
+                }
+            }
+            // attributes that do not cover every vertex are dropped, PackVertices fills in defaults
+            const size_t vertexCount = mesh.mappedVertices.size() / 4;
+            if (fileMesh->normals() && fileMesh->normals()->size() == vertexCount * 3)
+                mesh.mappedNormals = ArrayView<float>(reinterpret_cast<const float*>(fileMesh->normals()->Data()), fileMesh->normals()->size());
+            if (fileMesh->uvs() && fileMesh->uvs()->size() == vertexCount * 2)
+                mesh.mappedUVs = ArrayView<float>(reinterpret_cast<const float*>(fileMesh->uvs()->Data()), fileMesh->uvs()->size());
+            if (fileMesh->tangents() && fileMesh->tangents()->size() == vertexCount * 4)
+                mesh.mappedTangents = ArrayView<float>(reinterpret_cast<const float*>(fileMesh->tangents()->Data()), fileMesh->tangents()->size());
+            if (!MeshRangesValid(mesh)) {
+                printf("LoadSceneAsset: slices or index ranges out of bounds in mesh %u of %s\n", i, path);
+                // nothing of the mesh is drawn
+                mesh.mappedIndices = ArrayView<uint32_t>();
+                mesh.indices.clear();
+                mesh.slices.clear();
+                mesh.lods.clear();
+                mesh.meshlets.clear();
+            }
+            if (fileMesh->bounds_min() && fileMesh->bounds_max()) {
+                const SVector3* lo = fileMesh->bounds_min();
+                const SVector3* hi = fileMesh->bounds_max();
+                mesh.bounds.min = m3d::math::Vector3(lo->x(), lo->y(), lo->z());
+                mesh.bounds.max = m3d::math::Vector3(hi->x(), hi->y(), hi->z());
+            } else {
+                mesh.bounds = AABB::Empty();
+            }
+            meshIds.push_back(scene.meshes.insert(std::move(mesh)));
+        }
+    }
+
+    if (asset->instances()) {
+        for (flatbuffers::uoffset_t i = 0; i < asset->instances()->size(); ++i) {
+            const SInstance* fileInstance = asset->instances()->Get(i);
+            if (fileInstance->mesh() >= meshIds.size()) {
+                printf("LoadSceneAsset: instance of missing mesh %u\n", fileInstance->mesh());
+                continue;
+            }
+            Transform transform;
+            transform.position = m3d::math::Vector3(0.0f, 0.0f, 0.0f);
+            transform.scale = m3d::math::Vector3(1.0f, 1.0f, 1.0f);
+            transform.rotation = m3d::math::Quaternion(0.0f, 0.0f, 0.0f, 1.0f);
+            if (const SVector3* v = fileInstance->position())
+                transform.position = m3d::math::Vector3(v->x(), v->y(), v->z());
+            if (const SQuaternion* q = fileInstance->rotation())
+                transform.rotation = m3d::math::Quaternion(q->x(), q->y(), q->z(), q->w());
+            if (const SVector3* v = fileInstance->scale())
+                transform.scale = m3d::math::Vector3(v->x(), v->y(), v->z());
+
+            Instance instance;
+            instance.meshId = meshIds[fileInstance->mesh()];
+            instance.transformId = scene.transforms.insert(transform);
+            scene.instances.insert(instance);
+        }
+    }
+
+    scene.mappedFiles.push_back(std::move(mappedFile));
+    return true;
+}
+} // End of namespace m3d
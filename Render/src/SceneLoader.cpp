@@ -0,0 +1,111 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT)
+* (http://opensource.org/licenses/MIT)
+*/
+
+#include "SceneLoader.hpp"
+
+namespace m3d {
+SceneLoader::SceneLoader()
+    : state(State::Idle)
+    , progress(0.0f)
+    , cancelled(false)
+{
+}
+
+SceneLoader::~SceneLoader()
+{
+    Cancel();
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+bool SceneLoader::Start(const std::string& path)
+{
+    if (state.load() == State::Loading) {
+        return false;
+    }
+    if (thread.joinable()) {
+        thread.join();
+    }
+
+    ids = ImportIds();
+    progress = 0.0f;
+    cancelled = false;
+    state = State::Loading;
+    thread = std::thread(&SceneLoader::run, this, path);
+    return true;
+}
+
+void SceneLoader::Cancel()
+{
+    cancelled = true;
+}
+
+void SceneLoader::run(std::string path)
+{
+    FbxImportCallbacks callbacks;
+    // hashed here, before the lock, Publish only looks them up
+    callbacks.onTexture = [this](DiffuseMap&& diffuseMap) {
+        PendingTexture texture = { std::move(diffuseMap), 0 };
+        texture.contentHash = HashTextureContent(texture.diffuseMap);
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        pendingTextures.push_back(std::move(texture));
+    };
+    callbacks.onMaterial = [this](Material&& material) {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        pendingMaterials.push_back(std::move(material));
+    };
+    callbacks.onMesh = [this](Mesh&& mesh) {
+        PendingMesh pending = { std::move(mesh), 0 };
+        pending.geometryHash = HashMeshGeometry(pending.mesh);
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        pendingMeshes.push_back(std::move(pending));
+    };
+    callbacks.onProgress = [this](float fraction) {
+        progress = fraction;
+        return !cancelled.load();
+    };
+
+    const bool result = ImportFbx(path.c_str(), callbacks);
+    if (result) {
+        state = State::Done;
+    } else {
+        state = cancelled.load() ? State::Cancelled : State::Failed;
+        if (state.load() == State::Failed) {
+            printf("SceneLoader: failed to load %s\n", path.c_str());
+        }
+    }
+}
+
+size_t SceneLoader::Publish(Scene& scene, std::vector<uint32_t>* newMeshIds)
+{
+    std::vector<PendingTexture> textures;
+    std::vector<Material> materials;
+    std::vector<PendingMesh> meshes;
+    {
+        // swap out under the lock, the inserts below run without holding it
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        textures.swap(pendingTextures);
+        materials.swap(pendingMaterials);
+        meshes.swap(pendingMeshes);
+    }
+
+    // dependency order, a mesh only references materials handed out before it
+    for (PendingTexture& texture : textures) {
+        ids.AddTexture(scene, std::move(texture.diffuseMap), texture.contentHash);
+    }
+    for (Material& material : materials) {
+        ids.AddMaterial(scene, std::move(material));
+    }
+    for (PendingMesh& pending : meshes) {
+        const uint32_t meshId = ids.AddMesh(scene, std::move(pending.mesh), pending.geometryHash);
+        if (newMeshIds) {
+            newMeshIds->push_back(meshId);
+        }
+    }
+    return meshes.size();
+}
+} // End of namespace m3d
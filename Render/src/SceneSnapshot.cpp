@@ -0,0 +1,74 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT)
+* (http://opensource.org/licenses/MIT)
+*/
+
+#include "SceneSnapshot.hpp"
+#include "SpatialGrid.hpp"
+
+namespace m3d {
+static void CaptureTransforms(const Scene& scene, SceneSnapshot& snapshot)
+{
+    const size_t slotCount = scene.transforms.capacity();
+    if (snapshot.worldMatrices.Size() != slotCount) {
+        snapshot.worldMatrices.Resize(slotCount);
+        for (auto c = scene.transforms.get_cursor(); c; ++c) {
+            snapshot.worldMatrices.Write(c.id() & 0xFFFF) = GetWorldMatrix(*c);
+        }
+        return;
+    }
+    scene.dirtyTransforms.ForEach([&](uint32_t slot) {
+        // the transform may have been erased since it was marked
+        if (slot < slotCount && scene.transforms.contains_slot(slot))
+            snapshot.worldMatrices.Write(slot) = GetWorldMatrix(scene.transforms[slot]);
+    });
+}
+
+static void CaptureInstances(const Scene& scene, SceneSnapshot& snapshot)
+{
+    const size_t slotCount = scene.instances.capacity();
+    const bool rebuild = snapshot.instances.Size() != slotCount;
+    if (rebuild) {
+        snapshot.instances.Resize(slotCount);
+        for (auto c = scene.instances.get_cursor(); c; ++c) {
+            snapshot.instances.Write(c.id() & 0xFFFF) = *c;
+        }
+    } else {
+        scene.dirtyInstances.ForEach([&](uint32_t slot) {
+            if (slot < slotCount && scene.instances.contains_slot(slot))
+                snapshot.instances.Write(slot) = scene.instances[slot];
+        });
+    }
+
+    // erasing leaves no mark but changes the count
+    if (rebuild || scene.dirtyInstances.Any() || !snapshot.instanceIds || snapshot.instanceIds->size() != scene.instances.size()) {
+        std::shared_ptr<std::vector<uint32_t>> ids = std::make_shared<std::vector<uint32_t>>();
+        ids->reserve(scene.instances.size());
+        for (uint32_t instanceId : scene.instances) {
+            ids->push_back(instanceId);
+        }
+        snapshot.instanceIds = ids;
+    }
+}
+
+void CaptureScene(const Scene& scene, const SpatialGrid* grid, SceneSnapshot& snapshot)
+{
+    ++snapshot.frame;
+    if (scene.cameras.contains(scene.mainCameraID))
+        snapshot.camera = scene.cameras[scene.mainCameraID];
+
+    CaptureTransforms(scene, snapshot);
+    CaptureInstances(scene, snapshot);
+
+    // a new list each frame, the render thread may still hold the last one
+    std::shared_ptr<std::vector<uint32_t>> visible = std::make_shared<std::vector<uint32_t>>();
+    if (grid) {
+        visible->reserve(snapshot.visibleInstances ? snapshot.visibleInstances->size() : grid->size());
+        grid->QueryFrustum(GetCameraFrustum(snapshot.camera), [&](uint32_t instanceId, const AABB&, Containment) {
+            visible->push_back(instanceId);
+        });
+    }
+    snapshot.visibleInstances = visible;
+}
+} // End of namespace m3d
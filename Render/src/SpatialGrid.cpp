@@ -0,0 +1,270 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT)
+* (http://opensource.org/licenses/MIT)
+*/
+
+#include "SpatialGrid.hpp"
+
+#include <cassert>
+
+namespace m3d {
+FrustumCache::FrustumCache()
+    : stamp(0)
+    , valid(false)
+    , stats()
+{
+}
+
+SpatialGrid::SpatialGrid()
+    : cellSize(1.0f)
+    , invCellSize(1.0f)
+    , bucketMask(0)
+    , objectCount(0)
+    , cellFreeHead(invalid)
+    , oversizedHead(invalid)
+    , changeStamp(0)
+{
+}
+
+void SpatialGrid::Init(float size, uint32_t maxObjects, uint32_t bucketCount)
+{
+    assert(size > 0.0f);
+    assert(maxObjects <= index_mask + 1);
+
+    cellSize = size;
+    invCellSize = 1.0f / size;
+
+    uint32_t pow2 = 1;
+    while (pow2 < bucketCount)
+        pow2 <<= 1;
+    bucketMask = pow2 - 1;
+
+    entries.resize(maxObjects);
+    buckets.resize(pow2);
+    // never more occupied cells than objects
+    cells.resize(maxObjects);
+    liveIndex.resize(maxObjects);
+    liveCells.reserve(maxObjects);
+
+    Clear();
+}
+
+void SpatialGrid::Clear()
+{
+    for (auto& e : entries) {
+        e.cell = invalid;
+        e.prev = invalid;
+        e.next = invalid;
+    }
+    for (auto& b : buckets)
+        b = invalid;
+
+    cellFreeHead = invalid;
+    for (size_t i = cells.size(); i > 0; --i) {
+        cells[i - 1].nextInBucket = cellFreeHead;
+        cellFreeHead = static_cast<uint32_t>(i - 1);
+    }
+    liveCells.clear();
+    oversizedHead = invalid;
+    objectCount = 0;
+}
+
+void SpatialGrid::Insert(uint32_t id, const AABB& bounds)
+{
+    const uint32_t slot = id & index_mask;
+    assert(slot < entries.size());
+    assert(entries[slot].cell == invalid);
+
+    Entry& e = entries[slot];
+    e.id = id;
+    e.bounds = bounds;
+    e.stamp = ++changeStamp;
+
+    if (isOversized(bounds)) {
+        link(slot, oversized);
+    } else {
+        int32_t x, y, z;
+        cellCoord(bounds, &x, &y, &z);
+        link(slot, acquireCell(x, y, z));
+    }
+    ++objectCount;
+}
+
+void SpatialGrid::Move(uint32_t id, const AABB& bounds)
+{
+    const uint32_t slot = id & index_mask;
+    assert(Contains(id));
+
+    Entry& e = entries[slot];
+    e.bounds = bounds;
+    e.stamp = ++changeStamp;
+
+    uint32_t target = oversized;
+    if (!isOversized(bounds)) {
+        int32_t x, y, z;
+        cellCoord(bounds, &x, &y, &z);
+        if (e.cell != oversized) {
+            const Cell& current = cells[e.cell];
+            // the common case: the object is still in its cell
+            if (current.x == x && current.y == y && current.z == z)
+                return;
+        }
+        target = findCell(x, y, z);
+        if (target == invalid) {
+            unlink(slot);
+            link(slot, acquireCell(x, y, z));
+            return;
+        }
+    } else if (e.cell == oversized) {
+        return;
+    }
+
+    unlink(slot);
+    link(slot, target);
+}
+
+void SpatialGrid::Remove(uint32_t id)
+{
+    assert(Contains(id));
+    unlink(id & index_mask);
+    --objectCount;
+}
+
+bool SpatialGrid::Contains(uint32_t id) const
+{
+    const uint32_t slot = id & index_mask;
+    return slot < entries.size() && entries[slot].cell != invalid && entries[slot].id == id;
+}
+
+bool SpatialGrid::ContainsSlot(uint32_t slot, uint32_t* id) const
+{
+    slot &= index_mask;
+    if (slot >= entries.size() || entries[slot].cell == invalid)
+        return false;
+    *id = entries[slot].id;
+    return true;
+}
+
+void SpatialGrid::cellCoord(const AABB& bounds, int32_t* x, int32_t* y, int32_t* z) const
+{
+    const m3d::math::Vector3 center = bounds.Center();
+    *x = static_cast<int32_t>(std::floor(center.x * invCellSize));
+    *y = static_cast<int32_t>(std::floor(center.y * invCellSize));
+    *z = static_cast<int32_t>(std::floor(center.z * invCellSize));
+}
+
+bool SpatialGrid::isOversized(const AABB& bounds) const
+{
+    const m3d::math::Vector3 extents = bounds.Extents();
+    const float half = cellSize * 0.5f;
+    return extents.x > half || extents.y > half || extents.z > half;
+}
+
+uint32_t SpatialGrid::bucketOf(int32_t x, int32_t y, int32_t z) const
+{
+    const uint32_t h = (static_cast<uint32_t>(x) * 73856093u) ^ (static_cast<uint32_t>(y) * 19349663u) ^ (static_cast<uint32_t>(z) * 83492791u);
+    return h & bucketMask;
+}
+
+uint32_t SpatialGrid::findCell(int32_t x, int32_t y, int32_t z) const
+{
+    for (uint32_t c = buckets[bucketOf(x, y, z)]; c != invalid; c = cells[c].nextInBucket) {
+        const Cell& cell = cells[c];
+        if (cell.x == x && cell.y == y && cell.z == z)
+            return c;
+    }
+    return invalid;
+}
+
+uint32_t SpatialGrid::acquireCell(int32_t x, int32_t y, int32_t z)
+{
+    uint32_t c = findCell(x, y, z);
+    if (c != invalid)
+        return c;
+
+    assert(cellFreeHead != invalid);
+    c = cellFreeHead;
+    Cell& cell = cells[c];
+    cellFreeHead = cell.nextInBucket;
+
+    const uint32_t bucket = bucketOf(x, y, z);
+    cell.x = x;
+    cell.y = y;
+    cell.z = z;
+    cell.head = invalid;
+    cell.count = 0;
+    cell.stamp = ++changeStamp;
+    cell.nextInBucket = buckets[bucket];
+    buckets[bucket] = c;
+
+    liveIndex[c] = static_cast<uint32_t>(liveCells.size());
+    liveCells.push_back(c);
+    return c;
+}
+
+void SpatialGrid::releaseCell(uint32_t c)
+{
+    Cell& cell = cells[c];
+
+    // unchain from the bucket
+    uint32_t* link = &buckets[bucketOf(cell.x, cell.y, cell.z)];
+    while (*link != c)
+        link = &cells[*link].nextInBucket;
+    *link = cell.nextInBucket;
+
+    // swap-remove from the live list
+    const uint32_t last = liveCells.back();
+    liveCells[liveIndex[c]] = last;
+    liveIndex[last] = liveIndex[c];
+    liveCells.pop_back();
+
+    cell.nextInBucket = cellFreeHead;
+    cellFreeHead = c;
+}
+
+void SpatialGrid::link(uint32_t slot, uint32_t cellIndex)
+{
+    Entry& e = entries[slot];
+    uint32_t& head = cellIndex == oversized ? oversizedHead : cells[cellIndex].head;
+
+    e.cell = cellIndex;
+    e.prev = invalid;
+    e.next = head;
+    if (head != invalid)
+        entries[head].prev = slot;
+    head = slot;
+
+    if (cellIndex != oversized)
+        ++cells[cellIndex].count;
+}
+
+void SpatialGrid::unlink(uint32_t slot)
+{
+    Entry& e = entries[slot];
+    uint32_t& head = e.cell == oversized ? oversizedHead : cells[e.cell].head;
+
+    if (e.prev != invalid)
+        entries[e.prev].next = e.next;
+    else
+        head = e.next;
+    if (e.next != invalid)
+        entries[e.next].prev = e.prev;
+
+    if (e.cell != oversized && --cells[e.cell].count == 0)
+        releaseCell(e.cell);
+
+    e.cell = invalid;
+    e.prev = invalid;
+    e.next = invalid;
+}
+
+AABB SpatialGrid::looseBounds(const Cell& cell) const
+{
+    const float half = cellSize * 0.5f;
+    AABB loose;
+    loose.min = m3d::math::Vector3(cell.x * cellSize - half, cell.y * cellSize - half, cell.z * cellSize - half);
+    loose.max = m3d::math::Vector3((cell.x + 1) * cellSize + half, (cell.y + 1) * cellSize + half, (cell.z + 1) * cellSize + half);
+    return loose;
+}
+} // End of namespace m3d
@@ -0,0 +1,121 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT)
+* (http://opensource.org/licenses/MIT)
+*/
+
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace m3d {
+ThreadPool::ThreadPool(uint32_t workerCount)
+    : stopping(false)
+{
+    for (uint32_t i = 0; i < workerCount; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+ThreadPool& ThreadPool::Shared()
+{
+    static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+    return pool;
+}
+
+void ThreadPool::Submit(std::function<void()> task)
+{
+    if (workers.empty()) {
+        task();
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    wakeUp.notify_one();
+}
+
+void ThreadPool::workerLoop()
+{
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeUp.wait(lock, [this] { return stopping || !tasks.empty(); });
+            // drain the queue before stopping, ParallelFor callers may still be waiting on it
+            if (tasks.empty()) {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
+
+void ThreadPool::ParallelFor(uint32_t begin, uint32_t end, uint32_t grain, const std::function<void(uint32_t, uint32_t)>& fn)
+{
+    if (begin >= end) {
+        return;
+    }
+    grain = std::max(grain, 1u);
+    const uint32_t chunkCount = (end - begin + grain - 1) / grain;
+    if (chunkCount == 1 || workers.empty()) {
+        fn(begin, end);
+        return;
+    }
+
+    // chunks are claimed from a shared counter; helpers that start after the
+    // last chunk was claimed find nothing to do, so the state outlives the call
+    struct Job {
+        std::atomic<uint32_t> nextChunk;
+        std::atomic<uint32_t> chunksLeft;
+        std::mutex doneMutex;
+        std::condition_variable done;
+    };
+    std::shared_ptr<Job> job = std::make_shared<Job>();
+    job->nextChunk = 0;
+    job->chunksLeft = chunkCount;
+
+    // fn is only used while chunks are left, which is before this call returns
+    const std::function<void(uint32_t, uint32_t)>* body = &fn;
+    auto runChunks = [job, body, begin, end, grain, chunkCount]() {
+        for (;;) {
+            const uint32_t chunk = job->nextChunk.fetch_add(1);
+            if (chunk >= chunkCount) {
+                return;
+            }
+            const uint32_t chunkBegin = begin + chunk * grain;
+            (*body)(chunkBegin, std::min(end, chunkBegin + grain));
+            if (job->chunksLeft.fetch_sub(1) == 1) {
+                std::lock_guard<std::mutex> lock(job->doneMutex);
+                job->done.notify_all();
+            }
+        }
+    };
+
+    const uint32_t helperCount = std::min(GetWorkerCount(), chunkCount - 1);
+    for (uint32_t i = 0; i < helperCount; ++i) {
+        Submit(runChunks);
+    }
+    runChunks();
+
+    std::unique_lock<std::mutex> lock(job->doneMutex);
+    job->done.wait(lock, [&job] { return job->chunksLeft.load() == 0; });
+}
+} // End of namespace m3d
@@ -0,0 +1,172 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT)
+* (http://opensource.org/licenses/MIT)
+*/
+
+#include "VertexFormat.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace m3d {
+static const char* const AttributeNames[VertexAttributeCount] = { "position", "normal", "uv", "tangent" };
+// components the attribute has before padding
+static const uint32_t AttributeComponents[VertexAttributeCount] = { 3, 3, 2, 4 };
+// normal +z, uv 0, tangent +x with a positive bitangent sign
+static const float DefaultValues[VertexAttributeCount][4] = {
+    { 0.0f, 0.0f, 0.0f, 1.0f },
+    { 0.0f, 0.0f, 1.0f, 0.0f },
+    { 0.0f, 0.0f, 0.0f, 0.0f },
+    { 1.0f, 0.0f, 0.0f, 1.0f }
+};
+// array strides of the Mesh streams, see MeshOptimizer.hpp
+static const uint32_t SourceStrides[VertexAttributeCount] = { 4, 3, 2, 4 };
+
+static uint32_t EncodingSize(VertexEncoding encoding)
+{
+    switch (encoding) {
+    case VertexEncodingFloat32:
+        return 4;
+    case VertexEncodingFloat16:
+    case VertexEncodingSnorm16:
+        return 2;
+    case VertexEncodingSnorm8:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+uint32_t GetVertexComponentCount(VertexAttribute attribute, VertexEncoding encoding)
+{
+    if (encoding == VertexEncodingNone)
+        return 0;
+    // only 32 bit floats have 3 component formats every device supports
+    const uint32_t components = AttributeComponents[attribute];
+    return encoding == VertexEncodingFloat32 || components == 2 ? components : 4;
+}
+
+bool MakeVertexFormat(VertexFormat& format, VertexEncoding position, VertexEncoding normal, VertexEncoding uv,
+    VertexEncoding tangent)
+{
+    const VertexEncoding encodings[VertexAttributeCount] = { position, normal, uv, tangent };
+    if (position == VertexEncodingNone) {
+        printf("MakeVertexFormat: a vertex needs a position\n");
+        return false;
+    }
+
+    format = VertexFormat();
+    for (uint32_t a = 0; a < VertexAttributeCount; ++a) {
+        const VertexAttribute attribute = static_cast<VertexAttribute>(a);
+        const bool normalized = encodings[a] == VertexEncodingSnorm16 || encodings[a] == VertexEncodingSnorm8;
+        if (normalized && (attribute == VertexPosition || attribute == VertexUV)) {
+            printf("MakeVertexFormat: %s can not be stored normalized\n", AttributeNames[a]);
+            return false;
+        }
+        format.encodings[a] = encodings[a];
+        format.offsets[a] = format.stride;
+        format.stride += GetVertexComponentCount(attribute, encodings[a]) * EncodingSize(encodings[a]);
+    }
+    return true;
+}
+
+VertexFormat PositionVertexFormat()
+{
+    VertexFormat format;
+    MakeVertexFormat(format, VertexEncodingFloat32, VertexEncodingNone, VertexEncodingNone, VertexEncodingNone);
+    return format;
+}
+
+VertexFormat CompactVertexFormat()
+{
+    VertexFormat format;
+    MakeVertexFormat(format, VertexEncodingFloat32, VertexEncodingSnorm8, VertexEncodingFloat16, VertexEncodingSnorm8);
+    return format;
+}
+
+uint16_t FloatToHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const uint32_t sign = (bits >> 16) & 0x8000;
+    const uint32_t magnitude = bits & 0x7FFFFFFF;
+
+    // NaN stays NaN
+    if (magnitude > 0x7F800000)
+        return static_cast<uint16_t>(sign | 0x7E00);
+    // 65520 and up round to infinity
+    if (magnitude >= 0x477FF000)
+        return static_cast<uint16_t>(sign | 0x7C00);
+    // normal halves, rebias the exponent and round the dropped 13 bits
+    if (magnitude >= 0x38800000) {
+        const uint32_t rebiased = magnitude - 0x38000000;
+        return static_cast<uint16_t>(sign | ((rebiased + 0x0FFF + ((rebiased >> 13) & 1)) >> 13));
+    }
+    // subnormal halves, the implicit bit becomes explicit
+    if (magnitude < 0x33000000)
+        return static_cast<uint16_t>(sign);
+    const uint32_t exponent = magnitude >> 23;
+    const uint32_t mantissa = (magnitude & 0x007FFFFF) | 0x00800000;
+    const uint32_t shift = 126 - exponent;
+    const uint32_t half = mantissa >> shift;
+    const uint32_t dropped = mantissa & ((1u << shift) - 1);
+    const uint32_t halfway = 1u << (shift - 1);
+    return static_cast<uint16_t>(sign | (half + (dropped > halfway || (dropped == halfway && (half & 1)) ? 1 : 0)));
+}
+
+template <class T>
+static T EncodeSnorm(float value, float scale)
+{
+    value = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+    return static_cast<T>(std::lround(value * scale));
+}
+
+void PackVertices(const VertexFormat& format, const float* positions, const float* normals, const float* uvs,
+    const float* tangents, uint32_t vertexCount, void* destination)
+{
+    const float* sources[VertexAttributeCount] = { positions, normals, uvs, tangents };
+    uint8_t* out = static_cast<uint8_t*>(destination);
+    for (uint32_t v = 0; v < vertexCount; ++v, out += format.stride) {
+        for (uint32_t a = 0; a < VertexAttributeCount; ++a) {
+            const VertexEncoding encoding = format.encodings[a];
+            if (encoding == VertexEncodingNone)
+                continue;
+
+            // padding components get the default, w of a padded normal is 0
+            float values[4];
+            std::memcpy(values, DefaultValues[a], sizeof(values));
+            if (sources[a])
+                std::memcpy(values, sources[a] + v * SourceStrides[a], AttributeComponents[a] * sizeof(float));
+
+            const uint32_t components = GetVertexComponentCount(static_cast<VertexAttribute>(a), encoding);
+            uint8_t* element = out + format.offsets[a];
+            for (uint32_t c = 0; c < components; ++c) {
+                switch (encoding) {
+                case VertexEncodingFloat32:
+                    std::memcpy(element + c * 4, &values[c], 4);
+                    break;
+                case VertexEncodingFloat16: {
+                    const uint16_t half = FloatToHalf(values[c]);
+                    std::memcpy(element + c * 2, &half, 2);
+                    break;
+                }
+                case VertexEncodingSnorm16: {
+                    const int16_t snorm = EncodeSnorm<int16_t>(values[c], 32767.0f);
+                    std::memcpy(element + c * 2, &snorm, 2);
+                    break;
+                }
+                case VertexEncodingSnorm8: {
+                    const int8_t snorm = EncodeSnorm<int8_t>(values[c], 127.0f);
+                    std::memcpy(element + c, &snorm, 1);
+                    break;
+                }
+                default:
+                    break;
+                }
+            }
+        }
+    }
+}
+} // End of namespace m3d
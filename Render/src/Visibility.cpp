@@ -0,0 +1,72 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT)
+* (http://opensource.org/licenses/MIT)
+*/
+
+#include "Visibility.hpp"
+#include "ThreadPool.hpp"
+
+#include <cassert>
+#include <cmath>
+
+namespace m3d {
+ViewSet::ViewSet()
+    : viewCount(0)
+{
+}
+
+uint32_t ViewSet::AddView(const Frustum& frustum)
+{
+    assert(viewCount < MaxViews);
+    ViewPlanes& view = views[viewCount];
+    for (int p = 0; p < Frustum::PlaneCount; ++p) {
+        const float* normal = &frustum.planes[p].normal.x;
+        for (int axis = 0; axis < 3; ++axis) {
+            view.normal[p][axis] = normal[axis];
+            view.absNormal[p][axis] = std::fabs(normal[axis]);
+        }
+        view.d[p] = frustum.planes[p].d;
+    }
+    return viewCount++;
+}
+
+uint32_t ViewSet::Test(const AABB& box) const
+{
+    const m3d::math::Vector3 center = box.Center();
+    const m3d::math::Vector3 extents = box.Extents();
+
+    uint32_t mask = 0;
+    for (uint32_t v = 0; v < viewCount; ++v) {
+        const ViewPlanes& view = views[v];
+        bool inside = true;
+        // the same test as Classify, only whether the box is outside
+        for (int p = 0; p < Frustum::PlaneCount && inside; ++p) {
+            const float distance = view.normal[p][0] * center.x + view.normal[p][1] * center.y + view.normal[p][2] * center.z + view.d[p];
+            const float radius = view.absNormal[p][0] * extents.x + view.absNormal[p][1] * extents.y + view.absNormal[p][2] * extents.z;
+            inside = distance >= -radius;
+        }
+        mask |= inside ? 1u << v : 0;
+    }
+    return mask;
+}
+
+void ViewSet::TestAll(const AABB* boxes, size_t count, uint32_t* masks, ThreadPool& pool, uint32_t grain) const
+{
+    // every chunk writes its own masks, no locking
+    pool.ParallelFor(0, static_cast<uint32_t>(count), grain, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            masks[i] = Test(boxes[i]);
+        }
+    });
+}
+
+void CollectVisible(const uint32_t* ids, const uint32_t* masks, size_t count, uint32_t view, std::vector<uint32_t>& out)
+{
+    const uint32_t bit = 1u << view;
+    for (size_t i = 0; i < count; ++i) {
+        if (masks[i] & bit)
+            out.push_back(ids[i]);
+    }
+}
+} // End of namespace m3d
@@ -10,12 +10,26 @@ namespace schema {
 
 struct SVector3;
 
+struct SQuaternion;
+
 struct STransform;
 
+struct SSlice;
+
+struct SMeshlet;
+
 struct SScene;
 
 struct SModel;
 
+struct SMesh;
+
+struct STexture;
+
+struct SMaterial;
+
+struct SInstance;
+
 MANUALLY_ALIGNED_STRUCT(4) SVector3 FLATBUFFERS_FINAL_CLASS {
  private:
   float x_;
@@ -34,6 +48,26 @@ MANUALLY_ALIGNED_STRUCT(4) SVector3 FLATBUFFERS_FINAL_CLASS {
 };
 STRUCT_END(SVector3, 12);
 
+MANUALLY_ALIGNED_STRUCT(4) SQuaternion FLATBUFFERS_FINAL_CLASS {
+ private:
+  float x_;
+  float y_;
+  float z_;
+  float w_;
+
+ public:
+  SQuaternion() { memset(this, 0, sizeof(SQuaternion)); }
+  SQuaternion(const SQuaternion &_o) { memcpy(this, &_o, sizeof(SQuaternion)); }
+  SQuaternion(float _x, float _y, float _z, float _w)
+    : x_(flatbuffers::EndianScalar(_x)), y_(flatbuffers::EndianScalar(_y)), z_(flatbuffers::EndianScalar(_z)), w_(flatbuffers::EndianScalar(_w)) { }
+
+  float x() const { return flatbuffers::EndianScalar(x_); }
+  float y() const { return flatbuffers::EndianScalar(y_); }
+  float z() const { return flatbuffers::EndianScalar(z_); }
+  float w() const { return flatbuffers::EndianScalar(w_); }
+};
+STRUCT_END(SQuaternion, 16);
+
 MANUALLY_ALIGNED_STRUCT(4) STransform FLATBUFFERS_FINAL_CLASS {
  private:
   SVector3 position_;
@@ -52,16 +86,87 @@ MANUALLY_ALIGNED_STRUCT(4) STransform FLATBUFFERS_FINAL_CLASS {
 };
 STRUCT_END(STransform, 36);
 
+MANUALLY_ALIGNED_STRUCT(4) SSlice FLATBUFFERS_FINAL_CLASS {
+ private:
+  uint32_t index_offset_;
+  uint32_t triangle_count_;
+  uint32_t first_meshlet_;
+  uint32_t meshlet_count_;
+  uint32_t base_vertex_;
+  uint32_t material_;
+
+ public:
+  SSlice() { memset(this, 0, sizeof(SSlice)); }
+  SSlice(const SSlice &_o) { memcpy(this, &_o, sizeof(SSlice)); }
+  SSlice(uint32_t _index_offset, uint32_t _triangle_count, uint32_t _first_meshlet, uint32_t _meshlet_count, uint32_t _base_vertex, uint32_t _material)
+    : index_offset_(flatbuffers::EndianScalar(_index_offset)), triangle_count_(flatbuffers::EndianScalar(_triangle_count)), first_meshlet_(flatbuffers::EndianScalar(_first_meshlet)), meshlet_count_(flatbuffers::EndianScalar(_meshlet_count)), base_vertex_(flatbuffers::EndianScalar(_base_vertex)), material_(flatbuffers::EndianScalar(_material)) { }
+
+  uint32_t index_offset() const { return flatbuffers::EndianScalar(index_offset_); }
+  uint32_t triangle_count() const { return flatbuffers::EndianScalar(triangle_count_); }
+  uint32_t first_meshlet() const { return flatbuffers::EndianScalar(first_meshlet_); }
+  uint32_t meshlet_count() const { return flatbuffers::EndianScalar(meshlet_count_); }
+  uint32_t base_vertex() const { return flatbuffers::EndianScalar(base_vertex_); }
+  uint32_t material() const { return flatbuffers::EndianScalar(material_); }
+};
+STRUCT_END(SSlice, 24);
+
+MANUALLY_ALIGNED_STRUCT(4) SMeshlet FLATBUFFERS_FINAL_CLASS {
+ private:
+  SVector3 center_;
+  float radius_;
+  SVector3 cone_axis_;
+  float cone_cutoff_;
+  uint32_t index_offset_;
+  uint32_t triangle_count_;
+
+ public:
+  SMeshlet() { memset(this, 0, sizeof(SMeshlet)); }
+  SMeshlet(const SMeshlet &_o) { memcpy(this, &_o, sizeof(SMeshlet)); }
+  SMeshlet(const SVector3 &_center, float _radius, const SVector3 &_cone_axis, float _cone_cutoff, uint32_t _index_offset, uint32_t _triangle_count)
+    : center_(_center), radius_(flatbuffers::EndianScalar(_radius)), cone_axis_(_cone_axis), cone_cutoff_(flatbuffers::EndianScalar(_cone_cutoff)), index_offset_(flatbuffers::EndianScalar(_index_offset)), triangle_count_(flatbuffers::EndianScalar(_triangle_count)) { }
+
+  const SVector3 &center() const { return center_; }
+  float radius() const { return flatbuffers::EndianScalar(radius_); }
+  const SVector3 &cone_axis() const { return cone_axis_; }
+  float cone_cutoff() const { return flatbuffers::EndianScalar(cone_cutoff_); }
+  uint32_t index_offset() const { return flatbuffers::EndianScalar(index_offset_); }
+  uint32_t triangle_count() const { return flatbuffers::EndianScalar(triangle_count_); }
+};
+STRUCT_END(SMeshlet, 40);
+
 struct SScene FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
   enum {
-    VT_MODELS = 4
+    VT_MODELS = 4,
+    VT_VERSION = 6,
+    VT_MESHES = 8,
+    VT_MATERIALS = 10,
+    VT_TEXTURES = 12,
+    VT_INSTANCES = 14
   };
   const flatbuffers::Vector<flatbuffers::Offset<SModel>> *models() const { return GetPointer<const flatbuffers::Vector<flatbuffers::Offset<SModel>> *>(VT_MODELS); }
+  uint32_t version() const { return GetField<uint32_t>(VT_VERSION, 0); }
+  const flatbuffers::Vector<flatbuffers::Offset<SMesh>> *meshes() const { return GetPointer<const flatbuffers::Vector<flatbuffers::Offset<SMesh>> *>(VT_MESHES); }
+  const flatbuffers::Vector<flatbuffers::Offset<SMaterial>> *materials() const { return GetPointer<const flatbuffers::Vector<flatbuffers::Offset<SMaterial>> *>(VT_MATERIALS); }
+  const flatbuffers::Vector<flatbuffers::Offset<STexture>> *textures() const { return GetPointer<const flatbuffers::Vector<flatbuffers::Offset<STexture>> *>(VT_TEXTURES); }
+  const flatbuffers::Vector<flatbuffers::Offset<SInstance>> *instances() const { return GetPointer<const flatbuffers::Vector<flatbuffers::Offset<SInstance>> *>(VT_INSTANCES); }
   bool Verify(flatbuffers::Verifier &verifier) const {
     return VerifyTableStart(verifier) &&
            VerifyField<flatbuffers::uoffset_t>(verifier, VT_MODELS) &&
            verifier.Verify(models()) &&
            verifier.VerifyVectorOfTables(models()) &&
+           VerifyField<uint32_t>(verifier, VT_VERSION) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_MESHES) &&
+           verifier.Verify(meshes()) &&
+           verifier.VerifyVectorOfTables(meshes()) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_MATERIALS) &&
+           verifier.Verify(materials()) &&
+           verifier.VerifyVectorOfTables(materials()) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_TEXTURES) &&
+           verifier.Verify(textures()) &&
+           verifier.VerifyVectorOfTables(textures()) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_INSTANCES) &&
+           verifier.Verify(instances()) &&
+           verifier.VerifyVectorOfTables(instances()) &&
            verifier.EndTable();
   }
 };
@@ -70,24 +175,44 @@ struct SSceneBuilder {
   flatbuffers::FlatBufferBuilder &fbb_;
   flatbuffers::uoffset_t start_;
   void add_models(flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<SModel>>> models) { fbb_.AddOffset(SScene::VT_MODELS, models); }
+  void add_version(uint32_t version) { fbb_.AddElement<uint32_t>(SScene::VT_VERSION, version, 0); }
+  void add_meshes(flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<SMesh>>> meshes) { fbb_.AddOffset(SScene::VT_MESHES, meshes); }
+  void add_materials(flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<SMaterial>>> materials) { fbb_.AddOffset(SScene::VT_MATERIALS, materials); }
+  void add_textures(flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<STexture>>> textures) { fbb_.AddOffset(SScene::VT_TEXTURES, textures); }
+  void add_instances(flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<SInstance>>> instances) { fbb_.AddOffset(SScene::VT_INSTANCES, instances); }
   SSceneBuilder(flatbuffers::FlatBufferBuilder &_fbb) : fbb_(_fbb) { start_ = fbb_.StartTable(); }
   SSceneBuilder &operator=(const SSceneBuilder &);
   flatbuffers::Offset<SScene> Finish() {
-    auto o = flatbuffers::Offset<SScene>(fbb_.EndTable(start_, 1));
+    auto o = flatbuffers::Offset<SScene>(fbb_.EndTable(start_, 6));
     return o;
   }
 };
 
 inline flatbuffers::Offset<SScene> CreateSScene(flatbuffers::FlatBufferBuilder &_fbb,
-    flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<SModel>>> models = 0) {
+    flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<SModel>>> models = 0,
+    uint32_t version = 0,
+    flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<SMesh>>> meshes = 0,
+    flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<SMaterial>>> materials = 0,
+    flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<STexture>>> textures = 0,
+    flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<SInstance>>> instances = 0) {
   SSceneBuilder builder_(_fbb);
+  builder_.add_instances(instances);
+  builder_.add_textures(textures);
+  builder_.add_materials(materials);
+  builder_.add_meshes(meshes);
+  builder_.add_version(version);
   builder_.add_models(models);
   return builder_.Finish();
 }
 
 inline flatbuffers::Offset<SScene> CreateSSceneDirect(flatbuffers::FlatBufferBuilder &_fbb,
-    const std::vector<flatbuffers::Offset<SModel>> *models = nullptr) {
-  return CreateSScene(_fbb, models ? _fbb.CreateVector<flatbuffers::Offset<SModel>>(*models) : 0);
+    const std::vector<flatbuffers::Offset<SModel>> *models = nullptr,
+    uint32_t version = 0,
+    const std::vector<flatbuffers::Offset<SMesh>> *meshes = nullptr,
+    const std::vector<flatbuffers::Offset<SMaterial>> *materials = nullptr,
+    const std::vector<flatbuffers::Offset<STexture>> *textures = nullptr,
+    const std::vector<flatbuffers::Offset<SInstance>> *instances = nullptr) {
+  return CreateSScene(_fbb, models ? _fbb.CreateVector<flatbuffers::Offset<SModel>>(*models) : 0, version, meshes ? _fbb.CreateVector<flatbuffers::Offset<SMesh>>(*meshes) : 0, materials ? _fbb.CreateVector<flatbuffers::Offset<SMaterial>>(*materials) : 0, textures ? _fbb.CreateVector<flatbuffers::Offset<STexture>>(*textures) : 0, instances ? _fbb.CreateVector<flatbuffers::Offset<SInstance>>(*instances) : 0);
 }
 
 struct SModel FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
@@ -134,16 +259,338 @@ inline flatbuffers::Offset<SModel> CreateSModelDirect(flatbuffers::FlatBufferBui
   return CreateSModel(_fbb, name ? _fbb.CreateString(name) : 0, transform);
 }
 
+struct SMesh FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
+  enum {
+    VT_NAME = 4,
+    VT_BOUNDS_MIN = 6,
+    VT_BOUNDS_MAX = 8,
+    VT_SLICES = 10,
+    VT_MATERIAL_IDS = 12,
+    VT_VERTICES = 14,
+    VT_INDICES = 16,
+    VT_MESHLETS = 18,
+    VT_LOD_ERRORS = 20,
+    VT_LOD_SLICES = 22,
+    VT_NORMALS = 24,
+    VT_UVS = 26,
+    VT_TANGENTS = 28,
+    VT_INDEX_COUNT = 30,
+    VT_ENCODED_INDICES = 32,
+    VT_LOD_SLICE_COUNTS = 34
+  };
+  const flatbuffers::String *name() const { return GetPointer<const flatbuffers::String *>(VT_NAME); }
+  const SVector3 *bounds_min() const { return GetStruct<const SVector3 *>(VT_BOUNDS_MIN); }
+  const SVector3 *bounds_max() const { return GetStruct<const SVector3 *>(VT_BOUNDS_MAX); }
+  const flatbuffers::Vector<const SSlice *> *slices() const { return GetPointer<const flatbuffers::Vector<const SSlice *> *>(VT_SLICES); }
+  const flatbuffers::Vector<uint32_t> *material_ids() const { return GetPointer<const flatbuffers::Vector<uint32_t> *>(VT_MATERIAL_IDS); }
+  const flatbuffers::Vector<float> *vertices() const { return GetPointer<const flatbuffers::Vector<float> *>(VT_VERTICES); }
+  const flatbuffers::Vector<uint32_t> *indices() const { return GetPointer<const flatbuffers::Vector<uint32_t> *>(VT_INDICES); }
+  const flatbuffers::Vector<const SMeshlet *> *meshlets() const { return GetPointer<const flatbuffers::Vector<const SMeshlet *> *>(VT_MESHLETS); }
+  const flatbuffers::Vector<float> *lod_errors() const { return GetPointer<const flatbuffers::Vector<float> *>(VT_LOD_ERRORS); }
+  const flatbuffers::Vector<const SSlice *> *lod_slices() const { return GetPointer<const flatbuffers::Vector<const SSlice *> *>(VT_LOD_SLICES); }
+  const flatbuffers::Vector<float> *normals() const { return GetPointer<const flatbuffers::Vector<float> *>(VT_NORMALS); }
+  const flatbuffers::Vector<float> *uvs() const { return GetPointer<const flatbuffers::Vector<float> *>(VT_UVS); }
+  const flatbuffers::Vector<float> *tangents() const { return GetPointer<const flatbuffers::Vector<float> *>(VT_TANGENTS); }
+  uint32_t index_count() const { return GetField<uint32_t>(VT_INDEX_COUNT, 0); }
+  const flatbuffers::Vector<uint8_t> *encoded_indices() const { return GetPointer<const flatbuffers::Vector<uint8_t> *>(VT_ENCODED_INDICES); }
+  const flatbuffers::Vector<uint32_t> *lod_slice_counts() const { return GetPointer<const flatbuffers::Vector<uint32_t> *>(VT_LOD_SLICE_COUNTS); }
+  bool Verify(flatbuffers::Verifier &verifier) const {
+    return VerifyTableStart(verifier) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_NAME) &&
+           verifier.Verify(name()) &&
+           VerifyField<SVector3>(verifier, VT_BOUNDS_MIN) &&
+           VerifyField<SVector3>(verifier, VT_BOUNDS_MAX) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_SLICES) &&
+           verifier.Verify(slices()) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_MATERIAL_IDS) &&
+           verifier.Verify(material_ids()) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_VERTICES) &&
+           verifier.Verify(vertices()) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_INDICES) &&
+           verifier.Verify(indices()) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_MESHLETS) &&
+           verifier.Verify(meshlets()) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_LOD_ERRORS) &&
+           verifier.Verify(lod_errors()) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_LOD_SLICES) &&
+           verifier.Verify(lod_slices()) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_NORMALS) &&
+           verifier.Verify(normals()) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_UVS) &&
+           verifier.Verify(uvs()) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_TANGENTS) &&
+           verifier.Verify(tangents()) &&
+           VerifyField<uint32_t>(verifier, VT_INDEX_COUNT) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_ENCODED_INDICES) &&
+           verifier.Verify(encoded_indices()) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_LOD_SLICE_COUNTS) &&
+           verifier.Verify(lod_slice_counts()) &&
+           verifier.EndTable();
+  }
+};
+
+struct SMeshBuilder {
+  flatbuffers::FlatBufferBuilder &fbb_;
+  flatbuffers::uoffset_t start_;
+  void add_name(flatbuffers::Offset<flatbuffers::String> name) { fbb_.AddOffset(SMesh::VT_NAME, name); }
+  void add_bounds_min(const SVector3 *bounds_min) { fbb_.AddStruct(SMesh::VT_BOUNDS_MIN, bounds_min); }
+  void add_bounds_max(const SVector3 *bounds_max) { fbb_.AddStruct(SMesh::VT_BOUNDS_MAX, bounds_max); }
+  void add_slices(flatbuffers::Offset<flatbuffers::Vector<const SSlice *>> slices) { fbb_.AddOffset(SMesh::VT_SLICES, slices); }
+  void add_material_ids(flatbuffers::Offset<flatbuffers::Vector<uint32_t>> material_ids) { fbb_.AddOffset(SMesh::VT_MATERIAL_IDS, material_ids); }
+  void add_vertices(flatbuffers::Offset<flatbuffers::Vector<float>> vertices) { fbb_.AddOffset(SMesh::VT_VERTICES, vertices); }
+  void add_indices(flatbuffers::Offset<flatbuffers::Vector<uint32_t>> indices) { fbb_.AddOffset(SMesh::VT_INDICES, indices); }
+  void add_meshlets(flatbuffers::Offset<flatbuffers::Vector<const SMeshlet *>> meshlets) { fbb_.AddOffset(SMesh::VT_MESHLETS, meshlets); }
+  void add_lod_errors(flatbuffers::Offset<flatbuffers::Vector<float>> lod_errors) { fbb_.AddOffset(SMesh::VT_LOD_ERRORS, lod_errors); }
+  void add_lod_slices(flatbuffers::Offset<flatbuffers::Vector<const SSlice *>> lod_slices) { fbb_.AddOffset(SMesh::VT_LOD_SLICES, lod_slices); }
+  void add_normals(flatbuffers::Offset<flatbuffers::Vector<float>> normals) { fbb_.AddOffset(SMesh::VT_NORMALS, normals); }
+  void add_uvs(flatbuffers::Offset<flatbuffers::Vector<float>> uvs) { fbb_.AddOffset(SMesh::VT_UVS, uvs); }
+  void add_tangents(flatbuffers::Offset<flatbuffers::Vector<float>> tangents) { fbb_.AddOffset(SMesh::VT_TANGENTS, tangents); }
+  void add_index_count(uint32_t index_count) { fbb_.AddElement<uint32_t>(SMesh::VT_INDEX_COUNT, index_count, 0); }
+  void add_encoded_indices(flatbuffers::Offset<flatbuffers::Vector<uint8_t>> encoded_indices) { fbb_.AddOffset(SMesh::VT_ENCODED_INDICES, encoded_indices); }
+  void add_lod_slice_counts(flatbuffers::Offset<flatbuffers::Vector<uint32_t>> lod_slice_counts) { fbb_.AddOffset(SMesh::VT_LOD_SLICE_COUNTS, lod_slice_counts); }
+  SMeshBuilder(flatbuffers::FlatBufferBuilder &_fbb) : fbb_(_fbb) { start_ = fbb_.StartTable(); }
+  SMeshBuilder &operator=(const SMeshBuilder &);
+  flatbuffers::Offset<SMesh> Finish() {
+    auto o = flatbuffers::Offset<SMesh>(fbb_.EndTable(start_, 16));
+    return o;
+  }
+};
+
+inline flatbuffers::Offset<SMesh> CreateSMesh(flatbuffers::FlatBufferBuilder &_fbb,
+    flatbuffers::Offset<flatbuffers::String> name = 0,
+    const SVector3 *bounds_min = 0,
+    const SVector3 *bounds_max = 0,
+    flatbuffers::Offset<flatbuffers::Vector<const SSlice *>> slices = 0,
+    flatbuffers::Offset<flatbuffers::Vector<uint32_t>> material_ids = 0,
+    flatbuffers::Offset<flatbuffers::Vector<float>> vertices = 0,
+    flatbuffers::Offset<flatbuffers::Vector<uint32_t>> indices = 0,
+    flatbuffers::Offset<flatbuffers::Vector<const SMeshlet *>> meshlets = 0,
+    flatbuffers::Offset<flatbuffers::Vector<float>> lod_errors = 0,
+    flatbuffers::Offset<flatbuffers::Vector<const SSlice *>> lod_slices = 0,
+    flatbuffers::Offset<flatbuffers::Vector<float>> normals = 0,
+    flatbuffers::Offset<flatbuffers::Vector<float>> uvs = 0,
+    flatbuffers::Offset<flatbuffers::Vector<float>> tangents = 0,
+    uint32_t index_count = 0,
+    flatbuffers::Offset<flatbuffers::Vector<uint8_t>> encoded_indices = 0,
+    flatbuffers::Offset<flatbuffers::Vector<uint32_t>> lod_slice_counts = 0) {
+  SMeshBuilder builder_(_fbb);
+  builder_.add_lod_slice_counts(lod_slice_counts);
+  builder_.add_encoded_indices(encoded_indices);
+  builder_.add_index_count(index_count);
+  builder_.add_tangents(tangents);
+  builder_.add_uvs(uvs);
+  builder_.add_normals(normals);
+  builder_.add_lod_slices(lod_slices);
+  builder_.add_lod_errors(lod_errors);
+  builder_.add_meshlets(meshlets);
+  builder_.add_indices(indices);
+  builder_.add_vertices(vertices);
+  builder_.add_material_ids(material_ids);
+  builder_.add_slices(slices);
+  builder_.add_bounds_max(bounds_max);
+  builder_.add_bounds_min(bounds_min);
+  builder_.add_name(name);
+  return builder_.Finish();
+}
+
+inline flatbuffers::Offset<SMesh> CreateSMeshDirect(flatbuffers::FlatBufferBuilder &_fbb,
+    const char *name = nullptr,
+    const SVector3 *bounds_min = 0,
+    const SVector3 *bounds_max = 0,
+    const std::vector<const SSlice *> *slices = nullptr,
+    const std::vector<uint32_t> *material_ids = nullptr,
+    const std::vector<float> *vertices = nullptr,
+    const std::vector<uint32_t> *indices = nullptr,
+    const std::vector<const SMeshlet *> *meshlets = nullptr,
+    const std::vector<float> *lod_errors = nullptr,
+    const std::vector<const SSlice *> *lod_slices = nullptr,
+    const std::vector<float> *normals = nullptr,
+    const std::vector<float> *uvs = nullptr,
+    const std::vector<float> *tangents = nullptr,
+    uint32_t index_count = 0,
+    const std::vector<uint8_t> *encoded_indices = nullptr,
+    const std::vector<uint32_t> *lod_slice_counts = nullptr) {
+  return CreateSMesh(_fbb, name ? _fbb.CreateString(name) : 0, bounds_min, bounds_max, slices ? _fbb.CreateVector<const SSlice *>(*slices) : 0, material_ids ? _fbb.CreateVector<uint32_t>(*material_ids) : 0, vertices ? _fbb.CreateVector<float>(*vertices) : 0, indices ? _fbb.CreateVector<uint32_t>(*indices) : 0, meshlets ? _fbb.CreateVector<const SMeshlet *>(*meshlets) : 0, lod_errors ? _fbb.CreateVector<float>(*lod_errors) : 0, lod_slices ? _fbb.CreateVector<const SSlice *>(*lod_slices) : 0, normals ? _fbb.CreateVector<float>(*normals) : 0, uvs ? _fbb.CreateVector<float>(*uvs) : 0, tangents ? _fbb.CreateVector<float>(*tangents) : 0, index_count, encoded_indices ? _fbb.CreateVector<uint8_t>(*encoded_indices) : 0, lod_slice_counts ? _fbb.CreateVector<uint32_t>(*lod_slice_counts) : 0);
+}
+
+struct STexture FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
+  enum {
+    VT_PATH = 4
+  };
+  const flatbuffers::String *path() const { return GetPointer<const flatbuffers::String *>(VT_PATH); }
+  bool Verify(flatbuffers::Verifier &verifier) const {
+    return VerifyTableStart(verifier) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_PATH) &&
+           verifier.Verify(path()) &&
+           verifier.EndTable();
+  }
+};
+
+struct STextureBuilder {
+  flatbuffers::FlatBufferBuilder &fbb_;
+  flatbuffers::uoffset_t start_;
+  void add_path(flatbuffers::Offset<flatbuffers::String> path) { fbb_.AddOffset(STexture::VT_PATH, path); }
+  STextureBuilder(flatbuffers::FlatBufferBuilder &_fbb) : fbb_(_fbb) { start_ = fbb_.StartTable(); }
+  STextureBuilder &operator=(const STextureBuilder &);
+  flatbuffers::Offset<STexture> Finish() {
+    auto o = flatbuffers::Offset<STexture>(fbb_.EndTable(start_, 1));
+    return o;
+  }
+};
+
+inline flatbuffers::Offset<STexture> CreateSTexture(flatbuffers::FlatBufferBuilder &_fbb,
+    flatbuffers::Offset<flatbuffers::String> path = 0) {
+  STextureBuilder builder_(_fbb);
+  builder_.add_path(path);
+  return builder_.Finish();
+}
+
+inline flatbuffers::Offset<STexture> CreateSTextureDirect(flatbuffers::FlatBufferBuilder &_fbb,
+    const char *path = nullptr) {
+  return CreateSTexture(_fbb, path ? _fbb.CreateString(path) : 0);
+}
+
+struct SMaterial FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
+  enum {
+    VT_NAME = 4,
+    VT_AMBIENT = 6,
+    VT_DIFFUSE = 8,
+    VT_SPECULAR = 10,
+    VT_SHININESS = 12,
+    VT_DIFFUSE_TEXTURE = 14
+  };
+  const flatbuffers::String *name() const { return GetPointer<const flatbuffers::String *>(VT_NAME); }
+  const SVector3 *ambient() const { return GetStruct<const SVector3 *>(VT_AMBIENT); }
+  const SVector3 *diffuse() const { return GetStruct<const SVector3 *>(VT_DIFFUSE); }
+  const SVector3 *specular() const { return GetStruct<const SVector3 *>(VT_SPECULAR); }
+  float shininess() const { return GetField<float>(VT_SHININESS, 0.0f); }
+  int32_t diffuse_texture() const { return GetField<int32_t>(VT_DIFFUSE_TEXTURE, -1); }
+  bool Verify(flatbuffers::Verifier &verifier) const {
+    return VerifyTableStart(verifier) &&
+           VerifyField<flatbuffers::uoffset_t>(verifier, VT_NAME) &&
+           verifier.Verify(name()) &&
+           VerifyField<SVector3>(verifier, VT_AMBIENT) &&
+           VerifyField<SVector3>(verifier, VT_DIFFUSE) &&
+           VerifyField<SVector3>(verifier, VT_SPECULAR) &&
+           VerifyField<float>(verifier, VT_SHININESS) &&
+           VerifyField<int32_t>(verifier, VT_DIFFUSE_TEXTURE) &&
+           verifier.EndTable();
+  }
+};
+
+struct SMaterialBuilder {
+  flatbuffers::FlatBufferBuilder &fbb_;
+  flatbuffers::uoffset_t start_;
+  void add_name(flatbuffers::Offset<flatbuffers::String> name) { fbb_.AddOffset(SMaterial::VT_NAME, name); }
+  void add_ambient(const SVector3 *ambient) { fbb_.AddStruct(SMaterial::VT_AMBIENT, ambient); }
+  void add_diffuse(const SVector3 *diffuse) { fbb_.AddStruct(SMaterial::VT_DIFFUSE, diffuse); }
+  void add_specular(const SVector3 *specular) { fbb_.AddStruct(SMaterial::VT_SPECULAR, specular); }
+  void add_shininess(float shininess) { fbb_.AddElement<float>(SMaterial::VT_SHININESS, shininess, 0.0f); }
+  void add_diffuse_texture(int32_t diffuse_texture) { fbb_.AddElement<int32_t>(SMaterial::VT_DIFFUSE_TEXTURE, diffuse_texture, -1); }
+  SMaterialBuilder(flatbuffers::FlatBufferBuilder &_fbb) : fbb_(_fbb) { start_ = fbb_.StartTable(); }
+  SMaterialBuilder &operator=(const SMaterialBuilder &);
+  flatbuffers::Offset<SMaterial> Finish() {
+    auto o = flatbuffers::Offset<SMaterial>(fbb_.EndTable(start_, 6));
+    return o;
+  }
+};
+
+inline flatbuffers::Offset<SMaterial> CreateSMaterial(flatbuffers::FlatBufferBuilder &_fbb,
+    flatbuffers::Offset<flatbuffers::String> name = 0,
+    const SVector3 *ambient = 0,
+    const SVector3 *diffuse = 0,
+    const SVector3 *specular = 0,
+    float shininess = 0.0f,
+    int32_t diffuse_texture = -1) {
+  SMaterialBuilder builder_(_fbb);
+  builder_.add_diffuse_texture(diffuse_texture);
+  builder_.add_shininess(shininess);
+  builder_.add_specular(specular);
+  builder_.add_diffuse(diffuse);
+  builder_.add_ambient(ambient);
+  builder_.add_name(name);
+  return builder_.Finish();
+}
+
+inline flatbuffers::Offset<SMaterial> CreateSMaterialDirect(flatbuffers::FlatBufferBuilder &_fbb,
+    const char *name = nullptr,
+    const SVector3 *ambient = 0,
+    const SVector3 *diffuse = 0,
+    const SVector3 *specular = 0,
+    float shininess = 0.0f,
+    int32_t diffuse_texture = -1) {
+  return CreateSMaterial(_fbb, name ? _fbb.CreateString(name) : 0, ambient, diffuse, specular, shininess, diffuse_texture);
+}
+
+struct SInstance FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
+  enum {
+    VT_MESH = 4,
+    VT_POSITION = 6,
+    VT_ROTATION = 8,
+    VT_SCALE = 10
+  };
+  uint32_t mesh() const { return GetField<uint32_t>(VT_MESH, 0); }
+  const SVector3 *position() const { return GetStruct<const SVector3 *>(VT_POSITION); }
+  const SQuaternion *rotation() const { return GetStruct<const SQuaternion *>(VT_ROTATION); }
+  const SVector3 *scale() const { return GetStruct<const SVector3 *>(VT_SCALE); }
+  bool Verify(flatbuffers::Verifier &verifier) const {
+    return VerifyTableStart(verifier) &&
+           VerifyField<uint32_t>(verifier, VT_MESH) &&
+           VerifyField<SVector3>(verifier, VT_POSITION) &&
+           VerifyField<SQuaternion>(verifier, VT_ROTATION) &&
+           VerifyField<SVector3>(verifier, VT_SCALE) &&
+           verifier.EndTable();
+  }
+};
+
+struct SInstanceBuilder {
+  flatbuffers::FlatBufferBuilder &fbb_;
+  flatbuffers::uoffset_t start_;
+  void add_mesh(uint32_t mesh) { fbb_.AddElement<uint32_t>(SInstance::VT_MESH, mesh, 0); }
+  void add_position(const SVector3 *position) { fbb_.AddStruct(SInstance::VT_POSITION, position); }
+  void add_rotation(const SQuaternion *rotation) { fbb_.AddStruct(SInstance::VT_ROTATION, rotation); }
+  void add_scale(const SVector3 *scale) { fbb_.AddStruct(SInstance::VT_SCALE, scale); }
+  SInstanceBuilder(flatbuffers::FlatBufferBuilder &_fbb) : fbb_(_fbb) { start_ = fbb_.StartTable(); }
+  SInstanceBuilder &operator=(const SInstanceBuilder &);
+  flatbuffers::Offset<SInstance> Finish() {
+    auto o = flatbuffers::Offset<SInstance>(fbb_.EndTable(start_, 4));
+    return o;
+  }
+};
+
+inline flatbuffers::Offset<SInstance> CreateSInstance(flatbuffers::FlatBufferBuilder &_fbb,
+    uint32_t mesh = 0,
+    const SVector3 *position = 0,
+    const SQuaternion *rotation = 0,
+    const SVector3 *scale = 0) {
+  SInstanceBuilder builder_(_fbb);
+  builder_.add_scale(scale);
+  builder_.add_rotation(rotation);
+  builder_.add_position(position);
+  builder_.add_mesh(mesh);
+  return builder_.Finish();
+}
+
 inline const m3d::schema::SScene *GetSScene(const void *buf) {
   return flatbuffers::GetRoot<m3d::schema::SScene>(buf);
 }
 
+inline const char *SSceneIdentifier() {
+  return "M3DS";
+}
+
+inline bool SSceneBufferHasIdentifier(const void *buf) {
+  return flatbuffers::BufferHasIdentifier(buf, SSceneIdentifier());
+}
+
 inline bool VerifySSceneBuffer(flatbuffers::Verifier &verifier) {
-  return verifier.VerifyBuffer<m3d::schema::SScene>(nullptr);
+  return verifier.VerifyBuffer<m3d::schema::SScene>(SSceneIdentifier());
 }
 
+inline const char *SSceneExtension() { return "m3ds"; }
+
 inline void FinishSSceneBuffer(flatbuffers::FlatBufferBuilder &fbb, flatbuffers::Offset<m3d::schema::SScene> root) {
-  fbb.Finish(root);
+  fbb.Finish(root, SSceneIdentifier());
 }
 
 }  // namespace schema
@@ -4,6 +4,8 @@
 #extension GL_ARB_shading_language_420pack : enable
 
 layout (location = 0) in vec4 inPos;
+// per instance, locations 1 to 4
+layout (location = 1) in mat4 inInstanceMatrix;
 
 layout (binding = 0) uniform UBO 
 {
@@ -19,6 +21,6 @@ out gl_PerVertex
 
 void main() 
 {
-	gl_Position = inPos * ubo.modelMatrix * ubo.viewMatrix * ubo.projectionMatrix;
+	gl_Position = inPos * inInstanceMatrix * ubo.viewMatrix * ubo.projectionMatrix;
 	//gl_Position = ubo.projectionMatrix * ubo.viewMatrix * ubo.modelMatrix * inPos;
 }
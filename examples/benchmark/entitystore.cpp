@@ -0,0 +1,129 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+/*
+ * Scene's packed_freelists vs EntityStore on the per frame instance update:
+ * read each instance's mesh and transform, write its world matrix. The
+ * freelists are churned first, like a scene after streaming, so instances
+ * point at transforms all over the array; the store keeps the three
+ * components of an instance next to each other whatever the history.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "EntityStore.hpp"
+#include "Scene.hpp"
+#include "ThreadPool.hpp"
+
+using namespace m3d;
+using m3d::math::Matrix4x4;
+using m3d::math::Quaternion;
+using m3d::math::Vector3;
+
+static const uint32_t kInstanceCount = 60000;
+static const uint32_t kFrameCount = 60;
+
+struct MeshRef {
+    uint32_t meshId;
+};
+
+template <class Fn>
+static double TimeFrames(Fn fn)
+{
+    const auto tStart = std::chrono::high_resolution_clock::now();
+    for (uint32_t frame = 0; frame < kFrameCount; ++frame) {
+        fn();
+    }
+    const auto tEnd = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(tEnd - tStart).count() / kFrameCount;
+}
+
+int main()
+{
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+
+    std::vector<Transform> sources(kInstanceCount);
+    for (Transform& t : sources) {
+        t.position = Vector3(position(rng), 0.0f, position(rng));
+        t.scale = Vector3(1.0f, 1.0f, 1.0f);
+        t.rotation = Quaternion(0.0f, 0.0f, 0.0f, 1.0f);
+    }
+
+    // the current layout: transforms inserted in a shuffled order and half
+    // of them reinserted, so instance order and transform order disagree
+    packed_freelist<Transform> transforms(kInstanceCount);
+    packed_freelist<Instance> instances(kInstanceCount);
+    std::vector<uint32_t> order(kInstanceCount);
+    for (uint32_t i = 0; i < kInstanceCount; ++i) {
+        order[i] = i;
+    }
+    std::shuffle(order.begin(), order.end(), rng);
+    std::vector<uint32_t> transformIds(kInstanceCount);
+    for (uint32_t i : order) {
+        transformIds[i] = transforms.insert(sources[i]);
+    }
+    for (uint32_t i = 0; i < kInstanceCount; i += 2) {
+        transforms.erase(transformIds[order[i]]);
+        transformIds[order[i]] = transforms.insert(sources[order[i]]);
+    }
+    for (uint32_t i = 0; i < kInstanceCount; ++i) {
+        Instance instance = { i % 512, transformIds[i] };
+        instances.insert(instance);
+    }
+
+    EntityStore store;
+    for (uint32_t i = 0; i < kInstanceCount; ++i) {
+        store.Create(MeshRef{ i % 512 }, sources[i], Matrix4x4());
+    }
+
+    std::vector<Matrix4x4> worlds(kInstanceCount);
+    uint64_t meshSum = 0;
+
+    const double freelistMs = TimeFrames([&]() {
+        size_t item = 0;
+        for (uint32_t instanceId : instances) {
+            const Instance& instance = instances[instanceId];
+            meshSum += instance.meshId;
+            worlds[item++] = GetWorldMatrix(transforms[instance.transformId]);
+        }
+    });
+
+    const double storeMs = TimeFrames([&]() {
+        store.ForEach<MeshRef, Transform, Matrix4x4>([&](uint32_t, const MeshRef& mesh, const Transform& transform, Matrix4x4& world) {
+            meshSum += mesh.meshId;
+            world = GetWorldMatrix(transform);
+        });
+    });
+
+    ThreadPool& pool = ThreadPool::Shared();
+    const double parallelMs = TimeFrames([&]() {
+        store.ParallelForEach<Transform, Matrix4x4>(pool, [](uint32_t, const Transform& transform, Matrix4x4& world) {
+            world = GetWorldMatrix(transform);
+        });
+    });
+
+    const double freelistParallelMs = TimeFrames([&]() {
+        instances.parallel_for_each(pool, [&](const Instance* slice, const uint32_t*, size_t first, size_t count) {
+            for (size_t i = 0; i < count; ++i) {
+                worlds[first + i] = GetWorldMatrix(transforms[slice[i].transformId]);
+            }
+        }, 1024);
+    });
+
+    printf("%u instances, %u threads\n", kInstanceCount, pool.GetWorkerCount() + 1);
+    printf("%-24s %10s %10s\n", "", "ms/frame", "speedup");
+    printf("%-24s %10.3f %10s\n", "packed_freelist lookups", freelistMs, "1.0x");
+    printf("%-24s %10.3f %9.1fx\n", "parallel_for_each", freelistParallelMs, freelistMs / freelistParallelMs);
+    printf("%-24s %10.3f %9.1fx\n", "EntityStore::ForEach", storeMs, freelistMs / storeMs);
+    printf("%-24s %10.3f %9.1fx\n", "ParallelForEach", parallelMs, freelistMs / parallelMs);
+    // keeps the loops from being optimized away
+    printf("(%llu)\n", static_cast<unsigned long long>(meshSum));
+    return 0;
+}
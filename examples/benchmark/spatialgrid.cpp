@@ -0,0 +1,110 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+/*
+ * SpatialGrid vs brute force, at different ratios of instances moving per frame.
+ * Each frame moves the moving set, then runs one frustum query and a batch of
+ * small AABB queries, the typical culling plus gameplay proximity workload.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "SpatialGrid.hpp"
+
+using namespace m3d;
+using m3d::math::Vector3;
+
+static const uint32_t kObjectCount = 60000;
+static const uint32_t kFrameCount = 60;
+static const uint32_t kProximityQueries = 256;
+static const float kWorldSize = 2000.0f;
+
+static AABB MakeBox(const Vector3& center, float halfSize)
+{
+    AABB box;
+    box.min = center - halfSize;
+    box.max = center + halfSize;
+    return box;
+}
+
+int main()
+{
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> position(-kWorldSize * 0.5f, kWorldSize * 0.5f);
+    std::uniform_real_distribution<float> step(-2.0f, 2.0f);
+    std::uniform_real_distribution<float> size(0.25f, 3.0f);
+
+    std::vector<AABB> bounds(kObjectCount);
+    for (auto& b : bounds) {
+        b = MakeBox(Vector3(position(rng), position(rng) * 0.05f, position(rng)), size(rng));
+    }
+
+    const Frustum frustum = Frustum::FromPerspective(Vector3(0.0f, 10.0f, 0.0f), Vector3(0.0f, 10.0f, -1.0f), Vector3(0.0f, 1.0f, 0.0f), 60.0f, 16.0f / 9.0f, 0.1f, 500.0f);
+    std::vector<Vector3> probes(kProximityQueries);
+    for (auto& p : probes) {
+        p = Vector3(position(rng), 0.0f, position(rng));
+    }
+
+    const float motionRatios[] = { 0.0f, 0.01f, 0.1f, 0.5f, 1.0f };
+    printf("%8s %14s %14s %10s\n", "moving", "brute (ms)", "grid (ms)", "speedup");
+
+    for (float ratio : motionRatios) {
+        const uint32_t movingCount = static_cast<uint32_t>(kObjectCount * ratio);
+        std::vector<AABB> world = bounds;
+
+        SpatialGrid grid;
+        grid.Init(8.0f, kObjectCount, 1 << 16);
+        for (uint32_t i = 0; i < kObjectCount; ++i) {
+            grid.Insert(i, world[i]);
+        }
+
+        size_t bruteHits = 0, gridHits = 0;
+        double bruteMs = 0.0, gridMs = 0.0;
+
+        for (uint32_t frame = 0; frame < kFrameCount; ++frame) {
+            for (uint32_t i = 0; i < movingCount; ++i) {
+                const Vector3 delta(step(rng), 0.0f, step(rng));
+                world[i].min += delta;
+                world[i].max += delta;
+            }
+
+            auto tStart = std::chrono::high_resolution_clock::now();
+            for (const auto& b : world) {
+                bruteHits += Intersects(frustum, b) ? 1 : 0;
+            }
+            for (const auto& p : probes) {
+                const AABB query = MakeBox(p, 16.0f);
+                for (const auto& b : world) {
+                    bruteHits += Intersects(query, b) ? 1 : 0;
+                }
+            }
+            auto tEnd = std::chrono::high_resolution_clock::now();
+            bruteMs += std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+
+            tStart = std::chrono::high_resolution_clock::now();
+            for (uint32_t i = 0; i < movingCount; ++i) {
+                grid.Move(i, world[i]);
+            }
+            grid.QueryFrustum(frustum, [&gridHits](uint32_t, const AABB&, Containment) { ++gridHits; });
+            for (const auto& p : probes) {
+                grid.QueryAABB(MakeBox(p, 16.0f), [&gridHits](uint32_t, const AABB&) { ++gridHits; });
+            }
+            tEnd = std::chrono::high_resolution_clock::now();
+            gridMs += std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+        }
+
+        printf("%7.0f%% %14.3f %14.3f %9.1fx%s\n",
+            ratio * 100.0f,
+            bruteMs / kFrameCount,
+            gridMs / kFrameCount,
+            bruteMs / gridMs,
+            bruteHits == gridHits ? "" : "  (MISMATCH)");
+    }
+
+    return 0;
+}
@@ -25,6 +25,10 @@
 
 #include "RendererVulkan.hpp"
 #include "Scene.hpp"
+#include "SceneAsset.hpp"
+#ifdef M3D_FBX_IMPORT
+#include "SceneLoader.hpp"
+#endif
 
 //VulkanExample *vulkanExample;
 m3d::RendererVulkan* renderer;
@@ -41,19 +45,37 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR pCmdLin
     m3d::Scene scene;
     scene.Init();
 
-    // fill the Scene
-    std::vector<uint32_t> loadedMeshIds;
-    LoadMeshes(&scene, &loadedMeshIds);
-    for (auto& meshId : loadedMeshIds) {
-        uint32_t instanceId;
-        AddInstance(scene, meshId, &instanceId);
-        // do some translation
+    // fill the Scene, a cooked scene (see fbxconv) is mapped in place, otherwise import the FBX in the background
+    const bool cooked = m3d::LoadSceneAsset(scene, "scene.m3ds");
+#ifdef M3D_FBX_IMPORT
+    m3d::SceneLoader loader;
+    if (!cooked) {
+        loader.Start(scene.loadPath);
+    }
+#else
+    if (!cooked) {
+        printf("scene.m3ds not found, cook one with fbxconv\n");
+        return -1;
     }
+#endif
 
     renderer = new m3d::RendererVulkan();
     renderer->createWin32Window(hInstance, WndProc, 1280, 720);
     renderer->Init(&scene);
-    renderer->DrawLoop();
+    renderer->DrawLoop([&]() {
+#ifdef M3D_FBX_IMPORT
+        std::vector<uint32_t> loadedMeshIds;
+        if (loader.Publish(scene, &loadedMeshIds) == 0) {
+            return;
+        }
+        for (auto& meshId : loadedMeshIds) {
+            uint32_t instanceId;
+            AddInstance(scene, meshId, &instanceId);
+            // do some translation
+        }
+        renderer->OnSceneChanged();
+#endif
+    });
 
     delete (renderer);
 
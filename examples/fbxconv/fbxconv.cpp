@@ -0,0 +1,402 @@
+/*
+* Copyright (C) 2017 Tracy Ma
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+/*
+ * fbxconv, the offline scene cooker:
+ *
+ *   fbxconv [-weld epsilon] [-lods count] [-batch cellsize] [-rawindices] input.fbx [output.m3ds]
+ *
+ * -weld  also merge vertices whose position, normal and uv are equal once
+ *        snapped to a grid of that size, the importer only merges exact
+ *        duplicates
+ * -lods  at most this many levels of detail below the full mesh, 4 by
+ *        default, 0 for none, 15 at most
+ * -batch  merge the static geometry into one mesh per material and grid
+ *        cell of this size, transforms applied, so the renderer draws a cell
+ *        of small meshes with one command per material and still culls cells
+ * -rawindices  store index buffers uncompressed, mapped in place at load
+ *        instead of decoded
+ *
+ * Imports the FBX file once, runs the mesh processing stages (welding, index
+ * and vertex order optimization, levels of detail, 16 bit index slices,
+ * meshlets, tangents) and writes a cooked scene asset (see SceneAsset.hpp). The runtime maps that
+ * file in place and never needs the FBX SDK. Every mesh gets one instance at the origin, like the FBX path of
+ * the viewer; meshes with identical content are stored once, with an instance each.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "FbxImport.hpp"
+#include "MeshOptimizer.hpp"
+#include "Meshlet.hpp"
+#include "RenderQueue.hpp"
+#include "Scene.hpp"
+#include "SceneAsset.hpp"
+
+using namespace m3d;
+
+struct CookOptions {
+    float weldEpsilon;
+    uint32_t maxLods;
+    bool rawIndices;
+    // 0 keeps every mesh and instance as imported
+    float batchCellSize;
+};
+
+// each level aims at half the triangles of the one before
+const uint32_t DefaultMaxLods = 4;
+// a level that saves less than this over the one before is not worth its memory
+const float MinLodReduction = 0.1f;
+
+struct CookStats {
+    uint32_t meshes;
+    uint64_t vertices;
+    uint64_t triangles;
+    uint64_t meshlets;
+    uint64_t lods;
+    uint64_t lodTriangles;
+    uint64_t slicesSplit;
+    // summed over all slices
+    VertexCacheStats cacheBefore;
+    VertexCacheStats cacheAfter;
+};
+
+static void AddCacheStats(VertexCacheStats& sum, const VertexCacheStats& stats)
+{
+    sum.triangles += stats.triangles;
+    sum.vertices += stats.vertices;
+    sum.transformed += stats.transformed;
+}
+
+/* Vertex cache then overdraw order inside each slice, then vertex fetch order for the whole mesh */
+static void OptimizeMesh(Mesh& mesh, CookStats& stats)
+{
+    const uint32_t vertexCount = static_cast<uint32_t>(mesh.vertices.size() / PositionStride);
+    for (const Mesh::Slice& slice : mesh.slices) {
+        uint32_t* indices = mesh.indices.data() + slice.indexOffset;
+        const size_t indexCount = slice.triangleCount * 3;
+
+        AddCacheStats(stats.cacheBefore, AnalyzeVertexCache(indices, indexCount, vertexCount));
+        OptimizeVertexCache(indices, indexCount, vertexCount);
+        OptimizeOverdraw(indices, indexCount, mesh.vertices.data(), vertexCount);
+        AddCacheStats(stats.cacheAfter, AnalyzeVertexCache(indices, indexCount, vertexCount));
+    }
+    OptimizeVertexFetch(mesh.vertices, mesh.normals, mesh.uvs, mesh.indices);
+}
+
+/*
+ * Simplifies every slice of the full mesh on its own, so material borders
+ * stay closed, at 1/2, 1/4, ... of its triangles. The levels index the
+ * optimized vertex buffer and get their own cache order.
+ */
+static void BuildLods(Mesh& mesh, const CookOptions& options, CookStats& stats)
+{
+    const uint32_t vertexCount = static_cast<uint32_t>(mesh.vertices.size() / PositionStride);
+    const m3d::math::Vector3 extent = mesh.bounds.max - mesh.bounds.min;
+    // no error limit to speak of, the runtime picks levels by their error
+    const float maxError = std::sqrt(extent | extent);
+    const float* normals = mesh.normals.size() == vertexCount * NormalStride ? mesh.normals.data() : nullptr;
+    const float* uvs = mesh.uvs.size() == vertexCount * UVStride ? mesh.uvs.data() : nullptr;
+
+    mesh.lods.clear();
+    size_t previousCount = mesh.indices.size();
+    std::vector<uint32_t> lodIndices;
+    for (uint32_t level = 1; level <= options.maxLods; ++level) {
+        Mesh::Lod lod;
+        lod.error = 0.0f;
+        lodIndices.clear();
+        for (const Mesh::Slice& slice : mesh.slices) {
+            const size_t indexCount = slice.triangleCount * 3;
+            const size_t offset = lodIndices.size();
+            lodIndices.resize(offset + indexCount);
+
+            float error = 0.0f;
+            const size_t count = SimplifyMesh(lodIndices.data() + offset, mesh.indices.data() + slice.indexOffset, indexCount,
+                mesh.vertices.data(), normals, uvs, vertexCount, (indexCount >> level) / 3 * 3, maxError, &error);
+            lodIndices.resize(offset + count);
+            lod.error = std::max(lod.error, error);
+            OptimizeVertexCache(lodIndices.data() + offset, count, vertexCount);
+            OptimizeOverdraw(lodIndices.data() + offset, count, mesh.vertices.data(), vertexCount);
+            lod.slices.emplace_back(static_cast<int>(mesh.indices.size() + offset), static_cast<int>(count / 3), slice.material);
+        }
+
+        if (lodIndices.size() > previousCount * (1.0f - MinLodReduction))
+            break;
+        previousCount = lodIndices.size();
+        mesh.indices.insert(mesh.indices.end(), lodIndices.begin(), lodIndices.end());
+        mesh.lods.push_back(std::move(lod));
+
+        stats.lods += 1;
+        stats.lodTriangles += lodIndices.size() / 3;
+    }
+}
+
+/*
+ * Cuts the slices of every level where their vertices span more than 16 bit
+ * indices can address, so the renderer can upload 16 bit indices relative to
+ * each slice's baseVertex. Meshlets are built afterwards and stay inside one
+ * slice.
+ */
+static void SplitSlices(Mesh& mesh, CookStats& stats)
+{
+    std::vector<IndexWindow> windows;
+    std::vector<Mesh::Slice> split;
+    for (uint32_t lod = 0; lod < mesh.GetLodCount(); ++lod) {
+        std::vector<Mesh::Slice>& slices = lod == 0 ? mesh.slices : mesh.lods[lod - 1].slices;
+        split.clear();
+        for (const Mesh::Slice& slice : slices) {
+            windows.clear();
+            SplitFor16BitIndices(mesh.indices.data() + slice.indexOffset, slice.triangleCount * 3, windows);
+            for (const IndexWindow& window : windows) {
+                Mesh::Slice part(slice.indexOffset + window.indexOffset, window.triangleCount, slice.material);
+                part.baseVertex = window.baseVertex;
+                split.push_back(part);
+            }
+            stats.slicesSplit += windows.size() > 1 ? windows.size() - 1 : 0;
+        }
+        slices.swap(split);
+    }
+}
+
+/* Cluster culling data, built on the final index order of every level */
+static void BuildMeshMeshlets(Mesh& mesh, CookStats& stats)
+{
+    const uint32_t vertexCount = static_cast<uint32_t>(mesh.vertices.size() / PositionStride);
+    mesh.meshlets.clear();
+    for (uint32_t lod = 0; lod < mesh.GetLodCount(); ++lod) {
+        for (Mesh::Slice& slice : lod == 0 ? mesh.slices : mesh.lods[lod - 1].slices) {
+            slice.firstMeshlet = static_cast<uint32_t>(mesh.meshlets.size());
+            slice.meshletCount = BuildMeshlets(mesh.vertices.data(), vertexCount, mesh.indices.data(), slice.indexOffset,
+                slice.triangleCount, mesh.meshlets);
+        }
+    }
+    stats.meshlets += mesh.meshlets.size();
+}
+
+/* Processing between extraction and writing, in place */
+static void CookMesh(Mesh& mesh, const CookOptions& options, CookStats& stats)
+{
+    if (options.weldEpsilon > 0.0f) {
+        WeldVertices(mesh.vertices, mesh.normals, mesh.uvs, mesh.indices, options.weldEpsilon);
+    }
+    OptimizeMesh(mesh, stats);
+    // the full mesh, before the levels add their indices
+    const size_t indexCount = mesh.indices.size();
+    BuildLods(mesh, options, stats);
+    SplitSlices(mesh, stats);
+    for (uint32_t lod = 0; lod < mesh.GetLodCount(); ++lod) {
+        if (mesh.GetSlices(lod).size() > sortkey::MaxSliceCount) {
+            printf("fbxconv: %s has %zu slices in level %u, the runtime loads at most %u\n", mesh.name.c_str(),
+                mesh.GetSlices(lod).size(), lod, sortkey::MaxSliceCount);
+        }
+    }
+    BuildMeshMeshlets(mesh, stats);
+    // the vertex order is final; tangents built here save the runtime the work
+    const size_t vertexCount = mesh.vertices.size() / PositionStride;
+    if (mesh.normals.size() == vertexCount * NormalStride && mesh.uvs.size() == vertexCount * UVStride) {
+        ComputeTangents(mesh.vertices, mesh.normals, mesh.uvs, mesh.indices, mesh.tangents);
+    }
+
+    stats.meshes += 1;
+    stats.vertices += mesh.vertices.size() / PositionStride;
+    stats.triangles += indexCount / 3;
+}
+
+struct BatchKey {
+    int32_t cell[3];
+    uint32_t materialId;
+    bool hasNormals;
+    bool hasUVs;
+
+    bool operator<(const BatchKey& other) const
+    {
+        return std::tie(cell[0], cell[1], cell[2], materialId, hasNormals, hasUVs)
+            < std::tie(other.cell[0], other.cell[1], other.cell[2], other.materialId, other.hasNormals, other.hasUVs);
+    }
+};
+
+/*
+ * Static batching, before cooking: every instance's slices are moved to
+ * world space and appended to the batch of their material and of the grid
+ * cell holding the instance's bounds center, meshes are never split across
+ * cells. The batches replace the instances, their transforms and meshes.
+ * Everything fbxconv imports is static, the FBX path has no animation.
+ * Fails without changing the scene when the batches do not fit in it.
+ */
+static bool BatchStaticInstances(Scene& scene, float cellSize, uint32_t* batchCount)
+{
+    std::map<BatchKey, Mesh> batches;
+    std::vector<uint32_t> instanceIds;
+    std::vector<uint32_t> meshIds;
+    for (uint32_t instanceId : scene.instances) {
+        const Instance& instance = scene.instances[instanceId];
+        const Mesh& mesh = scene.meshes[instance.meshId];
+        const uint32_t vertexCount = static_cast<uint32_t>(mesh.vertices.size() / PositionStride);
+        const m3d::math::Matrix4x4 world = GetWorldMatrix(scene.transforms[instance.transformId]);
+        const m3d::math::Vector3 center = GetInstanceBounds(scene, instanceId).Center();
+
+        BatchKey key;
+        key.cell[0] = static_cast<int32_t>(std::floor(center.x / cellSize));
+        key.cell[1] = static_cast<int32_t>(std::floor(center.y / cellSize));
+        key.cell[2] = static_cast<int32_t>(std::floor(center.z / cellSize));
+        key.hasNormals = mesh.normals.size() == vertexCount * NormalStride;
+        key.hasUVs = mesh.uvs.size() == vertexCount * UVStride;
+        for (const Mesh::Slice& slice : mesh.slices) {
+            key.materialId = slice.material < mesh.materialIds.size() ? mesh.materialIds[slice.material] : ImportNone;
+            Mesh& batch = batches[key];
+            AppendTransformed(world.m, mesh.vertices.data(), key.hasNormals ? mesh.normals.data() : nullptr,
+                key.hasUVs ? mesh.uvs.data() : nullptr, vertexCount, mesh.indices.data() + slice.indexOffset,
+                slice.triangleCount * 3, batch.vertices, batch.normals, batch.uvs, batch.indices);
+        }
+        instanceIds.push_back(instanceId);
+        meshIds.push_back(instance.meshId);
+    }
+
+    // instances of duplicates share meshes
+    std::sort(meshIds.begin(), meshIds.end());
+    meshIds.erase(std::unique(meshIds.begin(), meshIds.end()), meshIds.end());
+    // every batch takes a mesh, an instance and a transform
+    const size_t meshCount = scene.meshes.size() - meshIds.size() + batches.size();
+    const size_t instanceCount = scene.instances.size() - instanceIds.size() + batches.size();
+    const size_t transformCount = scene.transforms.size() - instanceIds.size() + batches.size();
+    if (meshCount > scene.meshes.capacity() || instanceCount > scene.instances.capacity()
+        || transformCount > scene.transforms.capacity()) {
+        printf("fbxconv: %zu batches do not fit in the scene, use a bigger -batch cell size\n", batches.size());
+        return false;
+    }
+
+    for (uint32_t instanceId : instanceIds) {
+        scene.transforms.erase(scene.instances[instanceId].transformId);
+        scene.instances.erase(instanceId);
+    }
+    for (uint32_t meshId : meshIds) {
+        scene.meshes.erase(meshId);
+    }
+
+    *batchCount = 0;
+    for (auto& entry : batches) {
+        Mesh& batch = entry.second;
+        batch.name = "batch" + std::to_string(*batchCount);
+        batch.slices.emplace_back(0, static_cast<int>(batch.indices.size() / 3), 0);
+        if (entry.first.materialId != ImportNone)
+            batch.materialIds.push_back(entry.first.materialId);
+        batch.bounds = AABB::Empty();
+        for (size_t v = 0; v < batch.vertices.size(); v += PositionStride) {
+            batch.bounds.Expand(m3d::math::Vector3(batch.vertices[v], batch.vertices[v + 1], batch.vertices[v + 2]));
+        }
+        AddInstance(scene, scene.meshes.insert(std::move(batch)), nullptr);
+        ++*batchCount;
+    }
+    return true;
+}
+
+static std::string DefaultOutputPath(const std::string& input)
+{
+    const size_t dot = input.find_last_of('.');
+    const size_t slash = input.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return input + ".m3ds";
+    }
+    return input.substr(0, dot) + ".m3ds";
+}
+
+int main(int argc, char** argv)
+{
+    CookOptions options = {};
+    options.maxLods = DefaultMaxLods;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "-weld" && i + 1 < argc) {
+            options.weldEpsilon = static_cast<float>(std::atof(argv[++i]));
+        } else if (arg == "-rawindices") {
+            options.rawIndices = true;
+        } else if (arg == "-batch" && i + 1 < argc) {
+            options.batchCellSize = static_cast<float>(std::atof(argv[++i]));
+        } else if (arg == "-lods" && i + 1 < argc) {
+            // the draw sort key holds MaxLodCount levels, the full mesh is one of them
+            options.maxLods = std::min(static_cast<uint32_t>(std::atoi(argv[++i])), sortkey::MaxLodCount - 1);
+        } else if (arg[0] == '-') {
+            paths.clear();
+            break;
+        } else {
+            paths.push_back(arg);
+        }
+    }
+    if (paths.empty() || paths.size() > 2) {
+        printf("usage: %s [-weld epsilon] [-lods count] [-batch cellsize] [-rawindices] input.fbx [output.m3ds]\n", argv[0]);
+        return 1;
+    }
+    const std::string inputPath = paths[0];
+    const std::string outputPath = paths.size() == 2 ? paths[1] : DefaultOutputPath(inputPath);
+
+    const auto start = std::chrono::steady_clock::now();
+
+    Scene scene;
+    scene.Init();
+
+    ImportIds ids;
+    CookStats stats = {};
+    int reported = -1;
+    FbxImportCallbacks callbacks;
+    callbacks.onTexture = [&](DiffuseMap&& diffuseMap) { ids.AddTexture(scene, std::move(diffuseMap)); };
+    callbacks.onMaterial = [&](Material&& material) { ids.AddMaterial(scene, std::move(material)); };
+    callbacks.onMesh = [&](Mesh&& mesh) {
+        // batches are cooked once merged
+        if (options.batchCellSize <= 0.0f)
+            CookMesh(mesh, options, stats);
+        AddInstance(scene, ids.AddMesh(scene, std::move(mesh)), nullptr);
+    };
+    callbacks.onProgress = [&](float progress) {
+        const int percent = static_cast<int>(progress * 100.0f);
+        if (percent / 10 != reported / 10) {
+            printf("cooking %s: %d%%\n", inputPath.c_str(), percent);
+            reported = percent;
+        }
+        return true;
+    };
+
+    if (!ImportFbx(inputPath.c_str(), callbacks)) {
+        printf("fbxconv: can not import %s\n", inputPath.c_str());
+        return 1;
+    }
+    uint32_t batchedInstances = 0;
+    uint32_t batches = 0;
+    if (options.batchCellSize > 0.0f) {
+        batchedInstances = static_cast<uint32_t>(scene.instances.size());
+        if (!BatchStaticInstances(scene, options.batchCellSize, &batches))
+            return 1;
+        for (auto c = scene.meshes.get_cursor(); c; ++c) {
+            CookMesh(*c, options, stats);
+        }
+    }
+    if (!SaveSceneAsset(scene, outputPath.c_str(), !options.rawIndices)) {
+        printf("fbxconv: can not write %s\n", outputPath.c_str());
+        return 1;
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%s: %u meshes, %llu vertices, %llu triangles, %.2f s\n", outputPath.c_str(), stats.meshes,
+        static_cast<unsigned long long>(stats.vertices), static_cast<unsigned long long>(stats.triangles), seconds);
+    printf("duplicates merged: %u meshes, %u materials, %u textures\n", ids.duplicateMeshes, ids.duplicateMaterials,
+        ids.duplicateTextures);
+    if (options.batchCellSize > 0.0f)
+        printf("static batches: %u instances merged into %u meshes\n", batchedInstances, batches);
+    printf("meshlets: %llu\n", static_cast<unsigned long long>(stats.meshlets));
+    printf("levels of detail: %llu, %llu triangles\n", static_cast<unsigned long long>(stats.lods),
+        static_cast<unsigned long long>(stats.lodTriangles));
+    printf("slices split for 16 bit indices: %llu\n", static_cast<unsigned long long>(stats.slicesSplit));
+    printf("vertex cache: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", stats.cacheBefore.Acmr(), stats.cacheAfter.Acmr(),
+        stats.cacheBefore.Atvr(), stats.cacheAfter.Atvr());
+    return 0;
+}
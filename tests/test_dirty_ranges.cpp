@@ -0,0 +1,71 @@
+#include "tests/gtest/gtest.h"
+
+#include <vector>
+
+#include "DirtyRanges.hpp"
+
+using namespace m3d;
+
+TEST(DirtyRanges, MarkAndClear)
+{
+    DirtyRanges dirty;
+    EXPECT_FALSE(dirty.Any());
+    EXPECT_FALSE(dirty.IsDirty(1000));
+
+    // only the 16 LSBs of an id are the slot
+    dirty.Mark((3u << 16) | 70);
+    dirty.Mark(5);
+    EXPECT_TRUE(dirty.Any());
+    EXPECT_TRUE(dirty.IsDirty(70));
+    EXPECT_TRUE(dirty.IsDirty((7u << 16) | 5));
+    EXPECT_FALSE(dirty.IsDirty(6));
+
+    std::vector<uint32_t> slots;
+    dirty.ForEach([&](uint32_t slot) { slots.push_back(slot); });
+    ASSERT_EQ(slots.size(), 2u);
+    EXPECT_EQ(slots[0], 5u);
+    EXPECT_EQ(slots[1], 70u);
+
+    dirty.Clear();
+    EXPECT_FALSE(dirty.Any());
+    EXPECT_FALSE(dirty.IsDirty(70));
+    slots.clear();
+    dirty.ForEach([&](uint32_t slot) { slots.push_back(slot); });
+    EXPECT_TRUE(slots.empty());
+}
+
+TEST(DirtyRanges, CoalescesAcrossSmallGaps)
+{
+    DirtyRanges dirty;
+    const uint32_t marked[] = { 1, 2, 3, 6, 64, 65, 200 };
+    for (uint32_t slot : marked) {
+        dirty.Mark(slot);
+    }
+
+    std::vector<SlotRange> ranges;
+    dirty.GetRanges(ranges);
+    ASSERT_EQ(ranges.size(), 4u);
+    EXPECT_EQ(ranges[0].first, 1u);
+    EXPECT_EQ(ranges[0].count, 3u);
+    EXPECT_EQ(ranges[1].first, 6u);
+    EXPECT_EQ(ranges[2].first, 64u);
+    EXPECT_EQ(ranges[2].count, 2u);
+    EXPECT_EQ(ranges[3].first, 200u);
+
+    // 4 and 5 are copied along, 7 to 63 are too far
+    ranges.clear();
+    dirty.GetRanges(ranges, 2);
+    ASSERT_EQ(ranges.size(), 3u);
+    EXPECT_EQ(ranges[0].first, 1u);
+    EXPECT_EQ(ranges[0].count, 6u);
+    EXPECT_EQ(ranges[1].first, 64u);
+
+    // earlier ranges in the vector are left alone
+    ranges.clear();
+    SlotRange other = { 0, 1 };
+    ranges.push_back(other);
+    dirty.GetRanges(ranges, 2);
+    ASSERT_EQ(ranges.size(), 4u);
+    EXPECT_EQ(ranges[0].count, 1u);
+    EXPECT_EQ(ranges[1].first, 1u);
+}
@@ -0,0 +1,158 @@
+#include "tests/gtest/gtest.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "EntityStore.hpp"
+#include "ThreadPool.hpp"
+
+using namespace m3d;
+
+namespace {
+struct Position {
+    float x, y, z;
+};
+
+struct Velocity {
+    float x, y, z;
+};
+
+struct Tag {
+    uint32_t value;
+};
+
+// not trivially copyable, counts its live copies
+struct Owner {
+    std::shared_ptr<int> resource;
+};
+}
+
+TEST(EntityStore, CreateGetDestroy)
+{
+    EntityStore store;
+    const uint32_t a = store.Create(Position{ 1.0f, 2.0f, 3.0f }, Tag{ 7 });
+    const uint32_t b = store.Create(Position{ 4.0f, 5.0f, 6.0f });
+    EXPECT_EQ(store.GetEntityCount(), 2u);
+    EXPECT_TRUE(store.IsAlive(a));
+    EXPECT_TRUE(store.Has<Tag>(a));
+    EXPECT_FALSE(store.Has<Tag>(b));
+    EXPECT_EQ(store.Get<Velocity>(a), nullptr);
+    ASSERT_NE(store.Get<Position>(b), nullptr);
+    EXPECT_EQ(store.Get<Position>(b)->y, 5.0f);
+    EXPECT_EQ(store.Get<Tag>(a)->value, 7u);
+
+    store.Destroy(a);
+    EXPECT_FALSE(store.IsAlive(a));
+    EXPECT_EQ(store.Get<Position>(a), nullptr);
+    EXPECT_EQ(store.GetEntityCount(), 1u);
+
+    // the record is reused with another generation, the stale handle stays dead
+    const uint32_t c = store.Create(Position{ 0.0f, 0.0f, 0.0f });
+    EXPECT_EQ(c & 0xFFFF, a & 0xFFFF);
+    EXPECT_NE(c, a);
+    EXPECT_FALSE(store.IsAlive(a));
+    EXPECT_TRUE(store.IsAlive(c));
+}
+
+TEST(EntityStore, AddRemoveKeepsHandlesAndValues)
+{
+    EntityStore store;
+    std::vector<uint32_t> ids;
+    for (uint32_t i = 0; i < 1000; ++i) {
+        ids.push_back(store.Create(Position{ float(i), 0.0f, 0.0f }, Tag{ i }));
+    }
+    // every other entity gains a velocity and loses its tag
+    for (uint32_t i = 0; i < ids.size(); i += 2) {
+        store.Add(ids[i], Velocity{ 1.0f, 0.0f, 0.0f });
+        store.Remove<Tag>(ids[i]);
+    }
+    for (uint32_t i = 0; i < ids.size(); ++i) {
+        ASSERT_TRUE(store.IsAlive(ids[i]));
+        EXPECT_EQ(store.Get<Position>(ids[i])->x, float(i));
+        EXPECT_EQ(store.Has<Velocity>(ids[i]), i % 2 == 0);
+        EXPECT_EQ(store.Has<Tag>(ids[i]), i % 2 == 1);
+        if (i % 2) {
+            EXPECT_EQ(store.Get<Tag>(ids[i])->value, i);
+        }
+    }
+
+    // adding a component the entity has only sets it
+    store.Add(ids[1], Tag{ 42 });
+    EXPECT_EQ(store.Get<Tag>(ids[1])->value, 42u);
+}
+
+TEST(EntityStore, IteratesMatchingArchetypes)
+{
+    EntityStore store;
+    std::vector<uint32_t> moving;
+    for (uint32_t i = 0; i < 3000; ++i) {
+        const uint32_t id = store.Create(Position{ 0.0f, 0.0f, 0.0f });
+        if (i % 3 == 0) {
+            store.Add(id, Velocity{ 1.0f, 2.0f, 3.0f });
+            moving.push_back(id);
+        }
+    }
+    // holes from destroyed entities are filled, chunks stay packed
+    for (size_t i = 0; i < moving.size(); i += 4) {
+        store.Destroy(moving[i]);
+    }
+
+    uint32_t visited = 0;
+    store.ForEach<Position, Velocity>([&](uint32_t, Position& p, const Velocity& v) {
+        p.x += v.x;
+        p.y += v.y;
+        ++visited;
+    });
+    EXPECT_EQ(visited, 750u);
+
+    uint32_t positions = 0;
+    store.ForEachChunk<Position>([&](uint32_t count, const uint32_t* entities, Position*) {
+        for (uint32_t i = 0; i < count; ++i) {
+            EXPECT_TRUE(store.IsAlive(entities[i]));
+        }
+        positions += count;
+    });
+    EXPECT_EQ(positions, store.GetEntityCount());
+
+    for (size_t i = 0; i < moving.size(); ++i) {
+        const Position* p = store.Get<Position>(moving[i]);
+        if (i % 4 == 0) {
+            EXPECT_EQ(p, nullptr);
+        } else {
+            ASSERT_NE(p, nullptr);
+            EXPECT_EQ(p->x, 1.0f);
+            EXPECT_EQ(p->y, 2.0f);
+        }
+    }
+
+    ThreadPool pool(3);
+    std::atomic<uint32_t> parallel(0);
+    store.ParallelForEach<Position, Velocity>(pool, [&](uint32_t, Position& p, const Velocity& v) {
+        p.z += v.z;
+        parallel.fetch_add(1);
+    });
+    EXPECT_EQ(parallel.load(), 750u);
+    EXPECT_EQ(store.Get<Position>(moving[1])->z, 3.0f);
+}
+
+TEST(EntityStore, MovesAndDestroysComponents)
+{
+    std::shared_ptr<int> resource = std::make_shared<int>(5);
+    {
+        EntityStore store;
+        std::vector<uint32_t> ids;
+        for (int i = 0; i < 100; ++i) {
+            ids.push_back(store.Create(Owner{ resource }));
+        }
+        EXPECT_EQ(resource.use_count(), 101);
+        // archetype changes move, they neither copy nor leak
+        store.Add(ids[0], Tag{ 1 });
+        store.Remove<Owner>(ids[1]);
+        EXPECT_EQ(resource.use_count(), 100);
+        store.Destroy(ids[2]);
+        EXPECT_EQ(resource.use_count(), 99);
+        EXPECT_EQ(*store.Get<Owner>(ids[0])->resource, 5);
+    }
+    EXPECT_EQ(resource.use_count(), 1);
+}
@@ -0,0 +1,98 @@
+#include "tests/gtest/gtest.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+#include "File.hpp"
+
+using namespace m3d::file;
+
+static std::string WriteTempFile(const std::vector<uint8_t>& bytes)
+{
+    const std::string path = "m3d_test_file.bin";
+    std::FILE* fp = std::fopen(path.c_str(), "wb");
+    if (!bytes.empty())
+        std::fwrite(bytes.data(), 1, bytes.size(), fp);
+    std::fclose(fp);
+    return path;
+}
+
+TEST(File, MappedFileViews)
+{
+    std::vector<uint8_t> bytes(10000);
+    for (size_t i = 0; i < bytes.size(); ++i)
+        bytes[i] = static_cast<uint8_t>(i * 7);
+    const std::string path = WriteTempFile(bytes);
+
+    MappedFile file;
+    ASSERT_TRUE(file.Open(path.c_str(), Access::Sequential));
+    ASSERT_EQ(file.Size(), bytes.size());
+    EXPECT_EQ(0, memcmp(file.Data(), bytes.data(), bytes.size()));
+
+    file.Advise(Access::WillNeed, 4097, 100);
+    m3d::ArrayView<uint8_t> view = file.View(9990, 100);
+    ASSERT_EQ(view.size(), 10u);
+    EXPECT_EQ(view[3], bytes[9993]);
+    EXPECT_TRUE(file.View(20000, 1).empty());
+
+    // moving keeps the data valid
+    MappedFile moved(std::move(file));
+    EXPECT_FALSE(file.IsOpen());
+    EXPECT_EQ(moved.Data()[5000], bytes[5000]);
+
+    std::vector<uint8_t> copy;
+    ASSERT_TRUE(readBinary(path.c_str(), copy));
+    EXPECT_EQ(copy, bytes);
+
+    moved.Close();
+    std::remove(path.c_str());
+}
+
+TEST(File, EmptyAndMissingFiles)
+{
+    const std::string path = WriteTempFile(std::vector<uint8_t>());
+    MappedFile file;
+    EXPECT_TRUE(file.Open(path.c_str()));
+    EXPECT_EQ(file.Size(), 0u);
+    file.Close();
+    std::remove(path.c_str());
+
+    EXPECT_FALSE(file.Open("m3d_test_does_not_exist.bin"));
+    EXPECT_FALSE(file.IsOpen());
+}
+
+#ifndef _WIN32
+TEST(File, PipesAreReadToTheEnd)
+{
+    const std::string path = "m3d_test_file.fifo";
+    std::remove(path.c_str());
+    ASSERT_EQ(mkfifo(path.c_str(), 0600), 0);
+
+    // more than the first read buffer, so it has to grow
+    std::vector<uint8_t> bytes(200000);
+    for (size_t i = 0; i < bytes.size(); ++i)
+        bytes[i] = static_cast<uint8_t>(i * 13);
+    std::thread writer([&]() {
+        std::FILE* fp = std::fopen(path.c_str(), "wb");
+        std::fwrite(bytes.data(), 1, bytes.size(), fp);
+        std::fclose(fp);
+    });
+
+    MappedFile file;
+    const bool opened = file.Open(path.c_str());
+    writer.join();
+    ASSERT_TRUE(opened);
+    EXPECT_FALSE(file.IsMapped());
+    ASSERT_EQ(file.Size(), bytes.size());
+    EXPECT_EQ(0, memcmp(file.Data(), bytes.data(), bytes.size()));
+    file.Close();
+    std::remove(path.c_str());
+}
+#endif
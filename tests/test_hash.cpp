@@ -0,0 +1,38 @@
+#include "tests/gtest/gtest.h"
+
+#include <cstring>
+#include <vector>
+
+#include "Hash.hpp"
+
+using namespace m3d;
+
+TEST(Hash, ReferenceValues)
+{
+    // XXH64 with seed 0
+    EXPECT_EQ(HashBytes("", 0), 0xEF46DB3751D8E999ULL);
+    EXPECT_EQ(HashBytes("a", 1), 0xD24EC4F1A98C6E5BULL);
+    EXPECT_EQ(HashBytes("abc", 3), 0x44BC2CF5AD770999ULL);
+}
+
+TEST(Hash, EveryByteCounts)
+{
+    // long enough for the four lane loop and every tail length
+    std::vector<uint8_t> data(100);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<uint8_t>(i * 7);
+    }
+    for (size_t size = 1; size <= data.size(); ++size) {
+        const uint64_t hash = HashBytes(data.data(), size);
+        EXPECT_NE(hash, HashBytes(data.data(), size - 1));
+        data[size - 1] ^= 1;
+        EXPECT_NE(hash, HashBytes(data.data(), size));
+        data[size - 1] ^= 1;
+        EXPECT_EQ(hash, HashBytes(data.data(), size));
+    }
+    EXPECT_NE(HashBytes(data.data(), data.size(), 1), HashBytes(data.data(), data.size(), 2));
+
+    // array boundaries are part of a chained hash
+    const std::vector<int> a = { 1 }, bc = { 2, 3 }, ab = { 1, 2 }, c = { 3 };
+    EXPECT_NE(HashArray(bc, HashArray(a)), HashArray(c, HashArray(ab)));
+}
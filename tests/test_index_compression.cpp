@@ -0,0 +1,60 @@
+#include "tests/gtest/gtest.h"
+
+#include <vector>
+
+#include "IndexCompression.hpp"
+#include "MeshOptimizer.hpp"
+
+using namespace m3d;
+
+static std::vector<uint32_t> RoundTrip(const std::vector<uint32_t>& indices, size_t* encodedSize = nullptr)
+{
+    std::vector<uint8_t> encoded;
+    EncodeIndexBuffer(indices.data(), indices.size(), encoded);
+    if (encodedSize)
+        *encodedSize = encoded.size();
+    std::vector<uint32_t> decoded(indices.size(), 0xDEADBEEF);
+    EXPECT_TRUE(DecodeIndexBuffer(decoded.data(), decoded.size(), encoded.data(), encoded.size()));
+    return decoded;
+}
+
+TEST(IndexCompression, RoundTripAllBlockModes)
+{
+    std::vector<uint32_t> indices;
+    // small steps, medium steps, huge jumps both ways and a tail
+    for (uint32_t i = 0; i < 64; ++i)
+        indices.push_back(i / 2);
+    for (uint32_t i = 0; i < 32; ++i)
+        indices.push_back(i % 2 ? 1000 * i : 30000);
+    for (uint32_t i = 0; i < 32; ++i)
+        indices.push_back(i % 2 ? 0xFFFFFFF0u : 3u);
+    indices.insert(indices.end(), { 7, 0x80000000u, 9 });
+
+    EXPECT_EQ(RoundTrip(indices), indices);
+    EXPECT_TRUE(RoundTrip(std::vector<uint32_t>()).empty());
+}
+
+TEST(IndexCompression, CompressesOptimizedMesh)
+{
+    // a 64 x 64 quad grid in row order
+    std::vector<uint32_t> indices;
+    for (uint32_t y = 0; y < 64; ++y) {
+        for (uint32_t x = 0; x < 64; ++x) {
+            const uint32_t v = y * 65 + x;
+            indices.insert(indices.end(), { v, v + 1, v + 66, v, v + 66, v + 65 });
+        }
+    }
+    size_t encodedSize = 0;
+    EXPECT_EQ(RoundTrip(indices, &encodedSize), indices);
+    // about a byte per index instead of four
+    EXPECT_LT(encodedSize, indices.size() * 3 / 2);
+}
+
+TEST(IndexCompression, RejectsTruncatedData)
+{
+    std::vector<uint32_t> indices(40, 100000);
+    std::vector<uint8_t> encoded;
+    EncodeIndexBuffer(indices.data(), indices.size(), encoded);
+    std::vector<uint32_t> decoded(indices.size());
+    EXPECT_FALSE(DecodeIndexBuffer(decoded.data(), decoded.size(), encoded.data(), encoded.size() - 1));
+}
@@ -0,0 +1,93 @@
+#include "tests/gtest/gtest.h"
+
+#include <string>
+
+#include "MemoryBudget.hpp"
+
+using namespace m3d;
+
+TEST(MemoryBudget, ReportSumsAssetsAndCategories)
+{
+    MemoryReport report;
+    report.AddAsset(MemoryMeshes, 3, "rock", 100, 0);
+    report.AddAsset(MemoryTextures, 3, "rock.png", 10, 4000);
+    // the renderer reports the GPU side of the same mesh
+    report.AddAsset(MemoryMeshes, 3, "", 0, 250);
+    report.AddAsset(MemoryMeshes, 7, "tree", 1000, 2000);
+    report.Add(MemorySceneGraph, 64, 0);
+
+    ASSERT_EQ(report.GetAssets().size(), 3u);
+    EXPECT_EQ(report.GetAssets()[0].name, "rock");
+    EXPECT_EQ(report.GetAssets()[0].usage.cpuBytes, 100u);
+    EXPECT_EQ(report.GetAssets()[0].usage.gpuBytes, 250u);
+    EXPECT_EQ(report.GetCategory(MemoryMeshes).cpuBytes, 1100u);
+    EXPECT_EQ(report.GetCategory(MemoryMeshes).gpuBytes, 2250u);
+    EXPECT_EQ(report.GetTotal().cpuBytes, 1174u);
+    EXPECT_EQ(report.GetTotal().gpuBytes, 6250u);
+
+    std::string json;
+    report.WriteJson(json);
+    EXPECT_EQ(json.find("{\"total\":{\"cpu\":1174,\"gpu\":6250}"), 0u);
+    // largest first
+    EXPECT_NE(json.find("\"meshes\":{\"cpu\":1100,\"gpu\":2250,\"assets\":[{\"id\":7,\"name\":\"tree\""), std::string::npos);
+
+    std::string text;
+    report.WriteText(text, 1);
+    EXPECT_NE(text.find("tree"), std::string::npos);
+    EXPECT_EQ(text.find("rock "), std::string::npos);
+    EXPECT_NE(text.find("(1 more)"), std::string::npos);
+
+    report.Clear();
+    EXPECT_TRUE(report.GetAssets().empty());
+    EXPECT_EQ(report.GetTotal().gpuBytes, 0u);
+}
+
+TEST(MemoryBudget, JsonEscapesNames)
+{
+    MemoryReport report;
+    report.AddAsset(MemoryTextures, 1, "C:\\maps\\\"a\".png\n", 0, 0);
+    std::string json;
+    report.WriteJson(json);
+    EXPECT_NE(json.find("\"C:\\\\maps\\\\\\\"a\\\".png\\u000a\""), std::string::npos);
+}
+
+TEST(MemoryBudget, TextureBytes)
+{
+    EXPECT_EQ(GetTextureBytes(4, 4, 1), 64u);
+    // 4x4 + 2x2 + 1x1
+    EXPECT_EQ(GetTextureBytes(4, 4, 3), 84u);
+    EXPECT_EQ(GetTextureBytes(4, 4, 3, 1), 20u);
+    // non square chains keep at least one texel per side
+    EXPECT_EQ(GetTextureBytes(4, 1, 3), 28u);
+}
+
+TEST(MemoryBudget, LevelsStepTowardsTheBudget)
+{
+    MemoryBudget budget = { 1000, 1000 };
+    BudgetLevels levels = {};
+    MemoryReport report;
+    report.Add(MemoryMeshes, 0, 1500);
+    report.Add(MemoryTextures, 0, 800);
+
+    EXPECT_TRUE(UpdateBudgetLevels(budget, report, levels));
+    EXPECT_EQ(levels.lodBias, 1u);
+    EXPECT_EQ(levels.textureMipBias, 0u);
+
+    // in budget, but a finer level would not fit: stay
+    report.Clear();
+    report.Add(MemoryMeshes, 0, 900);
+    report.Add(MemoryTextures, 0, 800);
+    EXPECT_FALSE(UpdateBudgetLevels(budget, report, levels));
+    EXPECT_EQ(levels.lodBias, 1u);
+
+    // room for twice as much: take the level back
+    report.Clear();
+    report.Add(MemoryMeshes, 0, 400);
+    EXPECT_TRUE(UpdateBudgetLevels(budget, report, levels));
+    EXPECT_EQ(levels.lodBias, 0u);
+
+    // no budget, no bias
+    levels.textureMipBias = 3;
+    EXPECT_TRUE(UpdateBudgetLevels(MemoryBudget{ 0, 0 }, report, levels));
+    EXPECT_EQ(levels.textureMipBias, 0u);
+}
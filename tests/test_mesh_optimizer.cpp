@@ -0,0 +1,369 @@
+#include "tests/gtest/gtest.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "MeshOptimizer.hpp"
+
+using namespace m3d;
+
+// two triangles of a quad, emitted three vertices per triangle like the per polygon vertex import
+static void MakeQuadSoup(std::vector<float>& positions, std::vector<float>& normals, std::vector<float>& uvs, std::vector<uint32_t>& indices)
+{
+    const float corners[6][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 0 }, { 1, 1 }, { 0, 1 } };
+    for (uint32_t i = 0; i < 6; ++i) {
+        positions.insert(positions.end(), { corners[i][0], corners[i][1], 0.0f, 1.0f });
+        normals.insert(normals.end(), { 0.0f, 0.0f, 1.0f });
+        uvs.insert(uvs.end(), { corners[i][0], corners[i][1] });
+        indices.push_back(i);
+    }
+}
+
+TEST(MeshOptimizer, WeldMergesSharedVertices)
+{
+    std::vector<float> positions, normals, uvs;
+    std::vector<uint32_t> indices;
+    MakeQuadSoup(positions, normals, uvs, indices);
+
+    EXPECT_EQ(WeldVertices(positions, normals, uvs, indices), 4u);
+    EXPECT_EQ(positions.size(), 4u * PositionStride);
+    EXPECT_EQ(normals.size(), 4u * NormalStride);
+    EXPECT_EQ(uvs.size(), 4u * UVStride);
+    EXPECT_EQ(indices, std::vector<uint32_t>({ 0, 1, 2, 0, 2, 3 }));
+    // first use order
+    EXPECT_EQ(positions[3 * PositionStride], 0.0f);
+    EXPECT_EQ(positions[3 * PositionStride + 1], 1.0f);
+}
+
+TEST(MeshOptimizer, WeldKeepsSeams)
+{
+    std::vector<float> positions, normals, uvs;
+    std::vector<uint32_t> indices;
+    MakeQuadSoup(positions, normals, uvs, indices);
+    // same position, different uv: a texture seam
+    uvs[4 * UVStride] = 0.5f;
+
+    EXPECT_EQ(WeldVertices(positions, normals, uvs, indices), 5u);
+}
+
+TEST(MeshOptimizer, WeldEpsilon)
+{
+    std::vector<float> positions, normals, uvs;
+    std::vector<uint32_t> indices;
+    MakeQuadSoup(positions, normals, uvs, indices);
+    positions[3 * PositionStride] = 1e-5f;
+    normals.clear();
+    uvs.clear();
+
+    std::vector<float> exactPositions = positions, exactNormals, exactUVs;
+    std::vector<uint32_t> exactIndices = indices;
+    EXPECT_EQ(WeldVertices(exactPositions, exactNormals, exactUVs, exactIndices), 5u);
+    EXPECT_EQ(WeldVertices(positions, normals, uvs, indices, 1e-3f), 4u);
+    EXPECT_TRUE(normals.empty());
+}
+
+// n x n quad grid, triangles shuffled so the input order has no locality
+static void MakeGrid(uint32_t n, std::vector<float>& positions, std::vector<uint32_t>& indices)
+{
+    for (uint32_t y = 0; y <= n; ++y) {
+        for (uint32_t x = 0; x <= n; ++x) {
+            positions.insert(positions.end(), { float(x), float(y), 0.0f, 1.0f });
+        }
+    }
+    std::vector<uint32_t> triangles;
+    for (uint32_t y = 0; y < n; ++y) {
+        for (uint32_t x = 0; x < n; ++x) {
+            const uint32_t v = y * (n + 1) + x;
+            triangles.insert(triangles.end(), { v, v + 1, v + n + 2, v, v + n + 2, v + n + 1 });
+        }
+    }
+    const uint32_t triangleCount = static_cast<uint32_t>(triangles.size() / 3);
+    for (uint32_t i = 0; i < triangleCount; ++i) {
+        const uint32_t t = (i * 7919) % triangleCount;
+        indices.insert(indices.end(), &triangles[t * 3], &triangles[t * 3] + 3);
+    }
+}
+
+static std::vector<std::vector<uint32_t>> SortedTriangles(const std::vector<uint32_t>& indices)
+{
+    std::vector<std::vector<uint32_t>> triangles;
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        triangles.push_back({ indices[i], indices[i + 1], indices[i + 2] });
+    }
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+TEST(MeshOptimizer, VertexCacheLowersAcmr)
+{
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+    MakeGrid(64, positions, indices);
+    const uint32_t vertexCount = static_cast<uint32_t>(positions.size() / PositionStride);
+    const std::vector<uint32_t> original = indices;
+
+    const VertexCacheStats before = AnalyzeVertexCache(indices.data(), indices.size(), vertexCount);
+    OptimizeVertexCache(indices.data(), indices.size(), vertexCount);
+    const VertexCacheStats after = AnalyzeVertexCache(indices.data(), indices.size(), vertexCount);
+
+    EXPECT_EQ(before.vertices, vertexCount);
+    EXPECT_GT(before.Acmr(), 2.0f);
+    EXPECT_LT(after.Acmr(), 0.8f);
+    EXPECT_LT(after.Atvr(), 1.6f);
+    // same triangles, same winding
+    EXPECT_EQ(SortedTriangles(indices), SortedTriangles(original));
+}
+
+TEST(MeshOptimizer, OverdrawKeepsTrianglesAndCache)
+{
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+    MakeGrid(32, positions, indices);
+    const uint32_t vertexCount = static_cast<uint32_t>(positions.size() / PositionStride);
+    OptimizeVertexCache(indices.data(), indices.size(), vertexCount);
+    const std::vector<uint32_t> cacheOptimized = indices;
+    const float acmr = AnalyzeVertexCache(indices.data(), indices.size(), vertexCount).Acmr();
+
+    OptimizeOverdraw(indices.data(), indices.size(), positions.data(), vertexCount);
+
+    EXPECT_EQ(SortedTriangles(indices), SortedTriangles(cacheOptimized));
+    EXPECT_LT(AnalyzeVertexCache(indices.data(), indices.size(), vertexCount).Acmr(), acmr * 1.05f);
+}
+
+TEST(MeshOptimizer, VertexFetchFirstUseOrder)
+{
+    std::vector<float> positions = { 0, 0, 0, 1, 1, 0, 0, 1, 2, 0, 0, 1, 3, 0, 0, 1 };
+    std::vector<float> normals;
+    std::vector<float> uvs = { 0, 0, 1, 1, 2, 2, 3, 3 };
+    std::vector<uint32_t> indices = { 3, 1, 3, 1, 3, 1 };
+
+    EXPECT_EQ(OptimizeVertexFetch(positions, normals, uvs, indices), 2u);
+    EXPECT_EQ(indices, std::vector<uint32_t>({ 0, 1, 0, 1, 0, 1 }));
+    EXPECT_EQ(positions, std::vector<float>({ 3, 0, 0, 1, 1, 0, 0, 1 }));
+    EXPECT_EQ(uvs, std::vector<float>({ 3, 3, 1, 1 }));
+}
+
+TEST(MeshOptimizer, TangentsFollowUVs)
+{
+    // a quad in the xy plane facing +z, u along +x and v along -y
+    const std::vector<float> positions = { 0, 0, 0, 1, 1, 0, 0, 1, 1, 1, 0, 1, 0, 1, 0, 1 };
+    const std::vector<float> normals = { 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1 };
+    const std::vector<float> uvs = { 0, 1, 1, 1, 1, 0, 0, 0 };
+    const std::vector<uint32_t> indices = { 0, 1, 2, 0, 2, 3 };
+
+    std::vector<float> tangents;
+    ComputeTangents(positions, normals, uvs, indices, tangents);
+    ASSERT_EQ(tangents.size(), 16u);
+    for (uint32_t v = 0; v < 4; ++v) {
+        EXPECT_NEAR(tangents[v * 4], 1.0f, 1e-5f);
+        EXPECT_NEAR(tangents[v * 4 + 1], 0.0f, 1e-5f);
+        EXPECT_NEAR(tangents[v * 4 + 2], 0.0f, 1e-5f);
+        // cross(normal, tangent) is +y, v runs the other way
+        EXPECT_EQ(tangents[v * 4 + 3], -1.0f);
+    }
+}
+
+TEST(MeshOptimizer, SimplifyFlatGridKeepsBorder)
+{
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+    MakeGrid(16, positions, indices);
+    const uint32_t vertexCount = static_cast<uint32_t>(positions.size() / PositionStride);
+
+    std::vector<uint32_t> lod(indices.size());
+    float error = -1.0f;
+    const size_t count = SimplifyMesh(lod.data(), indices.data(), indices.size(), positions.data(), nullptr, nullptr,
+        vertexCount, indices.size() / 4, 0.01f, &error);
+    lod.resize(count);
+
+    EXPECT_LE(count, indices.size() / 4);
+    EXPECT_GT(count, 0u);
+    // a plane has no error to pay
+    EXPECT_LT(error, 1e-3f);
+    // the outline did not move: every border vertex is still used
+    std::vector<bool> used(vertexCount, false);
+    for (uint32_t v : lod)
+        used[v] = true;
+    for (uint32_t i = 0; i <= 16; ++i) {
+        EXPECT_TRUE(used[i]);
+        EXPECT_TRUE(used[16 * 17 + i]);
+        EXPECT_TRUE(used[i * 17]);
+        EXPECT_TRUE(used[i * 17 + 16]);
+    }
+    // still covers the same area, with the same winding
+    float area = 0.0f;
+    for (size_t t = 0; t < lod.size(); t += 3) {
+        const float* a = &positions[lod[t] * PositionStride];
+        const float* b = &positions[lod[t + 1] * PositionStride];
+        const float* c = &positions[lod[t + 2] * PositionStride];
+        area += 0.5f * ((b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]));
+    }
+    EXPECT_NEAR(area, 256.0f, 1e-3f);
+}
+
+TEST(MeshOptimizer, SimplifyStopsAtError)
+{
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+    MakeGrid(16, positions, indices);
+    const uint32_t vertexCount = static_cast<uint32_t>(positions.size() / PositionStride);
+    // a bowl, no collapse is free
+    for (uint32_t v = 0; v < vertexCount; ++v) {
+        const float x = positions[v * PositionStride] - 8.0f;
+        const float y = positions[v * PositionStride + 1] - 8.0f;
+        positions[v * PositionStride + 2] = (x * x + y * y) * 0.05f;
+    }
+
+    std::vector<uint32_t> lod(indices.size());
+    float error = -1.0f;
+    const size_t count = SimplifyMesh(lod.data(), indices.data(), indices.size(), positions.data(), nullptr, nullptr,
+        vertexCount, 0, 0.01f, &error);
+
+    EXPECT_GT(count, indices.size() / 2);
+    EXPECT_LE(error, 0.01f);
+
+    // a looser error goes further
+    const size_t looser = SimplifyMesh(lod.data(), indices.data(), indices.size(), positions.data(), nullptr, nullptr,
+        vertexCount, 0, 0.5f, &error);
+    EXPECT_LT(looser, count);
+    EXPECT_LE(error, 0.5f);
+}
+
+// largest difference between the first component of an attribute and its interpolation over the lod, taken at
+// every vertex of a grid in the xy plane
+static float InterpolationError(const std::vector<float>& positions, const float* attribute, uint32_t stride,
+    const std::vector<uint32_t>& lod)
+{
+    float worst = 0.0f;
+    for (size_t v = 0; v < positions.size() / PositionStride; ++v) {
+        const float x = positions[v * PositionStride];
+        const float y = positions[v * PositionStride + 1];
+        for (size_t t = 0; t < lod.size(); t += 3) {
+            const float* a = &positions[lod[t] * PositionStride];
+            const float* b = &positions[lod[t + 1] * PositionStride];
+            const float* c = &positions[lod[t + 2] * PositionStride];
+            const float area = (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+            const float wb = ((x - a[0]) * (c[1] - a[1]) - (y - a[1]) * (c[0] - a[0])) / area;
+            const float wc = ((b[0] - a[0]) * (y - a[1]) - (b[1] - a[1]) * (x - a[0])) / area;
+            const float wa = 1.0f - wb - wc;
+            if (wa < -1e-4f || wb < -1e-4f || wc < -1e-4f)
+                continue;
+            const float value = wa * attribute[lod[t] * stride] + wb * attribute[lod[t + 1] * stride]
+                + wc * attribute[lod[t + 2] * stride];
+            worst = std::max(worst, std::fabs(value - attribute[v * stride]));
+            break;
+        }
+    }
+    return worst;
+}
+
+TEST(MeshOptimizer, SimplifyKeepsAttributeDetail)
+{
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+    MakeGrid(16, positions, indices);
+    const uint32_t vertexCount = static_cast<uint32_t>(positions.size() / PositionStride);
+    // a flat grid, u and the normal's x run linearly over the left half and curve over the right
+    std::vector<float> normals, uvs;
+    for (uint32_t v = 0; v < vertexCount; ++v) {
+        const float x = positions[v * PositionStride];
+        const float bend = x > 8.0f ? (x - 8.0f) * (x - 8.0f) / 32.0f : 0.0f;
+        normals.insert(normals.end(), { bend, 0.0f, 1.0f });
+        uvs.insert(uvs.end(), { x / 16.0f + bend, positions[v * PositionStride + 1] / 16.0f });
+    }
+
+    for (int attribute = 0; attribute < 2; ++attribute) {
+        const float* values = attribute == 0 ? normals.data() : uvs.data();
+        const uint32_t stride = attribute == 0 ? NormalStride : UVStride;
+        std::vector<uint32_t> lod(indices.size());
+        float error = -1.0f;
+        size_t count = SimplifyMesh(lod.data(), indices.data(), indices.size(), positions.data(),
+            attribute == 0 ? values : nullptr, attribute == 1 ? values : nullptr, vertexCount, indices.size() / 4, 0.01f,
+            &error);
+        lod.resize(count);
+        EXPECT_LE(count, indices.size() / 4) << attribute;
+        // the reported error is the surface's, a plane has none
+        EXPECT_LT(error, 1e-3f) << attribute;
+        // the collapses went where the attribute is linear, the lod still interpolates it exactly
+        EXPECT_LT(InterpolationError(positions, values, stride, lod), 1e-3f) << attribute;
+
+        // positions alone see a plane and collapse anywhere
+        lod.resize(indices.size());
+        count = SimplifyMesh(lod.data(), indices.data(), indices.size(), positions.data(), nullptr, nullptr, vertexCount,
+            indices.size() / 4, 0.01f);
+        lod.resize(count);
+        EXPECT_GT(InterpolationError(positions, values, stride, lod), 0.05f) << attribute;
+    }
+}
+
+TEST(MeshOptimizer, SplitFor16BitIndices)
+{
+    // a strip of triangles walking over 200000 vertices
+    std::vector<uint32_t> indices;
+    for (uint32_t v = 0; v + 2 < 200000; v += 2) {
+        indices.insert(indices.end(), { v, v + 1, v + 2 });
+    }
+    std::vector<IndexWindow> windows;
+    const uint32_t count = SplitFor16BitIndices(indices.data(), indices.size(), windows);
+    EXPECT_EQ(count, 4u);
+
+    uint32_t next = 0;
+    for (const IndexWindow& window : windows) {
+        // contiguous and in order
+        EXPECT_EQ(window.indexOffset, next);
+        next += window.triangleCount * 3;
+        for (uint32_t i = window.indexOffset; i < next; ++i) {
+            EXPECT_GE(indices[i], window.baseVertex);
+            EXPECT_LE(indices[i] - window.baseVertex, 0xFFFFu);
+        }
+    }
+    EXPECT_EQ(next, indices.size());
+}
+
+TEST(MeshOptimizer, AppendTransformedPlacesAndRemaps)
+{
+    // a quad in the xy plane facing +z, the second triangle only
+    const std::vector<float> positions = { 0, 0, 0, 1, 1, 0, 0, 1, 1, 1, 0, 1, 0, 1, 0, 1 };
+    const std::vector<float> normals = { 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1 };
+    const std::vector<float> uvs = { 0, 0, 1, 0, 1, 1, 0, 1 };
+    const std::vector<uint32_t> indices = { 0, 1, 2, 0, 2, 3 };
+
+    std::vector<float> outPositions = { 9, 9, 9, 1 };
+    std::vector<float> outNormals = { 0, 1, 0 };
+    std::vector<float> outUVs = { 0, 0 };
+    std::vector<uint32_t> outIndices = { 0, 0, 0 };
+
+    // scaled by 2 along x, moved by (10, 0, 0)
+    const float move[3][4] = { { 2, 0, 0, 10 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 } };
+    EXPECT_EQ(AppendTransformed(move, positions.data(), normals.data(), uvs.data(), 4, indices.data() + 3, 3,
+                  outPositions, outNormals, outUVs, outIndices),
+        3u);
+    EXPECT_EQ(outIndices, std::vector<uint32_t>({ 0, 0, 0, 1, 2, 3 }));
+    EXPECT_EQ(outPositions, std::vector<float>({ 9, 9, 9, 1, 10, 0, 0, 1, 12, 1, 0, 1, 10, 1, 0, 1 }));
+    EXPECT_EQ(outUVs, std::vector<float>({ 0, 0, 0, 0, 1, 1, 0, 1 }));
+    for (uint32_t v = 1; v < 4; ++v) {
+        EXPECT_NEAR(outNormals[v * 3 + 2], 1.0f, 1e-6f);
+    }
+
+    // mirrored in x: positions flip, the winding flips back and normals stay outward
+    const float mirror[3][4] = { { -1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 } };
+    outPositions.clear();
+    outNormals.clear();
+    outIndices.clear();
+    std::vector<float> noUVs;
+    EXPECT_EQ(AppendTransformed(mirror, positions.data(), normals.data(), nullptr, 4, indices.data(), 3, outPositions,
+                  outNormals, noUVs, outIndices),
+        3u);
+    EXPECT_TRUE(noUVs.empty());
+    // first use order of the flipped triangle 0, 2, 1
+    EXPECT_EQ(outIndices, std::vector<uint32_t>({ 0, 1, 2 }));
+    EXPECT_EQ(outPositions[4], -1.0f);
+    EXPECT_EQ(outPositions[5], 1.0f);
+    const float* a = &outPositions[0];
+    const float* b = &outPositions[4];
+    const float* c = &outPositions[8];
+    const float z = (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+    EXPECT_GT(z, 0.0f);
+    EXPECT_NEAR(outNormals[2], 1.0f, 1e-6f);
+}
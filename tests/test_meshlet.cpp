@@ -0,0 +1,87 @@
+#include "tests/gtest/gtest.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "Meshlet.hpp"
+
+using namespace m3d;
+using m3d::math::Vector3;
+
+// n x n quads in the z = 0 plane facing +z, row by row
+static void MakePlane(uint32_t n, std::vector<float>& positions, std::vector<uint32_t>& indices)
+{
+    for (uint32_t y = 0; y <= n; ++y) {
+        for (uint32_t x = 0; x <= n; ++x) {
+            positions.insert(positions.end(), { float(x), float(y), 0.0f, 1.0f });
+        }
+    }
+    for (uint32_t y = 0; y < n; ++y) {
+        for (uint32_t x = 0; x < n; ++x) {
+            const uint32_t v = y * (n + 1) + x;
+            indices.insert(indices.end(), { v, v + 1, v + n + 2, v, v + n + 2, v + n + 1 });
+        }
+    }
+}
+
+TEST(Meshlet, BuildRespectsLimitsAndCoversSlice)
+{
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+    MakePlane(32, positions, indices);
+    const uint32_t vertexCount = static_cast<uint32_t>(positions.size() / 4);
+    const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+    std::vector<Meshlet> meshlets;
+    const uint32_t count = BuildMeshlets(positions.data(), vertexCount, indices.data(), 0, triangleCount, meshlets);
+    ASSERT_EQ(count, meshlets.size());
+    ASSERT_GT(count, 1u);
+
+    uint32_t next = 0;
+    for (const Meshlet& meshlet : meshlets) {
+        EXPECT_EQ(meshlet.indexOffset, next);
+        EXPECT_LE(meshlet.triangleCount, MeshletMaxTriangles);
+        std::vector<uint32_t> used(indices.begin() + meshlet.indexOffset, indices.begin() + meshlet.indexOffset + meshlet.triangleCount * 3);
+        std::sort(used.begin(), used.end());
+        EXPECT_LE(std::unique(used.begin(), used.end()) - used.begin(), MeshletMaxVertices);
+        // flat plane: the cone is a line along +z
+        EXPECT_NEAR(meshlet.coneAxis.z, 1.0f, 1e-5f);
+        EXPECT_NEAR(meshlet.coneCutoff, 0.0f, 1e-3f);
+        next += meshlet.triangleCount * 3;
+    }
+    EXPECT_EQ(next, indices.size());
+}
+
+TEST(Meshlet, CullFrustumAndBackfaces)
+{
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+    MakePlane(32, positions, indices);
+    std::vector<Meshlet> meshlets;
+    BuildMeshlets(positions.data(), static_cast<uint32_t>(positions.size() / 4), indices.data(), 0,
+        static_cast<uint32_t>(indices.size() / 3), meshlets);
+    const uint32_t count = static_cast<uint32_t>(meshlets.size());
+
+    // looking down at the plane from the front, everything in view: one merged range
+    const Vector3 front(16.0f, 16.0f, 50.0f);
+    const Frustum wide = Frustum::FromPerspective(front, Vector3(16.0f, 16.0f, 0.0f), Vector3(0.0f, 1.0f, 0.0f), 90.0f, 1.0f, 0.1f, 1000.0f);
+    std::vector<IndexRange> ranges;
+    EXPECT_EQ(CullMeshlets(meshlets.data(), count, m3d::math::Matrix4x4(), wide, front, true, ranges), count);
+    ASSERT_EQ(ranges.size(), 1u);
+    EXPECT_EQ(ranges[0].indexCount, indices.size());
+
+    // from behind every meshlet faces away
+    const Vector3 back(16.0f, 16.0f, -50.0f);
+    const Frustum behind = Frustum::FromPerspective(back, Vector3(16.0f, 16.0f, 0.0f), Vector3(0.0f, 1.0f, 0.0f), 90.0f, 1.0f, 0.1f, 1000.0f);
+    ranges.clear();
+    EXPECT_EQ(CullMeshlets(meshlets.data(), count, m3d::math::Matrix4x4(), behind, back, true, ranges), 0u);
+    EXPECT_TRUE(ranges.empty());
+    EXPECT_EQ(CullMeshlets(meshlets.data(), count, m3d::math::Matrix4x4(), behind, back, false, ranges), count);
+
+    // a narrow view of one corner keeps only some of them
+    const Frustum narrow = Frustum::FromPerspective(front, Vector3(2.0f, 2.0f, 0.0f), Vector3(0.0f, 1.0f, 0.0f), 5.0f, 1.0f, 0.1f, 1000.0f);
+    ranges.clear();
+    const uint32_t visible = CullMeshlets(meshlets.data(), count, m3d::math::Matrix4x4(), narrow, front, true, ranges);
+    EXPECT_GT(visible, 0u);
+    EXPECT_LT(visible, count);
+}
@@ -0,0 +1,98 @@
+#include "tests/gtest/gtest.h"
+
+#include <atomic>
+#include <vector>
+
+#include "packed_freelist.h"
+
+TEST(PackedFreelist, LookupBatch)
+{
+    packed_freelist<int> list(64);
+    std::vector<uint32_t> ids;
+    for (int i = 0; i < 40; ++i) {
+        ids.push_back(list.insert(i * 10));
+    }
+    // erasing moves the last object into the hole, ids keep working
+    const uint32_t erased = ids[3];
+    list.erase(erased);
+    // the slot is reused with a new generation, the old id must not resolve to it
+    for (int i = 0; i < 30; ++i) {
+        list.erase(list.insert(-1));
+    }
+
+    std::vector<int*> objects(ids.size());
+    EXPECT_EQ(list.lookup_batch(ids.data(), ids.size(), objects.data()), ids.size() - 1);
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (ids[i] == erased) {
+            EXPECT_EQ(objects[i], nullptr);
+        } else {
+            ASSERT_NE(objects[i], nullptr);
+            EXPECT_EQ(*objects[i], int(i) * 10);
+            EXPECT_EQ(objects[i], &list[ids[i]]);
+        }
+    }
+    EXPECT_EQ(list.lookup_batch(ids.data(), 0, objects.data()), 0u);
+}
+
+TEST(PackedFreelist, Cursor)
+{
+    packed_freelist<int> list(16);
+    std::vector<uint32_t> ids;
+    for (int i = 0; i < 10; ++i) {
+        ids.push_back(list.insert(i));
+    }
+    list.erase(ids[0]);
+    list.erase(ids[5]);
+
+    size_t visited = 0;
+    int sum = 0;
+    for (auto c = list.get_cursor(); c; ++c) {
+        EXPECT_TRUE(list.contains(c.id()));
+        EXPECT_EQ(&*c, &list[c.id()]);
+        sum += *c;
+        ++visited;
+    }
+    EXPECT_EQ(visited, list.size());
+    EXPECT_EQ(sum, 45 - 0 - 5);
+
+    packed_freelist<int> empty(4);
+    EXPECT_FALSE(empty.get_cursor());
+}
+
+TEST(PackedFreelist, ParallelForEach)
+{
+    packed_freelist<int> list(5000);
+    std::vector<uint32_t> ids;
+    for (int i = 0; i < 4000; ++i) {
+        ids.push_back(list.insert(i));
+    }
+    for (size_t i = 0; i < ids.size(); i += 3) {
+        list.erase(ids[i]);
+    }
+
+    m3d::ThreadPool pool(3);
+    std::vector<uint32_t> seen(list.size(), 0);
+    std::atomic<size_t> visited(0);
+    list.parallel_for_each(pool, [&](int* objects, const uint32_t* sliceIds, size_t first, size_t count) {
+        EXPECT_LE(count, 100u);
+        for (size_t i = 0; i < count; ++i) {
+            EXPECT_EQ(&objects[i], &list[sliceIds[i]]);
+            objects[i] *= 2;
+            ++seen[first + i];
+        }
+        visited.fetch_add(count);
+    }, 100);
+    EXPECT_EQ(visited.load(), list.size());
+    for (uint32_t count : seen) {
+        EXPECT_EQ(count, 1u);
+    }
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (i % 3) {
+            EXPECT_EQ(list[ids[i]], int(i) * 2);
+        }
+    }
+
+    // the shared pool overload, nothing to visit
+    packed_freelist<int> empty(4);
+    empty.parallel_for_each([&](int*, const uint32_t*, size_t, size_t) { ADD_FAILURE(); });
+}
@@ -0,0 +1,321 @@
+#include "tests/gtest/gtest.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "RadixSort.hpp"
+#include "RenderQueue.hpp"
+#include "Scene.hpp"
+
+using namespace m3d;
+using m3d::math::Vector3;
+
+static Transform MakeTransform(float x, float y, float z)
+{
+    Transform transform;
+    transform.position = Vector3(x, y, z);
+    transform.scale = Vector3(1.0f, 1.0f, 1.0f);
+    transform.rotation = m3d::math::Quaternion(0.0f, 0.0f, 0.0f, 1.0f);
+    return transform;
+}
+
+static void InitScene(Scene& scene)
+{
+    scene.meshes = packed_freelist<Mesh>(16);
+    scene.transforms = packed_freelist<Transform>(64);
+    scene.instances = packed_freelist<Instance>(64);
+    scene.prefabs = packed_freelist<Prefab>(4);
+    scene.prefabInstances = packed_freelist<PrefabInstance>(16);
+}
+
+// a row of quadCount unit quads in the z = 0 plane along +x, 2 units apart, one slice of material 0 and a meshlet per quad
+static uint32_t AddQuadRow(Scene& scene, uint32_t quadCount)
+{
+    Mesh mesh;
+    for (uint32_t q = 0; q < quadCount; ++q) {
+        const float x = float(q * 2);
+        const uint32_t v = q * 4;
+        mesh.vertices.insert(mesh.vertices.end(), { x, 0.0f, 0.0f, 1.0f, x + 1.0f, 0.0f, 0.0f, 1.0f,
+                                                      x + 1.0f, 1.0f, 0.0f, 1.0f, x, 1.0f, 0.0f, 1.0f });
+        mesh.indices.insert(mesh.indices.end(), { v, v + 1, v + 2, v, v + 2, v + 3 });
+    }
+    mesh.bounds = AABB::Empty();
+    mesh.bounds.Expand(Vector3(0.0f, 0.0f, 0.0f));
+    mesh.bounds.Expand(Vector3(float(quadCount * 2 - 1), 1.0f, 0.0f));
+    mesh.slices.emplace_back(0, static_cast<int>(quadCount * 2), 0);
+    mesh.slices[0].meshletCount = BuildMeshlets(mesh.vertices.data(), quadCount * 4, mesh.indices.data(), 0, quadCount * 2,
+        mesh.meshlets, MeshletMaxVertices, 2);
+    mesh.materialIds.push_back(7);
+    return scene.meshes.insert(std::move(mesh));
+}
+
+static RenderItem MakeItem(uint32_t material, uint32_t mesh, uint32_t lod, uint32_t depth, uint32_t instanceId)
+{
+    RenderItem item;
+    item.key = sortkey::Make(RenderPassOpaque, material, mesh, lod, 0, depth);
+    item.instanceId = instanceId;
+    item.prefabPart = 0;
+    item.meshId = mesh;
+    item.materialId = material;
+    item.lod = lod;
+    item.slice = 0;
+    return item;
+}
+
+TEST(RenderQueue, SortKeyFieldOrder)
+{
+    const uint64_t key = sortkey::Make(1, 3, 4, 5, 6, 7);
+    EXPECT_EQ(sortkey::Field(key, sortkey::PassShift, sortkey::PassBits), 1u);
+    EXPECT_EQ(sortkey::Field(key, sortkey::MaterialShift, sortkey::MaterialBits), 3u);
+    EXPECT_EQ(sortkey::Field(key, sortkey::MeshShift, sortkey::MeshBits), 4u);
+    EXPECT_EQ(sortkey::Field(key, sortkey::LodShift, sortkey::LodBits), 5u);
+    EXPECT_EQ(sortkey::Field(key, sortkey::SliceShift, sortkey::SliceBits), 6u);
+    EXPECT_EQ(sortkey::Field(key, sortkey::DepthShift, sortkey::DepthBits), 7u);
+
+    // a pass change outranks any material, mesh or depth difference
+    EXPECT_LT(sortkey::Make(0, 0xFFFF, 0xFFFF, 0xF, 0xFF, 0xFFFF), sortkey::Make(1, 0, 0, 0, 0, 0));
+
+    // the highest level and slice the loader accepts keep their own values
+    const uint64_t last = sortkey::Make(0, 0, 0, sortkey::MaxLodCount - 1, sortkey::MaxSliceCount - 1, 0);
+    EXPECT_EQ(sortkey::Field(last, sortkey::LodShift, sortkey::LodBits), sortkey::MaxLodCount - 1);
+    EXPECT_EQ(sortkey::Field(last, sortkey::SliceShift, sortkey::SliceBits), sortkey::MaxSliceCount - 1);
+    EXPECT_EQ(sortkey::Field(last, sortkey::MeshShift, sortkey::MeshBits), 0u);
+}
+
+TEST(RenderQueue, LodSelectionByScreenError)
+{
+    // 1000 pixels per unit at distance 1
+    LodSelection selection = { 1000.0f, 1.0f, 0 };
+    EXPECT_TRUE(selection.Accepts(0.0f, 0.0f));
+    EXPECT_FALSE(selection.Accepts(0.01f, 1.0f));
+    EXPECT_TRUE(selection.Accepts(0.01f, 10.0f));
+    // not set up, full meshes only
+    selection.projectionScale = 0.0f;
+    EXPECT_FALSE(selection.Accepts(0.0f, 10.0f));
+}
+
+TEST(RenderQueue, RadixSortIsStable)
+{
+    std::mt19937 rng(7);
+    std::vector<RenderItem> items(5000);
+    for (uint32_t i = 0; i < items.size(); ++i) {
+        // few distinct keys so stability is exercised
+        items[i].key = sortkey::Make(rng() % 2, rng() % 8, rng() % 8, rng() % 2, rng() % 2, rng() % 4);
+        items[i].instanceId = i;
+    }
+
+    std::vector<RenderItem> expected = items;
+    std::stable_sort(expected.begin(), expected.end(), [](const RenderItem& a, const RenderItem& b) { return a.key < b.key; });
+
+    std::vector<RenderItem> scratch(items.size());
+    RenderItem* sorted = RadixSort64(items.data(), scratch.data(), items.size(), [](const RenderItem& item) { return item.key; });
+    for (size_t i = 0; i < items.size(); ++i) {
+        EXPECT_EQ(sorted[i].key, expected[i].key);
+        EXPECT_EQ(sorted[i].instanceId, expected[i].instanceId);
+    }
+}
+
+TEST(RenderQueue, BuildDrawListMergesRuns)
+{
+    RenderQueue queue;
+    // pushed out of order, the sort brings the runs together
+    queue.Push(MakeItem(2, 5, 0, 1, 0));
+    queue.Push(MakeItem(1, 4, 0, 9, 1));
+    queue.Push(MakeItem(1, 5, 0, 2, 2));
+    queue.Push(MakeItem(1, 4, 0, 3, 3));
+    queue.Push(MakeItem(1, 4, 1, 4, 4));
+    queue.Push(MakeItem(1, 4, 0, 1, 5));
+    queue.Sort();
+    queue.BuildDrawList();
+
+    const std::vector<RenderItem>& items = queue.GetItems();
+    const std::vector<DrawCommand>& draws = queue.GetDrawList();
+    ASSERT_EQ(draws.size(), 4u);
+
+    // material 1, mesh 4, level 0: three instances front to back
+    EXPECT_EQ(draws[0].changes, uint32_t(DrawCommand::ChangeMaterial | DrawCommand::ChangeMesh));
+    EXPECT_EQ(draws[0].firstInstance, 0u);
+    EXPECT_EQ(draws[0].instanceCount, 3u);
+    EXPECT_EQ(items[0].instanceId, 5u);
+    EXPECT_EQ(items[1].instanceId, 3u);
+    EXPECT_EQ(items[2].instanceId, 1u);
+    // another level of the same mesh never merges, but changes no state
+    EXPECT_EQ(draws[1].lod, 1u);
+    EXPECT_EQ(draws[1].changes, 0u);
+    EXPECT_EQ(draws[1].firstInstance, 3u);
+    EXPECT_EQ(draws[1].instanceCount, 1u);
+    EXPECT_EQ(draws[2].meshId, 5u);
+    EXPECT_EQ(draws[2].changes, uint32_t(DrawCommand::ChangeMesh));
+    EXPECT_EQ(draws[3].material, 2u);
+    EXPECT_EQ(draws[3].changes, uint32_t(DrawCommand::ChangeMaterial));
+
+    const RenderQueue::Stats& stats = queue.GetStats();
+    EXPECT_EQ(stats.draws, 4u);
+    EXPECT_EQ(stats.instances, 6u);
+    EXPECT_EQ(stats.materialChanges, 2u);
+    EXPECT_EQ(stats.meshChanges, 2u);
+}
+
+TEST(RenderQueue, BuildDrawListSplitsPasses)
+{
+    RenderQueue queue;
+    RenderItem opaque = MakeItem(1, 4, 0, 5, 0);
+    RenderItem transparent = MakeItem(1, 4, 0, 5, 1);
+    transparent.key = sortkey::Make(RenderPassTransparent, 1, 4, 0, 0, 5);
+    queue.Push(transparent);
+    queue.Push(opaque);
+    queue.Sort();
+    queue.BuildDrawList();
+
+    // same material and mesh, but blended draws never join the opaque ones
+    const std::vector<DrawCommand>& draws = queue.GetDrawList();
+    ASSERT_EQ(draws.size(), 2u);
+    EXPECT_EQ(draws[0].instanceCount, 1u);
+    EXPECT_EQ(draws[1].firstInstance, 1u);
+    EXPECT_EQ(draws[1].instanceCount, 1u);
+    EXPECT_EQ(queue.GetItems()[1].instanceId, 1u);
+}
+
+TEST(RenderQueue, PushInstanceKeysSlicesAndLevels)
+{
+    Scene scene;
+    InitScene(scene);
+    Mesh mesh;
+    mesh.vertices = { 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 1.0f };
+    mesh.indices = { 0, 1, 2, 0, 1, 2, 0, 1, 2 };
+    mesh.bounds = AABB::Empty();
+    mesh.bounds.Expand(Vector3(0.0f, 0.0f, 0.0f));
+    mesh.bounds.Expand(Vector3(1.0f, 1.0f, 0.0f));
+    mesh.slices.emplace_back(0, 1, 0);
+    mesh.slices.emplace_back(3, 1, 1);
+    mesh.materialIds = { 3, 9 };
+    Mesh::Lod lod;
+    lod.error = 0.1f;
+    lod.slices.emplace_back(6, 1, 1);
+    mesh.lods.push_back(lod);
+    const uint32_t meshId = scene.meshes.insert(std::move(mesh));
+
+    uint32_t nearId, farId;
+    AddInstance(scene, meshId, &nearId);
+    AddInstance(scene, meshId, &farId);
+    scene.transforms[scene.instances[farId].transformId] = MakeTransform(0.0f, 0.0f, 500.0f);
+
+    RenderQueue queue;
+    const Vector3 eye(0.5f, 0.5f, -10.0f);
+    // 0.1 units of error cover 100 pixels at distance 1, one pixel at distance 100
+    queue.SetLodSelection({ 1000.0f, 1.0f, 0 });
+    queue.PushInstance(scene, nearId, eye, 1000.0f);
+    queue.PushInstance(scene, farId, eye, 1000.0f);
+    queue.PushInstance(scene, nearId, eye, 1000.0f, RenderPassTransparent);
+
+    const std::vector<RenderItem>& items = queue.GetItems();
+    ASSERT_EQ(items.size(), 5u);
+    // close by, every slice of the full mesh
+    EXPECT_EQ(items[0].lod, 0u);
+    EXPECT_EQ(items[0].materialId, 3u);
+    EXPECT_EQ(items[1].slice, 1u);
+    EXPECT_EQ(items[1].materialId, 9u);
+    const uint32_t nearDepth = sortkey::QuantizeDepth(10.0f, 1000.0f);
+    EXPECT_EQ(items[1].key, sortkey::Make(RenderPassOpaque, 9, meshId, 0, 1, nearDepth));
+    // far away, the level's single slice
+    EXPECT_EQ(items[2].instanceId, farId);
+    EXPECT_EQ(items[2].lod, 1u);
+    EXPECT_EQ(items[2].slice, 0u);
+    EXPECT_EQ(items[2].materialId, 9u);
+    // transparent items sort back to front
+    EXPECT_EQ(sortkey::Field(items[3].key, sortkey::PassShift, sortkey::PassBits), uint64_t(RenderPassTransparent));
+    EXPECT_EQ(sortkey::Field(items[3].key, sortkey::DepthShift, sortkey::DepthBits), ((1u << sortkey::DepthBits) - 1) - nearDepth);
+}
+
+TEST(RenderQueue, CullClustersOfSingleInstances)
+{
+    Scene scene;
+    InitScene(scene);
+    const uint32_t meshId = AddQuadRow(scene, 16);
+    ASSERT_EQ(scene.meshes[meshId].meshlets.size(), 16u);
+    uint32_t single, pair0, pair1;
+    AddInstance(scene, meshId, &single);
+    AddInstance(scene, meshId, &pair0);
+    AddInstance(scene, meshId, &pair1);
+    RenderQueue queue;
+    const Vector3 eye(0.5f, 0.5f, -5.0f);
+    queue.PushInstance(scene, single, eye, 1000.0f);
+    queue.Sort();
+    queue.BuildDrawList();
+
+    // sees the first quad only
+    const Frustum frustum = Frustum::FromPerspective(eye, Vector3(0.5f, 0.5f, 0.0f), Vector3(0.0f, 1.0f, 0.0f), 10.0f, 1.0f, 0.1f, 100.0f);
+    queue.CullClusters(scene, frustum, eye, false);
+    ASSERT_EQ(queue.GetDrawList().size(), 1u);
+    const DrawCommand& draw = queue.GetDrawList()[0];
+    EXPECT_EQ(draw.instanceCount, 1u);
+    ASSERT_EQ(draw.rangeCount, 1u);
+    const IndexRange& range = queue.GetClusterRanges()[draw.firstRange];
+    EXPECT_EQ(range.firstIndex, 0u);
+    EXPECT_EQ(range.indexCount, 6u);
+    EXPECT_EQ(queue.GetStats().clustersCulled, 15u);
+
+    // instanced draws keep the whole slice
+    queue.Clear();
+    queue.PushInstance(scene, pair0, eye, 1000.0f);
+    queue.PushInstance(scene, pair1, eye, 1000.0f);
+    queue.Sort();
+    queue.BuildDrawList();
+    queue.CullClusters(scene, frustum, eye, false);
+    ASSERT_EQ(queue.GetDrawList().size(), 1u);
+    EXPECT_EQ(queue.GetDrawList()[0].instanceCount, 2u);
+    EXPECT_EQ(queue.GetDrawList()[0].rangeCount, 0u);
+    EXPECT_TRUE(queue.GetClusterRanges().empty());
+
+    // looking away, nothing is left of the single instance
+    queue.Clear();
+    queue.PushInstance(scene, single, eye, 1000.0f);
+    queue.Sort();
+    queue.BuildDrawList();
+    const Frustum away = Frustum::FromPerspective(eye, Vector3(0.5f, 0.5f, -10.0f), Vector3(0.0f, 1.0f, 0.0f), 30.0f, 1.0f, 0.1f, 100.0f);
+    queue.CullClusters(scene, away, eye, false);
+    EXPECT_EQ(queue.GetDrawList()[0].instanceCount, 0u);
+    EXPECT_EQ(queue.GetStats().clustersCulled, 16u);
+}
+
+TEST(RenderQueue, PushPrefabInstancesExpandsParts)
+{
+    Scene scene;
+    InitScene(scene);
+    const uint32_t meshId = AddQuadRow(scene, 1);
+    Prefab prefab;
+    prefab.name = "pair";
+    prefab.parts.push_back({ meshId, MakeTransform(0.0f, 0.0f, 0.0f) });
+    prefab.parts.push_back({ meshId, MakeTransform(100.0f, 0.0f, 0.0f) });
+    const uint32_t prefabId = AddPrefab(scene, std::move(prefab));
+    EXPECT_EQ(scene.prefabs[prefabId].bounds.max.x, 101.0f);
+
+    uint32_t ids[3];
+    AddPrefabInstance(scene, prefabId, MakeTransform(0.0f, 5.0f, 0.0f), &ids[0]);
+    AddPrefabInstance(scene, prefabId, MakeTransform(0.0f, 5.0f, 10.0f), &ids[1]);
+    AddPrefabInstance(scene, prefabId, MakeTransform(0.0f, 5.0f, 20.0f), &ids[2]);
+    scene.prefabInstances.erase(ids[2]);
+
+    const Vector3 eye(0.5f, 5.5f, -5.0f);
+    RenderQueue queue;
+    queue.PushPrefabInstances(scene, ids, 3, eye, 1000.0f, nullptr);
+    const std::vector<RenderItem>& items = queue.GetItems();
+    // every part of the live placements, the erased one is skipped
+    ASSERT_EQ(items.size(), 4u);
+    EXPECT_EQ(items[1].instanceId, ids[0]);
+    EXPECT_EQ(items[1].prefabPart, 2u);
+    EXPECT_EQ(items[1].materialId, 7u);
+    const Transform where = GetItemTransform(scene, items[1]);
+    EXPECT_EQ(where.position.x, 100.0f);
+    EXPECT_EQ(where.position.y, 5.0f);
+
+    // the parts at x = 100 are outside
+    queue.Clear();
+    const Frustum frustum = Frustum::FromPerspective(eye, Vector3(0.5f, 5.5f, 0.0f), Vector3(0.0f, 1.0f, 0.0f), 30.0f, 1.0f, 0.1f, 100.0f);
+    queue.PushPrefabInstances(scene, ids, 3, eye, 1000.0f, &frustum);
+    ASSERT_EQ(queue.GetItems().size(), 2u);
+    EXPECT_EQ(queue.GetItems()[0].prefabPart, 1u);
+    EXPECT_EQ(queue.GetItems()[1].prefabPart, 1u);
+    EXPECT_EQ(queue.GetItems()[1].instanceId, ids[1]);
+}
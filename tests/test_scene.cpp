@@ -0,0 +1,103 @@
+#include "tests/gtest/gtest.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "Scene.hpp"
+
+using namespace m3d;
+
+static void InitScene(Scene& scene)
+{
+    scene.diffuseMaps = packed_freelist<DiffuseMap>(8);
+    scene.materials = packed_freelist<Material>(8);
+    scene.meshes = packed_freelist<Mesh>(8);
+}
+
+static Material MakeMaterial(const char* name)
+{
+    Material material = {};
+    material.name = name;
+    material.diffuse[0] = 0.5f;
+    material.shininess = 8.0f;
+    material.diffuseMapId = ImportNone;
+    return material;
+}
+
+static Mesh MakeMesh(const char* name)
+{
+    Mesh mesh;
+    mesh.name = name;
+    mesh.vertices = { 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 1.0f };
+    mesh.indices = { 0, 1, 2 };
+    mesh.slices.emplace_back(0, 1, 0);
+    // import order, the first material
+    mesh.materialIds.push_back(0);
+    return mesh;
+}
+
+static void WriteFile(const char* path, const char* content)
+{
+    std::FILE* fp = std::fopen(path, "wb");
+    std::fputs(content, fp);
+    std::fclose(fp);
+}
+
+TEST(ImportIds, MergesDuplicatesWhateverTheirNames)
+{
+    Scene scene;
+    InitScene(scene);
+    ImportIds ids;
+
+    ids.AddMaterial(scene, MakeMaterial("red"));
+    ids.AddMaterial(scene, MakeMaterial("also red"));
+    Material shinier = MakeMaterial("shinier");
+    shinier.shininess = 8.5f;
+    ids.AddMaterial(scene, std::move(shinier));
+    ASSERT_EQ(ids.materialIds.size(), 3u);
+    EXPECT_EQ(ids.materialIds[0], ids.materialIds[1]);
+    EXPECT_NE(ids.materialIds[0], ids.materialIds[2]);
+    EXPECT_EQ(ids.duplicateMaterials, 1u);
+    EXPECT_EQ(scene.materials.size(), 2u);
+
+    const uint32_t first = ids.AddMesh(scene, MakeMesh("box"));
+    EXPECT_EQ(ids.AddMesh(scene, MakeMesh("box copy")), first);
+    Mesh moved = MakeMesh("moved");
+    moved.vertices[4] = 1.5f;
+    EXPECT_NE(ids.AddMesh(scene, std::move(moved)), first);
+    // import order material 1 merged into material 0, the mesh merges too
+    Mesh renamedMaterial = MakeMesh("other material index");
+    renamedMaterial.materialIds[0] = 1;
+    EXPECT_EQ(ids.AddMesh(scene, std::move(renamedMaterial)), first);
+    EXPECT_EQ(ids.duplicateMeshes, 2u);
+    EXPECT_EQ(scene.meshes.size(), 2u);
+}
+
+TEST(ImportIds, MergesTexturesByContent)
+{
+    WriteFile("m3d_test_texture_a.bin", "same pixels");
+    WriteFile("m3d_test_texture_b.bin", "same pixels");
+    WriteFile("m3d_test_texture_c.bin", "other pixels");
+
+    Scene scene;
+    InitScene(scene);
+    ImportIds ids;
+    const char* paths[] = { "m3d_test_texture_a.bin", "m3d_test_texture_b.bin", "m3d_test_texture_c.bin" };
+    for (const char* path : paths) {
+        DiffuseMap diffuseMap;
+        diffuseMap.path = path;
+        // hashed ahead like SceneLoader does
+        const uint64_t contentHash = HashTextureContent(diffuseMap);
+        ids.AddTexture(scene, std::move(diffuseMap), contentHash);
+    }
+    ASSERT_EQ(ids.textureIds.size(), 3u);
+    EXPECT_EQ(ids.textureIds[0], ids.textureIds[1]);
+    EXPECT_NE(ids.textureIds[0], ids.textureIds[2]);
+    EXPECT_EQ(ids.duplicateTextures, 1u);
+    EXPECT_EQ(scene.diffuseMaps[ids.textureIds[1]].path, "m3d_test_texture_a.bin");
+
+    for (const char* path : paths) {
+        std::remove(path);
+    }
+}
@@ -0,0 +1,112 @@
+#include "tests/gtest/gtest.h"
+
+#include <cstdio>
+#include <vector>
+
+#include "Scene.hpp"
+#include "SceneAsset.hpp"
+
+using namespace m3d;
+using m3d::math::Vector3;
+
+static void InitScene(Scene& scene, uint32_t meshCapacity)
+{
+    scene.diffuseMaps = packed_freelist<DiffuseMap>(4);
+    scene.materials = packed_freelist<Material>(4);
+    scene.meshes = packed_freelist<Mesh>(meshCapacity);
+    scene.transforms = packed_freelist<Transform>(8);
+    scene.instances = packed_freelist<Instance>(8);
+}
+
+// 17 triangles over 65536 vertices: a block of 8 bit deltas, one of 16 bit, one of 32 bit and a 3 index tail
+static Mesh MakeMesh()
+{
+    Mesh mesh;
+    mesh.name = "blocks";
+    mesh.vertices.resize(65536 * 4, 1.0f);
+    for (uint32_t i = 0; i < 16; ++i)
+        mesh.indices.push_back(i);
+    for (uint32_t i = 1; i <= 16; ++i)
+        mesh.indices.push_back(i * 1000);
+    for (uint32_t i = 0; i < 16; ++i)
+        mesh.indices.push_back(i % 2 ? 60000 : 0);
+    mesh.indices.insert(mesh.indices.end(), { 5, 6, 7 });
+    mesh.slices.emplace_back(0, 17, 0);
+    mesh.bounds = AABB::Empty();
+    mesh.bounds.Expand(Vector3(0.0f, 0.0f, 0.0f));
+    mesh.bounds.Expand(Vector3(1.0f, 1.0f, 1.0f));
+    return mesh;
+}
+
+static const Mesh* FindMesh(const Scene& scene, const std::string& name)
+{
+    for (uint32_t id : scene.meshes) {
+        if (scene.meshes[id].name == name)
+            return &scene.meshes[id];
+    }
+    return nullptr;
+}
+
+TEST(SceneAsset, RoundTripsIndicesInBothEncodings)
+{
+    const char* path = "m3d_test_scene.m3ds";
+    const Mesh original = MakeMesh();
+    for (int compress = 0; compress < 2; ++compress) {
+        Scene saved;
+        InitScene(saved, 4);
+        Mesh mesh = original;
+        AddInstance(saved, saved.meshes.insert(std::move(mesh)), nullptr);
+        ASSERT_TRUE(SaveSceneAsset(saved, path, compress != 0));
+
+        Scene loaded;
+        InitScene(loaded, 4);
+        ASSERT_TRUE(LoadSceneAsset(loaded, path));
+        ASSERT_EQ(loaded.instances.size(), 1u);
+        const Mesh* result = FindMesh(loaded, "blocks");
+        ASSERT_NE(result, nullptr);
+        // uncompressed indices are used in place, compressed ones decoded
+        EXPECT_EQ(result->mappedIndices.data() != nullptr, compress == 0);
+        const ArrayView<uint32_t> indices = result->GetIndices();
+        ASSERT_EQ(indices.size(), original.indices.size());
+        for (size_t i = 0; i < indices.size(); ++i) {
+            ASSERT_EQ(indices[i], original.indices[i]) << i;
+        }
+        ASSERT_EQ(result->slices.size(), 1u);
+        EXPECT_EQ(result->slices[0].triangleCount, 17);
+        EXPECT_EQ(result->GetVertices().size(), original.vertices.size());
+    }
+    std::remove(path);
+}
+
+TEST(SceneAsset, RejectsMeshesWithBadSlices)
+{
+    const char* path = "m3d_test_scene.m3ds";
+    Scene saved;
+    InitScene(saved, 4);
+    saved.meshes.insert(MakeMesh());
+    Mesh broken = MakeMesh();
+    broken.name = "broken";
+    // runs past the 51 indices
+    broken.slices.emplace_back(48, 2, 0);
+    saved.meshes.insert(std::move(broken));
+    ASSERT_TRUE(SaveSceneAsset(saved, path));
+
+    Scene loaded;
+    InitScene(loaded, 4);
+    ASSERT_TRUE(LoadSceneAsset(loaded, path));
+    const Mesh* good = FindMesh(loaded, "blocks");
+    const Mesh* bad = FindMesh(loaded, "broken");
+    ASSERT_NE(good, nullptr);
+    ASSERT_NE(bad, nullptr);
+    EXPECT_EQ(good->GetIndices().size(), 51u);
+    // nothing of the broken mesh is drawn
+    EXPECT_TRUE(bad->GetIndices().empty());
+    EXPECT_TRUE(bad->slices.empty());
+
+    // two meshes do not fit in a scene with room for one, nothing is added
+    Scene full;
+    InitScene(full, 1);
+    EXPECT_FALSE(LoadSceneAsset(full, path));
+    EXPECT_EQ(full.meshes.size(), 0u);
+    std::remove(path);
+}
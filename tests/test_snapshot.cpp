@@ -0,0 +1,99 @@
+#include "tests/gtest/gtest.h"
+
+#include <thread>
+
+#include "Snapshot.hpp"
+
+using namespace m3d;
+
+TEST(Snapshot, CowArraySharesUnchangedChunks)
+{
+    CowArray<int> a;
+    a.Resize(1000);
+    EXPECT_EQ(a.GetChunkCount(), 4u);
+    EXPECT_EQ(a[999], 0);
+    for (int i = 0; i < 1000; ++i) {
+        a.Write(i) = i;
+    }
+
+    CowArray<int> b = a;
+    b.Write(300) = -1;
+    // only the written chunk was cloned
+    EXPECT_TRUE(b.SharesChunk(a, 0));
+    EXPECT_FALSE(b.SharesChunk(a, 1));
+    EXPECT_TRUE(b.SharesChunk(a, 2));
+    EXPECT_EQ(a[300], 300);
+    EXPECT_EQ(b[300], -1);
+    EXPECT_EQ(b[301], 301);
+
+    // a chunk held by one copy only is written in place
+    const int* chunk = b.GetChunk(1);
+    b.Write(301) = -2;
+    EXPECT_EQ(b.GetChunk(1), chunk);
+
+    b.Resize(300);
+    EXPECT_EQ(b.GetChunkCount(), 2u);
+    b.Resize(600);
+    EXPECT_EQ(b[599], 0);
+    EXPECT_FALSE(b.SharesChunk(a, 2));
+}
+
+TEST(Snapshot, ExchangeHandsOverLatest)
+{
+    SnapshotExchange<CowArray<int>> exchange;
+    EXPECT_EQ(exchange.Acquire(), nullptr);
+
+    CowArray<int>& first = exchange.BeginWrite();
+    first.Resize(600);
+    first.Write(0) = 1;
+    exchange.Publish();
+
+    const CowArray<int>* read = exchange.Acquire();
+    ASSERT_NE(read, nullptr);
+    EXPECT_EQ((*read)[0], 1);
+    EXPECT_EQ(exchange.Acquire(), read);
+
+    // two frames published while the reader holds the first
+    for (int frame = 2; frame <= 3; ++frame) {
+        CowArray<int>& next = exchange.BeginWrite();
+        EXPECT_EQ(next[0], frame - 1);
+        next.Write(0) = frame;
+        exchange.Publish();
+    }
+    EXPECT_EQ((*read)[0], 1);
+    const CowArray<int>* latest = exchange.Acquire();
+    EXPECT_EQ((*latest)[0], 3);
+    // the untouched chunks are the first frame's memory
+    EXPECT_TRUE(latest->SharesChunk(*read, 1) || read == latest);
+}
+
+TEST(Snapshot, ConcurrentWriterAndReader)
+{
+    // every element of a published frame holds the frame number
+    SnapshotExchange<CowArray<uint32_t>> exchange;
+    const uint32_t frames = 2000;
+    std::thread writer([&]() {
+        for (uint32_t frame = 1; frame <= frames; ++frame) {
+            CowArray<uint32_t>& snapshot = exchange.BeginWrite();
+            snapshot.Resize(1024);
+            for (uint32_t i = 0; i < snapshot.Size(); ++i) {
+                snapshot.Write(i) = frame;
+            }
+            exchange.Publish();
+        }
+    });
+
+    uint32_t last = 0;
+    while (last < frames) {
+        const CowArray<uint32_t>* snapshot = exchange.Acquire();
+        if (!snapshot)
+            continue;
+        const uint32_t frame = (*snapshot)[0];
+        ASSERT_GE(frame, last);
+        for (uint32_t i = 0; i < snapshot->Size(); ++i) {
+            ASSERT_EQ((*snapshot)[i], frame);
+        }
+        last = frame;
+    }
+    writer.join();
+}
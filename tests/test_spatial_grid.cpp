@@ -0,0 +1,142 @@
+#include "tests/gtest/gtest.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "SpatialGrid.hpp"
+
+using namespace m3d;
+using m3d::math::Vector3;
+
+static AABB MakeBox(float x, float y, float z, float halfSize)
+{
+    AABB box;
+    box.min = Vector3(x - halfSize, y - halfSize, z - halfSize);
+    box.max = Vector3(x + halfSize, y + halfSize, z + halfSize);
+    return box;
+}
+
+TEST(SpatialGrid, AABBQueryMatchesBruteForce)
+{
+    SpatialGrid grid;
+    grid.Init(4.0f, 1024);
+
+    std::vector<AABB> boxes;
+    for (uint32_t i = 0; i < 512; ++i) {
+        // every 64th object is larger than a cell and lands in the oversized list
+        const float halfSize = (i % 64 == 0) ? 6.0f : 0.5f + (i % 3) * 0.5f;
+        boxes.push_back(MakeBox((i * 37 % 101) - 50.0f, (i * 17 % 23) - 11.0f, (i * 53 % 97) - 48.0f, halfSize));
+        grid.Insert(i, boxes.back());
+    }
+    EXPECT_EQ(grid.size(), 512u);
+
+    const AABB query = MakeBox(3.0f, 0.0f, -7.0f, 9.0f);
+    std::vector<uint32_t> found;
+    grid.QueryAABB(query, [&found](uint32_t id, const AABB&) { found.push_back(id); });
+
+    std::vector<uint32_t> expected;
+    for (uint32_t i = 0; i < boxes.size(); ++i) {
+        if (Intersects(query, boxes[i]))
+            expected.push_back(i);
+    }
+    std::sort(found.begin(), found.end());
+    EXPECT_EQ(found, expected);
+}
+
+TEST(SpatialGrid, MoveAndRemove)
+{
+    SpatialGrid grid;
+    grid.Init(2.0f, 16);
+
+    grid.Insert(3, MakeBox(0.0f, 0.0f, 0.0f, 0.5f));
+    grid.Insert(5, MakeBox(0.5f, 0.0f, 0.0f, 0.5f));
+    EXPECT_EQ(grid.cellCount(), 1u);
+
+    grid.Move(3, MakeBox(100.0f, 0.0f, 0.0f, 0.5f));
+    EXPECT_EQ(grid.cellCount(), 2u);
+
+    std::vector<uint32_t> found;
+    grid.QuerySphere(Sphere{ Vector3(100.0f, 0.0f, 0.0f), 1.0f }, [&found](uint32_t id, const AABB&) { found.push_back(id); });
+    ASSERT_EQ(found.size(), 1u);
+    EXPECT_EQ(found[0], 3u);
+
+    grid.Remove(5);
+    EXPECT_FALSE(grid.Contains(5));
+    EXPECT_EQ(grid.cellCount(), 1u);
+    EXPECT_EQ(grid.size(), 1u);
+}
+
+TEST(SpatialGrid, FrustumAndRay)
+{
+    SpatialGrid grid;
+    grid.Init(4.0f, 16);
+
+    grid.Insert(0, MakeBox(0.0f, 0.0f, -20.0f, 1.0f));
+    grid.Insert(1, MakeBox(0.0f, 0.0f, 20.0f, 1.0f));
+
+    const Frustum frustum = Frustum::FromPerspective(Vector3(0.0f, 0.0f, 0.0f), Vector3(0.0f, 0.0f, -1.0f), Vector3(0.0f, 1.0f, 0.0f), 60.0f, 1.0f, 0.1f, 100.0f);
+    std::vector<uint32_t> visible;
+    grid.QueryFrustum(frustum, [&visible](uint32_t id, const AABB&, Containment) { visible.push_back(id); });
+    ASSERT_EQ(visible.size(), 1u);
+    EXPECT_EQ(visible[0], 0u);
+
+    const Ray ray = { Vector3(0.0f, 0.0f, 0.0f), Vector3(0.0f, 0.0f, 1.0f), 1000.0f };
+    std::vector<uint32_t> hits;
+    grid.QueryRay(ray, [&hits](uint32_t id, const AABB&, float t) {
+        EXPECT_NEAR(t, 19.0f, 1e-4f);
+        hits.push_back(id);
+    });
+    ASSERT_EQ(hits.size(), 1u);
+    EXPECT_EQ(hits[0], 1u);
+}
+
+TEST(SpatialGrid, FrustumCachedMatchesUncached)
+{
+    SpatialGrid grid;
+    grid.Init(4.0f, 2048);
+
+    std::vector<AABB> boxes;
+    for (uint32_t i = 0; i < 2000; ++i) {
+        // every 128th object goes to the oversized list
+        const float halfSize = (i % 128 == 0) ? 5.0f : 0.5f + (i % 3) * 0.5f;
+        boxes.push_back(MakeBox((i * 37 % 201) - 100.0f, (i * 17 % 23) - 11.0f, (i * 53 % 197) - 98.0f, halfSize));
+        grid.Insert(i, boxes.back());
+    }
+
+    typedef std::pair<uint32_t, Containment> Result;
+    auto collect = [](std::vector<Result>& out) {
+        return [&out](uint32_t id, const AABB&, Containment c) { out.push_back(Result(id, c)); };
+    };
+
+    FrustumCache cache;
+    for (uint32_t frame = 0; frame < 40; ++frame) {
+        // a slowly turning camera, still every 4th frame, and a few moving objects
+        const float angle = (frame - frame / 4) * 0.05f;
+        const Vector3 eye(0.0f, 2.0f, 0.0f);
+        const Vector3 target(std::sin(angle), 2.0f, std::cos(angle));
+        const Frustum frustum = Frustum::FromPerspective(eye, target, Vector3(0.0f, 1.0f, 0.0f), 60.0f, 1.5f, 0.1f, 80.0f);
+        for (uint32_t i = frame; i < boxes.size(); i += 97) {
+            boxes[i] = MakeBox(boxes[i].Center().x + 3.0f, boxes[i].Center().y, boxes[i].Center().z - 2.0f, boxes[i].Extents().x);
+            grid.Move(i, boxes[i]);
+        }
+
+        std::vector<Result> expected;
+        grid.QueryFrustum(frustum, collect(expected));
+        std::vector<Result> found;
+        grid.QueryFrustumCached(frustum, cache, collect(found));
+        std::sort(expected.begin(), expected.end());
+        std::sort(found.begin(), found.end());
+        ASSERT_EQ(found, expected) << frame;
+    }
+
+    // the same frustum again with one object moved: only that object, and the cell it may have opened, are tested
+    const Frustum frustum = Frustum::FromPerspective(Vector3(0.0f, 2.0f, 0.0f), Vector3(0.0f, 2.0f, 1.0f), Vector3(0.0f, 1.0f, 0.0f), 60.0f, 1.5f, 0.1f, 80.0f);
+    grid.QueryFrustumCached(frustum, cache, [](uint32_t, const AABB&, Containment) {});
+    grid.Move(7, MakeBox(0.0f, 2.0f, 10.0f, 0.5f));
+    uint32_t visible = 0;
+    grid.QueryFrustumCached(frustum, cache, [&visible](uint32_t id, const AABB&, Containment) { visible += id == 7 ? 1 : 0; });
+    EXPECT_EQ(visible, 1u);
+    EXPECT_LE(cache.GetStats().cellTests, 1u);
+    EXPECT_LE(cache.GetStats().objectTests, 1u);
+    EXPECT_GT(cache.GetStats().cellsReused, 0u);
+}
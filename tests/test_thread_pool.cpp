@@ -0,0 +1,34 @@
+#include "tests/gtest/gtest.h"
+
+#include <atomic>
+#include <vector>
+
+#include "ThreadPool.hpp"
+
+using namespace m3d;
+
+TEST(ThreadPool, ParallelForCoversRangeOnce)
+{
+    ThreadPool pool(3);
+    std::vector<std::atomic<int>> hits(10007);
+    for (auto& hit : hits)
+        hit = 0;
+
+    pool.ParallelFor(0, static_cast<uint32_t>(hits.size()), 64, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i)
+            ++hits[i];
+    });
+    for (const auto& hit : hits)
+        ASSERT_EQ(hit.load(), 1);
+}
+
+TEST(ThreadPool, NestedParallelFor)
+{
+    ThreadPool pool(3);
+    std::atomic<uint32_t> sum(0);
+    // inner loops run while the outer one holds every worker
+    pool.ParallelFor(0, 16, 1, [&](uint32_t, uint32_t) {
+        pool.ParallelFor(0, 1000, 10, [&](uint32_t begin, uint32_t end) { sum += end - begin; });
+    });
+    EXPECT_EQ(sum.load(), 16000u);
+}
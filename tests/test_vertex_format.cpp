@@ -0,0 +1,70 @@
+#include "tests/gtest/gtest.h"
+
+#include <cstring>
+#include <vector>
+
+#include "VertexFormat.hpp"
+
+using namespace m3d;
+
+TEST(VertexFormat, Layout)
+{
+    const VertexFormat compact = CompactVertexFormat();
+    EXPECT_EQ(compact.stride, 24u);
+    EXPECT_EQ(compact.offsets[VertexPosition], 0u);
+    EXPECT_EQ(compact.offsets[VertexNormal], 12u);
+    EXPECT_EQ(compact.offsets[VertexUV], 16u);
+    EXPECT_EQ(compact.offsets[VertexTangent], 20u);
+
+    VertexFormat format;
+    ASSERT_TRUE(MakeVertexFormat(format, VertexEncodingFloat16, VertexEncodingSnorm16, VertexEncodingNone, VertexEncodingNone));
+    // half position padded to four components
+    EXPECT_EQ(format.stride, 16u);
+    EXPECT_FALSE(format.Has(VertexUV));
+    EXPECT_FALSE(MakeVertexFormat(format, VertexEncodingSnorm16, VertexEncodingNone, VertexEncodingNone, VertexEncodingNone));
+    EXPECT_FALSE(MakeVertexFormat(format, VertexEncodingNone, VertexEncodingFloat32, VertexEncodingNone, VertexEncodingNone));
+}
+
+TEST(VertexFormat, HalfConversion)
+{
+    EXPECT_EQ(FloatToHalf(0.0f), 0x0000);
+    EXPECT_EQ(FloatToHalf(-0.0f), 0x8000);
+    EXPECT_EQ(FloatToHalf(1.0f), 0x3C00);
+    EXPECT_EQ(FloatToHalf(-2.0f), 0xC000);
+    EXPECT_EQ(FloatToHalf(0.1f), 0x2E66);
+    EXPECT_EQ(FloatToHalf(65504.0f), 0x7BFF);
+    EXPECT_EQ(FloatToHalf(1e6f), 0x7C00);
+    // smallest subnormal
+    EXPECT_EQ(FloatToHalf(5.96046448e-8f), 0x0001);
+}
+
+TEST(VertexFormat, PackCompact)
+{
+    const std::vector<float> positions = { 1.0f, 2.0f, 3.0f, 1.0f };
+    const std::vector<float> normals = { 0.0f, -1.0f, 0.0f };
+    const std::vector<float> uvs = { 0.5f, 1.0f };
+
+    const VertexFormat format = CompactVertexFormat();
+    std::vector<uint8_t> packed(format.stride);
+    PackVertices(format, positions.data(), normals.data(), uvs.data(), nullptr, 1, packed.data());
+
+    float position[3];
+    std::memcpy(position, &packed[format.offsets[VertexPosition]], sizeof(position));
+    EXPECT_EQ(position[0], 1.0f);
+    EXPECT_EQ(position[2], 3.0f);
+
+    const int8_t* normal = reinterpret_cast<const int8_t*>(&packed[format.offsets[VertexNormal]]);
+    EXPECT_EQ(normal[0], 0);
+    EXPECT_EQ(normal[1], -127);
+    EXPECT_EQ(normal[2], 0);
+
+    uint16_t uv[2];
+    std::memcpy(uv, &packed[format.offsets[VertexUV]], sizeof(uv));
+    EXPECT_EQ(uv[0], 0x3800);
+    EXPECT_EQ(uv[1], 0x3C00);
+
+    // no tangents given, +x with a positive sign
+    const int8_t* tangent = reinterpret_cast<const int8_t*>(&packed[format.offsets[VertexTangent]]);
+    EXPECT_EQ(tangent[0], 127);
+    EXPECT_EQ(tangent[3], 127);
+}
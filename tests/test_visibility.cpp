@@ -0,0 +1,71 @@
+#include "tests/gtest/gtest.h"
+
+#include <vector>
+
+#include "ThreadPool.hpp"
+#include "Visibility.hpp"
+
+using namespace m3d;
+using m3d::math::Vector3;
+
+TEST(Visibility, MasksMatchClassifyPerView)
+{
+    // four views looking along each horizontal axis and one straight down
+    const Vector3 up(0.0f, 1.0f, 0.0f);
+    std::vector<Frustum> frustums;
+    frustums.push_back(Frustum::FromPerspective(Vector3(0.0f, 0.0f, 0.0f), Vector3(1.0f, 0.0f, 0.0f), up, 60.0f, 1.0f, 0.1f, 50.0f));
+    frustums.push_back(Frustum::FromPerspective(Vector3(0.0f, 0.0f, 0.0f), Vector3(-1.0f, 0.0f, 0.0f), up, 60.0f, 1.0f, 0.1f, 50.0f));
+    frustums.push_back(Frustum::FromPerspective(Vector3(0.0f, 0.0f, 0.0f), Vector3(0.0f, 0.0f, 1.0f), up, 90.0f, 1.5f, 0.1f, 30.0f));
+    frustums.push_back(Frustum::FromPerspective(Vector3(5.0f, 0.0f, 5.0f), Vector3(5.0f, 0.0f, -1.0f), up, 45.0f, 1.0f, 1.0f, 80.0f));
+    frustums.push_back(Frustum::FromPerspective(Vector3(0.0f, 40.0f, 0.0f), Vector3(0.0f, 0.0f, 0.0f), Vector3(0.0f, 0.0f, 1.0f), 70.0f, 1.0f, 1.0f, 100.0f));
+
+    ViewSet views;
+    for (uint32_t v = 0; v < frustums.size(); ++v) {
+        EXPECT_EQ(views.AddView(frustums[v]), v);
+    }
+    EXPECT_EQ(views.GetAllViewsMask(), 0x1Fu);
+
+    std::vector<AABB> boxes;
+    for (uint32_t i = 0; i < 5000; ++i) {
+        const Vector3 center((i * 37 % 201) - 100.0f, (i * 17 % 41) - 20.0f, (i * 53 % 197) - 98.0f);
+        const float halfSize = 0.5f + (i % 4);
+        AABB box;
+        box.min = center - Vector3(halfSize, halfSize, halfSize);
+        box.max = center + Vector3(halfSize, halfSize, halfSize);
+        boxes.push_back(box);
+    }
+    ThreadPool pool(3);
+    std::vector<uint32_t> masks(boxes.size());
+    views.TestAll(boxes.data(), boxes.size(), masks.data(), pool, 256);
+
+    uint32_t visible = 0;
+    for (uint32_t i = 0; i < boxes.size(); ++i) {
+        uint32_t expected = 0;
+        for (uint32_t v = 0; v < frustums.size(); ++v) {
+            expected |= Classify(frustums[v], boxes[i]) != Containment::Outside ? 1u << v : 0;
+        }
+        ASSERT_EQ(masks[i], expected) << i;
+        visible += expected ? 1 : 0;
+    }
+    // the views see some of the boxes, not all of them
+    EXPECT_GT(visible, 0u);
+    EXPECT_LT(visible, boxes.size());
+}
+
+TEST(Visibility, CollectsOneView)
+{
+    const uint32_t ids[] = { 10, 11, 12, 13 };
+    const uint32_t masks[] = { 0x1, 0x3, 0x0, 0x2 };
+    std::vector<uint32_t> out;
+    CollectVisible(ids, masks, 4, 1, out);
+    ASSERT_EQ(out.size(), 2u);
+    EXPECT_EQ(out[0], 11u);
+    EXPECT_EQ(out[1], 13u);
+
+    ViewSet views;
+    EXPECT_EQ(views.GetAllViewsMask(), 0u);
+    AABB box;
+    box.min = Vector3(-1.0f, -1.0f, -1.0f);
+    box.max = Vector3(1.0f, 1.0f, 1.0f);
+    EXPECT_EQ(views.Test(box), 0u);
+}